@@ -0,0 +1,241 @@
+// GLReplay: plays back a GL trace the viewer recorded with --trace, frame by frame and
+// with timing. The exact call stream of a slow frame can be measured again, repeated as
+// a micro-benchmark or run on another driver. Also compares the call counts of two
+// traces, e.g. the same scene recorded with two builds.
+//
+//   GLReplay <trace> [--repeat n] [--frames first-last] [--hidden]
+//   GLReplay <trace> --counts
+//   GLReplay <trace> --diff <other trace>
+//
+// Frame 0 holds everything up to the first SwapBuffers, loading included, and is played
+// once without timing. The timed frames are played 'repeat' times in a row; GL state
+// simply carries over from the previous pass, which is how the viewer renders them too.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the frames the counts are compared over, loading only distorts the per frame numbers
+static void steadyFrames(const GLTraceFile& trace, size_t& first, size_t& last)
+{
+	first = trace.frameCount() > 1 ? 1 : 0;
+	last = trace.frameCount();
+}
+
+static int printCounts(const GLTraceFile& trace)
+{
+	size_t first, last;
+	steadyFrames(trace, first, last);
+	std::vector<uint64_t> counts = trace.callCounts(first, last);
+	std::vector<size_t> order;
+	uint64_t total = 0;
+	for (size_t i = 1; i < counts.size(); i++)
+	{
+		if (counts[i] > 0)
+			order.push_back(i);
+		total += counts[i];
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return counts[a] > counts[b]; });
+	double frames = (double)std::max<size_t>(last - first, 1);
+	std::printf("%-36s %12s %12s\n", "call", "total", "per frame");
+	for (size_t i : order)
+		std::printf("%-36s %12llu %12.1f\n", glTraceCallName((GLTraceCall)i), (unsigned long long)counts[i], counts[i] / frames);
+	std::printf("%-36s %12llu %12.1f  (frames %zu-%zu)\n", "all", (unsigned long long)total, total / frames, first, last - 1);
+	return 0;
+}
+
+// per frame averages, so traces of different length compare
+static int printDiff(const GLTraceFile& a, const GLTraceFile& b)
+{
+	size_t firstA, lastA, firstB, lastB;
+	steadyFrames(a, firstA, lastA);
+	steadyFrames(b, firstB, lastB);
+	std::vector<uint64_t> countsA = a.callCounts(firstA, lastA);
+	std::vector<uint64_t> countsB = b.callCounts(firstB, lastB);
+	double framesA = (double)std::max<size_t>(lastA - firstA, 1);
+	double framesB = (double)std::max<size_t>(lastB - firstB, 1);
+
+	std::vector<size_t> changed;
+	double totalA = 0.0, totalB = 0.0;
+	for (size_t i = 1; i < countsA.size(); i++)
+	{
+		double perFrameA = countsA[i] / framesA;
+		double perFrameB = countsB[i] / framesB;
+		totalA += perFrameA;
+		totalB += perFrameB;
+		if (std::abs(perFrameA - perFrameB) >= 0.05)
+			changed.push_back(i);
+	}
+	auto delta = [&](size_t i) { return countsB[i] / framesB - countsA[i] / framesA; };
+	std::sort(changed.begin(), changed.end(), [&](size_t x, size_t y) { return std::abs(delta(x)) > std::abs(delta(y)); });
+
+	std::printf("%-36s %12s %12s %12s\n", "calls per frame", "a", "b", "b - a");
+	for (size_t i : changed)
+		std::printf("%-36s %12.1f %12.1f %+12.1f\n", glTraceCallName((GLTraceCall)i), countsA[i] / framesA, countsB[i] / framesB, delta(i));
+	std::printf("%-36s %12.1f %12.1f %+12.1f\n", "all", totalA, totalB, totalB - totalA);
+	if (changed.empty())
+		std::cout << "same calls per frame" << std::endl;
+	return 0;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5))];
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: GLReplay <trace> [--repeat n] [--frames first-last] [--hidden] | --counts | --diff <other trace>" << std::endl;
+		return 1;
+	}
+	GLTraceFile trace;
+	if (!trace.open(argv[1]))
+		return 1;
+
+	int repeat = 10;
+	size_t firstFrame = 1;
+	size_t lastFrame = trace.frameCount() > 0 ? trace.frameCount() - 1 : 0;
+	bool hidden = false;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--counts")
+			return printCounts(trace);
+		if (arg == "--diff" && i + 1 < argc)
+		{
+			GLTraceFile other;
+			if (!other.open(argv[++i]))
+				return 1;
+			return printDiff(trace, other);
+		}
+		if (arg == "--repeat" && i + 1 < argc)
+			repeat = std::max(1, std::atoi(argv[++i]));
+		if (arg == "--frames" && i + 1 < argc)
+		{
+			unsigned first = 0, last = 0;
+			if (std::sscanf(argv[++i], "%u-%u", &first, &last) == 2)
+			{
+				firstFrame = first;
+				lastFrame = last;
+			}
+		}
+		if (arg == "--hidden")
+			hidden = true;
+	}
+	if (trace.frameCount() < 2)
+	{
+		std::cout << "ERROR::GLREPLAY::NO_FRAMES " << argv[1] << " has " << trace.frameCount() << " frames, frame 0 is only the loading" << std::endl;
+		return 1;
+	}
+	firstFrame = std::max<size_t>(firstFrame, 1);
+	lastFrame = std::min(lastFrame, trace.frameCount() - 1);
+	if (firstFrame > lastFrame)
+	{
+		std::cout << "ERROR::GLREPLAY::FRAMES the trace has frames 1-" << trace.frameCount() - 1 << std::endl;
+		return 1;
+	}
+
+	// the same context the viewer asks for, the default framebuffer as big as it was
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	if (hidden)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(std::max(trace.width(), 1), std::max(trace.height(), 1), "GLReplay", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+	glfwSwapInterval(0);
+	std::cout << "Replaying " << argv[1] << " on " << (const char*)glGetString(GL_RENDERER) << std::endl;
+
+	GLTracePlayer player(trace);
+	auto loadBegin = std::chrono::high_resolution_clock::now();
+	for (size_t f = 0; f < firstFrame; f++)
+	{
+		player.play(f);
+		glfwSwapBuffers(window);
+	}
+	glFinish();
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadBegin).count();
+
+	// best of the repeats per frame: what the call stream costs without outside noise
+	size_t frames = lastFrame - firstFrame + 1;
+	std::vector<double> submitMs(frames, 1e30), frameMs(frames, 1e30);
+	for (int r = 0; r < repeat && !glfwWindowShouldClose(window); r++)
+	{
+		for (size_t f = firstFrame; f <= lastFrame; f++)
+		{
+			auto begin = std::chrono::high_resolution_clock::now();
+			player.play(f);
+			auto submitted = std::chrono::high_resolution_clock::now();
+			glFinish();
+			auto finished = std::chrono::high_resolution_clock::now();
+			submitMs[f - firstFrame] = std::min(submitMs[f - firstFrame], std::chrono::duration<double, std::milli>(submitted - begin).count());
+			frameMs[f - firstFrame] = std::min(frameMs[f - firstFrame], std::chrono::duration<double, std::milli>(finished - begin).count());
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+	}
+
+	std::vector<double> recordedMs;
+	for (size_t f = firstFrame; f <= lastFrame; f++)
+		recordedMs.push_back(trace.recordedMs(f));
+	std::vector<uint64_t> counts = trace.callCounts(firstFrame, lastFrame + 1);
+	uint64_t calls = 0;
+	for (size_t i = 1; i < counts.size(); i++)
+		calls += counts[i];
+
+	std::cout << "Frames " << firstFrame << "-" << lastFrame << ", best of " << repeat << ", " << calls / (double)frames << " calls per frame"
+		<< " (loading " << loadMs << " ms)" << std::endl;
+	std::printf("%-24s %10s %10s %10s %10s\n", "ms", "median", "p95", "max", "min");
+	std::printf("%-24s %10.3f %10.3f %10.3f %10.3f\n", "submit", percentile(submitMs, 0.5), percentile(submitMs, 0.95), percentile(submitMs, 1.0), percentile(submitMs, 0.0));
+	std::printf("%-24s %10.3f %10.3f %10.3f %10.3f\n", "submit + glFinish", percentile(frameMs, 0.5), percentile(frameMs, 0.95), percentile(frameMs, 1.0), percentile(frameMs, 0.0));
+	std::printf("%-24s %10.3f %10.3f %10.3f %10.3f\n", "recorded (viewer CPU)", percentile(recordedMs, 0.5), percentile(recordedMs, 0.95), percentile(recordedMs, 1.0), percentile(recordedMs, 0.0));
+
+	// the frames worth a closer look
+	std::vector<size_t> slowest(frames);
+	for (size_t i = 0; i < frames; i++)
+		slowest[i] = i;
+	std::sort(slowest.begin(), slowest.end(), [&](size_t a, size_t b) { return frameMs[a] > frameMs[b]; });
+	std::cout << "Slowest frames:";
+	for (size_t i = 0; i < std::min<size_t>(5, frames); i++)
+	{
+		std::vector<uint64_t> frameCounts = trace.callCounts(firstFrame + slowest[i], firstFrame + slowest[i] + 1);
+		uint64_t frameCalls = 0;
+		for (size_t c = 1; c < frameCounts.size(); c++)
+			frameCalls += frameCounts[c];
+		std::cout << " " << firstFrame + slowest[i] << " (" << frameMs[slowest[i]] << " ms, " << frameCalls << " calls)";
+	}
+	std::cout << std::endl;
+	if (player.skippedCalls() > 0)
+		std::cout << "WARNING::GLREPLAY::UNKNOWN_CALLS " << player.skippedCalls() << " calls this build doesn't know were skipped" << std::endl;
+
+	glfwTerminate();
+	return 0;
+}
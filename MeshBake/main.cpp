@@ -0,0 +1,124 @@
+// MeshBake: converts OBJ/glTF files into the binary container from BakedMesh.h so
+// the viewer can map them instead of parsing text at startup.
+//
+//   MeshBake <input.obj|.gltf|.glb> <output.bmesh> [--format quantized|float] [--lods n] [--no-meshlets]
+//   MeshBake <input.png|.jpg|.tga> <output.ktx2> [--bc 1|3|5|7] [--linear] [--mips box|kaiser]
+//
+// The vertex format has to match the one the viewer's MeshArena uses, the default
+// (16 bit positions, octahedral normals, half float uvs) is what OpenGLRefresh renders
+// with (ShaderVariants::vertexFormat()).
+// Meshes get a chain of up to 8 simplified LODs, each about half the triangles of the
+// one before (see MeshSimplify.h); --lods 1 bakes only the source triangles. The source
+// triangles are also split into meshlets for cluster culling (see MeshletBuilder.h).
+// Textures default to what the file name says (_D sRGB BC7, _N BC5, see TextureImport.h).
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "BakedMesh.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshImport.h"
+#include "TextureImport.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int bakeTexture(const std::string& input, const std::string& output, int argc, char** argv)
+{
+	TextureImportSettings settings = TextureImportSettings::fromName(input);
+	for (int i = 3; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bc" && i + 1 < argc)
+		{
+			int bc = std::atoi(argv[++i]);
+			settings.format = bc == 1 ? BcFormat::BC1 : bc == 3 ? BcFormat::BC3 : bc == 5 ? BcFormat::BC5 : BcFormat::BC7;
+		}
+		if (arg == "--linear")
+			settings.srgb = false;
+		if (arg == "--mips" && i + 1 < argc)
+			settings.mipFilter = std::string(argv[++i]) == "box" ? MipFilter::Box : MipFilter::Kaiser;
+	}
+	if (settings.format == BcFormat::BC5)
+		settings.srgb = false;
+
+	MappedFile source(input);
+	if (!source.isOpen())
+		return 1;
+	JobSystem jobs;
+	TextureImportReport report;
+	if (!importTexture(source.data(), source.size(), input, settings, output, &jobs, &report))
+		return 1;
+	report.print(input, settings);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cout << "usage: MeshBake <input.obj|.gltf|.glb> <output.bmesh> [--format quantized|float] [--lods n] [--no-meshlets]" << std::endl;
+		std::cout << "       MeshBake <input.png|.jpg|.tga> <output.ktx2> [--bc 1|3|5|7] [--linear] [--mips box|kaiser]" << std::endl;
+		return 1;
+	}
+	std::string input = argv[1];
+	std::string output = argv[2];
+	if (output.size() > 5 && output.compare(output.size() - 5, 5, ".ktx2") == 0)
+		return bakeTexture(input, output, argc, argv);
+
+	VertexFormat format;
+	format.position = PositionEncoding::Unorm16;
+	format.normal = NormalEncoding::Oct16;
+	format.uv = UvEncoding::Half;
+	size_t maxLods = BAKED_MESH_MAX_LODS;
+	bool meshlets = true;
+	for (int i = 3; i < argc; i++)
+		if (std::string(argv[i]) == "--no-meshlets")
+			meshlets = false;
+	for (int i = 3; i + 1 < argc; i++)
+	{
+		if (std::string(argv[i]) == "--format" && std::string(argv[i + 1]) == "float")
+			format = VertexFormat::full();
+		if (std::string(argv[i]) == "--lods")
+			maxLods = (size_t)std::max(1, std::atoi(argv[i + 1]));
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	JobSystem jobs;
+	LoadStats stats;
+	std::vector<BakeMeshInput> meshes;
+
+	if (!importMeshFile(input, format, &jobs, meshes, &stats, maxLods, meshlets))
+		return 1;
+	stats.print(input);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].lods.size() > 1)
+		{
+			std::cout << "  mesh " << i << " LODs:";
+			for (const BakedLod& lod : meshes[i].lods)
+				std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+			std::cout << " triangles (error)" << std::endl;
+		}
+		if (!meshes[i].meshlets.empty())
+			std::cout << "  mesh " << i << " meshlets: " << meshes[i].meshlets.size() << ", " << meshes[i].meshletVertices.size() << " meshlet vertices for "
+				<< meshes[i].vertices.vertexCount() << " vertices, " << (double)meshes[i].lods[0].indexCount / 3.0 / (double)meshes[i].meshlets.size() << " triangles each" << std::endl;
+	}
+
+	if (!writeBakedMeshFile(output, format, meshes))
+		return 1;
+
+	size_t bytes = 0;
+	for (const BakeMeshInput& mesh : meshes)
+		bytes += mesh.vertices.data.size() + mesh.indices.size() * 4;
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Baked " << meshes.size() << " meshes into " << output << " (" << bytes / 1024 << " KB of vertex/index data, "
+		<< "source " << stats.bytes / 1024 << " KB) in " << seconds * 1000.0 << " ms" << std::endl;
+	return 0;
+}
@@ -0,0 +1,246 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include "MappedFile.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+
+// XXH64 (same output as the reference implementation), fast enough to hash every
+// source asset on every launch without noticing
+class XxHash64
+{
+public:
+	static uint64_t hash(const void* input, size_t length, uint64_t seed = 0)
+	{
+		const uint8_t* p = (const uint8_t*)input;
+		const uint8_t* end = p + length;
+		uint64_t h;
+		if (length >= 32)
+		{
+			uint64_t v1 = seed + P1 + P2;
+			uint64_t v2 = seed + P2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - P1;
+			const uint8_t* limit = end - 32;
+			do
+			{
+				v1 = round(v1, read64(p));
+				v2 = round(v2, read64(p + 8));
+				v3 = round(v3, read64(p + 16));
+				v4 = round(v4, read64(p + 24));
+				p += 32;
+			} while (p <= limit);
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = mergeRound(h, v1);
+			h = mergeRound(h, v2);
+			h = mergeRound(h, v3);
+			h = mergeRound(h, v4);
+		}
+		else
+			h = seed + P5;
+		h += (uint64_t)length;
+
+		while (p + 8 <= end)
+		{
+			h ^= round(0, read64(p));
+			h = rotl(h, 27) * P1 + P4;
+			p += 8;
+		}
+		if (p + 4 <= end)
+		{
+			uint32_t k;
+			std::memcpy(&k, p, 4);
+			h ^= (uint64_t)k * P1;
+			h = rotl(h, 23) * P2 + P3;
+			p += 4;
+		}
+		while (p < end)
+		{
+			h ^= (uint64_t)(*p++) * P5;
+			h = rotl(h, 11) * P1;
+		}
+		h ^= h >> 33;
+		h *= P2;
+		h ^= h >> 29;
+		h *= P3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	static uint64_t hash(const std::string& text, uint64_t seed = 0) { return hash(text.data(), text.size(), seed); }
+
+private:
+	static const uint64_t P1 = 11400714785074694791ull;
+	static const uint64_t P2 = 14029467366897019727ull;
+	static const uint64_t P3 = 1609587929392839161ull;
+	static const uint64_t P4 = 9650029242287828579ull;
+	static const uint64_t P5 = 2870177450012600261ull;
+
+	static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	static uint64_t read64(const uint8_t* p)
+	{
+		uint64_t v;
+		std::memcpy(&v, p, 8);
+		return v;
+	}
+	static uint64_t round(uint64_t acc, uint64_t input)
+	{
+		acc += input * P2;
+		acc = rotl(acc, 31);
+		return acc * P1;
+	}
+	static uint64_t mergeRound(uint64_t acc, uint64_t value)
+	{
+		acc ^= round(0, value);
+		return acc * P1 + P4;
+	}
+};
+
+// Identifies one processed output: which importer made it, in which version and
+// from which input. 'hash' covers the source bytes and every setting that changes
+// the output, so editing a file or an import option simply misses the cache.
+struct AssetKey
+{
+	std::string importer;
+	uint32_t version = 0;
+	uint64_t hash = 0;
+
+	std::string fileName() const
+	{
+		char hex[17];
+		std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+		return importer + "-v" + std::to_string(version) + "-" + hex + ".bin";
+	}
+};
+
+// Content addressed store for processed assets (baked meshes, mip chains, compressed
+// textures, program binaries) in a local directory. Entries are never modified, a
+// changed input gets a new key; stale entries can be deleted by removing the folder.
+// A hit maps the cached file, so loading costs one read of the output.
+class AssetCache
+{
+public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t bytesRead = 0;      // cached outputs mapped on hits
+		size_t bytesWritten = 0;
+		size_t sourceBytesSkipped = 0; // inputs that did not need processing thanks to a hit
+		double hashSeconds = 0.0;
+
+		double hitRate() const { return hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0; }
+	};
+
+	explicit AssetCache(const std::string& directory = "cache") : root(directory)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(root, error);
+		if (error)
+		{
+			std::cout << "ERROR::ASSET_CACHE::CREATE_DIRECTORY_FAILED " << root << ": " << error.message() << std::endl;
+			enabled = false;
+		}
+	}
+
+	bool isEnabled() const { return enabled; }
+	void setEnabled(bool value) { enabled = value; }
+
+	// key from the source bytes plus a string of everything else the output depends on
+	AssetKey key(const std::string& importer, uint32_t version, const void* source, size_t size, const std::string& settings = "")
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		AssetKey k;
+		k.importer = importer;
+		k.version = version;
+		k.hash = XxHash64::hash(source, size, XxHash64::hash(settings));
+		stats.hashSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return k;
+	}
+
+	std::string path(const AssetKey& k) const
+	{
+		return (std::filesystem::path(root) / k.fileName()).string();
+	}
+
+	// maps the cached output if there is one, 'sourceBytes' only feeds the statistics
+	bool find(const AssetKey& k, MappedFile& out, size_t sourceBytes = 0)
+	{
+		std::error_code error;
+		if (!enabled || !std::filesystem::exists(path(k), error))
+		{
+			stats.misses++;
+			return false;
+		}
+		if (!out.open(path(k)))
+		{
+			stats.misses++;
+			return false;
+		}
+		stats.hits++;
+		stats.bytesRead += out.size();
+		stats.sourceBytesSkipped += sourceBytes;
+		return true;
+	}
+
+	bool store(const AssetKey& k, const void* data, size_t size)
+	{
+		return storeWith(k, [&](const std::string& file)
+		{
+			std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+			stream.write((const char*)data, (std::streamsize)size);
+			return (bool)stream;
+		});
+	}
+
+	// for outputs that come with their own writer: 'write' fills the given file, which
+	// is then renamed into place so a crash never leaves a half written entry behind
+	bool storeWith(const AssetKey& k, const std::function<bool(const std::string&)>& write)
+	{
+		if (!enabled)
+			return false;
+		std::string target = path(k);
+		std::string temporary = target + ".tmp";
+		if (!write(temporary))
+		{
+			std::cout << "ERROR::ASSET_CACHE::WRITE_FAILED " << target << std::endl;
+			std::error_code ignored;
+			std::filesystem::remove(temporary, ignored);
+			return false;
+		}
+		std::error_code error;
+		stats.bytesWritten += (size_t)std::filesystem::file_size(temporary, error);
+		std::filesystem::rename(temporary, target, error);
+		if (error)
+		{
+			std::cout << "ERROR::ASSET_CACHE::WRITE_FAILED " << target << ": " << error.message() << std::endl;
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+
+	const Stats& statistics() const { return stats; }
+
+	void printStats() const
+	{
+		std::cout << "AssetCache: " << stats.hits << " hits, " << stats.misses << " misses (" << stats.hitRate() * 100.0 << "% hit rate), "
+			<< stats.bytesRead / 1024 << " KB read from cache, " << stats.sourceBytesSkipped / 1024 << " KB of sources not reprocessed, "
+			<< stats.bytesWritten / 1024 << " KB written, hashing took " << stats.hashSeconds * 1000.0 << " ms" << std::endl;
+	}
+
+private:
+	std::string root;
+	bool enabled = true;
+	Stats stats;
+};
+
+#endif
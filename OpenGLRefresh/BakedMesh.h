@@ -0,0 +1,335 @@
+#ifndef BAKED_MESH_H
+#define BAKED_MESH_H
+
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary mesh container written by the MeshBake tool. Everything the renderer needs
+// is stored ready for the GPU: vertices already encoded in the file's VertexFormat,
+// 32 bit indices per LOD and meshlets. The runtime maps the file and hands pointers
+// into the mapping straight to glBufferSubData, there is no parsing step.
+//
+// Layout (little endian, every blob 64 byte aligned):
+//   BakedFileHeader
+//   BakedMeshRecord[meshCount]
+//   blobs: vertices, indices of all LODs, meshlets, meshlet vertices, meshlet triangles
+//
+// Bump BAKED_MESH_VERSION whenever one of the structs below changes; old files are
+// rejected and have to be baked again.
+
+const uint32_t BAKED_MESH_MAGIC = 0x48534D42; // "BMSH"
+const uint32_t BAKED_MESH_VERSION = 2;
+const uint32_t BAKED_MESH_MAX_LODS = 8;
+const uint64_t BAKED_MESH_ALIGNMENT = 64;
+
+struct BakedFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;   // sizeof(BakedFileHeader), catches struct packing mismatches
+	uint32_t recordSize;   // sizeof(BakedMeshRecord)
+	uint64_t fileSize;
+	uint32_t meshCount;
+	uint8_t positionEncoding;
+	uint8_t normalEncoding;
+	uint8_t uvEncoding;
+	uint8_t reserved0;
+	uint32_t vertexStride;
+	uint32_t reserved1[7];
+};
+
+struct BakedLod
+{
+	uint32_t firstIndex;   // relative to the mesh's index blob
+	uint32_t indexCount;
+	float error;           // object space error of this LOD, 0 for the original
+	uint32_t reserved;
+};
+
+struct BakedMeshlet
+{
+	uint32_t vertexOffset;   // into the meshlet vertex blob
+	uint32_t triangleOffset; // into the meshlet triangle blob, 3 bytes per triangle
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+struct BakedMeshRecord
+{
+	float aabbMin[3];
+	float aabbMax[3];
+	float transform[16];   // node transform * dequantization, column major
+	float normalMatrix[9]; // inverse transpose of the node transform alone, column major
+	uint32_t vertexCount;
+	uint32_t indexCount;   // all LODs together
+	uint64_t vertexOffset; // byte offsets from the start of the file
+	uint64_t indexOffset;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint64_t meshletOffset;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletTriangleOffset;
+	uint32_t meshletVertexCount;
+	uint32_t meshletTriangleBytes;
+	BakedLod lods[BAKED_MESH_MAX_LODS];
+};
+
+// what normals are multiplied with: they are encoded apart from the positions, so the
+// dequantization's non-uniform scale must not reach them, only the node transform's
+inline glm::mat3 bakedNormalMatrix(const glm::mat4& nodeTransform)
+{
+	glm::mat3 linear(nodeTransform);
+	if (std::fabs(glm::determinant(linear)) < 1e-12f)
+		return glm::mat3(1.0f); // flattened by a zero scale, nothing sensible to light
+	return glm::transpose(glm::inverse(linear));
+}
+
+// what the baker collects per mesh before writing
+struct BakeMeshInput
+{
+	EncodedVertices vertices;
+	glm::mat4 transform = glm::mat4(1.0f);
+	std::vector<uint32_t> indices;           // LODs back to back
+	std::vector<BakedLod> lods;
+	std::vector<BakedMeshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+};
+
+inline bool writeBakedMeshFile(const std::string& path, const VertexFormat& format, const std::vector<BakeMeshInput>& meshes)
+{
+	auto align = [](uint64_t offset) { return (offset + BAKED_MESH_ALIGNMENT - 1) & ~(BAKED_MESH_ALIGNMENT - 1); };
+
+	BakedFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = BAKED_MESH_MAGIC;
+	header.version = BAKED_MESH_VERSION;
+	header.headerSize = sizeof(BakedFileHeader);
+	header.recordSize = sizeof(BakedMeshRecord);
+	header.meshCount = (uint32_t)meshes.size();
+	header.positionEncoding = (uint8_t)format.position;
+	header.normalEncoding = (uint8_t)format.normal;
+	header.uvEncoding = (uint8_t)format.uv;
+	header.vertexStride = (uint32_t)format.stride();
+
+	// lay out the blobs first so the records can point at them
+	std::vector<BakedMeshRecord> records(meshes.size());
+	uint64_t offset = align(sizeof(BakedFileHeader) + sizeof(BakedMeshRecord) * meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const BakeMeshInput& mesh = meshes[i];
+		BakedMeshRecord& record = records[i];
+		std::memset(&record, 0, sizeof(record));
+		if (mesh.lods.size() > BAKED_MESH_MAX_LODS || mesh.vertices.format.stride() != format.stride())
+		{
+			std::cout << "ERROR::BAKED_MESH::INVALID_INPUT " << path << std::endl;
+			return false;
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			record.aabbMin[c] = mesh.vertices.aabbMin[c];
+			record.aabbMax[c] = mesh.vertices.aabbMax[c];
+		}
+		glm::mat4 transform = mesh.transform * mesh.vertices.dequantizeMatrix();
+		std::memcpy(record.transform, &transform[0][0], sizeof(record.transform));
+		glm::mat3 normalMatrix = bakedNormalMatrix(mesh.transform);
+		std::memcpy(record.normalMatrix, &normalMatrix[0][0], sizeof(record.normalMatrix));
+		record.vertexCount = (uint32_t)mesh.vertices.vertexCount();
+		record.indexCount = (uint32_t)mesh.indices.size();
+		record.lodCount = (uint32_t)mesh.lods.size();
+		for (size_t l = 0; l < mesh.lods.size(); l++)
+			record.lods[l] = mesh.lods[l];
+		record.meshletCount = (uint32_t)mesh.meshlets.size();
+		record.meshletVertexCount = (uint32_t)mesh.meshletVertices.size();
+		record.meshletTriangleBytes = (uint32_t)mesh.meshletTriangles.size();
+
+		record.vertexOffset = offset;
+		offset = align(offset + mesh.vertices.data.size());
+		record.indexOffset = offset;
+		offset = align(offset + mesh.indices.size() * sizeof(uint32_t));
+		record.meshletOffset = offset;
+		offset = align(offset + mesh.meshlets.size() * sizeof(BakedMeshlet));
+		record.meshletVertexOffset = offset;
+		offset = align(offset + mesh.meshletVertices.size() * sizeof(uint32_t));
+		record.meshletTriangleOffset = offset;
+		offset = align(offset + mesh.meshletTriangles.size());
+	}
+	header.fileSize = offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::BAKED_MESH::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	uint64_t written = 0;
+	auto write = [&](const void* data, uint64_t size)
+	{
+		file.write((const char*)data, (std::streamsize)size);
+		written += size;
+	};
+	auto pad = [&](uint64_t to)
+	{
+		static const char zeros[BAKED_MESH_ALIGNMENT] = {};
+		while (written < to)
+			write(zeros, std::min<uint64_t>(to - written, BAKED_MESH_ALIGNMENT));
+	};
+	write(&header, sizeof(header));
+	write(records.data(), sizeof(BakedMeshRecord) * records.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const BakeMeshInput& mesh = meshes[i];
+		const BakedMeshRecord& record = records[i];
+		pad(record.vertexOffset);
+		write(mesh.vertices.data.data(), mesh.vertices.data.size());
+		pad(record.indexOffset);
+		write(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		pad(record.meshletOffset);
+		write(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(BakedMeshlet));
+		pad(record.meshletVertexOffset);
+		write(mesh.meshletVertices.data(), mesh.meshletVertices.size() * sizeof(uint32_t));
+		pad(record.meshletTriangleOffset);
+		write(mesh.meshletTriangles.data(), mesh.meshletTriangles.size());
+	}
+	pad(header.fileSize);
+	if (!file)
+	{
+		std::cout << "ERROR::BAKED_MESH::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Read side: maps the file and validates every offset and index once, after that all
+// accessors are plain pointer arithmetic into the mapping.
+class BakedMeshFile
+{
+public:
+	bool load(const std::string& path)
+	{
+		MappedFile mapped;
+		if (!mapped.open(path))
+			return false;
+		return load(std::move(mapped), path);
+	}
+
+	// takes over a mapping that is already open, e.g. one handed out by the AssetCache
+	bool load(MappedFile&& mapped, const std::string& path)
+	{
+		file = std::move(mapped);
+		if (file.size() < sizeof(BakedFileHeader))
+			return fail(path, "file too small");
+		const BakedFileHeader* h = (const BakedFileHeader*)file.data();
+		if (h->magic != BAKED_MESH_MAGIC)
+			return fail(path, "not a baked mesh");
+		if (h->version != BAKED_MESH_VERSION || h->headerSize != sizeof(BakedFileHeader) || h->recordSize != sizeof(BakedMeshRecord))
+			return fail(path, "version " + std::to_string(h->version) + " needs to be baked again");
+		if (h->fileSize != file.size() || sizeof(BakedFileHeader) + (uint64_t)h->meshCount * sizeof(BakedMeshRecord) > file.size())
+			return fail(path, "truncated");
+
+		VertexFormat f;
+		f.position = (PositionEncoding)h->positionEncoding;
+		f.normal = (NormalEncoding)h->normalEncoding;
+		f.uv = (UvEncoding)h->uvEncoding;
+		if (f.stride() != h->vertexStride)
+			return fail(path, "vertex stride mismatch");
+
+		for (uint32_t i = 0; i < h->meshCount; i++)
+		{
+			const BakedMeshRecord& r = record(i);
+			auto inside = [&](uint64_t offset, uint64_t bytes) { return offset % 4 == 0 && offset <= file.size() && bytes <= file.size() - offset; };
+			if (r.lodCount > BAKED_MESH_MAX_LODS
+				|| !inside(r.vertexOffset, (uint64_t)r.vertexCount * h->vertexStride)
+				|| !inside(r.indexOffset, (uint64_t)r.indexCount * 4)
+				|| !inside(r.meshletOffset, (uint64_t)r.meshletCount * sizeof(BakedMeshlet))
+				|| !inside(r.meshletVertexOffset, (uint64_t)r.meshletVertexCount * 4)
+				|| !inside(r.meshletTriangleOffset, r.meshletTriangleBytes))
+				return fail(path, "mesh " + std::to_string(i) + " out of bounds");
+			for (uint32_t l = 0; l < r.lodCount; l++)
+				if ((uint64_t)r.lods[l].firstIndex + r.lods[l].indexCount > r.indexCount)
+					return fail(path, "lod out of bounds");
+
+			// the GPU would read past the vertex buffer otherwise, same checks as the OBJ parser
+			const uint32_t* index = (const uint32_t*)(file.data() + r.indexOffset);
+			for (uint32_t k = 0; k < r.indexCount; k++)
+				if (index[k] >= r.vertexCount)
+					return fail(path, "mesh " + std::to_string(i) + " index out of range");
+			const uint32_t* meshletVertex = (const uint32_t*)(file.data() + r.meshletVertexOffset);
+			for (uint32_t k = 0; k < r.meshletVertexCount; k++)
+				if (meshletVertex[k] >= r.vertexCount)
+					return fail(path, "mesh " + std::to_string(i) + " meshlet vertex out of range");
+			const BakedMeshlet* meshlet = (const BakedMeshlet*)(file.data() + r.meshletOffset);
+			const uint8_t* triangles = file.data() + r.meshletTriangleOffset;
+			for (uint32_t m = 0; m < r.meshletCount; m++)
+			{
+				const BakedMeshlet& ml = meshlet[m];
+				if ((uint64_t)ml.vertexOffset + ml.vertexCount > r.meshletVertexCount
+					|| (uint64_t)ml.triangleOffset + (uint64_t)ml.triangleCount * 3 > r.meshletTriangleBytes)
+					return fail(path, "mesh " + std::to_string(i) + " meshlet out of bounds");
+				for (uint64_t k = 0; k < (uint64_t)ml.triangleCount * 3; k++)
+					if (triangles[ml.triangleOffset + k] >= ml.vertexCount)
+						return fail(path, "mesh " + std::to_string(i) + " meshlet triangle out of range");
+			}
+		}
+		vertexFormat = f;
+		return true;
+	}
+
+	const BakedFileHeader& header() const { return *(const BakedFileHeader*)file.data(); }
+	const VertexFormat& format() const { return vertexFormat; }
+	uint32_t meshCount() const { return file.isOpen() ? header().meshCount : 0; }
+	size_t size() const { return file.size(); }
+
+	const BakedMeshRecord& record(uint32_t mesh) const
+	{
+		return ((const BakedMeshRecord*)(file.data() + sizeof(BakedFileHeader)))[mesh];
+	}
+
+	const uint8_t* vertices(uint32_t mesh) const { return file.data() + record(mesh).vertexOffset; }
+	const uint32_t* indices(uint32_t mesh) const { return (const uint32_t*)(file.data() + record(mesh).indexOffset); }
+	const BakedMeshlet* meshlets(uint32_t mesh) const { return (const BakedMeshlet*)(file.data() + record(mesh).meshletOffset); }
+	const uint32_t* meshletVertices(uint32_t mesh) const { return (const uint32_t*)(file.data() + record(mesh).meshletVertexOffset); }
+	const uint8_t* meshletTriangles(uint32_t mesh) const { return file.data() + record(mesh).meshletTriangleOffset; }
+
+	glm::mat4 transform(uint32_t mesh) const
+	{
+		glm::mat4 m;
+		std::memcpy(&m[0][0], record(mesh).transform, sizeof(float) * 16);
+		return m;
+	}
+
+	glm::mat3 normalMatrix(uint32_t mesh) const
+	{
+		glm::mat3 m;
+		std::memcpy(&m[0][0], record(mesh).normalMatrix, sizeof(float) * 9);
+		return m;
+	}
+
+private:
+	MappedFile file;
+	VertexFormat vertexFormat;
+
+	bool fail(const std::string& path, const std::string& why)
+	{
+		std::cout << "ERROR::BAKED_MESH::LOAD_FAILED " << path << ": " << why << std::endl;
+		file.close();
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef BATCH_JOBS_H
+#define BATCH_JOBS_H
+
+#include <glm/glm.hpp>
+
+#include "FrameCapture.h"
+#include "Json.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Offline rendering jobs, read from a JSON job file:
+//
+//   { "jobs": [ {
+//       "name": "orbit", "output": "renders/orbit",
+//       "width": 1280, "height": 720, "frames": 240, "fps": 30, "format": "png",
+//       "camera": [ { "time": 0, "position": [0, 0, 3], "target": [0, 0, 0], "fov": 45 },
+//                   { "time": 8, "position": [3, 1, 0], "target": [0, 0, 0] } ],
+//       "light":  [ { "time": 0, "position": [1.2, 1, 2] } ]
+//   } ] }
+//
+// Frame f of a job shows the scene at startTime + f / fps. Camera and light keys are
+// interpolated linearly and held before the first and after the last key; a job without
+// light keys keeps the usual orbit. "format" is png, raw or y4m (see FrameCapture).
+struct CameraKey
+{
+	float time = 0.0f;
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+	glm::vec3 target = glm::vec3(0.0f);
+	float fov = 45.0f;
+};
+
+struct LightKey
+{
+	float time = 0.0f;
+	glm::vec3 position = glm::vec3(0.0f);
+};
+
+struct RenderJob
+{
+	std::string name;
+	std::string output;
+	int width = 640;
+	int height = 360;
+	int frames = 1;
+	int fps = 30;
+	float startTime = 0.0f;
+	CaptureFormat format = CaptureFormat::Png;
+	std::vector<CameraKey> camera;
+	std::vector<LightKey> light;
+
+	float time(int frame) const { return startTime + (float)frame / fps; }
+
+	CameraKey cameraAt(float t) const
+	{
+		if (camera.empty())
+			return CameraKey();
+		size_t i = keyIndex(camera, t);
+		if (i + 1 >= camera.size() || t <= camera[i].time)
+			return camera[i];
+		const CameraKey& a = camera[i];
+		const CameraKey& b = camera[i + 1];
+		float s = (t - a.time) / std::max(b.time - a.time, 1e-6f);
+		CameraKey key;
+		key.time = t;
+		key.position = glm::mix(a.position, b.position, s);
+		key.target = glm::mix(a.target, b.target, s);
+		key.fov = a.fov + (b.fov - a.fov) * s;
+		return key;
+	}
+
+	// false when the job has no light keys
+	bool lightAt(float t, glm::vec3& position) const
+	{
+		if (light.empty())
+			return false;
+		size_t i = keyIndex(light, t);
+		if (i + 1 >= light.size() || t <= light[i].time)
+			position = light[i].position;
+		else
+		{
+			float s = (t - light[i].time) / std::max(light[i + 1].time - light[i].time, 1e-6f);
+			position = glm::mix(light[i].position, light[i + 1].position, s);
+		}
+		return true;
+	}
+
+private:
+	// last key at or before t, keys are sorted by time
+	template <typename Key>
+	static size_t keyIndex(const std::vector<Key>& keys, float t)
+	{
+		size_t i = 0;
+		while (i + 1 < keys.size() && keys[i + 1].time <= t)
+			i++;
+		return i;
+	}
+};
+
+inline glm::vec3 jsonVec3(const JsonValue& value, const glm::vec3& fallback)
+{
+	if (!value.isArray() || value.size() < 3)
+		return fallback;
+	return glm::vec3(value[(size_t)0].asFloat(), value[1].asFloat(), value[2].asFloat());
+}
+
+inline bool loadRenderJobs(const std::string& path, std::vector<RenderJob>& jobs)
+{
+	MappedFile file(path);
+	if (!file.isOpen())
+		return false;
+	JsonValue doc;
+	std::string error;
+	const char* text = (const char*)file.data();
+	if (!JsonParser::parse(text, text + file.size(), doc, error))
+	{
+		std::cout << "ERROR::BATCH::JSON " << path << ": " << error << std::endl;
+		return false;
+	}
+	const JsonValue& list = doc["jobs"];
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		const JsonValue& entry = list[i];
+		RenderJob job;
+		job.name = entry["name"].isString() ? entry["name"].asString() : "job" + std::to_string(i);
+		job.output = entry["output"].isString() ? entry["output"].asString() : "renders/" + job.name;
+		job.width = std::max(1, entry["width"].asInt(job.width));
+		job.height = std::max(1, entry["height"].asInt(job.height));
+		job.frames = std::max(1, entry["frames"].asInt(job.frames));
+		job.fps = std::max(1, entry["fps"].asInt(job.fps));
+		job.startTime = entry["startTime"].asFloat(job.startTime);
+		if (entry["format"].isString() && !parseCaptureFormat(entry["format"].asString(), job.format))
+			std::cout << "ERROR::BATCH::FORMAT " << job.name << ": unknown format " << entry["format"].asString() << ", using png" << std::endl;
+		const JsonValue& camera = entry["camera"];
+		for (size_t k = 0; k < camera.size(); k++)
+		{
+			CameraKey key;
+			key.time = camera[k]["time"].asFloat(0.0f);
+			key.position = jsonVec3(camera[k]["position"], key.position);
+			key.target = jsonVec3(camera[k]["target"], key.target);
+			key.fov = camera[k]["fov"].asFloat(job.camera.empty() ? key.fov : job.camera.back().fov);
+			job.camera.push_back(key);
+		}
+		const JsonValue& light = entry["light"];
+		for (size_t k = 0; k < light.size(); k++)
+		{
+			LightKey key;
+			key.time = light[k]["time"].asFloat(0.0f);
+			key.position = jsonVec3(light[k]["position"], key.position);
+			job.light.push_back(key);
+		}
+		auto byTime = [](const auto& a, const auto& b) { return a.time < b.time; };
+		std::stable_sort(job.camera.begin(), job.camera.end(), byTime);
+		std::stable_sort(job.light.begin(), job.light.end(), byTime);
+		jobs.push_back(job);
+	}
+	if (jobs.empty())
+		std::cout << "ERROR::BATCH::NO_JOBS in " << path << std::endl;
+	return !jobs.empty();
+}
+
+// a range of frames of one job, what a single worker renders in one go
+struct RenderWorkUnit
+{
+	int job = 0;
+	int firstFrame = 0;
+	int frameCount = 0;
+};
+
+// PNG jobs are cut into one range per worker, each frame is its own file. Raw and y4m
+// write a single stream and stay whole. Ranges are dealt out round robin.
+inline std::vector<RenderWorkUnit> renderWorkUnits(const std::vector<RenderJob>& jobs, int worker, int workerCount)
+{
+	std::vector<RenderWorkUnit> all;
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		int parts = jobs[j].format == CaptureFormat::Png ? std::min(workerCount, jobs[j].frames) : 1;
+		for (int p = 0; p < parts; p++)
+		{
+			RenderWorkUnit unit;
+			unit.job = (int)j;
+			unit.firstFrame = jobs[j].frames * p / parts;
+			unit.frameCount = jobs[j].frames * (p + 1) / parts - unit.firstFrame;
+			all.push_back(unit);
+		}
+	}
+	std::vector<RenderWorkUnit> mine;
+	for (size_t u = 0; u < all.size(); u++)
+		if ((int)(u % workerCount) == worker)
+			mine.push_back(all[u]);
+	return mine;
+}
+
+// The frames one worker process renders, walked by the viewer's render loop like the
+// golden images: setup of the current frame, then advance() once it is captured.
+class BatchRun
+{
+public:
+	BatchRun() {}
+	BatchRun(const std::vector<RenderJob>& jobs, int worker, int workerCount)
+		: jobList(jobs), units(renderWorkUnits(jobs, worker, workerCount)), worker(worker)
+	{
+		for (const RenderWorkUnit& unit : units)
+			totalFrames += unit.frameCount;
+	}
+
+	bool enabled() const { return !jobList.empty(); }
+	bool active() const { return unit < units.size(); }
+
+	const RenderJob& job() const { return jobList[units[unit].job]; }
+	int frame() const { return units[unit].firstFrame + frameInUnit; }
+	float time() const { return job().time(frame()); }
+	// true on the first frame of a range: resize the target and restart the capture
+	bool unitStarts() const { return frameInUnit == 0; }
+	int firstFrame() const { return units[unit].firstFrame; }
+
+	// right before the first frame, loading is not part of the throughput
+	void start() { begin = std::chrono::high_resolution_clock::now(); }
+
+	void advance()
+	{
+		frameCount++;
+		if (++frameInUnit >= units[unit].frameCount)
+		{
+			unit++;
+			frameInUnit = 0;
+		}
+	}
+
+	void printStats() const
+	{
+		double seconds = frameCount > 0 ? std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count() : 0.0;
+		std::cout << "Batch worker " << worker << ": " << frameCount << "/" << totalFrames << " frames of " << units.size() << " ranges in "
+			<< seconds << " s, " << (seconds > 0.0 ? frameCount / seconds : 0.0) << " fps" << std::endl;
+	}
+
+private:
+	std::vector<RenderJob> jobList;
+	std::vector<RenderWorkUnit> units;
+	int worker = 0;
+	size_t unit = 0;
+	int frameInUnit = 0;
+	int frameCount = 0;
+	int totalFrames = 0;
+	std::chrono::high_resolution_clock::time_point begin;
+};
+
+// Starts 'workerCount' copies of this program, each with "--batch-worker i/n" behind
+// 'arguments', and waits for them. Every process has its own context, which is what
+// scales on GPU-less nodes: llvmpipe is told to use one thread per process so the
+// throughput per worker is the throughput per core. Returns the number of failed workers.
+inline int runBatchWorkers(const std::string& executable, const std::string& arguments, int workerCount, int totalFrames)
+{
+#ifdef _WIN32
+	if (!std::getenv("LP_NUM_THREADS"))
+		_putenv_s("LP_NUM_THREADS", "1");
+#else
+	setenv("LP_NUM_THREADS", "1", 0);
+#endif
+	auto begin = std::chrono::high_resolution_clock::now();
+	std::vector<int> results(workerCount, 0);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < workerCount; i++)
+	{
+		threads.emplace_back([&, i]()
+		{
+			std::string command = "\"" + executable + "\"" + arguments + " --batch-worker " + std::to_string(i) + "/" + std::to_string(workerCount);
+#ifdef _WIN32
+			// cmd.exe strips the first and last quote of the line
+			command = "\"" + command + "\"";
+#endif
+			results[i] = std::system(command.c_str());
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+	int failed = 0;
+	for (int i = 0; i < workerCount; i++)
+	{
+		if (results[i] != 0)
+		{
+			std::cout << "ERROR::BATCH::WORKER_FAILED worker " << i << " exit code " << results[i] << std::endl;
+			failed++;
+		}
+	}
+	double fps = totalFrames / seconds;
+	std::cout << "Batch: " << totalFrames << " frames with " << workerCount << " workers in " << seconds << " s, " << fps << " fps, "
+		<< fps / workerCount << " fps per worker (" << std::max(1u, std::thread::hardware_concurrency()) << " cores)" << std::endl;
+	return failed;
+}
+
+#endif
@@ -0,0 +1,791 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define BC_ENCODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// CPU block compression for textures. Every 4x4 block is independent, so whole images
+// are encoded row-of-blocks parallel on the job system. Per block the endpoints start
+// on the principal axis of the colors, indices are picked by an exhaustive palette
+// search (4 pixels per SSE2 instruction) and the endpoints are then refitted by least
+// squares for the chosen indices a couple of times.
+//
+//   BC1  RGB, 4 bpp             diffuse without alpha
+//   BC3  RGBA, 8 bpp            BC4 alpha + BC1 color
+//   BC5  RG, 8 bpp              two BC4 channels, normal maps
+//   BC7  RGBA, 8 bpp            mode 6 (one subset, 4 bit indices, p-bits), plus
+//                               mode 5 (separate alpha) for blocks that aren't opaque
+//
+// This is the usual "fast" BC7: a single subset handles gradients well but blocks
+// with several distinct colors would need the partitioned modes.
+enum class BcFormat { BC1, BC3, BC5, BC7 };
+
+inline size_t bcBlockBytes(BcFormat format) { return format == BcFormat::BC1 ? 8 : 16; }
+
+inline const char* bcFormatName(BcFormat format)
+{
+	switch (format)
+	{
+	case BcFormat::BC1: return "BC1";
+	case BcFormat::BC3: return "BC3";
+	case BcFormat::BC5: return "BC5";
+	default: return "BC7";
+	}
+}
+
+// channels that carry data, used for the PSNR
+inline int bcChannelCount(BcFormat format)
+{
+	switch (format)
+	{
+	case BcFormat::BC1: return 3;
+	case BcFormat::BC5: return 2;
+	default: return 4;
+	}
+}
+
+// one 4x4 block, planar so four pixels of one channel are one SSE register
+struct BcBlock
+{
+	alignas(16) float c[4][16]; // r, g, b, a in 0..255
+};
+
+inline void bcLoadBlock(const uint8_t* rgba, int width, int height, int blockX, int blockY, BcBlock& block)
+{
+	// blocks hanging over the edge repeat the last row/column
+	for (int y = 0; y < 4; y++)
+	{
+		int sy = std::min(blockY * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			int sx = std::min(blockX * 4 + x, width - 1);
+			const uint8_t* p = rgba + ((size_t)sy * width + sx) * 4;
+			for (int ch = 0; ch < 4; ch++)
+				block.c[ch][y * 4 + x] = p[ch];
+		}
+	}
+}
+
+// nearest palette entry for every pixel over channels [first, first + count),
+// returns the summed squared error
+inline float bcSelectIndices(const BcBlock& block, const float palette[][4], int entries, int first, int count, uint8_t indices[16])
+{
+#ifdef BC_ENCODER_SSE2
+	__m128 total = _mm_setzero_ps();
+	for (int group = 0; group < 16; group += 4)
+	{
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (int e = 0; e < entries; e++)
+		{
+			__m128 distance = _mm_setzero_ps();
+			for (int ch = first; ch < first + count; ch++)
+			{
+				__m128 d = _mm_sub_ps(_mm_load_ps(&block.c[ch][group]), _mm_set1_ps(palette[e][ch]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(e)), _mm_andnot_si128(closer, bestIndex));
+		}
+		total = _mm_add_ps(total, best);
+		alignas(16) int32_t lanes[4];
+		_mm_store_si128((__m128i*)lanes, bestIndex);
+		for (int k = 0; k < 4; k++)
+			indices[group + k] = (uint8_t)lanes[k];
+	}
+	alignas(16) float sums[4];
+	_mm_store_ps(sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float best = FLT_MAX;
+		for (int e = 0; e < entries; e++)
+		{
+			float distance = 0.0f;
+			for (int ch = first; ch < first + count; ch++)
+			{
+				float d = block.c[ch][i] - palette[e][ch];
+				distance += d * d;
+			}
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (uint8_t)e;
+			}
+		}
+		total += best;
+	}
+	return total;
+#endif
+}
+
+// start endpoints: the extent of the block along the principal axis of its colors
+inline void bcPrincipalEndpoints(const BcBlock& block, int first, int count, float a[4], float b[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int ch = first; ch < first + count; ch++)
+	{
+		for (int i = 0; i < 16; i++)
+			mean[ch] += block.c[ch][i];
+		mean[ch] /= 16.0f;
+	}
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int x = first; x < first + count; x++)
+			for (int y = first; y < first + count; y++)
+				covariance[x][y] += (block.c[x][i] - mean[x]) * (block.c[y][i] - mean[y]);
+
+	// power iteration, 8 steps are plenty for a 4x4 matrix
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (int x = first; x < first + count; x++)
+		{
+			for (int y = first; y < first + count; y++)
+				next[x] += covariance[x][y] * axis[y];
+			length = std::max(length, std::fabs(next[x]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int ch = first; ch < first + count; ch++)
+			axis[ch] = next[ch] / length;
+	}
+	float axisLength = 0.0f;
+	for (int ch = first; ch < first + count; ch++)
+		axisLength += axis[ch] * axis[ch];
+	axisLength = std::sqrt(axisLength);
+
+	float lo = 0.0f, hi = 0.0f;
+	if (axisLength > 1e-6f)
+	{
+		lo = FLT_MAX;
+		hi = -FLT_MAX;
+		for (int ch = first; ch < first + count; ch++)
+			axis[ch] /= axisLength;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int ch = first; ch < first + count; ch++)
+				t += (block.c[ch][i] - mean[ch]) * axis[ch];
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+	}
+	for (int ch = first; ch < first + count; ch++)
+	{
+		a[ch] = std::min(255.0f, std::max(0.0f, mean[ch] + axis[ch] * lo));
+		b[ch] = std::min(255.0f, std::max(0.0f, mean[ch] + axis[ch] * hi));
+	}
+}
+
+// least squares endpoints for fixed indices, 'weights' maps an index to its position t
+// between a (t = 0) and b (t = 1). Returns false if all pixels use the same weight.
+inline bool bcFitEndpoints(const BcBlock& block, const uint8_t indices[16], const float* weights, int first, int count, float a[4], float b[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float t = weights[indices[i]];
+		float s = 1.0f - t;
+		aa += s * s;
+		ab += s * t;
+		bb += t * t;
+		for (int ch = first; ch < first + count; ch++)
+		{
+			ax[ch] += s * block.c[ch][i];
+			bx[ch] += t * block.c[ch][i];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+	float inverse = 1.0f / determinant;
+	for (int ch = first; ch < first + count; ch++)
+	{
+		a[ch] = std::min(255.0f, std::max(0.0f, (bb * ax[ch] - ab * bx[ch]) * inverse));
+		b[ch] = std::min(255.0f, std::max(0.0f, (aa * bx[ch] - ab * ax[ch]) * inverse));
+	}
+	return true;
+}
+
+inline uint16_t bcTo565(const float c[4])
+{
+	int r = std::min(31, std::max(0, (int)std::lround(c[0] * 31.0f / 255.0f)));
+	int g = std::min(63, std::max(0, (int)std::lround(c[1] * 63.0f / 255.0f)));
+	int b = std::min(31, std::max(0, (int)std::lround(c[2] * 31.0f / 255.0f)));
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void bcFrom565(uint16_t v, float out[4])
+{
+	int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+	out[0] = (float)((r << 3) | (r >> 2));
+	out[1] = (float)((g << 2) | (g >> 4));
+	out[2] = (float)((b << 3) | (b >> 2));
+	out[3] = 255.0f;
+}
+
+// BC1 color block (also the color half of BC3), always in 4 color mode
+inline float bcEncodeColor(const BcBlock& block, uint8_t out[8])
+{
+	static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float a[4], b[4];
+	bcPrincipalEndpoints(block, 0, 3, a, b);
+	uint16_t c0 = bcTo565(b), c1 = bcTo565(a);
+
+	float bestError = FLT_MAX;
+	uint16_t best0 = c0, best1 = c1;
+	uint8_t bestIndices[16] = {};
+	for (int iteration = 0; iteration < 3; iteration++)
+	{
+		float palette[4][4];
+		bcFrom565(c0, palette[0]);
+		bcFrom565(c1, palette[1]);
+		for (int ch = 0; ch < 3; ch++)
+		{
+			palette[2][ch] = (2.0f * palette[0][ch] + palette[1][ch]) / 3.0f;
+			palette[3][ch] = (palette[0][ch] + 2.0f * palette[1][ch]) / 3.0f;
+		}
+		uint8_t indices[16];
+		float error = bcSelectIndices(block, palette, 4, 0, 3, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			best0 = c0;
+			best1 = c1;
+			std::memcpy(bestIndices, indices, 16);
+		}
+		if (error == 0.0f || !bcFitEndpoints(block, indices, weights, 0, 3, a, b))
+			break;
+		c0 = bcTo565(a);
+		c1 = bcTo565(b);
+	}
+
+	// color0 > color1 selects 4 color mode, swapping the endpoints swaps 0/1 and 2/3
+	if (best0 < best1)
+	{
+		std::swap(best0, best1);
+		for (int i = 0; i < 16; i++)
+			bestIndices[i] ^= 1;
+	}
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint32_t)(best0 == best1 ? 0 : bestIndices[i]) << (2 * i);
+	std::memcpy(out, &best0, 2);
+	std::memcpy(out + 2, &best1, 2);
+	std::memcpy(out + 4, &bits, 4);
+	return bestError;
+}
+
+// BC4 block for one channel (alpha of BC3, red/green of BC5), always 8 value mode
+inline float bcEncodeSingleChannel(const BcBlock& block, int channel, uint8_t out[8])
+{
+	static const float weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+	float lo = 255.0f, hi = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		lo = std::min(lo, block.c[channel][i]);
+		hi = std::max(hi, block.c[channel][i]);
+	}
+	int r0 = (int)hi, r1 = (int)lo;
+
+	float bestError = FLT_MAX;
+	int best0 = r0, best1 = r1;
+	uint8_t bestIndices[16] = {};
+	for (int iteration = 0; iteration < 2; iteration++)
+	{
+		float palette[8][4];
+		for (int e = 0; e < 8; e++)
+			palette[e][channel] = r0 + (r1 - r0) * weights[e];
+		uint8_t indices[16];
+		float error = bcSelectIndices(block, palette, 8, channel, 1, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			best0 = r0;
+			best1 = r1;
+			std::memcpy(bestIndices, indices, 16);
+		}
+		float a[4], b[4];
+		if (error == 0.0f || !bcFitEndpoints(block, indices, weights, channel, 1, a, b))
+			break;
+		r0 = (int)std::lround(a[channel]);
+		r1 = (int)std::lround(b[channel]);
+	}
+
+	// red0 > red1 selects 8 value mode, swapping mirrors the interpolated indices
+	if (best0 < best1)
+	{
+		std::swap(best0, best1);
+		for (int i = 0; i < 16; i++)
+			bestIndices[i] = bestIndices[i] < 2 ? bestIndices[i] ^ 1 : (uint8_t)(9 - bestIndices[i]);
+	}
+	out[0] = (uint8_t)best0;
+	out[1] = (uint8_t)best1;
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint64_t)(best0 == best1 ? 0 : bestIndices[i]) << (3 * i);
+	for (int k = 0; k < 6; k++)
+		out[2 + k] = (uint8_t)(bits >> (8 * k));
+	return bestError;
+}
+
+struct BcBitWriter
+{
+	uint8_t* out;
+	int position = 0;
+
+	void put(uint32_t value, int bits)
+	{
+		for (int i = 0; i < bits; i++, position++)
+			if ((value >> i) & 1)
+				out[position >> 3] |= (uint8_t)(1 << (position & 7));
+	}
+};
+
+struct BcBitReader
+{
+	const uint8_t* in;
+	int position = 0;
+
+	uint32_t get(int bits)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < bits; i++, position++)
+			value |= (uint32_t)((in[position >> 3] >> (position & 7)) & 1) << i;
+		return value;
+	}
+};
+
+const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+const int BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+
+// BC7 mode 5: RGB and alpha get separate endpoints and indices, so alpha cutouts
+// don't have to lie on the color line
+inline float bcEncodeBc7Mode5(const BcBlock& block, uint8_t out[16])
+{
+	float weights[4];
+	for (int i = 0; i < 4; i++)
+		weights[i] = BC7_WEIGHTS2[i] / 64.0f;
+
+	// color: 7 bit endpoints, expanded by replicating the top bit
+	float a[4], b[4];
+	bcPrincipalEndpoints(block, 0, 3, a, b);
+	float colorError = FLT_MAX;
+	int colorEndpoints[2][3] = {};
+	uint8_t colorIndices[16] = {};
+	for (int iteration = 0; iteration < 3; iteration++)
+	{
+		int q[2][3];
+		float palette[4][4];
+		for (int ch = 0; ch < 3; ch++)
+		{
+			q[0][ch] = std::min(127, std::max(0, (int)std::lround(a[ch] * 127.0f / 255.0f)));
+			q[1][ch] = std::min(127, std::max(0, (int)std::lround(b[ch] * 127.0f / 255.0f)));
+			int e0 = (q[0][ch] << 1) | (q[0][ch] >> 6), e1 = (q[1][ch] << 1) | (q[1][ch] >> 6);
+			for (int i = 0; i < 4; i++)
+				palette[i][ch] = (float)(((64 - BC7_WEIGHTS2[i]) * e0 + BC7_WEIGHTS2[i] * e1 + 32) >> 6);
+		}
+		uint8_t indices[16];
+		float error = bcSelectIndices(block, palette, 4, 0, 3, indices);
+		if (error < colorError)
+		{
+			colorError = error;
+			std::memcpy(colorEndpoints, q, sizeof(q));
+			std::memcpy(colorIndices, indices, 16);
+		}
+		if (error == 0.0f || !bcFitEndpoints(block, indices, weights, 0, 3, a, b))
+			break;
+	}
+
+	// alpha: full 8 bit endpoints
+	float lo = 255.0f, hi = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		lo = std::min(lo, block.c[3][i]);
+		hi = std::max(hi, block.c[3][i]);
+	}
+	a[3] = lo;
+	b[3] = hi;
+	float alphaError = FLT_MAX;
+	int alphaEndpoints[2] = { 0, 0 };
+	uint8_t alphaIndices[16] = {};
+	for (int iteration = 0; iteration < 2; iteration++)
+	{
+		int e0 = (int)std::lround(a[3]), e1 = (int)std::lround(b[3]);
+		float palette[4][4];
+		for (int i = 0; i < 4; i++)
+			palette[i][3] = (float)(((64 - BC7_WEIGHTS2[i]) * e0 + BC7_WEIGHTS2[i] * e1 + 32) >> 6);
+		uint8_t indices[16];
+		float error = bcSelectIndices(block, palette, 4, 3, 1, indices);
+		if (error < alphaError)
+		{
+			alphaError = error;
+			alphaEndpoints[0] = e0;
+			alphaEndpoints[1] = e1;
+			std::memcpy(alphaIndices, indices, 16);
+		}
+		if (error == 0.0f || !bcFitEndpoints(block, indices, weights, 3, 1, a, b))
+			break;
+	}
+
+	// both index sets have an implicit 0 high bit on the first pixel
+	if (colorIndices[0] & 2)
+	{
+		std::swap(colorEndpoints[0], colorEndpoints[1]);
+		for (int i = 0; i < 16; i++)
+			colorIndices[i] = (uint8_t)(3 - colorIndices[i]);
+	}
+	if (alphaIndices[0] & 2)
+	{
+		std::swap(alphaEndpoints[0], alphaEndpoints[1]);
+		for (int i = 0; i < 16; i++)
+			alphaIndices[i] = (uint8_t)(3 - alphaIndices[i]);
+	}
+
+	std::memset(out, 0, 16);
+	BcBitWriter writer{ out };
+	writer.put(1 << 5, 6); // mode 5
+	writer.put(0, 2);      // no channel rotation
+	for (int ch = 0; ch < 3; ch++)
+	{
+		writer.put((uint32_t)colorEndpoints[0][ch], 7);
+		writer.put((uint32_t)colorEndpoints[1][ch], 7);
+	}
+	writer.put((uint32_t)alphaEndpoints[0], 8);
+	writer.put((uint32_t)alphaEndpoints[1], 8);
+	for (int i = 0; i < 16; i++)
+		writer.put(colorIndices[i], i == 0 ? 1 : 2);
+	for (int i = 0; i < 16; i++)
+		writer.put(alphaIndices[i], i == 0 ? 1 : 2);
+	return colorError + alphaError;
+}
+
+// BC7 mode 6: RGBA endpoints with 7 bits + a shared low bit (p-bit) per endpoint
+inline float bcEncodeBc7Mode6(const BcBlock& block, uint8_t out[16])
+{
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = BC7_WEIGHTS4[i] / 64.0f;
+	float a[4], b[4];
+	bcPrincipalEndpoints(block, 0, 4, a, b);
+
+	float bestError = FLT_MAX;
+	int bestEndpoints[2][4] = {};
+	int bestP[2] = { 0, 0 };
+	uint8_t bestIndices[16] = {};
+	for (int iteration = 0; iteration < 3; iteration++)
+	{
+		float iterationError = FLT_MAX;
+		uint8_t iterationIndices[16] = {};
+		for (int p = 0; p < 4; p++)
+		{
+			int p0 = p & 1, p1 = p >> 1;
+			int e0[4], e1[4];
+			for (int ch = 0; ch < 4; ch++)
+			{
+				e0[ch] = std::min(127, std::max(0, (int)std::lround((a[ch] - p0) * 0.5f))) * 2 + p0;
+				e1[ch] = std::min(127, std::max(0, (int)std::lround((b[ch] - p1) * 0.5f))) * 2 + p1;
+			}
+			float palette[16][4];
+			for (int i = 0; i < 16; i++)
+				for (int ch = 0; ch < 4; ch++)
+					palette[i][ch] = (float)(((64 - BC7_WEIGHTS4[i]) * e0[ch] + BC7_WEIGHTS4[i] * e1[ch] + 32) >> 6);
+			uint8_t indices[16];
+			float error = bcSelectIndices(block, palette, 16, 0, 4, indices);
+			if (error < iterationError)
+			{
+				iterationError = error;
+				std::memcpy(iterationIndices, indices, 16);
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				std::memcpy(bestEndpoints[0], e0, sizeof(e0));
+				std::memcpy(bestEndpoints[1], e1, sizeof(e1));
+				bestP[0] = p0;
+				bestP[1] = p1;
+				std::memcpy(bestIndices, indices, 16);
+			}
+		}
+		if (bestError == 0.0f || !bcFitEndpoints(block, iterationIndices, weights, 0, 4, a, b))
+			break;
+	}
+
+	// the first pixel's index has an implicit 0 high bit
+	if (bestIndices[0] & 8)
+	{
+		std::swap(bestEndpoints[0], bestEndpoints[1]);
+		std::swap(bestP[0], bestP[1]);
+		for (int i = 0; i < 16; i++)
+			bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+	}
+
+	std::memset(out, 0, 16);
+	BcBitWriter writer{ out };
+	writer.put(1 << 6, 7); // mode 6
+	for (int ch = 0; ch < 4; ch++)
+	{
+		writer.put((uint32_t)bestEndpoints[0][ch] >> 1, 7);
+		writer.put((uint32_t)bestEndpoints[1][ch] >> 1, 7);
+	}
+	writer.put((uint32_t)bestP[0], 1);
+	writer.put((uint32_t)bestP[1], 1);
+	writer.put(bestIndices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.put(bestIndices[i], 4);
+	return bestError;
+}
+
+// mode 6 for opaque blocks, blocks with alpha also try mode 5 and keep the better one
+inline float bcEncodeBc7(const BcBlock& block, uint8_t out[16])
+{
+	bool opaque = true;
+	for (int i = 0; i < 16; i++)
+		opaque = opaque && block.c[3][i] == 255.0f;
+	float error = bcEncodeBc7Mode6(block, out);
+	if (opaque || error == 0.0f)
+		return error;
+	uint8_t mode5[16];
+	float mode5Error = bcEncodeBc7Mode5(block, mode5);
+	if (mode5Error < error)
+	{
+		std::memcpy(out, mode5, 16);
+		return mode5Error;
+	}
+	return error;
+}
+
+inline void bcEncodeBlock(const BcBlock& block, BcFormat format, uint8_t* out)
+{
+	switch (format)
+	{
+	case BcFormat::BC1:
+		bcEncodeColor(block, out);
+		break;
+	case BcFormat::BC3:
+		bcEncodeSingleChannel(block, 3, out);
+		bcEncodeColor(block, out + 8);
+		break;
+	case BcFormat::BC5:
+		bcEncodeSingleChannel(block, 0, out);
+		bcEncodeSingleChannel(block, 1, out + 8);
+		break;
+	case BcFormat::BC7:
+		bcEncodeBc7(block, out);
+		break;
+	}
+}
+
+// RGBA8 image to blocks, rows of blocks are spread over the job system
+inline std::vector<uint8_t> bcEncodeImage(const uint8_t* rgba, int width, int height, BcFormat format, JobSystem* jobs = nullptr)
+{
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	size_t blockBytes = bcBlockBytes(format);
+	std::vector<uint8_t> out((size_t)blocksX * blocksY * blockBytes);
+	auto encodeRows = [&](size_t begin, size_t end)
+	{
+		BcBlock block;
+		for (size_t y = begin; y < end; y++)
+			for (int x = 0; x < blocksX; x++)
+			{
+				bcLoadBlock(rgba, width, height, x, (int)y, block);
+				bcEncodeBlock(block, format, out.data() + (y * blocksX + x) * blockBytes);
+			}
+	};
+	if (jobs)
+		jobs->parallelFor((size_t)blocksY, 1, [&](size_t begin, size_t end, size_t, unsigned int) { encodeRows(begin, end); });
+	else
+		encodeRows(0, (size_t)blocksY);
+	return out;
+}
+
+// decoding -------------------------------------------------------------------------
+// used for the PSNR report and as fallback when the driver lacks a format
+
+inline void bcDecodeColor(const uint8_t* in, uint8_t rgba[16][4], bool alwaysFourColors)
+{
+	uint16_t c0, c1;
+	uint32_t bits;
+	std::memcpy(&c0, in, 2);
+	std::memcpy(&c1, in + 2, 2);
+	std::memcpy(&bits, in + 4, 4);
+	float palette[4][4];
+	bcFrom565(c0, palette[0]);
+	bcFrom565(c1, palette[1]);
+	bool fourColors = alwaysFourColors || c0 > c1;
+	for (int ch = 0; ch < 3; ch++)
+	{
+		palette[2][ch] = fourColors ? (2.0f * palette[0][ch] + palette[1][ch]) / 3.0f : (palette[0][ch] + palette[1][ch]) / 2.0f;
+		palette[3][ch] = fourColors ? (palette[0][ch] + 2.0f * palette[1][ch]) / 3.0f : 0.0f;
+	}
+	palette[2][3] = 255.0f;
+	palette[3][3] = fourColors ? 255.0f : 0.0f;
+	for (int i = 0; i < 16; i++)
+		for (int ch = 0; ch < 4; ch++)
+			rgba[i][ch] = (uint8_t)std::lround(palette[(bits >> (2 * i)) & 3][ch]);
+}
+
+inline void bcDecodeSingleChannel(const uint8_t* in, uint8_t rgba[16][4], int channel)
+{
+	int r0 = in[0], r1 = in[1];
+	float values[8] = { (float)r0, (float)r1 };
+	for (int i = 2; i < 8; i++)
+	{
+		if (r0 > r1)
+			values[i] = ((8 - i) * r0 + (i - 1) * r1) / 7.0f;
+		else
+			values[i] = i < 6 ? ((6 - i) * r0 + (i - 1) * r1) / 5.0f : (i == 6 ? 0.0f : 255.0f);
+	}
+	uint64_t bits = 0;
+	for (int k = 0; k < 6; k++)
+		bits |= (uint64_t)in[2 + k] << (8 * k);
+	for (int i = 0; i < 16; i++)
+		rgba[i][channel] = (uint8_t)std::lround(values[(bits >> (3 * i)) & 7]);
+}
+
+// only modes 5 and 6, the ones the encoder writes; other modes decode as magenta
+inline void bcDecodeBc7(const uint8_t* in, uint8_t rgba[16][4])
+{
+	BcBitReader reader{ in };
+	int mode = 0;
+	while (mode < 8 && reader.get(1) == 0)
+		mode++;
+	if (mode == 5)
+	{
+		int rotation = (int)reader.get(2);
+		int e[2][4];
+		for (int ch = 0; ch < 3; ch++)
+			for (int k = 0; k < 2; k++)
+			{
+				int q = (int)reader.get(7);
+				e[k][ch] = (q << 1) | (q >> 6);
+			}
+		e[0][3] = (int)reader.get(8);
+		e[1][3] = (int)reader.get(8);
+		int colorIndex[16], alphaIndex[16];
+		for (int i = 0; i < 16; i++)
+			colorIndex[i] = (int)reader.get(i == 0 ? 1 : 2);
+		for (int i = 0; i < 16; i++)
+			alphaIndex[i] = (int)reader.get(i == 0 ? 1 : 2);
+		for (int i = 0; i < 16; i++)
+		{
+			for (int ch = 0; ch < 4; ch++)
+			{
+				int w = BC7_WEIGHTS2[ch < 3 ? colorIndex[i] : alphaIndex[i]];
+				rgba[i][ch] = (uint8_t)(((64 - w) * e[0][ch] + w * e[1][ch] + 32) >> 6);
+			}
+			if (rotation > 0)
+				std::swap(rgba[i][3], rgba[i][rotation - 1]);
+		}
+		return;
+	}
+	if (mode != 6)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			rgba[i][0] = 255; rgba[i][1] = 0; rgba[i][2] = 255; rgba[i][3] = 255;
+		}
+		return;
+	}
+	int e[2][4];
+	for (int ch = 0; ch < 4; ch++)
+	{
+		e[0][ch] = (int)reader.get(7) << 1;
+		e[1][ch] = (int)reader.get(7) << 1;
+	}
+	int p0 = (int)reader.get(1), p1 = (int)reader.get(1);
+	for (int ch = 0; ch < 4; ch++)
+	{
+		e[0][ch] |= p0;
+		e[1][ch] |= p1;
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (int)reader.get(i == 0 ? 3 : 4);
+		int w = BC7_WEIGHTS4[index];
+		for (int ch = 0; ch < 4; ch++)
+			rgba[i][ch] = (uint8_t)(((64 - w) * e[0][ch] + w * e[1][ch] + 32) >> 6);
+	}
+}
+
+inline void bcDecodeBlock(const uint8_t* in, BcFormat format, uint8_t rgba[16][4])
+{
+	switch (format)
+	{
+	case BcFormat::BC1:
+		bcDecodeColor(in, rgba, false);
+		break;
+	case BcFormat::BC3:
+		bcDecodeColor(in + 8, rgba, true);
+		bcDecodeSingleChannel(in, rgba, 3);
+		break;
+	case BcFormat::BC5:
+		bcDecodeSingleChannel(in, rgba, 0);
+		bcDecodeSingleChannel(in + 8, rgba, 1);
+		for (int i = 0; i < 16; i++)
+		{
+			rgba[i][2] = 0;
+			rgba[i][3] = 255;
+		}
+		break;
+	case BcFormat::BC7:
+		bcDecodeBc7(in, rgba);
+		break;
+	}
+}
+
+inline std::vector<uint8_t> bcDecodeImage(const uint8_t* blocks, int width, int height, BcFormat format)
+{
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	std::vector<uint8_t> rgba((size_t)width * height * 4);
+	uint8_t decoded[16][4];
+	for (int by = 0; by < blocksY; by++)
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			bcDecodeBlock(blocks + ((size_t)by * blocksX + bx) * bcBlockBytes(format), format, decoded);
+			for (int y = 0; y < 4 && by * 4 + y < height; y++)
+				for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+					std::memcpy(&rgba[(((size_t)by * 4 + y) * width + bx * 4 + x) * 4], decoded[y * 4 + x], 4);
+		}
+	return rgba;
+}
+
+// peak signal to noise ratio over the first 'channels' channels, in dB
+inline double bcPsnr(const uint8_t* a, const uint8_t* b, size_t pixels, int channels)
+{
+	double squaredError = 0.0;
+	for (size_t i = 0; i < pixels; i++)
+		for (int ch = 0; ch < channels; ch++)
+		{
+			double d = (double)a[i * 4 + ch] - (double)b[i * 4 + ch];
+			squaredError += d * d;
+		}
+	if (squaredError == 0.0)
+		return 99.0;
+	double mse = squaredError / ((double)pixels * channels);
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+#endif
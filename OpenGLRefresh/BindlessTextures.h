@@ -0,0 +1,141 @@
+#ifndef BINDLESS_TEXTURES_H
+#define BINDLESS_TEXTURES_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+// GL_ARB_bindless_texture entry points, the 3.3 glad loader doesn't know them
+struct BindlessTextureApi
+{
+	typedef GLuint64 (APIENTRYP GetTextureHandleFn)(GLuint texture);
+	typedef void (APIENTRYP MakeTextureHandleResidentFn)(GLuint64 handle);
+	typedef void (APIENTRYP MakeTextureHandleNonResidentFn)(GLuint64 handle);
+
+	GetTextureHandleFn getTextureHandle = nullptr;
+	MakeTextureHandleResidentFn makeTextureHandleResident = nullptr;
+	MakeTextureHandleNonResidentFn makeTextureHandleNonResident = nullptr;
+	bool supported = false;
+
+	static BindlessTextureApi& instance()
+	{
+		static BindlessTextureApi api;
+		return api;
+	}
+
+	// call once the context is current, e.g. with glfwGetProcAddress. The handles are
+	// read from a shader storage buffer, so that extension is needed as well.
+	static void load(GLADloadproc getProcAddress)
+	{
+		BindlessTextureApi& api = instance();
+		api.getTextureHandle = (GetTextureHandleFn)getProcAddress("glGetTextureHandleARB");
+		api.makeTextureHandleResident = (MakeTextureHandleResidentFn)getProcAddress("glMakeTextureHandleResidentARB");
+		api.makeTextureHandleNonResident = (MakeTextureHandleNonResidentFn)getProcAddress("glMakeTextureHandleNonResidentARB");
+		api.supported = api.getTextureHandle && api.makeTextureHandleResident && api.makeTextureHandleNonResident
+			&& glHasExtension("GL_ARB_bindless_texture") && glHasExtension("GL_ARB_shader_storage_buffer_object");
+	}
+};
+
+// Every texture gets a 64 bit handle that is made resident once and stored in one
+// shader storage buffer, shaders pick theirs by index. Nothing gets bound per draw and
+// a single (multi) draw can sample any texture of the table.
+// Taking the handle freezes the texture: no more level uploads or parameter changes,
+// so streamed textures (TextureStreamer changes the base level) can't go in here.
+class BindlessTextureTable
+{
+public:
+	~BindlessTextureTable() { release(); }
+
+	static bool isSupported() { return BindlessTextureApi::instance().supported; }
+
+	// for Shader's 'defines', goes right behind the #version line. The handle block has
+	// no binding qualifier (that needs 4.2), blocks default to binding point 0.
+	static std::string shaderDefines()
+	{
+		return "#extension GL_ARB_bindless_texture : require\n"
+			"#extension GL_ARB_shader_storage_buffer_object : require\n"
+			"#define BINDLESS_TEXTURES 1\n";
+	}
+
+	// complete texture with all levels uploaded, returns its index in the table
+	int add(unsigned int texture)
+	{
+		if (!isSupported() || texture == 0)
+			return -1;
+		GLuint64 handle = BindlessTextureApi::instance().getTextureHandle(texture);
+		if (handle == 0)
+		{
+			std::cout << "ERROR::BINDLESS::NO_HANDLE for texture " << texture << std::endl;
+			return -1;
+		}
+		textures.push_back(texture);
+		handles.push_back(handle);
+		dirty = true;
+		return (int)handles.size() - 1;
+	}
+
+	// makes the new handles resident and writes the table, call before drawing
+	void upload()
+	{
+		if (!dirty)
+			return;
+		BindlessTextureApi& api = BindlessTextureApi::instance();
+		for (size_t i = residentCount; i < handles.size(); i++)
+			api.makeTextureHandleResident(handles[i]);
+		residentCount = handles.size();
+
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, handles.size() * sizeof(GLuint64), handles.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		dirty = false;
+	}
+
+	// the table for 'layout(std430) buffer { uvec2 handles[]; }', once per frame
+	void bind(GLuint binding = 0) const
+	{
+		if (buffer != 0)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+	}
+
+	int count() const { return (int)handles.size(); }
+	unsigned int texture(int index) const { return textures[index]; }
+	GLuint64 handle(int index) const { return handles[index]; }
+
+	// handles have to be non resident before their textures get deleted
+	void release()
+	{
+		if (residentCount > 0)
+		{
+			BindlessTextureApi& api = BindlessTextureApi::instance();
+			for (size_t i = 0; i < residentCount; i++)
+				api.makeTextureHandleNonResident(handles[i]);
+		}
+		if (buffer != 0)
+			glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		residentCount = 0;
+		textures.clear();
+		handles.clear();
+		dirty = false;
+	}
+
+private:
+	std::vector<unsigned int> textures;
+	std::vector<GLuint64> handles;
+	size_t residentCount = 0;
+	unsigned int buffer = 0;
+	bool dirty = false;
+};
+
+#endif
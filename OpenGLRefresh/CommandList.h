@@ -0,0 +1,386 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Backend agnostic draw commands. Every command starts with a CommandHeader and is
+// padded to 8 bytes so the replay loop can read the structs straight out of the buffer.
+// Handles (programs, VAOs, textures) and uniform locations are plain integers that
+// have to be resolved on the GL thread before recording starts.
+enum class CommandType : uint16_t
+{
+	BindProgram,
+	BindVertexArray,
+	BindTexture,
+	Uniform,
+	DrawArrays,
+	DrawElements,
+	DrawArraysInstanced,
+	DrawElementsInstanced
+};
+
+enum class UniformType : uint16_t
+{
+	Int,
+	Float,
+	Vec2,
+	Vec3,
+	Vec4,
+	Mat3,
+	Mat4
+};
+
+enum class PrimitiveType : uint16_t
+{
+	Triangles,
+	TriangleStrip,
+	Lines,
+	Points
+};
+
+struct CommandHeader
+{
+	CommandType type;
+	uint16_t size; // whole command including this header and the payload
+};
+
+struct CmdBindProgram { CommandHeader header; uint32_t program; };
+struct CmdBindVertexArray { CommandHeader header; uint32_t vao; };
+struct CmdBindTexture { CommandHeader header; uint32_t unit; uint32_t target2DArray; uint32_t texture; };
+// followed by count * component bytes of uniform data
+struct CmdUniform { CommandHeader header; UniformType uniformType; uint16_t count; int32_t location; };
+struct CmdDraw
+{
+	CommandHeader header;
+	PrimitiveType primitive;
+	uint16_t indexed16; // only used by the indexed draws: 1 = GL_UNSIGNED_SHORT, 0 = GL_UNSIGNED_INT
+	uint32_t first;      // first vertex or first index
+	uint32_t count;
+	int32_t baseVertex;
+	uint32_t instanceCount;
+	uint32_t baseInstance;
+};
+
+// one linear buffer of commands. reset() keeps the memory so a list that is reused
+// every frame stops allocating after the first couple of frames.
+class CommandList
+{
+public:
+	void reset() { data.clear(); commandCount = 0; }
+	bool empty() const { return data.empty(); }
+	size_t sizeInBytes() const { return data.size(); }
+	size_t commands() const { return commandCount; }
+	const uint8_t* begin() const { return data.data(); }
+	const uint8_t* end() const { return data.data() + data.size(); }
+
+	// ------------------------------------------------------------------------
+	void bindProgram(uint32_t program)
+	{
+		CmdBindProgram* cmd = push<CmdBindProgram>(CommandType::BindProgram);
+		cmd->program = program;
+	}
+	void bindVertexArray(uint32_t vao)
+	{
+		CmdBindVertexArray* cmd = push<CmdBindVertexArray>(CommandType::BindVertexArray);
+		cmd->vao = vao;
+	}
+	void bindTexture(uint32_t unit, uint32_t texture, bool array = false)
+	{
+		CmdBindTexture* cmd = push<CmdBindTexture>(CommandType::BindTexture);
+		cmd->unit = unit;
+		cmd->target2DArray = array ? 1 : 0;
+		cmd->texture = texture;
+	}
+	// ------------------------------------------------------------------------
+	void setInt(int location, int value) { uniform(location, UniformType::Int, 1, &value, sizeof(int)); }
+	void setFloat(int location, float value) { uniform(location, UniformType::Float, 1, &value, sizeof(float)); }
+	void setVec2(int location, const glm::vec2& value) { uniform(location, UniformType::Vec2, 1, &value[0], sizeof(float) * 2); }
+	void setVec3(int location, const glm::vec3& value) { uniform(location, UniformType::Vec3, 1, &value[0], sizeof(float) * 3); }
+	void setVec4(int location, const glm::vec4& value) { uniform(location, UniformType::Vec4, 1, &value[0], sizeof(float) * 4); }
+	void setMat3(int location, const glm::mat3& mat) { uniform(location, UniformType::Mat3, 1, &mat[0][0], sizeof(float) * 9); }
+	void setMat4(int location, const glm::mat4& mat) { uniform(location, UniformType::Mat4, 1, &mat[0][0], sizeof(float) * 16); }
+	// raw blob for arrays of uniforms, 'bytes' has to match count * size of one element.
+	// The header only stores 16 bit sizes, so one call is limited to just under 64 KB.
+	void uniform(int location, UniformType type, size_t count, const void* values, size_t bytes)
+	{
+		if (location < 0)
+			return;
+		assert(count <= 0xFFFF && "CommandList::uniform: too many array elements");
+		CmdUniform* cmd = push<CmdUniform>(CommandType::Uniform, bytes);
+		cmd->uniformType = type;
+		cmd->count = (uint16_t)count;
+		cmd->location = location;
+		std::memcpy(cmd + 1, values, bytes);
+	}
+	// ------------------------------------------------------------------------
+	void drawArrays(PrimitiveType primitive, uint32_t first, uint32_t count, uint32_t instanceCount = 1)
+	{
+		CmdDraw* cmd = push<CmdDraw>(instanceCount == 1 ? CommandType::DrawArrays : CommandType::DrawArraysInstanced);
+		fillDraw(cmd, primitive, first, count, 0, instanceCount, false);
+	}
+	void drawElements(PrimitiveType primitive, uint32_t firstIndex, uint32_t count, int32_t baseVertex = 0, uint32_t instanceCount = 1, bool shortIndices = false)
+	{
+		CmdDraw* cmd = push<CmdDraw>(instanceCount == 1 ? CommandType::DrawElements : CommandType::DrawElementsInstanced);
+		fillDraw(cmd, primitive, firstIndex, count, baseVertex, instanceCount, shortIndices);
+	}
+
+private:
+	std::vector<uint8_t> data;
+	size_t commandCount = 0;
+
+	template <typename T>
+	T* push(CommandType type, size_t payload = 0)
+	{
+		size_t size = (sizeof(T) + payload + 7) & ~size_t(7);
+		assert(size <= 0xFFFF && "CommandList: command too large for its header");
+		size_t offset = data.size();
+		data.resize(offset + size);
+		T* cmd = reinterpret_cast<T*>(data.data() + offset);
+		cmd->header.type = type;
+		cmd->header.size = (uint16_t)size;
+		commandCount++;
+		return cmd;
+	}
+
+	static void fillDraw(CmdDraw* cmd, PrimitiveType primitive, uint32_t first, uint32_t count, int32_t baseVertex, uint32_t instanceCount, bool shortIndices)
+	{
+		cmd->primitive = primitive;
+		cmd->indexed16 = shortIndices ? 1 : 0;
+		cmd->first = first;
+		cmd->count = count;
+		cmd->baseVertex = baseVertex;
+		cmd->instanceCount = instanceCount;
+		cmd->baseInstance = 0;
+	}
+};
+
+// Records command lists on the job system. Each thread writes into its own linear
+// CommandList and every chunk remembers which slice of which list it produced, so
+// the replay walks the chunks in submission order no matter which thread ran them.
+class ParallelCommandRecorder
+{
+public:
+	struct Span
+	{
+		uint32_t thread;
+		size_t begin;
+		size_t end;
+	};
+
+	// record(list, begin, end) is called for every chunk of [0, itemCount)
+	template <typename RecordFn>
+	void record(JobSystem& jobs, size_t itemCount, size_t grain, RecordFn recordFn)
+	{
+		if (threadLists.size() < jobs.threadCount())
+			threadLists.resize(jobs.threadCount());
+		for (CommandList& list : threadLists)
+			list.reset();
+		chunks.clear();
+		if (itemCount == 0)
+			return;
+		if (grain == 0)
+			grain = 1;
+		chunks.resize((itemCount + grain - 1) / grain);
+
+		jobs.parallelFor(itemCount, grain, [&](size_t begin, size_t end, size_t chunk, unsigned int thread)
+		{
+			CommandList& list = threadLists[thread];
+			Span& span = chunks[chunk];
+			span.thread = thread;
+			span.begin = list.sizeInBytes();
+			recordFn(list, begin, end);
+			span.end = list.sizeInBytes();
+		});
+	}
+
+	const std::vector<Span>& spans() const { return chunks; }
+	const CommandList& list(uint32_t thread) const { return threadLists[thread]; }
+
+	size_t commandCount() const
+	{
+		size_t total = 0;
+		for (const CommandList& list : threadLists)
+			total += list.commands();
+		return total;
+	}
+
+private:
+	std::vector<CommandList> threadLists;
+	std::vector<Span> chunks;
+};
+
+// GL backend: replays command lists on the context thread. Redundant program, VAO and
+// texture binds are dropped since neighbouring draws often share them.
+class GLCommandReplayer
+{
+public:
+	struct Stats
+	{
+		size_t commands = 0;
+		size_t drawCalls = 0;
+		size_t skippedBinds = 0;
+		size_t textureBinds = 0; // the ones that reached GL
+		size_t uniforms = 0;
+		size_t bytes = 0;
+	};
+
+	static const uint32_t TEXTURE_UNITS = 16;
+
+	GLCommandReplayer() { beginFrame(); }
+
+	// call once per frame before replaying, GL state may have changed behind our back
+	void beginFrame()
+	{
+		currentProgram = ~0u;
+		currentVao = ~0u;
+		for (uint32_t unit = 0; unit < TEXTURE_UNITS; unit++)
+			currentTextures[unit] = ~0u;
+		activeUnit = ~0u;
+		stats = Stats();
+	}
+
+	void replay(const CommandList& list)
+	{
+		replay(list.begin(), list.end());
+	}
+
+	void replay(const ParallelCommandRecorder& recorder)
+	{
+		for (const ParallelCommandRecorder::Span& span : recorder.spans())
+		{
+			const uint8_t* base = recorder.list(span.thread).begin();
+			replay(base + span.begin, base + span.end);
+		}
+	}
+
+	void replay(const uint8_t* it, const uint8_t* end)
+	{
+		stats.bytes += end - it;
+		while (it < end)
+		{
+			const CommandHeader* header = reinterpret_cast<const CommandHeader*>(it);
+			switch (header->type)
+			{
+			case CommandType::BindProgram:
+			{
+				const CmdBindProgram* cmd = reinterpret_cast<const CmdBindProgram*>(it);
+				if (cmd->program != currentProgram)
+				{
+					glUseProgram(cmd->program);
+					currentProgram = cmd->program;
+				}
+				else
+					stats.skippedBinds++;
+				break;
+			}
+			case CommandType::BindVertexArray:
+			{
+				const CmdBindVertexArray* cmd = reinterpret_cast<const CmdBindVertexArray*>(it);
+				if (cmd->vao != currentVao)
+				{
+					glBindVertexArray(cmd->vao);
+					currentVao = cmd->vao;
+				}
+				else
+					stats.skippedBinds++;
+				break;
+			}
+			case CommandType::BindTexture:
+			{
+				const CmdBindTexture* cmd = reinterpret_cast<const CmdBindTexture*>(it);
+				// the target goes into the key, a unit can hold a 2D and an array texture
+				uint32_t key = cmd->texture * 2 + cmd->target2DArray;
+				if (cmd->unit >= TEXTURE_UNITS || currentTextures[cmd->unit] != key)
+				{
+					if (cmd->unit != activeUnit)
+					{
+						glActiveTexture(GL_TEXTURE0 + cmd->unit);
+						activeUnit = cmd->unit;
+					}
+					glBindTexture(cmd->target2DArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, cmd->texture);
+					if (cmd->unit < TEXTURE_UNITS)
+						currentTextures[cmd->unit] = key;
+					stats.textureBinds++;
+				}
+				else
+					stats.skippedBinds++;
+				break;
+			}
+			case CommandType::Uniform:
+			{
+				const CmdUniform* cmd = reinterpret_cast<const CmdUniform*>(it);
+				const void* values = cmd + 1;
+				switch (cmd->uniformType)
+				{
+				case UniformType::Int: glUniform1iv(cmd->location, cmd->count, (const GLint*)values); break;
+				case UniformType::Float: glUniform1fv(cmd->location, cmd->count, (const GLfloat*)values); break;
+				case UniformType::Vec2: glUniform2fv(cmd->location, cmd->count, (const GLfloat*)values); break;
+				case UniformType::Vec3: glUniform3fv(cmd->location, cmd->count, (const GLfloat*)values); break;
+				case UniformType::Vec4: glUniform4fv(cmd->location, cmd->count, (const GLfloat*)values); break;
+				case UniformType::Mat3: glUniformMatrix3fv(cmd->location, cmd->count, GL_FALSE, (const GLfloat*)values); break;
+				case UniformType::Mat4: glUniformMatrix4fv(cmd->location, cmd->count, GL_FALSE, (const GLfloat*)values); break;
+				}
+				stats.uniforms++;
+				break;
+			}
+			case CommandType::DrawArrays:
+			case CommandType::DrawArraysInstanced:
+			{
+				const CmdDraw* cmd = reinterpret_cast<const CmdDraw*>(it);
+				if (header->type == CommandType::DrawArrays)
+					glDrawArrays(glPrimitive(cmd->primitive), cmd->first, cmd->count);
+				else
+					glDrawArraysInstanced(glPrimitive(cmd->primitive), cmd->first, cmd->count, cmd->instanceCount);
+				stats.drawCalls++;
+				break;
+			}
+			case CommandType::DrawElements:
+			case CommandType::DrawElementsInstanced:
+			{
+				const CmdDraw* cmd = reinterpret_cast<const CmdDraw*>(it);
+				GLenum indexType = cmd->indexed16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+				size_t indexSize = cmd->indexed16 ? 2 : 4;
+				void* offset = (void*)(cmd->first * indexSize);
+				if (header->type == CommandType::DrawElements)
+					glDrawElementsBaseVertex(glPrimitive(cmd->primitive), cmd->count, indexType, offset, cmd->baseVertex);
+				else
+					glDrawElementsInstancedBaseVertex(glPrimitive(cmd->primitive), cmd->count, indexType, offset, cmd->instanceCount, cmd->baseVertex);
+				stats.drawCalls++;
+				break;
+			}
+			}
+			stats.commands++;
+			it += header->size;
+		}
+	}
+
+	const Stats& frameStats() const { return stats; }
+
+private:
+	uint32_t currentProgram = ~0u;
+	uint32_t currentVao = ~0u;
+	uint32_t currentTextures[TEXTURE_UNITS];
+	uint32_t activeUnit = ~0u;
+	Stats stats;
+
+	static GLenum glPrimitive(PrimitiveType primitive)
+	{
+		switch (primitive)
+		{
+		case PrimitiveType::TriangleStrip: return GL_TRIANGLE_STRIP;
+		case PrimitiveType::Lines: return GL_LINES;
+		case PrimitiveType::Points: return GL_POINTS;
+		default: return GL_TRIANGLES;
+		}
+	}
+};
+
+#endif
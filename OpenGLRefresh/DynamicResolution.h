@@ -0,0 +1,350 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "AssetCache.h"
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GPU time of the frame graph from GL_TIME_ELAPSED queries. A result is only read once
+// the driver says it is there, a few frames later, so measuring never stalls the CPU.
+// With every query of the ring still in flight a frame simply goes unmeasured.
+class GpuFrameTimer
+{
+public:
+	static const int RING = 4;
+
+	GpuFrameTimer() {}
+	GpuFrameTimer(const GpuFrameTimer&) = delete;
+	GpuFrameTimer& operator=(const GpuFrameTimer&) = delete;
+
+	// 'tag' comes back with the result, the render scale the measured frame was drawn at
+	void begin(float tag)
+	{
+		if (queries[0] == 0)
+			glGenQueries(RING, queries);
+		running = issued - collected < RING;
+		if (!running)
+			return;
+		tags[issued % RING] = tag;
+		glBeginQuery(GL_TIME_ELAPSED, queries[issued % RING]);
+	}
+
+	void end()
+	{
+		if (!running)
+			return;
+		glEndQuery(GL_TIME_ELAPSED);
+		issued++;
+		running = false;
+	}
+
+	// the oldest finished measurement, false when none is ready yet
+	bool poll(double& ms, float& tag)
+	{
+		if (collected == issued)
+			return false;
+		GLuint query = queries[collected % RING];
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		ms = nanoseconds / 1e6;
+		tag = tags[collected % RING];
+		collected++;
+		return true;
+	}
+
+	void release()
+	{
+		if (queries[0] != 0)
+			glDeleteQueries(RING, queries);
+		std::fill(queries, queries + RING, 0u);
+		issued = collected = 0;
+		running = false;
+	}
+
+private:
+	GLuint queries[RING] = {};
+	float tags[RING] = {};
+	uint64_t issued = 0;
+	uint64_t collected = 0;
+	bool running = false;
+};
+
+// Picks the scale the scene is rendered at so the GPU time stays within 'targetMs'. The
+// cost is taken as proportional to the pixel count, scale squared, and the controller
+// aims a little below the budget. Overruns are answered at once, headroom is given back
+// over several frames so the resolution doesn't pump with every noisy measurement.
+class DynamicResolution
+{
+public:
+	struct Sample
+	{
+		float scale; // the scale the measured frame was rendered at
+		double gpuMs;
+	};
+
+	static const size_t HISTORY = 600;
+
+	DynamicResolution() {}
+	DynamicResolution(float targetMs, float minScale = 0.5f, float maxScale = 1.0f)
+		: targetMs(targetMs), minScale(std::min(minScale, maxScale)), maxScale(maxScale), current(maxScale) {}
+
+	bool enabled() const { return targetMs > 0.0f; }
+	float scale() const { return current; }
+	float budgetMs() const { return targetMs; }
+
+	// the part of the full size target the scene renders into this frame
+	void renderSize(int width, int height, int& renderWidth, int& renderHeight) const
+	{
+		renderWidth = std::max(1, (int)(width * current + 0.5f));
+		renderHeight = std::max(1, (int)(height * current + 0.5f));
+	}
+
+	void update(double gpuMs, float renderedScale)
+	{
+		// the first frames pay for pool allocations and the driver finishing its shaders
+		if (warmup > 0)
+		{
+			warmup--;
+			return;
+		}
+		if (history.size() < HISTORY)
+			history.push_back({ renderedScale, gpuMs });
+		else
+			history[frames % HISTORY] = { renderedScale, gpuMs };
+		frames++;
+		if (gpuMs <= targetMs)
+			framesWithinBudget++;
+
+		// measurements lag a few frames behind, judging them against the scale they were
+		// rendered at keeps one overrun from shrinking the image again and again
+		double aim = targetMs * HEADROOM;
+		float desired = (float)(renderedScale * std::sqrt(aim / std::max(gpuMs, 0.01)));
+		desired = std::min(std::max(desired, minScale), maxScale);
+		if (desired < current - DEADBAND)
+			current = desired;
+		else if (desired > current + DEADBAND)
+			current = std::min(desired, current + std::max((desired - current) * RAISE_RATE, STEP));
+		current = std::min(std::max(std::round(current / STEP) * STEP, minScale), maxScale);
+	}
+
+	// oldest first
+	std::vector<Sample> samples() const
+	{
+		std::vector<Sample> ordered;
+		size_t first = history.size() < HISTORY ? 0 : (size_t)(frames % HISTORY);
+		for (size_t i = 0; i < history.size(); i++)
+			ordered.push_back(history[(first + i) % history.size()]);
+		return ordered;
+	}
+
+	// share of the measured frames whose GPU time was within the budget
+	double hitRate() const { return frames > 0 ? (double)framesWithinBudget / frames : 0.0; }
+
+	void printStats() const
+	{
+		std::vector<Sample> recent = samples();
+		if (recent.empty())
+		{
+			std::cout << "Dynamic resolution: no GPU times measured yet" << std::endl;
+			return;
+		}
+		float low = maxScale, high = minScale;
+		double scaleSum = 0.0;
+		size_t recentHits = 0;
+		std::vector<double> gpuMs;
+		for (const Sample& sample : recent)
+		{
+			low = std::min(low, sample.scale);
+			high = std::max(high, sample.scale);
+			scaleSum += sample.scale;
+			recentHits += sample.gpuMs <= targetMs;
+			gpuMs.push_back(sample.gpuMs);
+		}
+		std::sort(gpuMs.begin(), gpuMs.end());
+		std::printf("Dynamic resolution: budget %.2f ms, scale %.2f now, %.2f-%.2f (mean %.2f) over the last %zu frames\n",
+			targetMs, current, low, high, scaleSum / recent.size(), recent.size());
+		std::printf("  GPU median %.2f ms, p95 %.2f ms, within budget %.1f%% (last %zu), %.1f%% (all %llu frames)\n",
+			gpuMs[gpuMs.size() / 2], gpuMs[std::min(gpuMs.size() - 1, gpuMs.size() * 95 / 100)],
+			100.0 * recentHits / recent.size(), recent.size(), 100.0 * hitRate(), (unsigned long long)frames);
+	}
+
+	// one line per measured frame, for plotting the controller
+	bool writeHistory(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "ERROR::DYNAMIC_RESOLUTION::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		file << "scale,gpu_ms,budget_ms\n";
+		for (const Sample& sample : samples())
+			file << sample.scale << "," << sample.gpuMs << "," << targetMs << "\n";
+		return true;
+	}
+
+private:
+	static constexpr double HEADROOM = 0.9;
+	static constexpr float DEADBAND = 0.02f;
+	static constexpr float RAISE_RATE = 0.1f;
+	static constexpr float STEP = 0.01f;
+	static const int WARMUP_FRAMES = 3;
+
+	float targetMs = 0.0f;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float current = 1.0f;
+	std::vector<Sample> history;
+	uint64_t frames = 0;
+	uint64_t framesWithinBudget = 0;
+	int warmup = WARMUP_FRAMES;
+};
+
+enum class UpscaleMode
+{
+	Bilinear,
+	Fsr // edge adaptive upscale plus sharpening, after AMD's FidelityFX Super Resolution 1
+};
+
+inline bool parseUpscaleMode(const std::string& name, UpscaleMode& mode)
+{
+	if (name == "bilinear")
+		mode = UpscaleMode::Bilinear;
+	else if (name == "fsr")
+		mode = UpscaleMode::Fsr;
+	else
+		return false;
+	return true;
+}
+
+// Brings the dynamic resolution image up to the output size. The scene texture keeps the
+// full size and the scene only draws into its bottom left 'renderWidth' x 'renderHeight',
+// so a new scale never reallocates anything; the passes clamp their reads to that part.
+class Upscaler
+{
+public:
+	// 'defines' are the base defines ShaderCheck validates the shaders with, so --spirv finds them
+	Upscaler(UpscaleMode mode, const std::string& defines, AssetCache* cache = nullptr)
+		: mode(mode)
+	{
+		if (mode == UpscaleMode::Bilinear)
+			upscaleProgram = Shader("shaders/fullscreen.vs", "shaders/upscale_bilinear.fs", defines, cache).ID;
+		else
+		{
+			upscaleProgram = Shader("shaders/fullscreen.vs", "shaders/upscale_easu.fs", defines, cache).ID;
+			sharpenProgram = Shader("shaders/fullscreen.vs", "shaders/sharpen_rcas.fs", defines, cache).ID;
+			sharpnessLocation = Shader::uniformLocation(sharpenProgram, "sharpness");
+			glUseProgram(sharpenProgram);
+			glUniform1i(Shader::uniformLocation(sharpenProgram, "source"), 0);
+		}
+		renderSizeLocation = Shader::uniformLocation(upscaleProgram, "renderSize");
+		outputSizeLocation = Shader::uniformLocation(upscaleProgram, "outputSize");
+		glUseProgram(upscaleProgram);
+		glUniform1i(Shader::uniformLocation(upscaleProgram, "source"), 0);
+		glUseProgram(0);
+		// the full screen triangle comes from gl_VertexID, core profile still wants a VAO
+		glGenVertexArrays(1, &emptyVao);
+	}
+	Upscaler(const Upscaler&) = delete;
+	Upscaler& operator=(const Upscaler&) = delete;
+
+	// 0 turns the sharpening off, 1 is the strongest
+	float sharpness = 0.8f;
+
+	void addPasses(FrameGraph& graph, FrameGraphResource scene, FrameGraphResource output, const FrameGraphTextureDesc& outputDesc, int renderWidth, int renderHeight)
+	{
+		if (mode == UpscaleMode::Bilinear)
+		{
+			graph.addPass("upscale", [=](FrameGraph::PassBuilder& builder)
+			{
+				builder.read(scene);
+				builder.write(output);
+			},
+			[=](const FrameGraphContext& context)
+			{
+				context.bindRenderTarget();
+				glUseProgram(upscaleProgram);
+				glUniform2f(renderSizeLocation, (float)renderWidth, (float)renderHeight);
+				draw(context.texture(scene));
+			});
+			return;
+		}
+
+		// EASU into a full size intermediate, RCAS from there into the output
+		FrameGraphResource upscaled = FRAME_GRAPH_INVALID;
+		graph.addPass("easu", [&](FrameGraph::PassBuilder& builder)
+		{
+			builder.read(scene);
+			FrameGraphTextureDesc desc = outputDesc;
+			desc.internalFormat = GL_RGBA8;
+			upscaled = builder.create("upscaled", desc);
+			builder.write(upscaled);
+		},
+		[=](const FrameGraphContext& context)
+		{
+			context.bindRenderTarget();
+			glUseProgram(upscaleProgram);
+			glUniform2f(renderSizeLocation, (float)renderWidth, (float)renderHeight);
+			glUniform2f(outputSizeLocation, (float)outputDesc.width, (float)outputDesc.height);
+			draw(context.texture(scene));
+		});
+		graph.addPass("rcas", [=](FrameGraph::PassBuilder& builder)
+		{
+			builder.read(upscaled);
+			builder.write(output);
+		},
+		[=](const FrameGraphContext& context)
+		{
+			context.bindRenderTarget();
+			glUseProgram(sharpenProgram);
+			glUniform1f(sharpnessLocation, sharpness);
+			draw(context.texture(upscaled));
+		});
+	}
+
+	void release()
+	{
+		glDeleteProgram(upscaleProgram);
+		if (sharpenProgram != 0)
+			glDeleteProgram(sharpenProgram);
+		glDeleteVertexArrays(1, &emptyVao);
+		upscaleProgram = sharpenProgram = emptyVao = 0;
+	}
+
+private:
+	UpscaleMode mode;
+	GLuint upscaleProgram = 0;
+	GLuint sharpenProgram = 0;
+	GLuint emptyVao = 0;
+	GLint renderSizeLocation = -1;
+	GLint outputSizeLocation = -1;
+	GLint sharpnessLocation = -1;
+
+	// a full screen triangle with the program already bound, the scene expects depth testing
+	void draw(GLuint source) const
+	{
+		glDisable(GL_DEPTH_TEST);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, source);
+		glBindVertexArray(emptyVao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glEnable(GL_DEPTH_TEST);
+	}
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef FAST_PARSE_H
+#define FAST_PARSE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Number parsing for the text loaders. Works on [begin, end) ranges out of a mapped
+// file (no null terminator needed) and never touches the locale. Most numbers in
+// asset files have few digits, those take Clinger's fast path: the decimal mantissa
+// fits a double exactly and one multiply/divide by an exact power of ten rounds
+// correctly. Everything else falls back to strtod on a small stack copy.
+
+inline bool isDigit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+inline const char* skipSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
+
+inline const char* skipLine(const char* p, const char* end)
+{
+	const char* newline = (const char*)std::memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+// returns the position after the number, or nullptr if there is no number at p
+inline const char* parseDouble(const char* p, const char* end, double& out)
+{
+	static const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	while (p < end && isDigit(*p))
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+			if (mantissa != 0)
+				digits++;
+		}
+		else
+			exponent++; // digits beyond what we keep only scale the value
+		p++;
+		any = true;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && isDigit(*p))
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				if (mantissa != 0)
+					digits++;
+				exponent--;
+			}
+			p++;
+			any = true;
+		}
+	}
+	if (!any)
+		return nullptr;
+
+	bool slowPath = digits >= 19;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+		{
+			negativeExponent = *e == '-';
+			e++;
+		}
+		if (e < end && isDigit(*e))
+		{
+			int value = 0;
+			while (e < end && isDigit(*e))
+			{
+				if (value < 10000)
+					value = value * 10 + (*e - '0');
+				e++;
+			}
+			exponent += negativeExponent ? -value : value;
+			p = e;
+		}
+	}
+
+	if (!slowPath && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double value = (double)mantissa;
+		value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+		out = negative ? -value : value;
+		return p;
+	}
+
+	char buffer[128];
+	size_t length = (size_t)(p - start);
+	if (length >= sizeof(buffer))
+		length = sizeof(buffer) - 1;
+	std::memcpy(buffer, start, length);
+	buffer[length] = '\0';
+	out = std::strtod(buffer, nullptr);
+	return p;
+}
+
+inline const char* parseFloat(const char* p, const char* end, float& out)
+{
+	double value;
+	p = parseDouble(p, end, value);
+	if (p)
+		out = (float)value;
+	return p;
+}
+
+inline const char* parseInt(const char* p, const char* end, long long& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+	if (p >= end || !isDigit(*p))
+		return nullptr;
+	long long value = 0;
+	while (p < end && isDigit(*p))
+		value = value * 10 + (*p++ - '0');
+	out = negative ? -value : value;
+	return p;
+}
+
+#endif
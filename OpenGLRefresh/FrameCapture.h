@@ -0,0 +1,479 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include "Image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat
+{
+	Png, // one numbered file per frame
+	Raw, // RGBA8 frames back to back, top row first, one file per frame size
+	Y4m  // YUV4MPEG2 4:2:0 video, ffmpeg/mpv read it directly
+};
+
+inline bool parseCaptureFormat(const std::string& name, CaptureFormat& format)
+{
+	if (name == "png")
+		format = CaptureFormat::Png;
+	else if (name == "raw")
+		format = CaptureFormat::Raw;
+	else if (name == "y4m")
+		format = CaptureFormat::Y4m;
+	else
+		return false;
+	return true;
+}
+
+// Framebuffer capture without stalling: glReadPixels goes into one pixel buffer of a
+// small ring and only queues the copy, a fence marks when it is done. Buffers are mapped
+// once their fence has passed, usually the frame after next, and the pixels go to a
+// writer thread that encodes them in order. The render thread only pays for issuing the
+// read and one memcpy per frame; it waits only when every buffer of the ring is still in
+// flight, and drops frames when the writer falls too far behind instead of piling up memory.
+class FrameCapture
+{
+public:
+	struct Stats
+	{
+		uint64_t frames = 0;       // readbacks issued
+		uint64_t written = 0;
+		uint64_t dropped = 0;      // the writer was 'maxQueued' frames behind
+		uint64_t stalls = 0;       // the ring was full and the oldest fence not passed
+		double overheadMsTotal = 0.0; // render thread time in frame()
+		double overheadMsMax = 0.0;
+		double encodeMsTotal = 0.0;   // writer thread
+		uint64_t bytesWritten = 0;
+	};
+
+	explicit FrameCapture(size_t ringSize = 3, size_t maxQueued = 8)
+		: slots(std::max<size_t>(ringSize, 2)), maxQueued(maxQueued)
+	{
+	}
+
+	~FrameCapture() { release(); }
+
+	// continuous capture of every frame into 'directory', PNGs are numbered from 'firstFrame'.
+	// Frames still in flight go where they were meant to, so jobs can start back to back.
+	bool start(const std::string& directory, CaptureFormat format, int framesPerSecond = 60, uint64_t firstFrame = 0)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error)
+		{
+			std::cout << "ERROR::CAPTURE::NO_DIRECTORY " << directory << std::endl;
+			return false;
+		}
+		startWriter();
+		output.directory = directory;
+		output.format = format;
+		output.fps = std::max(framesPerSecond, 1);
+		output.session++; // raw and y4m start a new file
+		nextFrameNumber = firstFrame;
+		streaming = true;
+		if (verbose)
+			std::cout << "Capturing to " << directory << std::endl;
+		return true;
+	}
+
+	// the frames already read back are still written
+	void stop()
+	{
+		streaming = false;
+	}
+
+	bool capturing() const { return streaming; }
+
+	// prints where captures start and every screenshot
+	bool verbose = true;
+
+	// the next frame() reads back one PNG to 'path', also while not capturing
+	void screenshot(const std::string& path)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+		startWriter();
+		screenshotPath = path;
+	}
+
+	// call after the frame is rendered and before the swap, reads the back buffer or the
+	// first color attachment of 'framebuffer'
+	void frame(int width, int height, unsigned int framebuffer = 0)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		collect(false);
+		if ((streaming || !screenshotPath.empty()) && width > 0 && height > 0)
+		{
+			Slot& slot = slots[next];
+			if (slot.fence)
+			{
+				// the ring is too short for how far the GPU runs behind
+				stats.stalls++;
+				collect(true);
+			}
+			issue(slot, width, height, framebuffer);
+			next = (next + 1) % slots.size();
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+		if (streaming || pendingCount() > 0)
+		{
+			stats.overheadMsTotal += ms;
+			stats.overheadMsMax = std::max(stats.overheadMsMax, ms);
+		}
+	}
+
+	// waits for everything in flight and for the writer
+	void flush()
+	{
+		while (pendingCount() > 0)
+			collect(true);
+		std::unique_lock<std::mutex> lock(queueMutex);
+		idleCondition.wait(lock, [this]() { return queue.empty() && !encoding; });
+	}
+
+	const Stats& statistics() const { return stats; }
+
+	void printStats()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (stats.frames == 0)
+			return;
+		std::cout << "Frame capture: " << stats.frames << " frames read back, " << stats.written << " written ("
+			<< stats.bytesWritten / (1024 * 1024) << " MB), " << stats.dropped << " dropped, " << stats.stalls << " ring stalls" << std::endl;
+		std::cout << "  render thread " << stats.overheadMsTotal / stats.frames << " ms per frame (max " << stats.overheadMsMax
+			<< " ms), writer " << (stats.written > 0 ? stats.encodeMsTotal / stats.written : 0.0) << " ms per frame" << std::endl;
+	}
+
+	void release()
+	{
+		if (writer.joinable())
+		{
+			flush();
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				quit = true;
+			}
+			queueCondition.notify_all();
+			writer.join();
+		}
+		for (Slot& slot : slots)
+		{
+			if (slot.fence)
+				glDeleteSync(slot.fence);
+			if (slot.buffer)
+				glDeleteBuffers(1, &slot.buffer);
+			slot = Slot();
+		}
+		streaming = false;
+	}
+
+private:
+	// where streamed frames go, copied into every readback
+	struct Output
+	{
+		std::string directory;
+		CaptureFormat format = CaptureFormat::Png;
+		int fps = 60;
+		uint64_t session = 0;
+	};
+
+	struct Slot
+	{
+		unsigned int buffer = 0;
+		size_t capacity = 0;
+		GLsync fence = nullptr;
+		int width = 0;
+		int height = 0;
+		std::string screenshot; // empty for the stream
+		bool stream = false;
+		Output output;
+		uint64_t frameNumber = 0;
+		uint64_t issued = 0;    // for FIFO order
+	};
+
+	struct Job
+	{
+		std::vector<uint8_t> pixels; // bottom row first, as GL returns them
+		int width = 0;
+		int height = 0;
+		std::string screenshot;
+		bool stream = false;
+		Output output;
+		uint64_t frameNumber = 0;
+	};
+
+	std::vector<Slot> slots;
+	size_t next = 0;
+	uint64_t issuedCount = 0;
+	size_t maxQueued;
+	bool streaming = false;
+	Output output;
+	uint64_t nextFrameNumber = 0;
+	std::string screenshotPath;
+	Stats stats;
+
+	// writer side, guarded by queueMutex
+	std::thread writer;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::condition_variable idleCondition;
+	std::deque<Job> queue;
+	std::vector<std::vector<uint8_t>> freeBuffers;
+	bool encoding = false;
+	bool quit = false;
+	std::ofstream streamFile;
+	uint64_t streamSession = 0;
+	int streamWidth = 0;
+	int streamHeight = 0;
+	int streamPart = 0;
+
+	size_t pendingCount() const
+	{
+		size_t count = 0;
+		for (const Slot& slot : slots)
+			count += slot.fence ? 1 : 0;
+		return count;
+	}
+
+	void issue(Slot& slot, int width, int height, unsigned int framebuffer)
+	{
+		size_t bytes = (size_t)width * height * 4;
+		if (slot.buffer == 0)
+			glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		if (slot.capacity != bytes)
+		{
+			glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+			slot.capacity = bytes;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.width = width;
+		slot.height = height;
+		slot.stream = streaming;
+		slot.output = output;
+		slot.frameNumber = streaming ? nextFrameNumber++ : 0;
+		slot.screenshot = screenshotPath;
+		slot.issued = issuedCount++;
+		screenshotPath.clear();
+		stats.frames++;
+	}
+
+	// maps the finished buffers oldest first, 'wait' blocks for the oldest one
+	void collect(bool wait)
+	{
+		while (true)
+		{
+			Slot* oldest = nullptr;
+			for (Slot& slot : slots)
+				if (slot.fence && (!oldest || slot.issued < oldest->issued))
+					oldest = &slot;
+			if (!oldest)
+				return;
+			GLenum state = glClientWaitSync(oldest->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+			if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+			{
+				if (!wait)
+					return;
+				std::cout << "ERROR::CAPTURE::FENCE_TIMEOUT" << std::endl;
+			}
+			glDeleteSync(oldest->fence);
+			oldest->fence = nullptr;
+			wait = false;
+
+			std::unique_lock<std::mutex> lock(queueMutex);
+			if (queue.size() >= maxQueued)
+			{
+				stats.dropped++;
+				continue;
+			}
+			Job job;
+			if (!freeBuffers.empty())
+			{
+				job.pixels = std::move(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+			lock.unlock();
+
+			size_t bytes = (size_t)oldest->width * oldest->height * 4;
+			job.pixels.resize(bytes);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest->buffer);
+			if (void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT))
+			{
+				std::memcpy(job.pixels.data(), mapped, bytes);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			job.width = oldest->width;
+			job.height = oldest->height;
+			job.stream = oldest->stream;
+			job.output = oldest->output;
+			job.frameNumber = oldest->frameNumber;
+			job.screenshot = oldest->screenshot;
+
+			lock.lock();
+			queue.push_back(std::move(job));
+			lock.unlock();
+			queueCondition.notify_one();
+		}
+	}
+
+	void startWriter()
+	{
+		if (!writer.joinable())
+		{
+			quit = false;
+			writer = std::thread([this]() { writerLoop(); });
+		}
+	}
+
+	void writerLoop()
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		while (true)
+		{
+			queueCondition.wait(lock, [this]() { return quit || !queue.empty(); });
+			if (queue.empty())
+				break;
+			Job job = std::move(queue.front());
+			queue.pop_front();
+			encoding = true;
+			lock.unlock();
+
+			auto begin = std::chrono::high_resolution_clock::now();
+			ImageRGBA8 image;
+			image.width = job.width;
+			image.height = job.height;
+			image.pixels.resize(job.pixels.size());
+			size_t stride = (size_t)job.width * 4;
+			for (int y = 0; y < job.height; y++)
+				std::memcpy(image.pixels.data() + y * stride, job.pixels.data() + (job.height - 1 - y) * stride, stride);
+			size_t bytes = 0;
+			if (!job.screenshot.empty() && PngWriter::write(job.screenshot, image))
+			{
+				bytes += (size_t)std::filesystem::file_size(job.screenshot);
+				if (verbose)
+					std::cout << "Saved " << job.screenshot << std::endl;
+			}
+			if (job.stream)
+				bytes += writeStreamFrame(job, image);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+
+			lock.lock();
+			stats.written++;
+			stats.encodeMsTotal += ms;
+			stats.bytesWritten += bytes;
+			freeBuffers.push_back(std::move(job.pixels));
+			encoding = false;
+			if (queue.empty())
+				idleCondition.notify_all();
+		}
+		streamFile.close();
+		idleCondition.notify_all();
+	}
+
+	// writer thread only
+	size_t writeStreamFrame(const Job& job, const ImageRGBA8& image)
+	{
+		const std::string& directory = job.output.directory;
+		CaptureFormat format = job.output.format;
+		if (format == CaptureFormat::Png)
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "/frame_%06llu.png", (unsigned long long)job.frameNumber);
+			std::string path = directory + name;
+			return PngWriter::write(path, image) ? (size_t)std::filesystem::file_size(path) : 0;
+		}
+
+		// a stream file holds one frame size, a resized window starts the next part
+		if (!streamFile.is_open() || job.output.session != streamSession || image.width != streamWidth || image.height != streamHeight)
+		{
+			streamFile.close();
+			streamSession = job.output.session;
+			streamWidth = image.width;
+			streamHeight = image.height;
+			std::string path = directory + "/capture_" + std::to_string(streamPart++) + "_" + std::to_string(image.width) + "x" + std::to_string(image.height)
+				+ (format == CaptureFormat::Raw ? ".rgba" : ".y4m");
+			streamFile.open(path, std::ios::binary);
+			if (!streamFile)
+			{
+				std::cout << "ERROR::CAPTURE::WRITE_FAILED " << path << std::endl;
+				return 0;
+			}
+			if (format == CaptureFormat::Y4m)
+				streamFile << "YUV4MPEG2 W" << image.width << " H" << image.height << " F" << job.output.fps << ":1 Ip A1:1 C420jpeg\n";
+		}
+		if (format == CaptureFormat::Raw)
+		{
+			streamFile.write((const char*)image.data(), image.bytes());
+			return image.bytes();
+		}
+
+		std::vector<uint8_t> yuv;
+		rgbaToI420(image, yuv);
+		streamFile << "FRAME\n";
+		streamFile.write((const char*)yuv.data(), yuv.size());
+		return yuv.size() + 6;
+	}
+
+	// full range BT.601 (JFIF), chroma averaged over 2x2 pixels
+	static void rgbaToI420(const ImageRGBA8& image, std::vector<uint8_t>& out)
+	{
+		int width = image.width, height = image.height;
+		int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+		out.resize((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+		uint8_t* yPlane = out.data();
+		uint8_t* uPlane = yPlane + (size_t)width * height;
+		uint8_t* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+		auto clampByte = [](float v) { return (uint8_t)std::min(std::max(v + 0.5f, 0.0f), 255.0f); };
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+			{
+				const uint8_t* p = image.data() + ((size_t)y * width + x) * 4;
+				yPlane[(size_t)y * width + x] = clampByte(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);
+			}
+		for (int cy = 0; cy < chromaHeight; cy++)
+			for (int cx = 0; cx < chromaWidth; cx++)
+			{
+				float r = 0.0f, g = 0.0f, b = 0.0f;
+				int samples = 0;
+				for (int dy = 0; dy < 2; dy++)
+					for (int dx = 0; dx < 2; dx++)
+					{
+						int x = std::min(cx * 2 + dx, width - 1), y = std::min(cy * 2 + dy, height - 1);
+						const uint8_t* p = image.data() + ((size_t)y * width + x) * 4;
+						r += p[0];
+						g += p[1];
+						b += p[2];
+						samples++;
+					}
+				r /= samples;
+				g /= samples;
+				b /= samples;
+				uPlane[(size_t)cy * chromaWidth + cx] = clampByte(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+				vPlane[(size_t)cy * chromaWidth + cx] = clampByte(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+			}
+	}
+};
+
+#endif
@@ -0,0 +1,559 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Declarative frame graph. Passes are added every frame and declare which textures
+// they create, read and write. compile() throws away passes nobody consumes, works out
+// when each transient texture is first and last used and hands out physical textures
+// from a pool so transients whose lifetimes don't overlap share the same memory.
+// Imported resources (like the default framebuffer) are never aliased or culled.
+
+struct FrameGraphTextureDesc
+{
+	int width = 0;
+	int height = 0;
+	GLenum internalFormat = GL_RGBA8;
+
+	bool operator==(const FrameGraphTextureDesc& other) const
+	{
+		return width == other.width && height == other.height && internalFormat == other.internalFormat;
+	}
+	bool operator!=(const FrameGraphTextureDesc& other) const { return !(*this == other); }
+};
+
+typedef int FrameGraphResource;
+const FrameGraphResource FRAME_GRAPH_INVALID = -1;
+
+// how a pass touches a resource, image access means load/store from a shader which
+// needs a memory barrier before anyone else may read it
+enum class FrameGraphAccess
+{
+	Attachment,
+	Sampled,
+	Image
+};
+
+inline size_t frameGraphBytesPerPixel(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8: return 1;
+	case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+	case GL_RGBA16F: case GL_RG32F: return 8;
+	case GL_RGBA32F: return 16;
+	case GL_RGB16F: return 6;
+	case GL_RGB32F: return 12;
+	default: return 4; // RGBA8, SRGB8_ALPHA8, R11F_G11F_B10F, RG16F, R32F, depth 24/32
+	}
+}
+
+inline bool frameGraphIsDepthFormat(GLenum internalFormat)
+{
+	return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24 || internalFormat == GL_DEPTH_COMPONENT32F
+		|| internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8;
+}
+
+// client format/type pair that goes with an internal format, needed for glTexImage2D
+inline void frameGraphUploadFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+{
+	switch (internalFormat)
+	{
+	case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return;
+	case GL_DEPTH32F_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; return;
+	case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; return;
+	case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; return;
+	case GL_R16F: case GL_R32F: format = GL_RED; type = GL_FLOAT; return;
+	case GL_RG8: format = GL_RG; type = GL_UNSIGNED_BYTE; return;
+	case GL_RG16F: case GL_RG32F: format = GL_RG; type = GL_FLOAT; return;
+	case GL_R11F_G11F_B10F: case GL_RGB16F: case GL_RGB32F: format = GL_RGB; type = GL_FLOAT; return;
+	case GL_RGBA16F: case GL_RGBA32F: format = GL_RGBA; type = GL_FLOAT; return;
+	default: format = GL_RGBA; type = GL_UNSIGNED_BYTE; return;
+	}
+}
+
+class FrameGraph;
+
+// handed to the execute callback of a pass
+class FrameGraphContext
+{
+public:
+	// GL texture behind a resource, 0 for the imported default framebuffer
+	GLuint texture(FrameGraphResource resource) const;
+	const FrameGraphTextureDesc& desc(FrameGraphResource resource) const;
+	// binds a framebuffer with all attachment writes of the pass and sets the viewport
+	void bindRenderTarget() const;
+
+private:
+	friend class FrameGraph;
+	FrameGraph* graph = nullptr;
+	size_t pass = 0;
+};
+
+class FrameGraph
+{
+public:
+	struct Stats
+	{
+		size_t passes = 0;
+		size_t culledPasses = 0;
+		size_t transientTextures = 0;
+		size_t physicalTextures = 0;
+		size_t requestedBytes = 0; // what the transients would cost without aliasing
+		size_t allocatedBytes = 0; // what the physical textures used this frame cost
+		size_t savedBytes() const { return requestedBytes > allocatedBytes ? requestedBytes - allocatedBytes : 0; }
+	};
+
+	class PassBuilder
+	{
+	public:
+		FrameGraphResource create(const std::string& name, const FrameGraphTextureDesc& desc)
+		{
+			FrameGraphResource resource = graph->addResource(name, desc, 0, false);
+			graph->resources[resource].producers.push_back(pass);
+			graph->passes[pass].creates.push_back(resource);
+			return resource;
+		}
+		FrameGraphResource read(FrameGraphResource resource, FrameGraphAccess access = FrameGraphAccess::Sampled)
+		{
+			graph->passes[pass].reads.push_back({ resource, access });
+			graph->resources[resource].readers.push_back(pass);
+			return resource;
+		}
+		FrameGraphResource write(FrameGraphResource resource, FrameGraphAccess access = FrameGraphAccess::Attachment)
+		{
+			graph->passes[pass].writes.push_back({ resource, access });
+			Resource& res = graph->resources[resource];
+			if (std::find(res.producers.begin(), res.producers.end(), pass) == res.producers.end())
+				res.producers.push_back(pass);
+			return resource;
+		}
+		// the pass does something visible outside the graph and must never be culled
+		void sideEffect() { graph->passes[pass].sideEffect = true; }
+
+	private:
+		friend class FrameGraph;
+		FrameGraph* graph;
+		size_t pass;
+	};
+
+	FrameGraph() {}
+	~FrameGraph() { release(); }
+	FrameGraph(const FrameGraph&) = delete;
+	FrameGraph& operator=(const FrameGraph&) = delete;
+
+	// clears the passes of the last frame, pooled textures and framebuffers survive
+	void reset()
+	{
+		passes.clear();
+		resources.clear();
+		compiled = false;
+	}
+
+	// texture == 0 imports the default framebuffer
+	FrameGraphResource importTexture(const std::string& name, GLuint texture, const FrameGraphTextureDesc& desc)
+	{
+		return addResource(name, desc, texture, true);
+	}
+
+	void addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, std::function<void(const FrameGraphContext&)> execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+		passes.push_back(pass);
+
+		PassBuilder builder;
+		builder.graph = this;
+		builder.pass = passes.size() - 1;
+		setup(builder);
+	}
+
+	// culls unused passes, computes lifetimes and assigns pooled textures
+	void compile()
+	{
+		frameIndex++;
+		stats = Stats();
+		stats.passes = passes.size();
+
+		// reference counting from the outputs back: a pass survives if it writes something
+		// imported, has side effects or produces something a surviving pass reads
+		std::vector<size_t> passRefs(passes.size());
+		std::vector<size_t> resourceRefs(resources.size());
+		for (size_t p = 0; p < passes.size(); p++)
+			passRefs[p] = passes[p].sideEffect ? 1 : 0;
+		for (size_t r = 0; r < resources.size(); r++)
+		{
+			resourceRefs[r] = resources[r].readers.size();
+			if (resources[r].imported)
+				for (size_t p : resources[r].producers)
+					passRefs[p]++;
+		}
+		for (size_t p = 0; p < passes.size(); p++)
+			for (const Access& write : passes[p].writes)
+				if (!resources[write.resource].imported && resourceRefs[write.resource] > 0)
+					passRefs[p]++;
+
+		std::vector<size_t> unreferenced;
+		for (size_t p = 0; p < passes.size(); p++)
+			if (passRefs[p] == 0)
+				unreferenced.push_back(p);
+		while (!unreferenced.empty())
+		{
+			size_t p = unreferenced.back();
+			unreferenced.pop_back();
+			if (passes[p].culled)
+				continue;
+			passes[p].culled = true;
+			stats.culledPasses++;
+			for (const Access& read : passes[p].reads)
+			{
+				if (resourceRefs[read.resource] == 0 || --resourceRefs[read.resource] != 0 || resources[read.resource].imported)
+					continue;
+				// nobody reads this resource anymore, so its producers lose a reference
+				for (size_t producer : resources[read.resource].producers)
+					if (passRefs[producer] > 0 && --passRefs[producer] == 0)
+						unreferenced.push_back(producer);
+			}
+		}
+
+		// lifetimes in pass order
+		for (Resource& res : resources)
+		{
+			res.firstUse = SIZE_MAX;
+			res.lastUse = 0;
+		}
+		for (size_t p = 0; p < passes.size(); p++)
+		{
+			if (passes[p].culled)
+				continue;
+			auto touch = [&](FrameGraphResource r)
+			{
+				resources[r].firstUse = std::min(resources[r].firstUse, p);
+				resources[r].lastUse = std::max(resources[r].lastUse, p);
+			};
+			for (const Access& a : passes[p].reads) touch(a.resource);
+			for (const Access& a : passes[p].writes) touch(a.resource);
+			for (FrameGraphResource r : passes[p].creates) touch(r);
+		}
+
+		// walk the passes and hand out physical textures, a texture goes back into the
+		// free list right after the last pass that uses it
+		for (PooledTexture& pooled : pool)
+			pooled.inUse = false;
+		for (size_t p = 0; p < passes.size(); p++)
+		{
+			if (passes[p].culled)
+				continue;
+			for (FrameGraphResource r : passes[p].creates)
+			{
+				Resource& res = resources[r];
+				if (res.firstUse != p)
+					continue;
+				stats.transientTextures++;
+				stats.requestedBytes += textureBytes(res.desc);
+				res.physical = acquire(res.desc);
+				res.texture = pool[res.physical].texture;
+			}
+			for (size_t r = 0; r < resources.size(); r++)
+				if (!resources[r].imported && resources[r].physical >= 0 && resources[r].lastUse == p)
+					pool[resources[r].physical].inUse = false;
+		}
+
+		// textures nobody asked for in a while are given back to the driver
+		for (size_t i = 0; i < pool.size(); )
+		{
+			if (pool[i].lastFrame + 60 < frameIndex)
+			{
+				releaseFramebuffers(pool[i].texture);
+				glDeleteTextures(1, &pool[i].texture);
+				pool.erase(pool.begin() + i);
+				for (Resource& res : resources)
+					if (res.physical > (int)i)
+						res.physical--;
+			}
+			else
+				i++;
+		}
+		for (const PooledTexture& pooled : pool)
+		{
+			if (pooled.lastFrame == frameIndex)
+			{
+				stats.physicalTextures++;
+				stats.allocatedBytes += textureBytes(pooled.desc);
+			}
+		}
+		compiled = true;
+	}
+
+	void execute()
+	{
+		if (!compiled)
+			compile();
+		for (size_t p = 0; p < passes.size(); p++)
+		{
+			if (passes[p].culled)
+				continue;
+			// shader image stores are not coherent with later texture fetches
+			bool needsBarrier = false;
+			for (const Access& read : passes[p].reads)
+				needsBarrier = needsBarrier || resources[read.resource].lastImageWrite;
+			// image writes only happen through compute, without it there's nothing to wait for
+			if (needsBarrier && ComputeApi::instance().supported)
+			{
+				ComputeApi::instance().memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+				for (const Access& read : passes[p].reads)
+					resources[read.resource].lastImageWrite = false;
+			}
+
+			FrameGraphContext context;
+			context.graph = this;
+			context.pass = p;
+			if (passes[p].execute)
+				passes[p].execute(context);
+
+			for (const Access& write : passes[p].writes)
+				resources[write.resource].lastImageWrite = write.access == FrameGraphAccess::Image;
+		}
+	}
+
+	const Stats& frameStats() const { return stats; }
+
+	// deletes all pooled textures and framebuffers, call before the context goes away
+	void release()
+	{
+		for (auto& entry : framebuffers)
+			glDeleteFramebuffers(1, &entry.second);
+		framebuffers.clear();
+		for (PooledTexture& pooled : pool)
+			glDeleteTextures(1, &pooled.texture);
+		pool.clear();
+	}
+
+	void printStats() const
+	{
+		std::cout << "FrameGraph: " << stats.passes << " passes (" << stats.culledPasses << " culled), "
+			<< stats.transientTextures << " transient textures in " << stats.physicalTextures << " physical, "
+			<< stats.requestedBytes / 1024 << " KB requested, " << stats.allocatedBytes / 1024 << " KB allocated, "
+			<< stats.savedBytes() / 1024 << " KB saved by aliasing" << std::endl;
+	}
+
+	// graphviz dump of the last compiled frame: boxes are passes, ellipses resources
+	std::string dumpDot() const
+	{
+		std::ostringstream dot;
+		dot << "digraph FrameGraph {\n\trankdir=LR;\n\tnode [fontname=\"Helvetica\"];\n";
+		for (size_t p = 0; p < passes.size(); p++)
+		{
+			dot << "\tpass" << p << " [shape=box, style=filled, fillcolor=" << (passes[p].culled ? "gray" : "orange")
+				<< ", label=\"" << passes[p].name << (passes[p].culled ? "\\n(culled)" : "") << "\"];\n";
+		}
+		for (size_t r = 0; r < resources.size(); r++)
+		{
+			const Resource& res = resources[r];
+			dot << "\tres" << r << " [shape=ellipse, style=filled, fillcolor=" << (res.imported ? "lightblue" : "lightgreen")
+				<< ", label=\"" << res.name << "\\n" << res.desc.width << "x" << res.desc.height;
+			if (res.imported)
+				dot << "\\nimported";
+			else if (res.physical >= 0)
+				dot << "\\ntexture #" << res.physical;
+			dot << "\"];\n";
+		}
+		for (size_t p = 0; p < passes.size(); p++)
+		{
+			for (const Access& read : passes[p].reads)
+				dot << "\tres" << read.resource << " -> pass" << p << ";\n";
+			for (const Access& write : passes[p].writes)
+				dot << "\tpass" << p << " -> res" << write.resource << " [color=red];\n";
+		}
+		dot << "}\n";
+		return dot.str();
+	}
+
+private:
+	friend class FrameGraphContext;
+
+	struct Access
+	{
+		FrameGraphResource resource;
+		FrameGraphAccess access;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void(const FrameGraphContext&)> execute;
+		std::vector<FrameGraphResource> creates;
+		std::vector<Access> reads;
+		std::vector<Access> writes;
+		bool sideEffect = false;
+		bool culled = false;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		FrameGraphTextureDesc desc;
+		GLuint texture = 0;
+		bool imported = false;
+		int physical = -1;
+		size_t firstUse = 0;
+		size_t lastUse = 0;
+		bool lastImageWrite = false;
+		std::vector<size_t> producers;
+		std::vector<size_t> readers;
+	};
+
+	struct PooledTexture
+	{
+		FrameGraphTextureDesc desc;
+		GLuint texture = 0;
+		bool inUse = false;
+		size_t lastFrame = 0;
+	};
+
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	std::vector<PooledTexture> pool;
+	std::map<std::vector<GLuint>, GLuint> framebuffers;
+	size_t frameIndex = 0;
+	bool compiled = false;
+	Stats stats;
+
+	FrameGraphResource addResource(const std::string& name, const FrameGraphTextureDesc& desc, GLuint texture, bool imported)
+	{
+		Resource res;
+		res.name = name;
+		res.desc = desc;
+		res.texture = texture;
+		res.imported = imported;
+		resources.push_back(res);
+		return (FrameGraphResource)resources.size() - 1;
+	}
+
+	static size_t textureBytes(const FrameGraphTextureDesc& desc)
+	{
+		return (size_t)desc.width * desc.height * frameGraphBytesPerPixel(desc.internalFormat);
+	}
+
+	int acquire(const FrameGraphTextureDesc& desc)
+	{
+		for (size_t i = 0; i < pool.size(); i++)
+		{
+			if (!pool[i].inUse && pool[i].desc == desc)
+			{
+				pool[i].inUse = true;
+				pool[i].lastFrame = frameIndex;
+				return (int)i;
+			}
+		}
+
+		PooledTexture pooled;
+		pooled.desc = desc;
+		pooled.inUse = true;
+		pooled.lastFrame = frameIndex;
+		glGenTextures(1, &pooled.texture);
+		glBindTexture(GL_TEXTURE_2D, pooled.texture);
+		GLenum format, type;
+		frameGraphUploadFormat(desc.internalFormat, format, type);
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		pool.push_back(pooled);
+		return (int)pool.size() - 1;
+	}
+
+	GLuint framebufferFor(const std::vector<GLuint>& colors, GLuint depth)
+	{
+		std::vector<GLuint> key = colors;
+		key.push_back(depth);
+		auto it = framebuffers.find(key);
+		if (it != framebuffers.end())
+			return it->second;
+
+		GLuint fbo;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		std::vector<GLenum> drawBuffers;
+		for (size_t i = 0; i < colors.size(); i++)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, colors[i], 0);
+			drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+		}
+		if (depth != 0)
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+		if (drawBuffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::FRAMEGRAPH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		framebuffers[key] = fbo;
+		return fbo;
+	}
+
+	void releaseFramebuffers(GLuint texture)
+	{
+		for (auto it = framebuffers.begin(); it != framebuffers.end(); )
+		{
+			if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end())
+			{
+				glDeleteFramebuffers(1, &it->second);
+				it = framebuffers.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+};
+
+inline GLuint FrameGraphContext::texture(FrameGraphResource resource) const
+{
+	return graph->resources[resource].texture;
+}
+
+inline const FrameGraphTextureDesc& FrameGraphContext::desc(FrameGraphResource resource) const
+{
+	return graph->resources[resource].desc;
+}
+
+inline void FrameGraphContext::bindRenderTarget() const
+{
+	std::vector<GLuint> colors;
+	GLuint depth = 0;
+	bool defaultFramebuffer = false;
+	int width = 0, height = 0;
+	for (const FrameGraph::Access& write : graph->passes[pass].writes)
+	{
+		if (write.access != FrameGraphAccess::Attachment)
+			continue;
+		const FrameGraph::Resource& res = graph->resources[write.resource];
+		width = res.desc.width;
+		height = res.desc.height;
+		if (res.imported && res.texture == 0)
+			defaultFramebuffer = true;
+		else if (frameGraphIsDepthFormat(res.desc.internalFormat))
+			depth = res.texture;
+		else
+			colors.push_back(res.texture);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer ? 0 : graph->framebufferFor(colors, depth));
+	glViewport(0, 0, width, height);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+// extension queries for features beyond the 3.3 core the context is created with.
+// The list is read once per process, the context must be current on first use.
+inline bool glHasExtension(const char* name)
+{
+	static std::unordered_set<std::string> extensions;
+	static bool loaded = false;
+	if (!loaded)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const GLubyte* extension = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension)
+				extensions.insert((const char*)extension);
+		}
+		loaded = true;
+	}
+	return extensions.count(name) != 0;
+}
+
+// major * 10 + minor of the context, e.g. 33 or 46
+inline int glContextVersion()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	return major * 10 + minor;
+}
+
+#endif
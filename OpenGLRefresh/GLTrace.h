@@ -0,0 +1,1424 @@
+#ifndef GL_TRACE_H
+#define GL_TRACE_H
+
+#include <glad/glad.h>
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Every GL function the viewer calls. The position is the number a call has in a trace
+// file, so new functions go at the end (and GLTraceFile::VERSION goes up when a layout
+// changes). Calls through the extension structs (ProgramBinaryApi, BindlessTextureApi,
+// SpirvApi, ComputeApi) don't go through glad and are not traced, the viewer turns them
+// off while it records.
+#define GL_TRACE_CALLS(X) \
+	X(ActiveTexture) X(AttachShader) X(BindBuffer) X(BindBufferBase) X(BindFramebuffer) X(BindTexture) \
+	X(BindVertexArray) X(BufferData) X(BufferSubData) X(CheckFramebufferStatus) X(Clear) X(ClearColor) \
+	X(ClientWaitSync) X(CompileShader) X(CompressedTexImage2D) X(CompressedTexImage3D) X(CompressedTexSubImage3D) \
+	X(CopyBufferSubData) X(CreateProgram) X(CreateShader) X(DeleteBuffers) X(DeleteFramebuffers) X(DeleteProgram) \
+	X(DeleteShader) X(DeleteSync) X(DeleteTextures) X(DeleteVertexArrays) X(DrawArrays) X(DrawArraysInstanced) \
+	X(DrawBuffer) X(DrawBuffers) X(DrawElementsBaseVertex) X(DrawElementsInstancedBaseVertex) X(Enable) \
+	X(EnableVertexAttribArray) X(FenceSync) X(Finish) X(FramebufferTexture2D) X(GenBuffers) X(GenFramebuffers) \
+	X(GenTextures) X(GenVertexArrays) X(GetIntegerv) X(GetProgramInfoLog) X(GetProgramiv) X(GetShaderInfoLog) \
+	X(GetShaderiv) X(GetString) X(GetStringi) X(GetUniformBlockIndex) X(GetUniformLocation) X(LinkProgram) \
+	X(MapBufferRange) X(PixelStorei) X(ReadBuffer) X(ReadPixels) X(ShaderSource) \
+	X(TexImage2D) X(TexImage3D) X(TexParameteri) X(TexSubImage3D) X(Uniform1f) X(Uniform1fv) X(Uniform1i) \
+	X(Uniform1iv) X(Uniform2f) X(Uniform2fv) X(Uniform3f) X(Uniform3fv) X(Uniform4f) X(Uniform4fv) \
+	X(UniformBlockBinding) X(UniformMatrix2fv) X(UniformMatrix3fv) X(UniformMatrix4fv) X(UnmapBuffer) \
+	X(UseProgram) X(VertexAttribPointer) X(Viewport) X(BeginQuery) X(DeleteQueries) X(Disable) X(EndQuery) \
+	X(GenQueries) X(GetQueryObjectiv) X(GetQueryObjectui64v) X(BlendFunc) X(DepthMask) X(VertexAttribDivisor)
+
+enum class GLTraceCall : uint16_t
+{
+	FrameEnd, // not a GL call: the viewer swapped buffers
+#define GL_TRACE_ENUM(name) name,
+	GL_TRACE_CALLS(GL_TRACE_ENUM)
+#undef GL_TRACE_ENUM
+	Count
+};
+
+inline const char* glTraceCallName(GLTraceCall call)
+{
+	static const char* names[] = {
+		"SwapBuffers",
+#define GL_TRACE_NAME(name) "gl" #name,
+		GL_TRACE_CALLS(GL_TRACE_NAME)
+#undef GL_TRACE_NAME
+	};
+	return call < GLTraceCall::Count ? names[(size_t)call] : "unknown";
+}
+
+// bytes of one pixel as glTexImage and glReadPixels see it in client memory
+inline size_t glPixelBytes(GLenum format, GLenum type)
+{
+	switch (type)
+	{
+	case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_5_5_5_1:
+		return 2;
+	case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+	case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+		return 4;
+	case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+		return 8;
+	}
+	size_t components = 4;
+	switch (format)
+	{
+	case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: components = 1; break;
+	case GL_RG: case GL_RG_INTEGER: components = 2; break;
+	case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+	}
+	switch (type)
+	{
+	case GL_BYTE: case GL_UNSIGNED_BYTE: return components;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return components * 2;
+	default: return components * 4;
+	}
+}
+
+// bytes glTexImage reads for a width x height x depth image, rows start 'alignment'
+// aligned (GL_UNPACK_ALIGNMENT) but the last one is not padded
+inline size_t glImageBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, GLint alignment)
+{
+	if (width <= 0 || height <= 0 || depth <= 0)
+		return 0;
+	size_t pixelRow = (size_t)width * glPixelBytes(format, type);
+	size_t row = (pixelRow + alignment - 1) / alignment * alignment;
+	return row * ((size_t)height * depth - 1) + pixelRow;
+}
+
+// Records the GL call stream into a compact binary trace by swapping the glad function
+// pointers for wrappers that write the call and its arguments and then call the driver.
+// Uploads (buffers, textures, uniform arrays, shader sources) go into the trace with
+// their data, readbacks only with their arguments. Opt-in with --trace, nothing is
+// hooked otherwise. Single threaded like the rest of the GL code.
+//
+// File: "GLTR", version, pointer size, width, height, then one record per call:
+// uint16 call, varint payload size, the arguments in order. Data arrays are a uint32
+// size (0xffffffff for nullptr) and the bytes. SwapBuffers records carry the CPU time
+// of the frame in nanoseconds.
+class GLTraceWriter
+{
+public:
+	static GLTraceWriter& instance()
+	{
+		static GLTraceWriter writer;
+		return writer;
+	}
+
+	// call right after gladLoadGLLoader: replaying needs every object the frames use,
+	// so the trace has to start with the context. 'frames' == 0 records until stop().
+	bool start(const std::string& path, int width, int height, int frames = 0)
+	{
+		if (file)
+			return false;
+		file = std::fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			std::cout << "ERROR::GLTRACE::OPEN_FAILED " << path << std::endl;
+			return false;
+		}
+		tracePath = path;
+		frameLimit = frames;
+		frameCount = 0;
+		callCount = 0;
+		bytesWritten = 0;
+		buffer.clear();
+		buffer.insert(buffer.end(), { 'G', 'L', 'T', 'R' });
+		append<uint32_t>(VERSION);
+		append<uint32_t>((uint32_t)sizeof(void*));
+		append<int32_t>(width);
+		append<int32_t>(height);
+		install();
+		lastFrame = std::chrono::high_resolution_clock::now();
+		std::cout << "Tracing GL calls to " << path << (frames > 0 ? " for " + std::to_string(frames) + " frames" : "") << std::endl;
+		return true;
+	}
+
+	bool recording() const { return file != nullptr; }
+
+	// after every SwapBuffers, stops on its own after the requested frames
+	void frameEnd()
+	{
+		if (!file)
+			return;
+		auto now = std::chrono::high_resolution_clock::now();
+		begin(GLTraceCall::FrameEnd);
+		put<uint64_t>((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastFrame).count());
+		end();
+		lastFrame = now;
+		frameCount++;
+		if (buffer.size() >= FLUSH_SIZE)
+			flush();
+		if (frameLimit > 0 && frameCount >= frameLimit)
+			stop();
+	}
+
+	// puts the driver's functions back and closes the file
+	void stop()
+	{
+		if (!file)
+			return;
+		for (size_t i = 0; i < (size_t)GLTraceCall::Count; i++)
+			if (slots[i])
+				*slots[i] = originals[i];
+		flush();
+		std::fclose(file);
+		file = nullptr;
+		std::cout << "GL trace: " << frameCount << " frames, " << callCount << " calls, " << bytesWritten / (1024.0 * 1024.0)
+			<< " MB in " << tracePath << std::endl;
+	}
+
+	static constexpr uint32_t VERSION = 2;
+
+private:
+	static const size_t FLUSH_SIZE = 4 << 20;
+
+	FILE* file = nullptr;
+	std::string tracePath;
+	std::vector<uint8_t> buffer;
+	size_t recordStart = 0;
+	int frameLimit = 0;
+	int frameCount = 0;
+	size_t callCount = 0;
+	size_t bytesWritten = 0;
+	std::chrono::high_resolution_clock::time_point lastFrame;
+	void* originals[(size_t)GLTraceCall::Count] = {};
+	void** slots[(size_t)GLTraceCall::Count] = {};
+
+	// what the wrappers need to know to size their data
+	GLint unpackAlignment = 4;
+	GLuint packBuffer = 0;
+	GLuint unpackBuffer = 0;
+	struct Mapping
+	{
+		void* pointer = nullptr;
+		size_t length = 0;
+	};
+	std::unordered_map<GLenum, Mapping> writeMappings;
+
+	GLTraceWriter() {}
+
+	template <typename T>
+	void append(const T& value)
+	{
+		const uint8_t* bytes = (const uint8_t*)&value;
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	void flush()
+	{
+		if (buffer.empty())
+			return;
+		std::fwrite(buffer.data(), 1, buffer.size(), file);
+		bytesWritten += buffer.size();
+		buffer.clear();
+	}
+
+	// a record is built in place, the payload size goes in front once it is known
+	void begin(GLTraceCall call)
+	{
+		append<uint16_t>((uint16_t)call);
+		recordStart = buffer.size();
+		callCount += call != GLTraceCall::FrameEnd;
+	}
+
+	void end()
+	{
+		size_t size = buffer.size() - recordStart;
+		uint8_t varint[10];
+		size_t length = 0;
+		do
+		{
+			varint[length++] = (uint8_t)((size & 0x7f) | (size > 0x7f ? 0x80 : 0));
+			size >>= 7;
+		} while (size > 0);
+		buffer.insert(buffer.begin() + recordStart, varint, varint + length);
+	}
+
+	template <typename T>
+	void put(T value)
+	{
+		if constexpr (std::is_pointer<T>::value)
+			append<uint64_t>((uint64_t)(uintptr_t)value);
+		else
+			append<T>(value);
+	}
+
+	void blob(const void* data, size_t size)
+	{
+		if (!data)
+		{
+			append<uint32_t>(0xffffffffu);
+			return;
+		}
+		append<uint32_t>((uint32_t)size);
+		buffer.insert(buffer.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+	}
+
+	// texture data: an offset into the bound GL_PIXEL_UNPACK_BUFFER or client memory
+	void pixels(const void* data, size_t size)
+	{
+		put<uint8_t>(unpackBuffer != 0);
+		if (unpackBuffer != 0)
+			put(data);
+		else
+			blob(data, size);
+	}
+
+	void* original(GLTraceCall call) const { return originals[(size_t)call]; }
+
+	void hook(GLTraceCall call, void** slot, void* function)
+	{
+		slots[(size_t)call] = slot;
+		originals[(size_t)call] = *slot;
+		*slot = function;
+	}
+
+	// calls whose arguments are all values (or offsets) are recorded as they are
+	template <GLTraceCall Call, typename R, typename... A>
+	static R APIENTRY traced(A... args)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(Call);
+		(trace.put(args), ...);
+		trace.end();
+		return ((R (APIENTRYP)(A...))trace.original(Call))(args...);
+	}
+
+	template <GLTraceCall Call, typename R, typename... A>
+	void hook(R (APIENTRYP& slot)(A...))
+	{
+		hook(Call, (void**)&slot, (void*)&traced<Call, R, A...>);
+	}
+
+#define GL_TRACE_ORIGINAL(name) ((decltype(glad_gl##name))instance().original(GLTraceCall::name))
+
+	static void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+	{
+		GLTraceWriter& trace = instance();
+		if (target == GL_PIXEL_PACK_BUFFER)
+			trace.packBuffer = buffer;
+		if (target == GL_PIXEL_UNPACK_BUFFER)
+			trace.unpackBuffer = buffer;
+		traced<GLTraceCall::BindBuffer, void, GLenum, GLuint>(target, buffer);
+	}
+
+	static void APIENTRY pixelStorei(GLenum pname, GLint param)
+	{
+		if (pname == GL_UNPACK_ALIGNMENT)
+			instance().unpackAlignment = param;
+		traced<GLTraceCall::PixelStorei, void, GLenum, GLint>(pname, param);
+	}
+
+	static void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::BufferData);
+		trace.put(target);
+		trace.put(size);
+		trace.blob(data, (size_t)size);
+		trace.put(usage);
+		trace.end();
+		GL_TRACE_ORIGINAL(BufferData)(target, size, data, usage);
+	}
+
+	static void APIENTRY bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::BufferSubData);
+		trace.put(target);
+		trace.put(offset);
+		trace.blob(data, (size_t)size);
+		trace.end();
+		GL_TRACE_ORIGINAL(BufferSubData)(target, offset, size, data);
+	}
+
+	// what was written into a mapping goes into the trace when it is unmapped
+	static void* APIENTRY mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::MapBufferRange);
+		trace.put(target);
+		trace.put(offset);
+		trace.put(length);
+		trace.put(access);
+		trace.end();
+		void* pointer = GL_TRACE_ORIGINAL(MapBufferRange)(target, offset, length, access);
+		if (pointer && (access & GL_MAP_WRITE_BIT))
+			trace.writeMappings[target] = { pointer, (size_t)length };
+		return pointer;
+	}
+
+	static GLboolean APIENTRY unmapBuffer(GLenum target)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::UnmapBuffer);
+		trace.put(target);
+		auto it = trace.writeMappings.find(target);
+		if (it != trace.writeMappings.end())
+		{
+			trace.blob(it->second.pointer, it->second.length);
+			trace.writeMappings.erase(it);
+		}
+		else
+			trace.blob(nullptr, 0);
+		trace.end();
+		return GL_TRACE_ORIGINAL(UnmapBuffer)(target);
+	}
+
+	static void APIENTRY texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+		GLenum format, GLenum type, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::TexImage2D);
+		trace.put(target);
+		trace.put(level);
+		trace.put(internalformat);
+		trace.put(width);
+		trace.put(height);
+		trace.put(border);
+		trace.put(format);
+		trace.put(type);
+		trace.pixels(data, glImageBytes(width, height, 1, format, type, trace.unpackAlignment));
+		trace.end();
+		GL_TRACE_ORIGINAL(TexImage2D)(target, level, internalformat, width, height, border, format, type, data);
+	}
+
+	static void APIENTRY texImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth,
+		GLint border, GLenum format, GLenum type, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::TexImage3D);
+		trace.put(target);
+		trace.put(level);
+		trace.put(internalformat);
+		trace.put(width);
+		trace.put(height);
+		trace.put(depth);
+		trace.put(border);
+		trace.put(format);
+		trace.put(type);
+		trace.pixels(data, glImageBytes(width, height, depth, format, type, trace.unpackAlignment));
+		trace.end();
+		GL_TRACE_ORIGINAL(TexImage3D)(target, level, internalformat, width, height, depth, border, format, type, data);
+	}
+
+	static void APIENTRY texSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height,
+		GLsizei depth, GLenum format, GLenum type, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::TexSubImage3D);
+		trace.put(target);
+		trace.put(level);
+		trace.put(x);
+		trace.put(y);
+		trace.put(z);
+		trace.put(width);
+		trace.put(height);
+		trace.put(depth);
+		trace.put(format);
+		trace.put(type);
+		trace.pixels(data, glImageBytes(width, height, depth, format, type, trace.unpackAlignment));
+		trace.end();
+		GL_TRACE_ORIGINAL(TexSubImage3D)(target, level, x, y, z, width, height, depth, format, type, data);
+	}
+
+	static void APIENTRY compressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+		GLint border, GLsizei imageSize, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::CompressedTexImage2D);
+		trace.put(target);
+		trace.put(level);
+		trace.put(internalformat);
+		trace.put(width);
+		trace.put(height);
+		trace.put(border);
+		trace.put(imageSize);
+		trace.pixels(data, (size_t)imageSize);
+		trace.end();
+		GL_TRACE_ORIGINAL(CompressedTexImage2D)(target, level, internalformat, width, height, border, imageSize, data);
+	}
+
+	static void APIENTRY compressedTexImage3D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+		GLsizei depth, GLint border, GLsizei imageSize, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::CompressedTexImage3D);
+		trace.put(target);
+		trace.put(level);
+		trace.put(internalformat);
+		trace.put(width);
+		trace.put(height);
+		trace.put(depth);
+		trace.put(border);
+		trace.put(imageSize);
+		trace.pixels(data, (size_t)imageSize);
+		trace.end();
+		GL_TRACE_ORIGINAL(CompressedTexImage3D)(target, level, internalformat, width, height, depth, border, imageSize, data);
+	}
+
+	static void APIENTRY compressedTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+		GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::CompressedTexSubImage3D);
+		trace.put(target);
+		trace.put(level);
+		trace.put(x);
+		trace.put(y);
+		trace.put(z);
+		trace.put(width);
+		trace.put(height);
+		trace.put(depth);
+		trace.put(format);
+		trace.put(imageSize);
+		trace.pixels(data, (size_t)imageSize);
+		trace.end();
+		GL_TRACE_ORIGINAL(CompressedTexSubImage3D)(target, level, x, y, z, width, height, depth, format, imageSize, data);
+	}
+
+	// into a GL_PIXEL_PACK_BUFFER the pointer is an offset, client memory is not recorded
+	static void APIENTRY readPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* data)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::ReadPixels);
+		trace.put(x);
+		trace.put(y);
+		trace.put(width);
+		trace.put(height);
+		trace.put(format);
+		trace.put(type);
+		trace.put<uint8_t>(trace.packBuffer != 0);
+		trace.put(trace.packBuffer != 0 ? data : nullptr);
+		trace.end();
+		GL_TRACE_ORIGINAL(ReadPixels)(x, y, width, height, format, type, data);
+	}
+
+	static void APIENTRY shaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::ShaderSource);
+		trace.put(shader);
+		trace.put(count);
+		for (GLsizei i = 0; i < count; i++)
+			trace.blob(strings[i], lengths && lengths[i] >= 0 ? (size_t)lengths[i] : std::strlen(strings[i]));
+		trace.end();
+		GL_TRACE_ORIGINAL(ShaderSource)(shader, count, strings, lengths);
+	}
+
+	static void APIENTRY drawBuffers(GLsizei n, const GLenum* buffers)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(GLTraceCall::DrawBuffers);
+		trace.blob(buffers, n * sizeof(GLenum));
+		trace.end();
+		GL_TRACE_ORIGINAL(DrawBuffers)(n, buffers);
+	}
+
+	// object names are recorded after the call, the replayer maps them to its own
+	template <GLTraceCall Call>
+	static void APIENTRY generate(GLsizei n, GLuint* names)
+	{
+		GLTraceWriter& trace = instance();
+		((void (APIENTRYP)(GLsizei, GLuint*))trace.original(Call))(n, names);
+		trace.begin(Call);
+		trace.blob(names, n * sizeof(GLuint));
+		trace.end();
+	}
+
+	template <GLTraceCall Call>
+	static void APIENTRY remove(GLsizei n, const GLuint* names)
+	{
+		GLTraceWriter& trace = instance();
+		if (Call == GLTraceCall::DeleteBuffers)
+		{
+			for (GLsizei i = 0; i < n; i++)
+			{
+				if (names[i] == trace.packBuffer)
+					trace.packBuffer = 0;
+				if (names[i] == trace.unpackBuffer)
+					trace.unpackBuffer = 0;
+			}
+		}
+		trace.begin(Call);
+		trace.blob(names, n * sizeof(GLuint));
+		trace.end();
+		((void (APIENTRYP)(GLsizei, const GLuint*))trace.original(Call))(n, names);
+	}
+
+	static GLuint APIENTRY createShader(GLenum type)
+	{
+		GLTraceWriter& trace = instance();
+		GLuint shader = GL_TRACE_ORIGINAL(CreateShader)(type);
+		trace.begin(GLTraceCall::CreateShader);
+		trace.put(type);
+		trace.put(shader);
+		trace.end();
+		return shader;
+	}
+
+	static GLuint APIENTRY createProgram()
+	{
+		GLTraceWriter& trace = instance();
+		GLuint program = GL_TRACE_ORIGINAL(CreateProgram)();
+		trace.begin(GLTraceCall::CreateProgram);
+		trace.put(program);
+		trace.end();
+		return program;
+	}
+
+	// locations and block indices depend on the driver, the replayer looks them up again
+	template <GLTraceCall Call, typename R>
+	static R APIENTRY lookup(GLuint program, const GLchar* name)
+	{
+		GLTraceWriter& trace = instance();
+		R result = ((R (APIENTRYP)(GLuint, const GLchar*))trace.original(Call))(program, name);
+		trace.begin(Call);
+		trace.put(program);
+		trace.blob(name, std::strlen(name));
+		trace.put(result);
+		trace.end();
+		return result;
+	}
+
+	static GLsync APIENTRY fenceSync(GLenum condition, GLbitfield flags)
+	{
+		GLTraceWriter& trace = instance();
+		GLsync sync = GL_TRACE_ORIGINAL(FenceSync)(condition, flags);
+		trace.begin(GLTraceCall::FenceSync);
+		trace.put(condition);
+		trace.put(flags);
+		trace.put(sync);
+		trace.end();
+		return sync;
+	}
+
+	template <GLTraceCall Call, typename T, int Components>
+	static void APIENTRY uniformArray(GLint location, GLsizei count, const T* value)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(Call);
+		trace.put(location);
+		trace.blob(value, count * Components * sizeof(T));
+		trace.end();
+		((void (APIENTRYP)(GLint, GLsizei, const T*))trace.original(Call))(location, count, value);
+	}
+
+	template <GLTraceCall Call, int Size>
+	static void APIENTRY uniformMatrix(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+	{
+		GLTraceWriter& trace = instance();
+		trace.begin(Call);
+		trace.put(location);
+		trace.put(transpose);
+		trace.blob(value, count * Size * Size * sizeof(GLfloat));
+		trace.end();
+		((void (APIENTRYP)(GLint, GLsizei, GLboolean, const GLfloat*))trace.original(Call))(location, count, transpose, value);
+	}
+
+#undef GL_TRACE_ORIGINAL
+
+	void install()
+	{
+		typedef GLTraceCall C;
+		hook<C::ActiveTexture>(glad_glActiveTexture);
+		hook<C::AttachShader>(glad_glAttachShader);
+		hook(C::BindBuffer, (void**)&glad_glBindBuffer, (void*)&bindBuffer);
+		hook<C::BindBufferBase>(glad_glBindBufferBase);
+		hook<C::BindFramebuffer>(glad_glBindFramebuffer);
+		hook<C::BindTexture>(glad_glBindTexture);
+		hook<C::BindVertexArray>(glad_glBindVertexArray);
+		hook(C::BufferData, (void**)&glad_glBufferData, (void*)&bufferData);
+		hook(C::BufferSubData, (void**)&glad_glBufferSubData, (void*)&bufferSubData);
+		hook<C::CheckFramebufferStatus>(glad_glCheckFramebufferStatus);
+		hook<C::Clear>(glad_glClear);
+		hook<C::ClearColor>(glad_glClearColor);
+		hook<C::ClientWaitSync>(glad_glClientWaitSync);
+		hook<C::CompileShader>(glad_glCompileShader);
+		hook(C::CompressedTexImage2D, (void**)&glad_glCompressedTexImage2D, (void*)&compressedTexImage2D);
+		hook(C::CompressedTexImage3D, (void**)&glad_glCompressedTexImage3D, (void*)&compressedTexImage3D);
+		hook(C::CompressedTexSubImage3D, (void**)&glad_glCompressedTexSubImage3D, (void*)&compressedTexSubImage3D);
+		hook<C::CopyBufferSubData>(glad_glCopyBufferSubData);
+		hook(C::CreateProgram, (void**)&glad_glCreateProgram, (void*)&createProgram);
+		hook(C::CreateShader, (void**)&glad_glCreateShader, (void*)&createShader);
+		hook(C::DeleteBuffers, (void**)&glad_glDeleteBuffers, (void*)&remove<C::DeleteBuffers>);
+		hook(C::DeleteFramebuffers, (void**)&glad_glDeleteFramebuffers, (void*)&remove<C::DeleteFramebuffers>);
+		hook<C::DeleteProgram>(glad_glDeleteProgram);
+		hook<C::DeleteShader>(glad_glDeleteShader);
+		hook<C::DeleteSync>(glad_glDeleteSync);
+		hook(C::DeleteTextures, (void**)&glad_glDeleteTextures, (void*)&remove<C::DeleteTextures>);
+		hook(C::DeleteVertexArrays, (void**)&glad_glDeleteVertexArrays, (void*)&remove<C::DeleteVertexArrays>);
+		hook<C::DrawArrays>(glad_glDrawArrays);
+		hook<C::DrawArraysInstanced>(glad_glDrawArraysInstanced);
+		hook<C::DrawBuffer>(glad_glDrawBuffer);
+		hook(C::DrawBuffers, (void**)&glad_glDrawBuffers, (void*)&drawBuffers);
+		hook<C::DrawElementsBaseVertex>(glad_glDrawElementsBaseVertex);
+		hook<C::DrawElementsInstancedBaseVertex>(glad_glDrawElementsInstancedBaseVertex);
+		hook<C::Enable>(glad_glEnable);
+		hook<C::EnableVertexAttribArray>(glad_glEnableVertexAttribArray);
+		hook(C::FenceSync, (void**)&glad_glFenceSync, (void*)&fenceSync);
+		hook<C::Finish>(glad_glFinish);
+		hook<C::FramebufferTexture2D>(glad_glFramebufferTexture2D);
+		hook(C::GenBuffers, (void**)&glad_glGenBuffers, (void*)&generate<C::GenBuffers>);
+		hook(C::GenFramebuffers, (void**)&glad_glGenFramebuffers, (void*)&generate<C::GenFramebuffers>);
+		hook(C::GenTextures, (void**)&glad_glGenTextures, (void*)&generate<C::GenTextures>);
+		hook(C::GenVertexArrays, (void**)&glad_glGenVertexArrays, (void*)&generate<C::GenVertexArrays>);
+		hook<C::GetIntegerv>(glad_glGetIntegerv);
+		hook<C::GetProgramInfoLog>(glad_glGetProgramInfoLog);
+		hook<C::GetProgramiv>(glad_glGetProgramiv);
+		hook<C::GetShaderInfoLog>(glad_glGetShaderInfoLog);
+		hook<C::GetShaderiv>(glad_glGetShaderiv);
+		hook<C::GetString>(glad_glGetString);
+		hook<C::GetStringi>(glad_glGetStringi);
+		hook(C::GetUniformBlockIndex, (void**)&glad_glGetUniformBlockIndex, (void*)&lookup<C::GetUniformBlockIndex, GLuint>);
+		hook(C::GetUniformLocation, (void**)&glad_glGetUniformLocation, (void*)&lookup<C::GetUniformLocation, GLint>);
+		hook<C::LinkProgram>(glad_glLinkProgram);
+		hook(C::MapBufferRange, (void**)&glad_glMapBufferRange, (void*)&mapBufferRange);
+		hook(C::PixelStorei, (void**)&glad_glPixelStorei, (void*)&pixelStorei);
+		hook<C::ReadBuffer>(glad_glReadBuffer);
+		hook(C::ReadPixels, (void**)&glad_glReadPixels, (void*)&readPixels);
+		hook(C::ShaderSource, (void**)&glad_glShaderSource, (void*)&shaderSource);
+		hook(C::TexImage2D, (void**)&glad_glTexImage2D, (void*)&texImage2D);
+		hook(C::TexImage3D, (void**)&glad_glTexImage3D, (void*)&texImage3D);
+		hook<C::TexParameteri>(glad_glTexParameteri);
+		hook(C::TexSubImage3D, (void**)&glad_glTexSubImage3D, (void*)&texSubImage3D);
+		hook<C::Uniform1f>(glad_glUniform1f);
+		hook(C::Uniform1fv, (void**)&glad_glUniform1fv, (void*)&uniformArray<C::Uniform1fv, GLfloat, 1>);
+		hook<C::Uniform1i>(glad_glUniform1i);
+		hook(C::Uniform1iv, (void**)&glad_glUniform1iv, (void*)&uniformArray<C::Uniform1iv, GLint, 1>);
+		hook<C::Uniform2f>(glad_glUniform2f);
+		hook(C::Uniform2fv, (void**)&glad_glUniform2fv, (void*)&uniformArray<C::Uniform2fv, GLfloat, 2>);
+		hook<C::Uniform3f>(glad_glUniform3f);
+		hook(C::Uniform3fv, (void**)&glad_glUniform3fv, (void*)&uniformArray<C::Uniform3fv, GLfloat, 3>);
+		hook<C::Uniform4f>(glad_glUniform4f);
+		hook(C::Uniform4fv, (void**)&glad_glUniform4fv, (void*)&uniformArray<C::Uniform4fv, GLfloat, 4>);
+		hook<C::UniformBlockBinding>(glad_glUniformBlockBinding);
+		hook(C::UniformMatrix2fv, (void**)&glad_glUniformMatrix2fv, (void*)&uniformMatrix<C::UniformMatrix2fv, 2>);
+		hook(C::UniformMatrix3fv, (void**)&glad_glUniformMatrix3fv, (void*)&uniformMatrix<C::UniformMatrix3fv, 3>);
+		hook(C::UniformMatrix4fv, (void**)&glad_glUniformMatrix4fv, (void*)&uniformMatrix<C::UniformMatrix4fv, 4>);
+		hook(C::UnmapBuffer, (void**)&glad_glUnmapBuffer, (void*)&unmapBuffer);
+		hook<C::UseProgram>(glad_glUseProgram);
+		hook<C::VertexAttribPointer>(glad_glVertexAttribPointer);
+		hook<C::Viewport>(glad_glViewport);
+		hook<C::BeginQuery>(glad_glBeginQuery);
+		hook(C::DeleteQueries, (void**)&glad_glDeleteQueries, (void*)&remove<C::DeleteQueries>);
+		hook<C::Disable>(glad_glDisable);
+		hook<C::EndQuery>(glad_glEndQuery);
+		hook(C::GenQueries, (void**)&glad_glGenQueries, (void*)&generate<C::GenQueries>);
+		hook<C::GetQueryObjectiv>(glad_glGetQueryObjectiv);
+		hook<C::GetQueryObjectui64v>(glad_glGetQueryObjectui64v);
+		hook<C::BlendFunc>(glad_glBlendFunc);
+		hook<C::DepthMask>(glad_glDepthMask);
+		hook<C::VertexAttribDivisor>(glad_glVertexAttribDivisor);
+	}
+};
+
+// one call of a trace, 'data' points at its arguments
+struct GLTraceRecord
+{
+	GLTraceCall call = GLTraceCall::FrameEnd;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// reads the arguments of a record in the order the writer put them
+class GLTraceArguments
+{
+public:
+	explicit GLTraceArguments(const GLTraceRecord& record) : p(record.data), end(record.data + record.size) {}
+
+	template <typename T>
+	T get()
+	{
+		if constexpr (std::is_pointer<T>::value)
+			return (T)(uintptr_t)get<uint64_t>();
+		else
+		{
+			T value{};
+			if ((size_t)(end - p) < sizeof(T))
+			{
+				p = end;
+				return value;
+			}
+			std::memcpy(&value, p, sizeof(T));
+			p += sizeof(T);
+			return value;
+		}
+	}
+
+	// nullptr for a recorded nullptr
+	const uint8_t* blob(uint32_t& size)
+	{
+		size = get<uint32_t>();
+		if (size == 0xffffffffu || (size_t)(end - p) < size)
+		{
+			size = 0;
+			return nullptr;
+		}
+		const uint8_t* data = p;
+		p += size;
+		return data;
+	}
+
+	// see GLTraceWriter::pixels()
+	const void* pixels()
+	{
+		if (get<uint8_t>())
+			return get<const void*>();
+		uint32_t size;
+		return blob(size);
+	}
+
+private:
+	const uint8_t* p;
+	const uint8_t* end;
+};
+
+// A trace file mapped and split into frames. Everything up to the first SwapBuffers,
+// loading included, is frame 0; calls after the last SwapBuffers (the viewer closed
+// mid-frame) are dropped. No GL needed, the call counts work without a context.
+class GLTraceFile
+{
+public:
+	bool open(const std::string& path)
+	{
+		file = MappedFile(path);
+		if (!file.isOpen())
+			return false;
+		const uint8_t* data = file.data();
+		const size_t HEADER = 20;
+		uint32_t version = 0, pointerSize = 0;
+		if (file.size() >= HEADER)
+		{
+			std::memcpy(&version, data + 4, 4);
+			std::memcpy(&pointerSize, data + 8, 4);
+			std::memcpy(&traceWidth, data + 12, 4);
+			std::memcpy(&traceHeight, data + 16, 4);
+		}
+		if (file.size() < HEADER || std::memcmp(data, "GLTR", 4) != 0 || version != GLTraceWriter::VERSION)
+		{
+			std::cout << "ERROR::GLTRACE::NOT_A_TRACE " << path << " (or a different version)" << std::endl;
+			return false;
+		}
+		if (pointerSize != sizeof(void*))
+		{
+			std::cout << "ERROR::GLTRACE::POINTER_SIZE " << path << " was recorded by a " << pointerSize * 8 << " bit build" << std::endl;
+			return false;
+		}
+
+		const uint8_t* p = data + HEADER;
+		const uint8_t* end = data + file.size();
+		frameStarts.assign(1, p);
+		GLTraceRecord record;
+		while (next(p, end, record))
+		{
+			if (record.call != GLTraceCall::FrameEnd)
+				continue;
+			frameStarts.push_back(p);
+			GLTraceArguments arguments(record);
+			recordedNs.push_back(arguments.get<uint64_t>());
+		}
+		return true;
+	}
+
+	int width() const { return traceWidth; }
+	int height() const { return traceHeight; }
+	size_t frameCount() const { return recordedNs.size(); }
+	// CPU time the viewer took for the frame while it was recorded
+	double recordedMs(size_t frame) const { return recordedNs[frame] / 1e6; }
+
+	// the records of one frame, SwapBuffers last
+	std::vector<GLTraceRecord> records(size_t frame) const
+	{
+		std::vector<GLTraceRecord> list;
+		const uint8_t* p = frameStarts[frame];
+		GLTraceRecord record;
+		while (p < frameStarts[frame + 1] && next(p, frameStarts[frame + 1], record))
+			list.push_back(record);
+		return list;
+	}
+
+	// calls of each kind in frames [first, last), indexed by GLTraceCall
+	std::vector<uint64_t> callCounts(size_t first, size_t last) const
+	{
+		std::vector<uint64_t> counts((size_t)GLTraceCall::Count + 1, 0);
+		for (size_t f = first; f < last && f < frameCount(); f++)
+			for (const GLTraceRecord& record : records(f))
+				counts[std::min((size_t)record.call, (size_t)GLTraceCall::Count)]++;
+		return counts;
+	}
+
+	static bool next(const uint8_t*& p, const uint8_t* end, GLTraceRecord& record)
+	{
+		if (end - p < 3)
+			return false;
+		uint16_t call;
+		std::memcpy(&call, p, 2);
+		p += 2;
+		size_t size = 0;
+		for (int shift = 0; p < end; shift += 7)
+		{
+			uint8_t byte = *p++;
+			size |= (size_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				break;
+		}
+		if ((size_t)(end - p) < size)
+			return false;
+		record.call = (GLTraceCall)call;
+		record.data = p;
+		record.size = size;
+		p += size;
+		return true;
+	}
+
+private:
+	MappedFile file;
+	int32_t traceWidth = 0;
+	int32_t traceHeight = 0;
+	std::vector<const uint8_t*> frameStarts;
+	std::vector<uint64_t> recordedNs;
+};
+
+// Re-issues the frames of a trace on the current context. Object names, uniform
+// locations and fences are mapped to what this context hands out. Queries are
+// issued into scratch memory so their stalls stay in the timing, readbacks into
+// client memory go to scratch memory as well.
+class GLTracePlayer
+{
+public:
+	explicit GLTracePlayer(const GLTraceFile& trace) : trace(trace) {}
+
+	void play(size_t frame)
+	{
+		for (const GLTraceRecord& record : trace.records(frame))
+			execute(record);
+	}
+
+	// calls this build doesn't know, from a newer viewer
+	size_t skippedCalls() const { return skipped; }
+
+private:
+	struct NameMap
+	{
+		std::unordered_map<GLuint, GLuint> names;
+
+		GLuint operator()(GLuint recorded) const
+		{
+			auto it = names.find(recorded);
+			return it != names.end() ? it->second : recorded;
+		}
+	};
+
+	const GLTraceFile& trace;
+	NameMap buffers;
+	NameMap textures;
+	NameMap framebuffers;
+	NameMap vertexArrays;
+	NameMap queries;
+	NameMap objects; // shaders and programs share their names
+	std::unordered_map<uint64_t, GLint> locations; // recorded program << 32 | recorded location
+	std::unordered_map<uint64_t, GLuint> blockIndices;
+	std::unordered_map<uint64_t, GLsync> syncs;
+	std::unordered_map<GLenum, void*> mappings;
+	GLuint program = 0; // recorded name of the program in use
+	std::vector<uint8_t> scratch;
+	GLint scratchInts[64] = {};
+	GLuint64 scratchResult = 0;
+	size_t skipped = 0;
+
+	static uint64_t key(GLuint program, GLint value) { return (uint64_t)program << 32 | (uint32_t)value; }
+
+	GLint location(GLint recorded) const
+	{
+		auto it = locations.find(key(program, recorded));
+		return recorded < 0 || it == locations.end() ? recorded : it->second;
+	}
+
+	template <typename R, typename... A>
+	static void call(R (APIENTRYP function)(A...), GLTraceArguments& arguments)
+	{
+		std::tuple<A...> values{ arguments.get<A>()... };
+		std::apply(function, values);
+	}
+
+	static void generate(void (APIENTRYP function)(GLsizei, GLuint*), NameMap& map, GLTraceArguments& arguments)
+	{
+		uint32_t size;
+		const uint8_t* recorded = arguments.blob(size);
+		std::vector<GLuint> names(size / sizeof(GLuint));
+		function((GLsizei)names.size(), names.data());
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			GLuint name;
+			std::memcpy(&name, recorded + i * sizeof(GLuint), sizeof(GLuint));
+			map.names[name] = names[i];
+		}
+	}
+
+	static void remove(void (APIENTRYP function)(GLsizei, const GLuint*), NameMap& map, GLTraceArguments& arguments)
+	{
+		uint32_t size;
+		const uint8_t* recorded = arguments.blob(size);
+		std::vector<GLuint> names(size / sizeof(GLuint));
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			GLuint name;
+			std::memcpy(&name, recorded + i * sizeof(GLuint), sizeof(GLuint));
+			names[i] = map(name);
+			map.names.erase(name);
+		}
+		function((GLsizei)names.size(), names.data());
+	}
+
+	template <typename T>
+	void uniformArray(void (APIENTRYP function)(GLint, GLsizei, const T*), int components, GLTraceArguments& arguments)
+	{
+		GLint recorded = arguments.get<GLint>();
+		uint32_t size;
+		const uint8_t* data = arguments.blob(size);
+		function(location(recorded), (GLsizei)(size / (components * sizeof(T))), (const T*)data);
+	}
+
+	void uniformMatrix(void (APIENTRYP function)(GLint, GLsizei, GLboolean, const GLfloat*), int size, GLTraceArguments& arguments)
+	{
+		GLint recorded = arguments.get<GLint>();
+		GLboolean transpose = arguments.get<GLboolean>();
+		uint32_t bytes;
+		const uint8_t* data = arguments.blob(bytes);
+		function(location(recorded), (GLsizei)(bytes / (size * size * sizeof(GLfloat))), transpose, (const GLfloat*)data);
+	}
+
+	void execute(const GLTraceRecord& record)
+	{
+		typedef GLTraceCall C;
+		GLTraceArguments a(record);
+		switch (record.call)
+		{
+		case C::FrameEnd:
+			break;
+		case C::ActiveTexture: call(glActiveTexture, a); break;
+		case C::AttachShader:
+		{
+			GLuint target = objects(a.get<GLuint>());
+			glAttachShader(target, objects(a.get<GLuint>()));
+			break;
+		}
+		case C::BindBuffer:
+		{
+			GLenum target = a.get<GLenum>();
+			glBindBuffer(target, buffers(a.get<GLuint>()));
+			break;
+		}
+		case C::BindBufferBase:
+		{
+			GLenum target = a.get<GLenum>();
+			GLuint index = a.get<GLuint>();
+			glBindBufferBase(target, index, buffers(a.get<GLuint>()));
+			break;
+		}
+		case C::BindFramebuffer:
+		{
+			GLenum target = a.get<GLenum>();
+			glBindFramebuffer(target, framebuffers(a.get<GLuint>()));
+			break;
+		}
+		case C::BindTexture:
+		{
+			GLenum target = a.get<GLenum>();
+			glBindTexture(target, textures(a.get<GLuint>()));
+			break;
+		}
+		case C::BindVertexArray: glBindVertexArray(vertexArrays(a.get<GLuint>())); break;
+		case C::BufferData:
+		{
+			GLenum target = a.get<GLenum>();
+			GLsizeiptr size = a.get<GLsizeiptr>();
+			uint32_t bytes;
+			const uint8_t* data = a.blob(bytes);
+			glBufferData(target, size, data, a.get<GLenum>());
+			break;
+		}
+		case C::BufferSubData:
+		{
+			GLenum target = a.get<GLenum>();
+			GLintptr offset = a.get<GLintptr>();
+			uint32_t bytes;
+			const uint8_t* data = a.blob(bytes);
+			glBufferSubData(target, offset, bytes, data);
+			break;
+		}
+		case C::CheckFramebufferStatus: call(glCheckFramebufferStatus, a); break;
+		case C::Clear: call(glClear, a); break;
+		case C::ClearColor: call(glClearColor, a); break;
+		case C::ClientWaitSync:
+		{
+			auto it = syncs.find(a.get<uint64_t>());
+			GLbitfield flags = a.get<GLbitfield>();
+			GLuint64 timeout = a.get<GLuint64>();
+			if (it != syncs.end())
+				glClientWaitSync(it->second, flags, timeout);
+			break;
+		}
+		case C::CompileShader: glCompileShader(objects(a.get<GLuint>())); break;
+		case C::CompressedTexImage2D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLint level = a.get<GLint>();
+			GLenum format = a.get<GLenum>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLint border = a.get<GLint>();
+			GLsizei size = a.get<GLsizei>();
+			glCompressedTexImage2D(target, level, format, width, height, border, size, a.pixels());
+			break;
+		}
+		case C::CompressedTexImage3D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLint level = a.get<GLint>();
+			GLenum format = a.get<GLenum>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLsizei depth = a.get<GLsizei>();
+			GLint border = a.get<GLint>();
+			GLsizei size = a.get<GLsizei>();
+			glCompressedTexImage3D(target, level, format, width, height, depth, border, size, a.pixels());
+			break;
+		}
+		case C::CompressedTexSubImage3D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLint level = a.get<GLint>();
+			GLint x = a.get<GLint>();
+			GLint y = a.get<GLint>();
+			GLint z = a.get<GLint>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLsizei depth = a.get<GLsizei>();
+			GLenum format = a.get<GLenum>();
+			GLsizei size = a.get<GLsizei>();
+			glCompressedTexSubImage3D(target, level, x, y, z, width, height, depth, format, size, a.pixels());
+			break;
+		}
+		case C::CopyBufferSubData: call(glCopyBufferSubData, a); break;
+		case C::CreateProgram: objects.names[a.get<GLuint>()] = glCreateProgram(); break;
+		case C::CreateShader:
+		{
+			GLenum type = a.get<GLenum>();
+			objects.names[a.get<GLuint>()] = glCreateShader(type);
+			break;
+		}
+		case C::DeleteBuffers: remove(glDeleteBuffers, buffers, a); break;
+		case C::DeleteFramebuffers: remove(glDeleteFramebuffers, framebuffers, a); break;
+		case C::DeleteProgram:
+		{
+			GLuint recorded = a.get<GLuint>();
+			glDeleteProgram(objects(recorded));
+			objects.names.erase(recorded);
+			break;
+		}
+		case C::DeleteShader:
+		{
+			GLuint recorded = a.get<GLuint>();
+			glDeleteShader(objects(recorded));
+			objects.names.erase(recorded);
+			break;
+		}
+		case C::DeleteSync:
+		{
+			auto it = syncs.find(a.get<uint64_t>());
+			if (it != syncs.end())
+			{
+				glDeleteSync(it->second);
+				syncs.erase(it);
+			}
+			break;
+		}
+		case C::DeleteTextures: remove(glDeleteTextures, textures, a); break;
+		case C::DeleteVertexArrays: remove(glDeleteVertexArrays, vertexArrays, a); break;
+		case C::DrawArrays: call(glDrawArrays, a); break;
+		case C::DrawArraysInstanced: call(glDrawArraysInstanced, a); break;
+		case C::DrawBuffer: call(glDrawBuffer, a); break;
+		case C::DrawBuffers:
+		{
+			uint32_t size;
+			const uint8_t* data = a.blob(size);
+			glDrawBuffers((GLsizei)(size / sizeof(GLenum)), (const GLenum*)data);
+			break;
+		}
+		case C::DrawElementsBaseVertex: call(glDrawElementsBaseVertex, a); break;
+		case C::DrawElementsInstancedBaseVertex: call(glDrawElementsInstancedBaseVertex, a); break;
+		case C::Enable: call(glEnable, a); break;
+		case C::EnableVertexAttribArray: call(glEnableVertexAttribArray, a); break;
+		case C::FenceSync:
+		{
+			GLenum condition = a.get<GLenum>();
+			GLbitfield flags = a.get<GLbitfield>();
+			syncs[a.get<uint64_t>()] = glFenceSync(condition, flags);
+			break;
+		}
+		case C::Finish: glFinish(); break;
+		case C::FramebufferTexture2D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLenum attachment = a.get<GLenum>();
+			GLenum textureTarget = a.get<GLenum>();
+			GLuint texture = textures(a.get<GLuint>());
+			glFramebufferTexture2D(target, attachment, textureTarget, texture, a.get<GLint>());
+			break;
+		}
+		case C::GenBuffers: generate(glGenBuffers, buffers, a); break;
+		case C::GenFramebuffers: generate(glGenFramebuffers, framebuffers, a); break;
+		case C::GenTextures: generate(glGenTextures, textures, a); break;
+		case C::GenVertexArrays: generate(glGenVertexArrays, vertexArrays, a); break;
+		case C::GetIntegerv: glGetIntegerv(a.get<GLenum>(), scratchInts); break;
+		case C::GetProgramInfoLog:
+		case C::GetShaderInfoLog:
+		{
+			GLuint object = objects(a.get<GLuint>());
+			GLsizei size = a.get<GLsizei>();
+			scratch.resize(std::max<GLsizei>(size, 1));
+			if (record.call == C::GetProgramInfoLog)
+				glGetProgramInfoLog(object, size, nullptr, (GLchar*)scratch.data());
+			else
+				glGetShaderInfoLog(object, size, nullptr, (GLchar*)scratch.data());
+			break;
+		}
+		case C::GetProgramiv:
+		{
+			GLuint object = objects(a.get<GLuint>());
+			glGetProgramiv(object, a.get<GLenum>(), scratchInts);
+			break;
+		}
+		case C::GetShaderiv:
+		{
+			GLuint object = objects(a.get<GLuint>());
+			glGetShaderiv(object, a.get<GLenum>(), scratchInts);
+			break;
+		}
+		case C::GetString: call(glGetString, a); break;
+		case C::GetStringi: call(glGetStringi, a); break;
+		case C::GetUniformBlockIndex:
+		case C::GetUniformLocation:
+		{
+			GLuint recordedProgram = a.get<GLuint>();
+			uint32_t size;
+			const uint8_t* data = a.blob(size);
+			std::string name(data ? (const char*)data : "", size);
+			if (record.call == C::GetUniformLocation)
+			{
+				GLint recorded = a.get<GLint>();
+				locations[key(recordedProgram, recorded)] = glGetUniformLocation(objects(recordedProgram), name.c_str());
+			}
+			else
+			{
+				GLuint recorded = a.get<GLuint>();
+				blockIndices[key(recordedProgram, (GLint)recorded)] = glGetUniformBlockIndex(objects(recordedProgram), name.c_str());
+			}
+			break;
+		}
+		case C::LinkProgram: glLinkProgram(objects(a.get<GLuint>())); break;
+		case C::MapBufferRange:
+		{
+			GLenum target = a.get<GLenum>();
+			GLintptr offset = a.get<GLintptr>();
+			GLsizeiptr length = a.get<GLsizeiptr>();
+			mappings[target] = glMapBufferRange(target, offset, length, a.get<GLbitfield>());
+			break;
+		}
+		case C::PixelStorei: call(glPixelStorei, a); break;
+		case C::ReadBuffer: call(glReadBuffer, a); break;
+		case C::ReadPixels:
+		{
+			GLint x = a.get<GLint>();
+			GLint y = a.get<GLint>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLenum format = a.get<GLenum>();
+			GLenum type = a.get<GLenum>();
+			bool intoBuffer = a.get<uint8_t>() != 0;
+			void* offset = a.get<void*>();
+			if (!intoBuffer)
+			{
+				// whatever GL_PACK_ALIGNMENT is, rows never get more than 8 bytes of padding
+				scratch.resize(((size_t)width * glPixelBytes(format, type) + 8) * std::max(height, 1));
+				offset = scratch.data();
+			}
+			glReadPixels(x, y, width, height, format, type, offset);
+			break;
+		}
+		case C::ShaderSource:
+		{
+			GLuint shader = objects(a.get<GLuint>());
+			GLsizei count = a.get<GLsizei>();
+			std::vector<const GLchar*> strings(count);
+			std::vector<GLint> lengths(count);
+			for (GLsizei i = 0; i < count; i++)
+			{
+				uint32_t size;
+				strings[i] = (const GLchar*)a.blob(size);
+				lengths[i] = (GLint)size;
+			}
+			glShaderSource(shader, count, strings.data(), lengths.data());
+			break;
+		}
+		case C::TexImage2D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLint level = a.get<GLint>();
+			GLint internalFormat = a.get<GLint>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLint border = a.get<GLint>();
+			GLenum format = a.get<GLenum>();
+			GLenum type = a.get<GLenum>();
+			glTexImage2D(target, level, internalFormat, width, height, border, format, type, a.pixels());
+			break;
+		}
+		case C::TexImage3D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLint level = a.get<GLint>();
+			GLint internalFormat = a.get<GLint>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLsizei depth = a.get<GLsizei>();
+			GLint border = a.get<GLint>();
+			GLenum format = a.get<GLenum>();
+			GLenum type = a.get<GLenum>();
+			glTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, a.pixels());
+			break;
+		}
+		case C::TexParameteri: call(glTexParameteri, a); break;
+		case C::TexSubImage3D:
+		{
+			GLenum target = a.get<GLenum>();
+			GLint level = a.get<GLint>();
+			GLint x = a.get<GLint>();
+			GLint y = a.get<GLint>();
+			GLint z = a.get<GLint>();
+			GLsizei width = a.get<GLsizei>();
+			GLsizei height = a.get<GLsizei>();
+			GLsizei depth = a.get<GLsizei>();
+			GLenum format = a.get<GLenum>();
+			GLenum type = a.get<GLenum>();
+			glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type, a.pixels());
+			break;
+		}
+		case C::Uniform1f:
+		{
+			GLint recorded = a.get<GLint>();
+			glUniform1f(location(recorded), a.get<GLfloat>());
+			break;
+		}
+		case C::Uniform1i:
+		{
+			GLint recorded = a.get<GLint>();
+			glUniform1i(location(recorded), a.get<GLint>());
+			break;
+		}
+		case C::Uniform2f:
+		{
+			GLint recorded = a.get<GLint>();
+			GLfloat x = a.get<GLfloat>();
+			glUniform2f(location(recorded), x, a.get<GLfloat>());
+			break;
+		}
+		case C::Uniform3f:
+		{
+			GLint recorded = a.get<GLint>();
+			GLfloat x = a.get<GLfloat>();
+			GLfloat y = a.get<GLfloat>();
+			glUniform3f(location(recorded), x, y, a.get<GLfloat>());
+			break;
+		}
+		case C::Uniform4f:
+		{
+			GLint recorded = a.get<GLint>();
+			GLfloat x = a.get<GLfloat>();
+			GLfloat y = a.get<GLfloat>();
+			GLfloat z = a.get<GLfloat>();
+			glUniform4f(location(recorded), x, y, z, a.get<GLfloat>());
+			break;
+		}
+		case C::Uniform1fv: uniformArray(glUniform1fv, 1, a); break;
+		case C::Uniform1iv: uniformArray(glUniform1iv, 1, a); break;
+		case C::Uniform2fv: uniformArray(glUniform2fv, 2, a); break;
+		case C::Uniform3fv: uniformArray(glUniform3fv, 3, a); break;
+		case C::Uniform4fv: uniformArray(glUniform4fv, 4, a); break;
+		case C::UniformBlockBinding:
+		{
+			GLuint recordedProgram = a.get<GLuint>();
+			GLuint index = a.get<GLuint>();
+			auto it = blockIndices.find(key(recordedProgram, (GLint)index));
+			glUniformBlockBinding(objects(recordedProgram), it != blockIndices.end() ? it->second : index, a.get<GLuint>());
+			break;
+		}
+		case C::UniformMatrix2fv: uniformMatrix(glUniformMatrix2fv, 2, a); break;
+		case C::UniformMatrix3fv: uniformMatrix(glUniformMatrix3fv, 3, a); break;
+		case C::UniformMatrix4fv: uniformMatrix(glUniformMatrix4fv, 4, a); break;
+		case C::UnmapBuffer:
+		{
+			GLenum target = a.get<GLenum>();
+			uint32_t size;
+			const uint8_t* written = a.blob(size);
+			void* mapped = mappings[target];
+			if (written && mapped)
+				std::memcpy(mapped, written, size);
+			mappings.erase(target);
+			glUnmapBuffer(target);
+			break;
+		}
+		case C::UseProgram:
+			program = a.get<GLuint>();
+			glUseProgram(objects(program));
+			break;
+		case C::VertexAttribPointer: call(glVertexAttribPointer, a); break;
+		case C::Viewport: call(glViewport, a); break;
+		case C::BeginQuery:
+		{
+			GLenum target = a.get<GLenum>();
+			glBeginQuery(target, queries(a.get<GLuint>()));
+			break;
+		}
+		case C::DeleteQueries: remove(glDeleteQueries, queries, a); break;
+		case C::Disable: call(glDisable, a); break;
+		case C::EndQuery: call(glEndQuery, a); break;
+		case C::GenQueries: generate(glGenQueries, queries, a); break;
+		case C::GetQueryObjectiv:
+		{
+			GLuint query = queries(a.get<GLuint>());
+			glGetQueryObjectiv(query, a.get<GLenum>(), scratchInts);
+			break;
+		}
+		case C::GetQueryObjectui64v:
+		{
+			GLuint query = queries(a.get<GLuint>());
+			glGetQueryObjectui64v(query, a.get<GLenum>(), &scratchResult);
+			break;
+		}
+		case C::BlendFunc: call(glBlendFunc, a); break;
+		case C::DepthMask: call(glDepthMask, a); break;
+		case C::VertexAttribDivisor: call(glVertexAttribDivisor, a); break;
+		default:
+			skipped++;
+			break;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "VertexFormat.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One drawable piece of a glTF file. The vertex streams point straight into the
+// mapped .glb/.bin, nothing is copied until the data is encoded for the GPU. Indices
+// that are not 32 bit in the file are widened into 'widenedIndices'.
+struct GltfPrimitive
+{
+	VertexStreams streams;
+	const uint32_t* indices = nullptr;
+	size_t indexCount = 0;
+	std::vector<uint32_t> widenedIndices;
+	glm::mat4 transform = glm::mat4(1.0f); // node hierarchy flattened
+	int material = -1;
+};
+
+// glTF 2.0 reader for .gltf (with external .bin or data: URIs) and .glb files.
+// Only triangle primitives with float positions are supported, which covers what
+// exporters write without extensions.
+class GltfModel
+{
+public:
+	std::vector<GltfPrimitive> primitives;
+
+	bool load(const std::string& path, JobSystem* jobs = nullptr, LoadStats* stats = nullptr)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		primitives.clear();
+		files.clear();
+		ownedBuffers.clear();
+		buffers.clear();
+
+		files.push_back(std::unique_ptr<MappedFile>(new MappedFile(path)));
+		const MappedFile& file = *files.back();
+		if (!file.isOpen())
+			return false;
+
+		const char* jsonBegin = file.chars();
+		const char* jsonEnd = file.chars() + file.size();
+		const uint8_t* binChunk = nullptr;
+		size_t binSize = 0;
+		if (file.size() >= 12 && readU32(file.data()) == 0x46546C67) // "glTF"
+		{
+			if (!parseGlbChunks(file, jsonBegin, jsonEnd, binChunk, binSize))
+				return fail(path, "bad glb container");
+		}
+
+		JsonValue doc;
+		std::string error;
+		if (!JsonParser::parse(jsonBegin, jsonEnd, doc, error))
+			return fail(path, error);
+
+		std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+		const JsonValue& bufferList = doc["buffers"];
+		size_t totalBytes = file.size();
+		for (size_t i = 0; i < bufferList.size(); i++)
+		{
+			const JsonValue& buffer = bufferList[i];
+			Buffer ref;
+			if (!buffer.has("uri"))
+			{
+				// the glb binary chunk
+				ref.data = binChunk;
+				ref.size = binSize;
+			}
+			else if (buffer["uri"].asString().compare(0, 5, "data:") == 0)
+			{
+				const std::string& uri = buffer["uri"].asString();
+				size_t comma = uri.find(',');
+				ownedBuffers.push_back(decodeBase64(uri.substr(comma == std::string::npos ? uri.size() : comma + 1)));
+				ref.data = ownedBuffers.back().data();
+				ref.size = ownedBuffers.back().size();
+			}
+			else
+			{
+				files.push_back(std::unique_ptr<MappedFile>(new MappedFile(directory + buffer["uri"].asString())));
+				if (!files.back()->isOpen())
+					return fail(path, "missing buffer " + buffer["uri"].asString());
+				ref.data = files.back()->data();
+				ref.size = files.back()->size();
+				totalBytes += ref.size;
+			}
+			if (ref.size < buffer["byteLength"].asSize())
+				return fail(path, "buffer shorter than byteLength");
+			buffers.push_back(ref);
+		}
+
+		// walk the default scene, or every root node if there is none
+		const JsonValue& nodes = doc["nodes"];
+		const JsonValue& scene = doc["scenes"][(size_t)doc["scene"].asInt(0)];
+		if (scene.isNull())
+		{
+			std::vector<bool> isChild(nodes.size(), false);
+			for (size_t n = 0; n < nodes.size(); n++)
+				for (size_t c = 0; c < nodes[n]["children"].size(); c++)
+					if (nodes[n]["children"][c].asSize() < isChild.size())
+						isChild[nodes[n]["children"][c].asSize()] = true;
+			for (size_t n = 0; n < nodes.size(); n++)
+				if (!isChild[n] && !visitNode(doc, n, glm::mat4(1.0f), 0))
+					return fail(path, error.empty() ? "bad node" : error);
+		}
+		else
+		{
+			for (size_t i = 0; i < scene["nodes"].size(); i++)
+				if (!visitNode(doc, scene["nodes"][i].asSize(), glm::mat4(1.0f), 0))
+					return fail(path, "bad node");
+		}
+		if (nodes.size() == 0)
+		{
+			// no node hierarchy at all, take every mesh as is
+			for (size_t m = 0; m < doc["meshes"].size(); m++)
+				if (!addMesh(doc, m, glm::mat4(1.0f)))
+					return fail(path, "bad mesh");
+		}
+
+		// widening 8/16 bit index buffers and checking every index against the vertex
+		// count is the only real work left, spread it out
+		std::vector<uint8_t> outOfRange(primitives.size(), 0);
+		auto widen = [&](size_t i)
+		{
+			GltfPrimitive& primitive = primitives[i];
+			const PendingIndices& pending = pendingIndices[i];
+			if (pending.data != nullptr)
+			{
+				primitive.widenedIndices.resize(pending.count);
+				for (size_t k = 0; k < pending.count; k++)
+				{
+					const uint8_t* src = pending.data + k * pending.stride;
+					uint32_t value = 0;
+					if (pending.componentType == 5121) value = *src;
+					else if (pending.componentType == 5123) { uint16_t v; std::memcpy(&v, src, 2); value = v; }
+					else std::memcpy(&value, src, 4);
+					primitive.widenedIndices[k] = value;
+				}
+				primitive.indices = primitive.widenedIndices.data();
+			}
+			for (size_t k = 0; k < primitive.indexCount; k++)
+				if (primitive.indices[k] >= primitive.streams.count)
+				{
+					outOfRange[i] = 1;
+					break;
+				}
+		};
+		if (jobs)
+			jobs->parallelFor(primitives.size(), 1, [&](size_t b, size_t e, size_t, unsigned int) { for (size_t i = b; i < e; i++) widen(i); });
+		else
+			for (size_t i = 0; i < primitives.size(); i++)
+				widen(i);
+		pendingIndices.clear();
+		for (size_t i = 0; i < primitives.size(); i++)
+			if (outOfRange[i])
+				return fail(path, "index out of range");
+
+		if (stats)
+		{
+			stats->bytes = totalBytes;
+			stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			stats->vertices = 0;
+			stats->triangles = 0;
+			for (const GltfPrimitive& primitive : primitives)
+			{
+				stats->vertices += primitive.streams.count;
+				stats->triangles += primitive.indexCount / 3;
+			}
+		}
+		return true;
+	}
+
+private:
+	struct Buffer
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+
+	struct PendingIndices
+	{
+		const uint8_t* data = nullptr;
+		size_t stride = 0;
+		size_t count = 0;
+		int componentType = 0;
+	};
+
+	// the mappings have to outlive the primitives that point into them
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<std::vector<uint8_t>> ownedBuffers;
+	std::vector<Buffer> buffers;
+	std::vector<PendingIndices> pendingIndices;
+
+	static uint32_t readU32(const uint8_t* p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, 4);
+		return v;
+	}
+
+	static bool fail(const std::string& path, const std::string& why)
+	{
+		std::cout << "ERROR::GLTF_LOADER::LOAD_FAILED " << path << ": " << why << std::endl;
+		return false;
+	}
+
+	static bool parseGlbChunks(const MappedFile& file, const char*& jsonBegin, const char*& jsonEnd, const uint8_t*& bin, size_t& binSize)
+	{
+		const uint8_t* data = file.data();
+		size_t length = readU32(data + 8);
+		if (readU32(data + 4) != 2 || length > file.size())
+			return false;
+		size_t offset = 12;
+		bool haveJson = false;
+		while (offset + 8 <= length)
+		{
+			uint32_t chunkLength = readU32(data + offset);
+			uint32_t chunkType = readU32(data + offset + 4);
+			const uint8_t* chunk = data + offset + 8;
+			if (offset + 8 + (size_t)chunkLength > length)
+				return false;
+			if (chunkType == 0x4E4F534A) // JSON
+			{
+				jsonBegin = (const char*)chunk;
+				jsonEnd = (const char*)chunk + chunkLength;
+				haveJson = true;
+			}
+			else if (chunkType == 0x004E4942 && bin == nullptr) // BIN
+			{
+				bin = chunk;
+				binSize = chunkLength;
+			}
+			offset += 8 + ((chunkLength + 3) & ~3u);
+		}
+		return haveJson;
+	}
+
+	static glm::mat4 nodeMatrix(const JsonValue& node)
+	{
+		glm::mat4 m(1.0f);
+		const JsonValue& matrix = node["matrix"];
+		if (matrix.size() == 16)
+		{
+			for (int c = 0; c < 4; c++)
+				for (int r = 0; r < 4; r++)
+					m[c][r] = matrix[(size_t)(c * 4 + r)].asFloat();
+			return m;
+		}
+		const JsonValue& t = node["translation"];
+		const JsonValue& r = node["rotation"];
+		const JsonValue& s = node["scale"];
+		float x = r[(size_t)0].asFloat(0.0f), y = r[1].asFloat(0.0f), z = r[2].asFloat(0.0f), w = r[3].asFloat(1.0f);
+		glm::vec3 scale(s[(size_t)0].asFloat(1.0f), s[1].asFloat(1.0f), s[2].asFloat(1.0f));
+		// T * R * S with R from the unit quaternion
+		m[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0.0f) * scale.x;
+		m[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0.0f) * scale.y;
+		m[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0.0f) * scale.z;
+		m[3] = glm::vec4(t[(size_t)0].asFloat(0.0f), t[1].asFloat(0.0f), t[2].asFloat(0.0f), 1.0f);
+		return m;
+	}
+
+	bool visitNode(const JsonValue& doc, size_t index, const glm::mat4& parent, int depth)
+	{
+		const JsonValue& node = doc["nodes"][index];
+		if (node.isNull() || depth > 64)
+			return false;
+		glm::mat4 world = parent * nodeMatrix(node);
+		if (node.has("mesh") && !addMesh(doc, node["mesh"].asSize(), world))
+			return false;
+		for (size_t c = 0; c < node["children"].size(); c++)
+			if (!visitNode(doc, node["children"][c].asSize(), world, depth + 1))
+				return false;
+		return true;
+	}
+
+	// resolves an accessor to a pointer/stride pair inside a mapped buffer
+	bool accessor(const JsonValue& doc, size_t index, const uint8_t*& data, size_t& stride, size_t& count, int& componentType, int components) const
+	{
+		const JsonValue& acc = doc["accessors"][index];
+		const JsonValue& view = doc["bufferViews"][acc["bufferView"].asSize()];
+		if (acc.isNull() || view.isNull() || !acc.has("bufferView"))
+			return false;
+		size_t buffer = view["buffer"].asSize();
+		if (buffer >= buffers.size())
+			return false;
+		componentType = acc["componentType"].asInt();
+		count = acc["count"].asSize();
+		size_t componentSize = componentType == 5121 || componentType == 5120 ? 1 : (componentType == 5123 || componentType == 5122 ? 2 : 4);
+		size_t elementSize = componentSize * components;
+		stride = view["byteStride"].asSize(elementSize);
+		size_t offset = view["byteOffset"].asSize() + acc["byteOffset"].asSize();
+		size_t needed = count == 0 ? 0 : (count - 1) * stride + elementSize;
+		if (offset + needed > view["byteOffset"].asSize() + view["byteLength"].asSize() || offset + needed > buffers[buffer].size)
+			return false;
+		data = buffers[buffer].data + offset;
+		return true;
+	}
+
+	bool addMesh(const JsonValue& doc, size_t meshIndex, const glm::mat4& transform)
+	{
+		const JsonValue& mesh = doc["meshes"][meshIndex];
+		if (mesh.isNull())
+			return false;
+		for (size_t p = 0; p < mesh["primitives"].size(); p++)
+		{
+			const JsonValue& prim = mesh["primitives"][p];
+			if (prim["mode"].asInt(4) != 4)
+				continue; // only triangle lists
+			const JsonValue& attributes = prim["attributes"];
+			if (!attributes.has("POSITION"))
+				continue;
+
+			GltfPrimitive primitive;
+			primitive.transform = transform;
+			primitive.material = prim["material"].asInt(-1);
+
+			const uint8_t* data;
+			size_t stride, count;
+			int type;
+			if (!accessor(doc, attributes["POSITION"].asSize(), data, stride, count, type, 3) || type != 5126 || stride % 4 != 0)
+				return false;
+			primitive.streams.positions = (const float*)data;
+			primitive.streams.positionStride = stride / 4;
+			primitive.streams.count = count;
+
+			if (attributes.has("NORMAL"))
+			{
+				size_t normalCount;
+				if (!accessor(doc, attributes["NORMAL"].asSize(), data, stride, normalCount, type, 3) || type != 5126 || stride % 4 != 0 || normalCount != count)
+					return false;
+				primitive.streams.normals = (const float*)data;
+				primitive.streams.normalStride = stride / 4;
+			}
+			if (attributes.has("TEXCOORD_0"))
+			{
+				size_t uvCount;
+				if (accessor(doc, attributes["TEXCOORD_0"].asSize(), data, stride, uvCount, type, 2) && type == 5126 && stride % 4 == 0 && uvCount == count)
+				{
+					primitive.streams.uvs = (const float*)data;
+					primitive.streams.uvStride = stride / 4;
+				}
+			}
+
+			PendingIndices pending;
+			if (prim.has("indices"))
+			{
+				size_t indexCount;
+				if (!accessor(doc, prim["indices"].asSize(), data, stride, indexCount, type, 1)
+					|| (type != 5121 && type != 5123 && type != 5125))
+					return false;
+				primitive.indexCount = indexCount;
+				if (type == 5125 && stride == 4 && ((uintptr_t)data & 3) == 0)
+					primitive.indices = (const uint32_t*)data; // usable in place
+				else
+					pending = { data, stride, indexCount, type };
+			}
+			else
+			{
+				// non-indexed: 0, 1, 2, ...
+				primitive.widenedIndices.resize(count);
+				for (size_t i = 0; i < count; i++)
+					primitive.widenedIndices[i] = (uint32_t)i;
+				primitive.indexCount = count;
+			}
+			primitives.push_back(std::move(primitive));
+			if (primitives.back().indices == nullptr && !primitives.back().widenedIndices.empty())
+				primitives.back().indices = primitives.back().widenedIndices.data();
+			pendingIndices.push_back(pending);
+		}
+		return true;
+	}
+
+	static std::vector<uint8_t> decodeBase64(const std::string& text)
+	{
+		std::vector<uint8_t> out;
+		out.reserve(text.size() / 4 * 3);
+		uint32_t accumulator = 0;
+		int bits = 0;
+		for (char c : text)
+		{
+			int value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+' || c == '-') value = 62;
+			else if (c == '/' || c == '_') value = 63;
+			else continue; // padding and whitespace
+			accumulator = (accumulator << 6) | (uint32_t)value;
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				out.push_back((uint8_t)(accumulator >> bits));
+			}
+		}
+		return out;
+	}
+};
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef GOLDEN_IMAGE_H
+#define GOLDEN_IMAGE_H
+
+#include "Image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Perceptual difference of two renders in the spirit of NVIDIA's FLIP: both images are
+// low pass filtered like the eye at a given viewing distance (pixels per degree) before
+// colors are compared in Lab (HyAB distance), and the color error is amplified where the
+// edges of the two images differ. Per pixel errors are 0..1, every channel one step off
+// scores about 0.03, a wrong color in a spot goes towards 1.
+struct ImageDifference
+{
+	bool sizeMatches = false;
+	double mean = 1.0;
+	double percentile99 = 1.0;
+	double max = 1.0;
+};
+
+class PerceptualDiff
+{
+public:
+	// 67 ppd is a 0.7 m away 24" 4K screen, the FLIP default
+	static ImageDifference compare(const ImageRGBA8& reference, const ImageRGBA8& test, ImageRGBA8* errorMap = nullptr, float pixelsPerDegree = 67.0f)
+	{
+		ImageDifference result;
+		if (reference.width != test.width || reference.height != test.height || reference.width == 0 || reference.height == 0)
+			return result;
+		result.sizeMatches = true;
+		int width = reference.width;
+		int height = reference.height;
+		size_t count = (size_t)width * height;
+
+		// color pipeline: filter in the linear opponent space YCxCz, compare in Lab
+		std::vector<float> referenceOpponent = toOpponent(reference);
+		std::vector<float> testOpponent = toOpponent(test);
+		// contrast sensitivity as gaussians, chroma is resolved a lot coarser than luminance
+		float lumaSigma = 0.0154f * pixelsPerDegree;
+		float chromaSigma = 0.0400f * pixelsPerDegree;
+		blur(referenceOpponent, width, height, lumaSigma, chromaSigma);
+		blur(testOpponent, width, height, lumaSigma, chromaSigma);
+
+		const float maxError = std::pow(hyab(rgbToLab(0.0f, 1.0f, 0.0f), rgbToLab(0.0f, 0.0f, 1.0f)), 0.7f);
+		std::vector<float> errors(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			float colorError = std::pow(hyab(opponentToLab(&referenceOpponent[i * 3]), opponentToLab(&testOpponent[i * 3])), 0.7f);
+			colorError = remapColorError(colorError, maxError);
+
+			// feature pipeline: edge strength of the luminance, differences make color errors stand out
+			int x = (int)(i % width);
+			int y = (int)(i / width);
+			float featureError = std::fabs(edge(reference, x, y) - edge(test, x, y));
+			featureError = std::pow(std::min(featureError, 1.0f), 0.5f);
+			errors[i] = std::pow(colorError, 1.0f - featureError);
+		}
+
+		double sum = 0.0;
+		for (float error : errors)
+			sum += error;
+		result.mean = sum / count;
+		if (errorMap)
+		{
+			errorMap->width = width;
+			errorMap->height = height;
+			errorMap->pixels.resize(count * 4);
+			for (size_t i = 0; i < count; i++)
+			{
+				// black to red to yellow
+				float e = std::min(errors[i] * 4.0f, 1.0f);
+				errorMap->pixels[i * 4 + 0] = (uint8_t)(std::min(e * 2.0f, 1.0f) * 255.0f);
+				errorMap->pixels[i * 4 + 1] = (uint8_t)(std::max(e * 2.0f - 1.0f, 0.0f) * 255.0f);
+				errorMap->pixels[i * 4 + 2] = 0;
+				errorMap->pixels[i * 4 + 3] = 255;
+			}
+		}
+		size_t percentile = std::min(count - 1, (size_t)(count * 0.99));
+		std::nth_element(errors.begin(), errors.begin() + percentile, errors.end());
+		result.percentile99 = errors[percentile];
+		result.max = *std::max_element(errors.begin() + percentile, errors.end());
+		return result;
+	}
+
+private:
+	struct Lab
+	{
+		float l, a, b;
+	};
+
+	static float srgbToLinear(uint8_t value)
+	{
+		float c = value / 255.0f;
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// linear sRGB to XYZ relative to the D65 white point
+	static void rgbToXyz(float r, float g, float b, float* xyz)
+	{
+		xyz[0] = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.9505f;
+		xyz[1] = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+		xyz[2] = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.0888f;
+	}
+
+	static std::vector<float> toOpponent(const ImageRGBA8& image)
+	{
+		size_t count = (size_t)image.width * image.height;
+		std::vector<float> opponent(count * 3);
+		for (size_t i = 0; i < count; i++)
+		{
+			float xyz[3];
+			const uint8_t* p = &image.pixels[i * 4];
+			rgbToXyz(srgbToLinear(p[0]), srgbToLinear(p[1]), srgbToLinear(p[2]), xyz);
+			opponent[i * 3 + 0] = 116.0f * xyz[1] - 16.0f;
+			opponent[i * 3 + 1] = 500.0f * (xyz[0] - xyz[1]);
+			opponent[i * 3 + 2] = 200.0f * (xyz[1] - xyz[2]);
+		}
+		return opponent;
+	}
+
+	static float labCurve(float t)
+	{
+		return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+	}
+
+	static Lab xyzToLab(const float* xyz)
+	{
+		float fx = labCurve(xyz[0]), fy = labCurve(xyz[1]), fz = labCurve(xyz[2]);
+		return { 116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz) };
+	}
+
+	static Lab rgbToLab(float r, float g, float b)
+	{
+		float xyz[3];
+		rgbToXyz(r, g, b, xyz);
+		return xyzToLab(xyz);
+	}
+
+	// back through XYZ, the filtered colors can leave the gamut so clamp them in linear RGB
+	static Lab opponentToLab(const float* opponent)
+	{
+		float y = (opponent[0] + 16.0f) / 116.0f;
+		float x = opponent[1] / 500.0f + y;
+		float z = y - opponent[2] / 200.0f;
+		x *= 0.9505f;
+		z *= 1.0888f;
+		float r = std::min(std::max(3.2406f * x - 1.5372f * y - 0.4986f * z, 0.0f), 1.0f);
+		float g = std::min(std::max(-0.9689f * x + 1.8758f * y + 0.0415f * z, 0.0f), 1.0f);
+		float b = std::min(std::max(0.0557f * x - 0.2040f * y + 1.0570f * z, 0.0f), 1.0f);
+		return rgbToLab(r, g, b);
+	}
+
+	static float hyab(const Lab& a, const Lab& b)
+	{
+		float da = a.a - b.a, db = a.b - b.b;
+		return std::fabs(a.l - b.l) + std::sqrt(da * da + db * db);
+	}
+
+	// FLIP's compression: small errors spread over most of the range, the rest is squeezed
+	static float remapColorError(float error, float maxError)
+	{
+		const float pc = 0.4f, pt = 0.95f;
+		if (error < pc * maxError)
+			return pt / (pc * maxError) * error;
+		return std::min(pt + (error - pc * maxError) / (maxError - pc * maxError) * (1.0f - pt), 1.0f);
+	}
+
+	static std::vector<float> kernel(float sigma)
+	{
+		int radius = std::max(1, (int)std::ceil(sigma * 3.0f));
+		std::vector<float> weights(radius * 2 + 1);
+		float sum = 0.0f;
+		for (int i = -radius; i <= radius; i++)
+			sum += weights[i + radius] = std::exp(-(float)(i * i) / (2.0f * sigma * sigma));
+		for (float& w : weights)
+			w /= sum;
+		return weights;
+	}
+
+	// separable, channel 0 with the luminance kernel and 1, 2 with the chroma one
+	static void blur(std::vector<float>& opponent, int width, int height, float lumaSigma, float chromaSigma)
+	{
+		std::vector<float> kernels[2] = { kernel(lumaSigma), kernel(chromaSigma) };
+		std::vector<float> temp(opponent.size());
+		for (int pass = 0; pass < 2; pass++)
+		{
+			std::vector<float>& src = pass == 0 ? opponent : temp;
+			std::vector<float>& dst = pass == 0 ? temp : opponent;
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+					for (int c = 0; c < 3; c++)
+					{
+						const std::vector<float>& k = kernels[c == 0 ? 0 : 1];
+						int radius = (int)k.size() / 2;
+						float sum = 0.0f;
+						for (int i = -radius; i <= radius; i++)
+						{
+							int sx = pass == 0 ? std::min(std::max(x + i, 0), width - 1) : x;
+							int sy = pass == 1 ? std::min(std::max(y + i, 0), height - 1) : y;
+							sum += k[i + radius] * src[((size_t)sy * width + sx) * 3 + c];
+						}
+						dst[((size_t)y * width + x) * 3 + c] = sum;
+					}
+		}
+	}
+
+	static float luminance(const ImageRGBA8& image, int x, int y)
+	{
+		x = std::min(std::max(x, 0), image.width - 1);
+		y = std::min(std::max(y, 0), image.height - 1);
+		const uint8_t* p = &image.pixels[((size_t)y * image.width + x) * 4];
+		return (0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2]) / 255.0f;
+	}
+
+	// Sobel gradient magnitude, 0..1
+	static float edge(const ImageRGBA8& image, int x, int y)
+	{
+		float gx = luminance(image, x + 1, y - 1) + 2.0f * luminance(image, x + 1, y) + luminance(image, x + 1, y + 1)
+			- luminance(image, x - 1, y - 1) - 2.0f * luminance(image, x - 1, y) - luminance(image, x - 1, y + 1);
+		float gy = luminance(image, x - 1, y + 1) + 2.0f * luminance(image, x, y + 1) + luminance(image, x + 1, y + 1)
+			- luminance(image, x - 1, y - 1) - 2.0f * luminance(image, x, y - 1) - luminance(image, x + 1, y - 1);
+		return std::min(std::sqrt(gx * gx + gy * gy) * 0.25f, 1.0f);
+	}
+};
+
+// Golden image run: the viewer renders its scene at fixed animation times, every frame is
+// compared to <directory>/<scene>_t<ms>.png. Failures leave <name>.actual.png and
+// <name>.diff.png next to it. Each time is rendered a few times and the median frame time
+// is reported beside the one stored when the references were made, so an optimization that
+// changes the picture shows up together with what it bought.
+// The references come from Mesa's llvmpipe, other drivers rasterize slightly differently.
+// They are committed in golden/ (the default scene and --lights 3 --shadows); a time
+// without one fails, only --update-golden writes references and frame times.
+class GoldenImageRun
+{
+public:
+	struct Result
+	{
+		std::string name;
+		ImageDifference difference;
+		double frameMs = 0.0;
+		double referenceMs = 0.0;
+		bool passed = false;
+		bool updated = false;
+	};
+
+	// mean error and the error 99 % of the pixels stay below, rounding differences pass
+	// while a missing light or a shifted edge doesn't
+	float meanTolerance = 0.05f;
+	float percentileTolerance = 0.2f;
+
+	GoldenImageRun(const std::string& directory, const std::string& scene, bool update)
+		: directory(directory), scene(scene), update(update)
+	{
+		std::ifstream file(timesPath());
+		std::string name;
+		double ms;
+		while (file >> name >> ms)
+			referenceTimes[name] = ms;
+	}
+
+	bool active() const { return !directory.empty() && next < times().size(); }
+	bool enabled() const { return !directory.empty(); }
+
+	// the light's orbit at its start, an eighth, a quarter and half way round
+	static const std::vector<float>& times()
+	{
+		static const std::vector<float> list = { 0.0f, 0.785f, 1.571f, 3.142f };
+		return list;
+	}
+
+	// animation time of the frame to render
+	float time() const { return times()[next]; }
+
+	// after each frame with its CPU + GPU time (glFinish included), true when this is the
+	// frame to read back and hand to check()
+	bool frameRendered(double ms)
+	{
+		// the first frame of each time compiles, streams and warms caches
+		if (repeat > 0)
+			frameMs.push_back(ms);
+		return ++repeat == REPEATS;
+	}
+
+	void check(const ImageRGBA8& image)
+	{
+		Result result;
+		char suffix[16];
+		std::snprintf(suffix, sizeof(suffix), "_t%04d", (int)std::lround(time() * 1000.0f));
+		result.name = scene + suffix;
+		std::sort(frameMs.begin(), frameMs.end());
+		result.frameMs = frameMs.empty() ? 0.0 : frameMs[frameMs.size() / 2];
+		auto reference = referenceTimes.find(result.name);
+		result.referenceMs = reference != referenceTimes.end() ? reference->second : 0.0;
+
+		std::string path = directory + "/" + result.name + ".png";
+		if (update)
+		{
+			result.updated = result.passed = PngWriter::write(path, image);
+			referenceTimes[result.name] = result.frameMs;
+		}
+		else
+		{
+			ImageRGBA8 golden;
+			std::ifstream file(path, std::ios::binary);
+			std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (bytes.empty())
+				std::cout << "ERROR::GOLDEN::NO_REFERENCE " << path << ", run with --update-golden first" << std::endl;
+			else if (decodeImageRGBA8(bytes.data(), bytes.size(), golden, path))
+			{
+				ImageRGBA8 errorMap;
+				result.difference = PerceptualDiff::compare(golden, image, &errorMap);
+				result.passed = result.difference.sizeMatches && result.difference.mean <= meanTolerance
+					&& result.difference.percentile99 <= percentileTolerance;
+				if (!result.difference.sizeMatches)
+					std::cout << "ERROR::GOLDEN::SIZE_MISMATCH " << path << " is " << golden.width << "x" << golden.height
+						<< ", the frame " << image.width << "x" << image.height << std::endl;
+				if (!result.passed)
+				{
+					PngWriter::write(directory + "/" + result.name + ".actual.png", image);
+					if (result.difference.sizeMatches)
+						PngWriter::write(directory + "/" + result.name + ".diff.png", errorMap);
+				}
+			}
+		}
+		print(result);
+		results.push_back(result);
+		frameMs.clear();
+		repeat = 0;
+		next++;
+	}
+
+	// prints the summary, stores the frame times of an update, returns the number of failures
+	int finish()
+	{
+		int passed = 0;
+		for (const Result& result : results)
+			passed += result.passed ? 1 : 0;
+		if (update)
+		{
+			std::ofstream file(timesPath());
+			for (const auto& entry : referenceTimes)
+				file << entry.first << " " << entry.second << "\n";
+		}
+		std::cout << "Golden images " << scene << ": " << passed << "/" << times().size()
+			<< (update ? " updated" : " passed") << std::endl;
+		return (int)times().size() - passed;
+	}
+
+private:
+	static const int REPEATS = 8;
+
+	std::string directory;
+	std::string scene;
+	bool update;
+	size_t next = 0;
+	int repeat = 0;
+	std::vector<double> frameMs;
+	std::map<std::string, double> referenceTimes;
+	std::vector<Result> results;
+
+	std::string timesPath() const { return directory + "/" + scene + ".frametimes"; }
+
+	void print(const Result& result) const
+	{
+		std::cout << "GOLDEN " << result.name << ": " << (result.updated ? "updated" : result.passed ? "pass" : "FAIL");
+		if (!result.updated && result.difference.sizeMatches)
+			std::cout << ", mean error " << result.difference.mean << ", 99% " << result.difference.percentile99 << ", max " << result.difference.max;
+		std::cout << ", " << result.frameMs << " ms";
+		if (!result.updated && result.referenceMs > 0.0)
+			std::cout << " (reference " << result.referenceMs << " ms)";
+		std::cout << std::endl;
+	}
+};
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 8 bit RGBA image in memory, rows top to bottom
+struct ImageRGBA8
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;
+
+	size_t bytes() const { return pixels.size(); }
+	const uint8_t* data() const { return pixels.data(); }
+};
+
+// decodes PNG/JPG/TGA/... from memory (e.g. a MappedFile) into RGBA8
+inline bool decodeImageRGBA8(const uint8_t* data, size_t size, ImageRGBA8& out, const std::string& name)
+{
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load_from_memory(data, (int)size, &width, &height, &channels, 4);
+	if (!pixels)
+	{
+		std::cout << "ERROR::IMAGE::DECODE_FAILED " << name << ": " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	out.width = width;
+	out.height = height;
+	out.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+	stbi_image_free(pixels);
+	return true;
+}
+
+// PNG writer for captures and reference images. Rows use the Sub filter and go through a
+// small fixed Huffman deflate with one hash probe per position: a lot smaller than
+// stored blocks for rendered frames, and fast enough to run per frame on a worker.
+class PngWriter
+{
+public:
+	static bool encode(const ImageRGBA8& image, std::vector<uint8_t>& out)
+	{
+		if (image.width <= 0 || image.height <= 0 || image.pixels.size() < (size_t)image.width * image.height * 4)
+			return false;
+		size_t stride = (size_t)image.width * 4;
+		std::vector<uint8_t> filtered((stride + 1) * image.height);
+		for (int y = 0; y < image.height; y++)
+		{
+			const uint8_t* row = image.data() + y * stride;
+			uint8_t* dst = filtered.data() + y * (stride + 1);
+			dst[0] = 1; // Sub
+			for (size_t x = 0; x < stride; x++)
+				dst[1 + x] = (uint8_t)(row[x] - (x >= 4 ? row[x - 4] : 0));
+		}
+
+		out.clear();
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.insert(out.end(), signature, signature + 8);
+		uint8_t header[13] = {};
+		writeBigEndian(header, (uint32_t)image.width);
+		writeBigEndian(header + 4, (uint32_t)image.height);
+		header[8] = 8; // bits per channel
+		header[9] = 6; // RGBA
+		writeChunk(out, "IHDR", header, sizeof(header));
+		std::vector<uint8_t> compressed = zlibCompress(filtered.data(), filtered.size());
+		writeChunk(out, "IDAT", compressed.data(), compressed.size());
+		writeChunk(out, "IEND", nullptr, 0);
+		return true;
+	}
+
+	static bool write(const std::string& path, const ImageRGBA8& image)
+	{
+		std::vector<uint8_t> png;
+		if (!encode(image, png))
+			return false;
+		std::ofstream file(path, std::ios::binary);
+		file.write((const char*)png.data(), png.size());
+		if (!file)
+		{
+			std::cout << "ERROR::IMAGE::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	struct BitWriter
+	{
+		std::vector<uint8_t>& out;
+		uint32_t bits = 0;
+		int count = 0;
+
+		explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+		void put(uint32_t value, int length)
+		{
+			bits |= value << count;
+			count += length;
+			while (count >= 8)
+			{
+				out.push_back((uint8_t)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+		// Huffman codes go most significant bit first
+		void putCode(uint32_t code, int length)
+		{
+			uint32_t reversed = 0;
+			for (int i = 0; i < length; i++)
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			put(reversed, length);
+		}
+		void flush()
+		{
+			if (count > 0)
+				out.push_back((uint8_t)bits);
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	static void writeBigEndian(uint8_t* dst, uint32_t value)
+	{
+		dst[0] = (uint8_t)(value >> 24);
+		dst[1] = (uint8_t)(value >> 16);
+		dst[2] = (uint8_t)(value >> 8);
+		dst[3] = (uint8_t)value;
+	}
+
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::vector<uint32_t> table = []()
+		{
+			std::vector<uint32_t> t(256);
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static void writeChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+	{
+		uint8_t length[4];
+		writeBigEndian(length, (uint32_t)size);
+		out.insert(out.end(), length, length + 4);
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		if (size > 0)
+			out.insert(out.end(), data, data + size);
+		uint8_t crc[4];
+		writeBigEndian(crc, crc32(out.data() + start, out.size() - start));
+		out.insert(out.end(), crc, crc + 4);
+	}
+
+	static void putLiteral(BitWriter& writer, uint32_t symbol)
+	{
+		if (symbol < 144)
+			writer.putCode(0x30 + symbol, 8);
+		else if (symbol < 256)
+			writer.putCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280)
+			writer.putCode(symbol - 256, 7);
+		else
+			writer.putCode(0xC0 + symbol - 280, 8);
+	}
+
+	static void putMatch(BitWriter& writer, int length, int distance)
+	{
+		static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+			4097, 6145, 8193, 12289, 16385, 24577 };
+		int code = 28;
+		while (lengthBase[code] > length)
+			code--;
+		putLiteral(writer, 257 + code);
+		writer.put(length - lengthBase[code], lengthExtra[code]);
+		int distanceCode = 29;
+		while (distanceBase[distanceCode] > distance)
+			distanceCode--;
+		writer.putCode(distanceCode, 5);
+		writer.put(distance - distanceBase[distanceCode], distanceCode < 4 ? 0 : distanceCode / 2 - 1);
+	}
+
+	static std::vector<uint8_t> zlibCompress(const uint8_t* data, size_t size)
+	{
+		const int WINDOW = 32768;
+		const int MAX_MATCH = 258;
+		const int HASH_BITS = 15;
+		std::vector<uint8_t> out = { 0x78, 0x01 };
+		BitWriter writer(out);
+		writer.put(1, 1); // last block
+		writer.put(1, 2); // fixed Huffman codes
+		std::vector<int64_t> head((size_t)1 << HASH_BITS, -WINDOW - 1);
+		size_t i = 0;
+		while (i < size)
+		{
+			int bestLength = 0;
+			size_t bestDistance = 0;
+			if (i + 3 <= size)
+			{
+				uint32_t hash = ((uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2]) * 2654435761u >> (32 - HASH_BITS);
+				int64_t candidate = head[hash];
+				head[hash] = (int64_t)i;
+				if (candidate >= 0 && (int64_t)i - candidate <= WINDOW)
+				{
+					size_t limit = std::min((size_t)MAX_MATCH, size - i);
+					int length = 0;
+					while ((size_t)length < limit && data[candidate + length] == data[i + length])
+						length++;
+					if (length >= 3)
+					{
+						bestLength = length;
+						bestDistance = i - (size_t)candidate;
+					}
+				}
+			}
+			if (bestLength >= 3)
+			{
+				putMatch(writer, bestLength, (int)bestDistance);
+				i += bestLength;
+			}
+			else
+				putLiteral(writer, data[i++]);
+		}
+		putLiteral(writer, 256);
+		writer.flush();
+
+		uint32_t a = 1, b = 0;
+		for (size_t k = 0; k < size; k++)
+		{
+			a = (a + data[k]) % 65521;
+			b = (b + a) % 65521;
+		}
+		uint8_t adler[4];
+		writeBigEndian(adler, (b << 16) | a);
+		out.insert(out.end(), adler, adler + 4);
+		return out;
+	}
+};
+
+#endif
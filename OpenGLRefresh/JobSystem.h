@@ -0,0 +1,197 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool. The thread that calls parallelFor() takes part
+// in the work as thread index 0, the workers are numbered 1..workerCount().
+// Nothing in here touches GL, so jobs must never issue GL calls - they record
+// into CommandLists instead which are replayed on the context thread.
+// Waiting threads never pick up queued jobs in between, so while a body runs
+// under some thread index, the only other code running under that index is a
+// nested parallelFor the body started itself.
+class JobSystem
+{
+public:
+	// threadCount = 0 picks one worker per hardware thread minus the calling thread
+	explicit JobSystem(unsigned int threadCount = 0)
+	{
+		if (threadCount == 0)
+		{
+			unsigned int hw = std::thread::hardware_concurrency();
+			threadCount = hw > 1 ? hw - 1 : 0;
+		}
+		for (unsigned int i = 0; i < threadCount; i++)
+			workers.emplace_back([this, i]() { workerLoop(i + 1); });
+	}
+
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			quitting = true;
+		}
+		queueCondition.notify_all();
+		for (std::thread& t : workers)
+			t.join();
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// number of background threads (the caller comes on top of that)
+	unsigned int workerCount() const { return (unsigned int)workers.size(); }
+	// number of threads that may run a parallelFor body at the same time
+	unsigned int threadCount() const { return workerCount() + 1; }
+
+	// index of the calling thread, 0 for any thread that is not a worker
+	static unsigned int currentThreadIndex() { return threadIndex(); }
+
+	// queue a job without waiting for it, use wait() to drain the queue
+	void submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			jobs.push_back(std::move(job));
+			pending++;
+		}
+		queueCondition.notify_one();
+	}
+
+	// blocks until every submitted job has finished, helping out meanwhile.
+	// Not allowed from inside a job, the helping would run another job under
+	// the same thread index.
+	void wait()
+	{
+		assert(!insideJob() && "JobSystem::wait() called from inside a job");
+		while (pending.load() != 0)
+		{
+			if (!runOne())
+				std::this_thread::yield();
+		}
+	}
+
+	// splits [0, count) into chunks of 'grain' items and runs fn(begin, end, chunk, thread)
+	// on all threads. Chunks are numbered in order so callers can keep per-chunk output
+	// and stitch it back together deterministically. Blocks until all chunks are done.
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t, unsigned int)>& fn)
+	{
+		if (count == 0)
+			return;
+		if (grain == 0)
+			grain = 1;
+		size_t chunkCount = (count + grain - 1) / grain;
+
+		// helpers may only get dequeued after this call returned, so the counters live
+		// on the heap. A late helper finds every chunk claimed and never touches fn.
+		struct State
+		{
+			std::atomic<size_t> nextChunk{ 0 };
+			std::atomic<size_t> running{ 0 };
+		};
+		std::shared_ptr<State> state = std::make_shared<State>();
+		const std::function<void(size_t, size_t, size_t, unsigned int)>* work = &fn;
+		auto body = [state, work, count, grain, chunkCount]()
+		{
+			unsigned int thread = threadIndex();
+			for (;;)
+			{
+				size_t chunk = state->nextChunk.fetch_add(1);
+				if (chunk >= chunkCount)
+					break;
+				size_t begin = chunk * grain;
+				size_t end = begin + grain < count ? begin + grain : count;
+				(*work)(begin, end, chunk, thread);
+			}
+		};
+
+		// no point in waking workers for a single chunk
+		size_t helpers = chunkCount - 1 < workers.size() ? chunkCount - 1 : workers.size();
+		for (size_t i = 0; i < helpers; i++)
+			submit([state, body]() { state->running++; body(); state->running--; });
+		body();
+		// every chunk has been claimed once body() returns here, only wait for the helpers
+		// still inside one. The caller runs all chunks itself if nobody helps, so this
+		// can't deadlock on nested calls without picking up unrelated jobs meanwhile.
+		while (state->running.load() != 0)
+			std::this_thread::yield();
+	}
+
+	// suggested number of chunks for a parallelFor so every thread gets a few
+	size_t suggestedGrain(size_t count, size_t minGrain = 1) const
+	{
+		size_t grain = count / (threadCount() * 4);
+		return grain < minGrain ? minGrain : grain;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::atomic<size_t> pending{ 0 };
+	bool quitting = false;
+
+	static unsigned int& threadIndex()
+	{
+		thread_local unsigned int index = 0;
+		return index;
+	}
+
+	static bool& insideJob()
+	{
+		thread_local bool inside = false;
+		return inside;
+	}
+
+	static void runJob(std::function<void()>& job)
+	{
+		insideJob() = true;
+		job();
+		insideJob() = false;
+	}
+
+	bool runOne()
+	{
+		std::function<void()> job;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (jobs.empty())
+				return false;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		runJob(job);
+		pending--;
+		return true;
+	}
+
+	void workerLoop(unsigned int index)
+	{
+		threadIndex() = index;
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() { return quitting || !jobs.empty(); });
+				if (quitting && jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			runJob(job);
+			pending--;
+		}
+	}
+};
+
+#endif
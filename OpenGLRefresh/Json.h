@@ -0,0 +1,273 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "FastParse.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON reader, enough for glTF and job files. Builds a small DOM; lookups on
+// missing keys/indices return a shared null value so chained access never crashes:
+//   double fov = doc["camera"]["fov"].asNumber(45.0);
+class JsonValue
+{
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	bool isNull() const { return type == Type::Null; }
+	bool isNumber() const { return type == Type::Number; }
+	bool isString() const { return type == Type::String; }
+	bool isArray() const { return type == Type::Array; }
+	bool isObject() const { return type == Type::Object; }
+
+	size_t size() const { return type == Type::Array ? array.size() : (type == Type::Object ? object.size() : 0); }
+
+	bool has(const char* key) const
+	{
+		for (const auto& member : object)
+			if (member.first == key)
+				return true;
+		return false;
+	}
+
+	const JsonValue& operator[](const char* key) const
+	{
+		for (const auto& member : object)
+			if (member.first == key)
+				return member.second;
+		return null();
+	}
+
+	const JsonValue& operator[](size_t index) const
+	{
+		return index < array.size() ? array[index] : null();
+	}
+
+	double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+	float asFloat(float fallback = 0.0f) const { return type == Type::Number ? (float)number : fallback; }
+	int asInt(int fallback = 0) const { return type == Type::Number ? (int)number : fallback; }
+	size_t asSize(size_t fallback = 0) const { return type == Type::Number ? (size_t)number : fallback; }
+	bool asBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+	const std::string& asString() const { return string; }
+
+	static const JsonValue& null()
+	{
+		static const JsonValue value;
+		return value;
+	}
+};
+
+class JsonParser
+{
+public:
+	// parses [begin, end) into 'out', on failure 'error' says what and where
+	static bool parse(const char* begin, const char* end, JsonValue& out, std::string& error)
+	{
+		JsonParser parser(begin, end);
+		if (!parser.value(out, 0))
+		{
+			error = parser.error + " at offset " + std::to_string(parser.p - begin);
+			return false;
+		}
+		parser.skipWhitespace();
+		if (parser.p != end && *parser.p != '\0')
+		{
+			error = "trailing characters at offset " + std::to_string(parser.p - begin);
+			return false;
+		}
+		return true;
+	}
+
+private:
+	const char* p;
+	const char* end;
+	std::string error;
+
+	JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+	void skipWhitespace()
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+			p++;
+	}
+
+	bool fail(const char* message)
+	{
+		error = message;
+		return false;
+	}
+
+	bool literal(const char* word)
+	{
+		size_t length = std::strlen(word);
+		if ((size_t)(end - p) < length || std::memcmp(p, word, length) != 0)
+			return fail("unexpected token");
+		p += length;
+		return true;
+	}
+
+	bool value(JsonValue& out, int depth)
+	{
+		if (depth > 256)
+			return fail("nesting too deep");
+		skipWhitespace();
+		if (p >= end)
+			return fail("unexpected end");
+		switch (*p)
+		{
+		case '{': return objectValue(out, depth);
+		case '[': return arrayValue(out, depth);
+		case '"': out.type = JsonValue::Type::String; return stringValue(out.string);
+		case 't': out.type = JsonValue::Type::Bool; out.boolean = true; return literal("true");
+		case 'f': out.type = JsonValue::Type::Bool; out.boolean = false; return literal("false");
+		case 'n': out.type = JsonValue::Type::Null; return literal("null");
+		default:
+		{
+			const char* next = parseDouble(p, end, out.number);
+			if (!next)
+				return fail("invalid number");
+			out.type = JsonValue::Type::Number;
+			p = next;
+			return true;
+		}
+		}
+	}
+
+	bool objectValue(JsonValue& out, int depth)
+	{
+		out.type = JsonValue::Type::Object;
+		p++;
+		skipWhitespace();
+		if (p < end && *p == '}')
+		{
+			p++;
+			return true;
+		}
+		for (;;)
+		{
+			skipWhitespace();
+			if (p >= end || *p != '"')
+				return fail("expected key");
+			out.object.emplace_back();
+			if (!stringValue(out.object.back().first))
+				return false;
+			skipWhitespace();
+			if (p >= end || *p != ':')
+				return fail("expected ':'");
+			p++;
+			if (!value(out.object.back().second, depth + 1))
+				return false;
+			skipWhitespace();
+			if (p < end && *p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (p < end && *p == '}')
+			{
+				p++;
+				return true;
+			}
+			return fail("expected ',' or '}'");
+		}
+	}
+
+	bool arrayValue(JsonValue& out, int depth)
+	{
+		out.type = JsonValue::Type::Array;
+		p++;
+		skipWhitespace();
+		if (p < end && *p == ']')
+		{
+			p++;
+			return true;
+		}
+		for (;;)
+		{
+			out.array.emplace_back();
+			if (!value(out.array.back(), depth + 1))
+				return false;
+			skipWhitespace();
+			if (p < end && *p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (p < end && *p == ']')
+			{
+				p++;
+				return true;
+			}
+			return fail("expected ',' or ']'");
+		}
+	}
+
+	bool stringValue(std::string& out)
+	{
+		p++; // opening quote
+		while (p < end && *p != '"')
+		{
+			if (*p != '\\')
+			{
+				out += *p++;
+				continue;
+			}
+			if (++p >= end)
+				break;
+			char c = *p++;
+			switch (c)
+			{
+			case 'n': out += '\n'; break;
+			case 't': out += '\t'; break;
+			case 'r': out += '\r'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'u':
+			{
+				if (end - p < 4)
+					return fail("bad unicode escape");
+				unsigned int code = 0;
+				for (int i = 0; i < 4; i++)
+				{
+					char h = *p++;
+					code <<= 4;
+					if (h >= '0' && h <= '9') code |= h - '0';
+					else if (h >= 'a' && h <= 'f') code |= h - 'a' + 10;
+					else if (h >= 'A' && h <= 'F') code |= h - 'A' + 10;
+					else return fail("bad unicode escape");
+				}
+				// utf-8 encode, surrogate pairs are passed through as two code points
+				if (code < 0x80)
+					out += (char)code;
+				else if (code < 0x800)
+				{
+					out += (char)(0xC0 | (code >> 6));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					out += (char)(0xE0 | (code >> 12));
+					out += (char)(0x80 | ((code >> 6) & 0x3F));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default: out += c; break; // \" \\ \/
+			}
+		}
+		if (p >= end)
+			return fail("unterminated string");
+		p++; // closing quote
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <glad/glad.h>
+
+#include "BcEncoder.h"
+#include "GLExtensions.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// compressed formats from EXT_texture_compression_s3tc / RGTC / BPTC, not all of them
+// are in the 3.3 core headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+// Khronos KTX 2.0 container, only what the texture pipeline writes: one 2D image with
+// a mip chain, BCn payload, no supercompression. Levels are stored smallest first as
+// the spec asks, the level index still lists level 0 first.
+namespace ktx2
+{
+	const uint8_t IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	struct Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	inline uint32_t vkFormat(BcFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BcFormat::BC1: return srgb ? 132 : 131; // VK_FORMAT_BC1_RGB_{SRGB,UNORM}_BLOCK
+		case BcFormat::BC3: return srgb ? 138 : 137;
+		case BcFormat::BC5: return 141;              // no sRGB variant
+		default: return srgb ? 146 : 145;
+		}
+	}
+
+	inline bool fromVkFormat(uint32_t vk, BcFormat& format, bool& srgb)
+	{
+		switch (vk)
+		{
+		case 131: case 132: format = BcFormat::BC1; srgb = vk == 132; return true;
+		case 137: case 138: format = BcFormat::BC3; srgb = vk == 138; return true;
+		case 141: format = BcFormat::BC5; srgb = false; return true;
+		case 145: case 146: format = BcFormat::BC7; srgb = vk == 146; return true;
+		default: return false;
+		}
+	}
+
+	inline GLenum glInternalFormat(BcFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BcFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BcFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BcFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		default: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	inline bool glSupports(BcFormat format)
+	{
+		switch (format)
+		{
+		case BcFormat::BC1: case BcFormat::BC3: return glHasExtension("GL_EXT_texture_compression_s3tc");
+		case BcFormat::BC5: return true; // RGTC is core since 3.0
+		default: return glContextVersion() >= 42 || glHasExtension("GL_ARB_texture_compression_bptc");
+		}
+	}
+
+	// basic data format descriptor for a BCn format, see KHR_DF_MODEL_BC*
+	inline std::vector<uint32_t> dataFormatDescriptor(BcFormat format, bool srgb)
+	{
+		struct Sample { uint32_t bitOffset, bitLength, channel; };
+		std::vector<Sample> samples;
+		uint8_t model;
+		switch (format)
+		{
+		case BcFormat::BC1: model = 128; samples.push_back({ 0, 64, 0 }); break;
+		case BcFormat::BC3: model = 130; samples.push_back({ 0, 64, 15 }); samples.push_back({ 64, 64, 0 }); break;
+		case BcFormat::BC5: model = 132; samples.push_back({ 0, 64, 0 }); samples.push_back({ 64, 64, 1 }); break;
+		default: model = 134; samples.push_back({ 0, 128, 0 }); break;
+		}
+		uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+		std::vector<uint32_t> words;
+		words.push_back(4 + blockSize);                 // dfdTotalSize
+		words.push_back(0);                             // vendorId 0 (Khronos), descriptorType 0 (basic)
+		words.push_back(2 | (blockSize << 16));         // versionNumber 2, descriptorBlockSize
+		words.push_back(model | (1u << 8) | ((srgb ? 2u : 1u) << 16)); // primaries BT709, transfer sRGB/linear, flags 0
+		words.push_back(3 | (3u << 8));                 // texel block 4x4x1x1 (stored minus one)
+		words.push_back((uint32_t)bcBlockBytes(format));// bytesPlane0
+		words.push_back(0);
+		for (const Sample& sample : samples)
+		{
+			words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+			words.push_back(0);                         // sample position 0,0,0,0
+			words.push_back(0);                         // sampleLower
+			words.push_back(0xFFFFFFFFu);               // sampleUpper
+		}
+		return words;
+	}
+}
+
+// writes levels[0..n) (level 0 = full size, each already block compressed)
+inline bool writeKtx2(const std::string& path, BcFormat format, bool srgb, int width, int height, const std::vector<std::vector<uint8_t>>& levels)
+{
+	std::vector<uint32_t> dfd = ktx2::dataFormatDescriptor(format, srgb);
+	const char keyValue[] = "KTXwriter\0OpenGLRefresh";
+	uint32_t keyValueLength = (uint32_t)sizeof(keyValue);
+
+	ktx2::Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.identifier, ktx2::IDENTIFIER, 12);
+	header.vkFormat = ktx2::vkFormat(format, srgb);
+	header.typeSize = 1;
+	header.pixelWidth = (uint32_t)width;
+	header.pixelHeight = (uint32_t)height;
+	header.faceCount = 1;
+	header.levelCount = (uint32_t)levels.size();
+	header.dfdByteOffset = (uint32_t)(sizeof(ktx2::Header) + sizeof(ktx2::LevelIndex) * levels.size());
+	header.dfdByteLength = (uint32_t)(dfd.size() * 4);
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = (4 + keyValueLength + 3) & ~3u;
+
+	// level data is aligned to the block size (8 or 16, both multiples of 4)
+	uint64_t alignment = bcBlockBytes(format);
+	uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+	std::vector<ktx2::LevelIndex> index(levels.size());
+	for (size_t l = levels.size(); l-- > 0;)
+	{
+		offset = (offset + alignment - 1) / alignment * alignment;
+		index[l].byteOffset = offset;
+		index[l].byteLength = levels[l].size();
+		index[l].uncompressedByteLength = levels[l].size();
+		offset += levels[l].size();
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::KTX2::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	uint64_t written = 0;
+	auto write = [&](const void* data, size_t size)
+	{
+		file.write((const char*)data, (std::streamsize)size);
+		written += size;
+	};
+	write(&header, sizeof(header));
+	write(index.data(), sizeof(ktx2::LevelIndex) * index.size());
+	write(dfd.data(), dfd.size() * 4);
+	write(&keyValueLength, 4);
+	write(keyValue, keyValueLength);
+	const char zeros[16] = {};
+	write(zeros, header.kvdByteLength - 4 - keyValueLength);
+	for (size_t l = levels.size(); l-- > 0;)
+	{
+		write(zeros, (size_t)(index[l].byteOffset - written));
+		write(levels[l].data(), levels[l].size());
+	}
+	if (!file)
+	{
+		std::cout << "ERROR::KTX2::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// mapped .ktx2 as written above, upload() creates the GL texture straight from the mapping
+class Ktx2Texture
+{
+public:
+	bool load(const std::string& path)
+	{
+		MappedFile mapped;
+		if (!mapped.open(path))
+			return false;
+		return load(std::move(mapped), path);
+	}
+
+	bool load(MappedFile&& mapped, const std::string& path)
+	{
+		file = std::move(mapped);
+		name = path;
+		if (file.size() < sizeof(ktx2::Header) || std::memcmp(file.data(), ktx2::IDENTIFIER, 12) != 0)
+			return fail("not a KTX2 file");
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (!ktx2::fromVkFormat(header.vkFormat, bcFormat, srgb))
+			return fail("unsupported vkFormat " + std::to_string(header.vkFormat));
+		if (header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+			return fail("only plain 2D textures are supported");
+		uint32_t levels = std::max(1u, header.levelCount);
+		if (sizeof(ktx2::Header) + sizeof(ktx2::LevelIndex) * (uint64_t)levels > file.size())
+			return fail("truncated");
+		index.resize(levels);
+		std::memcpy(index.data(), file.data() + sizeof(ktx2::Header), sizeof(ktx2::LevelIndex) * levels);
+		for (uint32_t l = 0; l < levels; l++)
+		{
+			uint64_t expected = (uint64_t)((levelWidth(l) + 3) / 4) * ((levelHeight(l) + 3) / 4) * bcBlockBytes(bcFormat);
+			if (index[l].byteOffset > file.size() || index[l].byteLength > file.size() - index[l].byteOffset || index[l].byteLength != expected)
+				return fail("level " + std::to_string(l) + " out of bounds");
+		}
+		return true;
+	}
+
+	BcFormat format() const { return bcFormat; }
+	bool isSrgb() const { return srgb; }
+	int width() const { return (int)header.pixelWidth; }
+	int height() const { return (int)header.pixelHeight; }
+	int levelCount() const { return (int)index.size(); }
+	int levelWidth(uint32_t level) const { return std::max(1, (int)(header.pixelWidth >> level)); }
+	int levelHeight(uint32_t level) const { return std::max(1, (int)(header.pixelHeight >> level)); }
+	const uint8_t* levelData(uint32_t level) const { return file.data() + index[level].byteOffset; }
+	size_t levelSize(uint32_t level) const { return (size_t)index[level].byteLength; }
+	const std::string& path() const { return name; }
+
+	// what a level takes on the GPU, RGBA8 when the driver lacks the format
+	size_t levelVramBytes(uint32_t level) const
+	{
+		return ktx2::glSupports(bcFormat) ? levelSize(level) : (size_t)levelWidth(level) * levelHeight(level) * 4;
+	}
+
+	size_t dataSize() const
+	{
+		size_t total = 0;
+		for (const ktx2::LevelIndex& level : index)
+			total += (size_t)level.byteLength;
+		return total;
+	}
+
+	// GL texture with all levels. Without driver support for the format the blocks are
+	// decoded on the CPU and uploaded as RGBA8, which costs the VRAM savings but works.
+	unsigned int upload() const
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		if (!ktx2::glSupports(bcFormat))
+			std::cout << "ERROR::KTX2::FORMAT_NOT_SUPPORTED " << bcFormatName(bcFormat) << " decoding " << name << " on the CPU" << std::endl;
+		for (int l = 0; l < levelCount(); l++)
+			uploadLevel(l);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+
+	// one level into the texture bound to GL_TEXTURE_2D
+	void uploadLevel(int level) const
+	{
+		if (ktx2::glSupports(bcFormat))
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx2::glInternalFormat(bcFormat, srgb), levelWidth(level), levelHeight(level), 0, (GLsizei)levelSize(level), levelData(level));
+		else
+		{
+			std::vector<uint8_t> rgba = bcDecodeImage(levelData(level), levelWidth(level), levelHeight(level), bcFormat);
+			glTexImage2D(GL_TEXTURE_2D, level, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, levelWidth(level), levelHeight(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+		}
+	}
+
+private:
+	MappedFile file;
+	std::string name;
+	ktx2::Header header = {};
+	std::vector<ktx2::LevelIndex> index;
+	BcFormat bcFormat = BcFormat::BC7;
+	bool srgb = false;
+
+	bool fail(const std::string& why)
+	{
+		std::cout << "ERROR::KTX2::LOAD_FAILED " << name << ": " << why << std::endl;
+		file.close();
+		return false;
+	}
+};
+
+#endif
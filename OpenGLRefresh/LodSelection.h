@@ -0,0 +1,133 @@
+#ifndef LOD_SELECTION_H
+#define LOD_SELECTION_H
+
+#include <glm/glm.hpp>
+
+#include "BakedMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// LOD chain of one arena mesh, as baked: every LOD indexes the same vertices and lives
+// in the mesh's indices at 'firstIndex'. An empty chain draws the mesh as uploaded.
+struct MeshLodChain
+{
+	std::vector<BakedLod> lods;
+	float errorScale = 1.0f; // LOD errors into the object's model space (the node scale)
+};
+
+// what an object currently draws; during a cross-fade 'previous' is drawn too and
+// 'fade' runs from 0 to 1 as the new LOD takes over
+struct LodState
+{
+	int lod = 0;
+	int previous = -1;
+	float fade = 1.0f;
+};
+
+// Picks the coarsest LOD whose simplification error projects to less than 'pixelError'
+// pixels. Switching to a coarser LOD needs the error 'hysteresis' below the limit, going
+// finer happens as soon as the current one is over it, so an object sitting at the
+// threshold does not flip between two LODs every frame.
+class LodSelector
+{
+public:
+	float pixelError = 1.0f;
+	float hysteresis = 0.25f;
+	bool crossFade = false;
+	float fadeSeconds = 0.25f;
+
+	// for the material shaders' base defines: shader.fs then takes 'lodFade' and dithers
+	static std::string shaderDefines() { return "#define LOD_CROSSFADE 1\n"; }
+
+	// size in pixels of 'worldError' at 'distance' with a vertical field of view 'fovY'
+	static float projectedPixels(float worldError, float distance, float fovY, float screenHeight)
+	{
+		return worldError / (std::max(distance, 1e-4f) * 2.0f * std::tan(fovY * 0.5f)) * screenHeight;
+	}
+
+	// largest scale a model matrix applies to a length
+	static float maxScale(const glm::mat4& m)
+	{
+		return std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+	}
+
+	// 'scale' takes the chain's model space to world space, 'distance' is from the camera
+	// to the nearest point of the object's bounding sphere
+	int select(const MeshLodChain& chain, float scale, float distance, float fovY, float screenHeight, int current) const
+	{
+		for (int lod = (int)chain.lods.size() - 1; lod > 0; lod--)
+		{
+			float pixels = projectedPixels(chain.lods[lod].error * chain.errorScale * scale, distance, fovY, screenHeight);
+			if (pixels <= (lod > current ? pixelError * (1.0f - hysteresis) : pixelError))
+				return lod;
+		}
+		return 0;
+	}
+
+	// moves 'state' to 'lod', starting a cross-fade from the old one when enabled
+	void update(LodState& state, int lod, float deltaTime) const
+	{
+		if (lod != state.lod)
+		{
+			state.previous = crossFade ? state.lod : -1;
+			state.fade = crossFade ? 0.0f : 1.0f;
+			state.lod = lod;
+		}
+		else if (state.previous >= 0)
+		{
+			state.fade += deltaTime / fadeSeconds;
+			if (state.fade >= 1.0f)
+			{
+				state.previous = -1;
+				state.fade = 1.0f;
+			}
+		}
+	}
+};
+
+// triangles drawn against what full detail would have drawn, summed over frames
+struct LodStats
+{
+	uint64_t frames = 0;
+	uint64_t objects = 0;
+	uint64_t fading = 0;
+	uint64_t triangles = 0;
+	uint64_t fullTriangles = 0;
+	uint64_t histogram[BAKED_MESH_MAX_LODS] = {};
+
+	void count(const MeshLodChain& chain, const LodState& state)
+	{
+		objects++;
+		histogram[state.lod]++;
+		fullTriangles += chain.lods[0].indexCount / 3;
+		triangles += chain.lods[state.lod].indexCount / 3;
+		if (state.previous >= 0)
+		{
+			fading++;
+			triangles += chain.lods[state.previous].indexCount / 3;
+		}
+	}
+
+	void print() const
+	{
+		if (frames == 0 || objects == 0)
+		{
+			std::cout << "LOD: no objects with LODs drawn" << std::endl;
+			return;
+		}
+		std::cout << "LOD: " << triangles / frames << " of " << fullTriangles / frames << " triangles per frame ("
+			<< 100.0 * (double)triangles / (double)fullTriangles << "%), " << 100.0 * (double)fading / (double)objects
+			<< "% of draws cross-fading" << std::endl;
+		std::cout << "  LOD histogram:";
+		for (uint32_t lod = 0; lod < BAKED_MESH_MAX_LODS; lod++)
+			std::cout << " " << 100.0 * (double)histogram[lod] / (double)objects << "%";
+		std::cout << std::endl;
+	}
+};
+
+#endif
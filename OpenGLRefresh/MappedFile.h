@@ -0,0 +1,149 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. The loaders parse straight out of the
+// mapping so nothing is copied into an intermediate buffer first; the OS pages the
+// file in on demand. Move-only, unmapped in the destructor.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	explicit MappedFile(const std::string& path) { open(path); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			bytes = other.bytes;
+			length = other.length;
+			valid = other.valid;
+#ifdef _WIN32
+			file = other.file;
+			mapping = other.mapping;
+			other.file = INVALID_HANDLE_VALUE;
+			other.mapping = NULL;
+#endif
+			other.bytes = nullptr;
+			other.length = 0;
+			other.valid = false;
+		}
+		return *this;
+	}
+
+	bool open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return fail(path);
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+			return fail(path);
+		length = (size_t)size.QuadPart;
+		valid = true;
+		if (length == 0)
+			return true;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return fail(path);
+		bytes = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (bytes == nullptr)
+			return fail(path);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return fail(path);
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return fail(path);
+		}
+		length = (size_t)st.st_size;
+		if (length > 0)
+		{
+			void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view == MAP_FAILED)
+			{
+				::close(fd);
+				return fail(path);
+			}
+			madvise(view, length, MADV_SEQUENTIAL);
+			bytes = (const uint8_t*)view;
+		}
+		::close(fd); // the mapping keeps the file alive
+#endif
+		valid = true;
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes)
+			UnmapViewOfFile(bytes);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes)
+			munmap((void*)bytes, length);
+#endif
+		bytes = nullptr;
+		length = 0;
+		valid = false;
+	}
+
+	bool isOpen() const { return valid; }
+	const uint8_t* data() const { return bytes; }
+	const char* chars() const { return (const char*)bytes; }
+	size_t size() const { return length; }
+
+private:
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+	bool valid = false;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+
+	bool fail(const std::string& path)
+	{
+		std::cout << "ERROR::MAPPED_FILE::OPEN_FAILED " << path << std::endl;
+		close();
+		return false;
+	}
+};
+
+#endif
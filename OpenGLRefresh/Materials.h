@@ -0,0 +1,321 @@
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "AssetCache.h"
+#include "BindlessTextures.h"
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Materials are plain parameter blocks packed into one uniform buffer and indexed by
+// material id in the shader. Switching materials between draws then costs no uniform
+// calls: the id rides along in the model matrix (see packMaterialIndex). What differs
+// in code (texture or not, how many lights, shadows) is a #define permutation of
+// shader.vs/shader.fs, compiled once per distinct set of defines.
+
+// must match MAX_MATERIALS in the shaders, 48 * 256 bytes stays below the 16 KB
+// every GL 3.3 driver allows for a uniform block
+const int MAX_MATERIALS = 256;
+const GLuint MATERIAL_BLOCK_BINDING = 0;
+const int MATERIAL_DIFFUSE_UNIT = 0;
+const int MATERIAL_SHADOW_UNIT = 1;
+
+struct Material
+{
+	glm::vec3 color = glm::vec3(1.0f);
+	float ambient = 0.2f;
+	float specular = 0.8f;
+	float shininess = 32.0f;
+	int texture = -1; // texture slot of the scene, -1 is untextured
+};
+
+// where a textured material's texture lives, depends on the texture path in use
+enum class MaterialTextureSource
+{
+	Bound2D,  // plain texture bound per draw (streamed or raw)
+	Array,    // layer (or atlas rectangle) of a TextureArrays array, array bound per draw
+	Bindless  // index into a BindlessTextureTable, nothing bound
+};
+
+struct MaterialTexture
+{
+	unsigned int texture = 0; // what gets bound to MATERIAL_DIFFUSE_UNIT, 0 for bindless
+	float layer = 0.0f;
+	glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	int bindlessIndex = -1;
+};
+
+// everything that changes the shader code, one program per distinct set
+struct ShaderPermutation
+{
+	bool textured = false;
+	MaterialTextureSource source = MaterialTextureSource::Bound2D;
+	int lights = 1;
+	bool shadows = false;
+
+	std::string defines() const
+	{
+		std::string defines;
+		if (textured && source == MaterialTextureSource::Bindless)
+			defines += BindlessTextureTable::shaderDefines();
+		if (textured)
+			defines += "#define TEXTURED 1\n";
+		if (textured && source == MaterialTextureSource::Array)
+			defines += "#define TEXTURE_ARRAYS 1\n";
+		defines += "#define LIGHT_COUNT " + std::to_string(lights) + "\n";
+		if (shadows)
+			defines += "#define SHADOWS 1\n";
+		defines += "#define MAX_MATERIALS " + std::to_string(MAX_MATERIALS) + "\n";
+		return defines;
+	}
+};
+
+// the shader reads the index back out of the bottom row of the model matrix, which is
+// always (0, 0, 0, 1) for the affine transforms used here
+inline glm::mat4 packMaterialIndex(glm::mat4 model, int material)
+{
+	model[0][3] = (float)std::max(material, 0);
+	return model;
+}
+
+// one compiled permutation and the uniforms the renderer sets on it every frame
+struct MaterialProgram
+{
+	unsigned int id = 0;
+	ShaderPermutation permutation;
+	int model = -1;
+	int view = -1;
+	int projection = -1;
+	int viewPos = -1;
+	int lightPositions = -1;
+	int lightColors = -1;
+	int lightSpace = -1;
+	int lodFade = -1;
+	int normalMatrix = -1;
+};
+
+// compiles the permutations of one vertex/fragment pair on demand. Identical define sets
+// share a program, and through the asset cache later launches load the binaries.
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(const std::string& vertexPath, const std::string& fragmentPath, const std::string& baseDefines, AssetCache* cache)
+		: vertexPath(vertexPath), fragmentPath(fragmentPath), baseDefines(baseDefines), cache(cache) {}
+	~ShaderPermutations() { release(); }
+
+	// index into programs()
+	int find(const ShaderPermutation& permutation)
+	{
+		requests++;
+		std::string defines = permutation.defines() + baseDefines;
+		auto it = lookup.find(defines);
+		if (it != lookup.end())
+			return it->second;
+
+		MaterialProgram program;
+		build(permutation, program);
+		programList.push_back(program);
+		int index = (int)programList.size() - 1;
+		lookup[defines] = index;
+		dependencies.set(index, files);
+		return index;
+	}
+
+	// rebuilds the programs that use one of 'changedFiles' (see ShaderSourceCache::pollChanges).
+	// A program that doesn't link keeps its last working version. True if any changed.
+	bool reload(const std::vector<std::string>& changedFiles)
+	{
+		bool reloaded = false;
+		for (int index : dependencies.affected(changedFiles))
+		{
+			MaterialProgram program;
+			if (!build(programList[index].permutation, program))
+			{
+				std::cout << "ERROR::SHADER::RELOAD_FAILED keeping the old " << fragmentPath << " permutation " << index << std::endl;
+				glDeleteProgram(program.id);
+				continue;
+			}
+			glDeleteProgram(programList[index].id);
+			programList[index] = program;
+			dependencies.set(index, files);
+			reloaded = true;
+		}
+		if (reloaded)
+			std::cout << "Reloaded shaders after changes to " << changedFiles.size() << " files" << std::endl;
+		return reloaded;
+	}
+
+	const std::vector<MaterialProgram>& programs() const { return programList; }
+	const MaterialProgram& program(int index) const { return programList[index]; }
+
+	void printStats() const
+	{
+		const ShaderSourceCache::Stats& sources = ShaderSourceCache::shared().statistics();
+		std::cout << "Shader permutations of " << fragmentPath << ": " << programList.size() << " programs for " << requests << " requests, "
+			<< compileSeconds * 1000.0 << " ms to build, " << sources.reads << " source files read, " << sources.hits << " include cache hits" << std::endl;
+	}
+
+	void release()
+	{
+		for (const MaterialProgram& program : programList)
+			glDeleteProgram(program.id);
+		programList.clear();
+		lookup.clear();
+		dependencies = ShaderDependencies();
+	}
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string baseDefines;
+	AssetCache* cache;
+	std::vector<MaterialProgram> programList;
+	std::map<std::string, int> lookup;
+	ShaderDependencies dependencies;
+	std::vector<std::string> files; // sources of the last build()
+	size_t requests = 0;
+	double compileSeconds = 0.0;
+
+	// false if the program didn't link, its id still has to be deleted
+	bool build(const ShaderPermutation& permutation, MaterialProgram& program)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		Shader shader(vertexPath.c_str(), fragmentPath.c_str(), permutation.defines() + baseDefines, cache);
+		compileSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		files = shader.files;
+
+		program.id = shader.ID;
+		program.permutation = permutation;
+		program.model = shader.location("model");
+		program.view = shader.location("view");
+		program.projection = shader.location("projection");
+		program.viewPos = shader.location("viewPos");
+		program.lightPositions = shader.location("lightPositions");
+		program.lightColors = shader.location("lightColors");
+		program.lightSpace = shader.location("lightSpace");
+		program.lodFade = shader.location("lodFade");
+		program.normalMatrix = shader.location("normalMatrix");
+
+		// fixed bindings, set once here instead of every frame. SPIR-V has them in the
+		// shader already and doesn't have to know the block's name.
+		if (!Shader::linkedFromSpirv(shader.ID))
+		{
+			GLuint block = glGetUniformBlockIndex(shader.ID, "Materials");
+			if (block != GL_INVALID_INDEX)
+				glUniformBlockBinding(shader.ID, block, MATERIAL_BLOCK_BINDING);
+		}
+		shader.use();
+		shader.setInt(permutation.source == MaterialTextureSource::Array ? "diffuseArray" : "diffuseMap", MATERIAL_DIFFUSE_UNIT);
+		shader.setInt("shadowMap", MATERIAL_SHADOW_UNIT);
+
+		GLint linked = 0;
+		glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+		return linked != 0;
+	}
+};
+
+// all materials of the scene and their uniform buffer
+class MaterialLibrary
+{
+public:
+	~MaterialLibrary() { release(); }
+
+	// returns the material id, -1 when the buffer is full
+	int add(const Material& material, const MaterialTexture& texture = MaterialTexture())
+	{
+		if ((int)materials.size() >= MAX_MATERIALS)
+		{
+			std::cout << "ERROR::MATERIALS::TOO_MANY only " << MAX_MATERIALS << " fit the uniform block" << std::endl;
+			return -1;
+		}
+		materials.push_back(material);
+		textures.push_back(texture);
+		dirty = true;
+		return (int)materials.size() - 1;
+	}
+
+	int count() const { return (int)materials.size(); }
+	const Material& material(int id) const { return materials[id]; }
+	const MaterialTexture& texture(int id) const { return textures[id]; }
+
+	// changes land in the buffer with the next upload(), no program is touched
+	void set(int id, const Material& material)
+	{
+		materials[id] = material;
+		dirty = true;
+	}
+
+	ShaderPermutation permutation(int id, MaterialTextureSource source, int lights, bool shadows) const
+	{
+		ShaderPermutation permutation;
+		permutation.textured = materials[id].texture >= 0;
+		permutation.source = source;
+		permutation.lights = lights;
+		permutation.shadows = shadows;
+		return permutation;
+	}
+
+	// packs everything into the std140 layout of MaterialData in shader.fs
+	void upload()
+	{
+		if (!dirty)
+			return;
+		std::vector<GpuMaterial> packed(materials.size());
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			const Material& m = materials[i];
+			packed[i].colorAmbient = glm::vec4(m.color, m.ambient);
+			packed[i].uvRect = textures[i].uvRect;
+			packed[i].params = glm::vec4(m.specular, m.shininess, textures[i].layer, (float)textures[i].bindlessIndex);
+		}
+		if (buffer == 0)
+		{
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(GpuMaterial), NULL, GL_DYNAMIC_DRAW);
+		}
+		else
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, packed.size() * sizeof(GpuMaterial), packed.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		dirty = false;
+	}
+
+	void bind() const
+	{
+		if (buffer != 0)
+			glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, buffer);
+	}
+
+	void release()
+	{
+		if (buffer != 0)
+			glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		dirty = !materials.empty();
+	}
+
+private:
+	struct GpuMaterial
+	{
+		glm::vec4 colorAmbient; // rgb color, ambient strength
+		glm::vec4 uvRect;       // offset xy, scale zw
+		glm::vec4 params;       // specular strength, shininess, array layer, bindless index
+	};
+
+	std::vector<Material> materials;
+	std::vector<MaterialTexture> textures;
+	unsigned int buffer = 0;
+	bool dirty = false;
+};
+
+#endif
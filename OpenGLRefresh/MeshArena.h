@@ -0,0 +1,566 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Two level segregated fit allocator (TLSF) working on abstract units. It only keeps
+// the bookkeeping, the memory it hands out lives somewhere else (a GL buffer here).
+// Allocation and free are O(1): the first level splits sizes by power of two, the
+// second level splits each power of two into 16 linear classes, and two bitmaps
+// point straight at a non-empty free list.
+class TlsfAllocator
+{
+public:
+	static const uint32_t INVALID = 0xFFFFFFFFu;
+
+	struct Stats
+	{
+		size_t capacity = 0;
+		size_t used = 0;
+		size_t freeTotal = 0;
+		size_t largestFree = 0;
+		size_t freeBlocks = 0;
+		size_t usedBlocks = 0;
+		// 0 when all free space is one block, close to 1 when it's scattered in crumbs
+		float fragmentation() const { return freeTotal ? 1.0f - (float)largestFree / (float)freeTotal : 0.0f; }
+		float utilization() const { return capacity ? (float)used / (float)capacity : 0.0f; }
+	};
+
+	explicit TlsfAllocator(size_t capacity = 0)
+	{
+		for (uint32_t fl = 0; fl < FL_COUNT; fl++)
+			for (uint32_t sl = 0; sl < SL_COUNT; sl++)
+				freeHeads[fl][sl] = INVALID;
+		if (capacity > 0)
+			grow(capacity);
+	}
+
+	// returns a block handle or INVALID when nothing big enough is free
+	uint32_t allocate(size_t size, uint32_t owner = 0)
+	{
+		if (size == 0)
+			size = 1;
+		uint32_t fl, sl;
+		mappingSearch(size, fl, sl);
+		uint32_t block = findSuitable(fl, sl);
+		if (block == INVALID)
+			return INVALID;
+		removeFree(block);
+
+		// hand back the tail so it can be used for something else
+		if (blocks[block].size > size)
+		{
+			uint32_t rest = newBlock();
+			blocks[rest].offset = blocks[block].offset + size;
+			blocks[rest].size = blocks[block].size - size;
+			blocks[rest].prevPhys = block;
+			blocks[rest].nextPhys = blocks[block].nextPhys;
+			if (blocks[block].nextPhys != INVALID)
+				blocks[blocks[block].nextPhys].prevPhys = rest;
+			else
+				lastBlock = rest;
+			blocks[block].nextPhys = rest;
+			blocks[block].size = size;
+			insertFree(rest);
+		}
+		blocks[block].used = true;
+		blocks[block].owner = owner;
+		used += blocks[block].size;
+		return block;
+	}
+
+	void free(uint32_t block)
+	{
+		if (block == INVALID || !blocks[block].used)
+			return;
+		used -= blocks[block].size;
+		blocks[block].used = false;
+
+		uint32_t next = blocks[block].nextPhys;
+		if (next != INVALID && !blocks[next].used)
+		{
+			removeFree(next);
+			absorbNext(block);
+		}
+		uint32_t prev = blocks[block].prevPhys;
+		if (prev != INVALID && !blocks[prev].used)
+		{
+			removeFree(prev);
+			absorbNext(prev);
+			block = prev;
+		}
+		insertFree(block);
+	}
+
+	// adds space at the end, merging it with a trailing free block
+	void grow(size_t newCapacity)
+	{
+		if (newCapacity <= capacity)
+			return;
+		size_t extra = newCapacity - capacity;
+		if (lastBlock != INVALID && !blocks[lastBlock].used)
+		{
+			removeFree(lastBlock);
+			blocks[lastBlock].size += extra;
+			insertFree(lastBlock);
+		}
+		else
+		{
+			uint32_t block = newBlock();
+			blocks[block].offset = capacity;
+			blocks[block].size = extra;
+			blocks[block].prevPhys = lastBlock;
+			if (lastBlock != INVALID)
+				blocks[lastBlock].nextPhys = block;
+			else
+				firstBlock = block;
+			lastBlock = block;
+			insertFree(block);
+		}
+		capacity = newCapacity;
+	}
+
+	size_t offset(uint32_t block) const { return blocks[block].offset; }
+	size_t size(uint32_t block) const { return blocks[block].size; }
+	uint32_t owner(uint32_t block) const { return blocks[block].owner; }
+	bool isUsed(uint32_t block) const { return blocks[block].used; }
+	uint32_t last() const { return lastBlock; }
+	uint32_t previous(uint32_t block) const { return blocks[block].prevPhys; }
+	size_t totalCapacity() const { return capacity; }
+
+	Stats stats() const
+	{
+		Stats s;
+		s.capacity = capacity;
+		s.used = used;
+		for (uint32_t b = firstBlock; b != INVALID; b = blocks[b].nextPhys)
+		{
+			if (blocks[b].used)
+				s.usedBlocks++;
+			else
+			{
+				s.freeBlocks++;
+				s.freeTotal += blocks[b].size;
+				if (blocks[b].size > s.largestFree)
+					s.largestFree = blocks[b].size;
+			}
+		}
+		return s;
+	}
+
+private:
+	static const uint32_t SL_BITS = 4;
+	static const uint32_t SL_COUNT = 1u << SL_BITS;
+	static const uint32_t FL_COUNT = 64 - SL_BITS + 1;
+
+	struct Block
+	{
+		size_t offset = 0;
+		size_t size = 0;
+		uint32_t prevPhys = INVALID;
+		uint32_t nextPhys = INVALID;
+		uint32_t prevFree = INVALID;
+		uint32_t nextFree = INVALID;
+		uint32_t owner = 0;
+		bool used = false;
+	};
+
+	std::vector<Block> blocks;
+	std::vector<uint32_t> unusedSlots;
+	uint32_t freeHeads[FL_COUNT][SL_COUNT];
+	uint64_t flBitmap = 0;
+	uint32_t slBitmap[FL_COUNT] = {};
+	uint32_t firstBlock = INVALID;
+	uint32_t lastBlock = INVALID;
+	size_t capacity = 0;
+	size_t used = 0;
+
+	static uint32_t highestBit(uint64_t v)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, v);
+		return (uint32_t)index;
+#else
+		return 63 - (uint32_t)__builtin_clzll(v);
+#endif
+	}
+
+	static uint32_t lowestBit(uint64_t v)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, v);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctzll(v);
+#endif
+	}
+
+	static void mapping(size_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size < SL_COUNT)
+		{
+			fl = 0;
+			sl = (uint32_t)size;
+			return;
+		}
+		uint32_t msb = highestBit(size);
+		fl = msb - SL_BITS + 1;
+		sl = (uint32_t)(size >> (msb - SL_BITS)) - SL_COUNT;
+	}
+
+	// rounds up to the next class so every block in the list found is big enough
+	static void mappingSearch(size_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size >= SL_COUNT)
+			size += ((size_t)1 << (highestBit(size) - SL_BITS)) - 1;
+		mapping(size, fl, sl);
+	}
+
+	uint32_t findSuitable(uint32_t fl, uint32_t sl) const
+	{
+		if (fl >= FL_COUNT)
+			return INVALID;
+		uint32_t slMap = slBitmap[fl] & (~0u << sl);
+		if (slMap == 0)
+		{
+			uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+			if (flMap == 0)
+				return INVALID;
+			fl = lowestBit(flMap);
+			slMap = slBitmap[fl];
+		}
+		return freeHeads[fl][lowestBit(slMap)];
+	}
+
+	void insertFree(uint32_t block)
+	{
+		uint32_t fl, sl;
+		mapping(blocks[block].size, fl, sl);
+		blocks[block].prevFree = INVALID;
+		blocks[block].nextFree = freeHeads[fl][sl];
+		if (freeHeads[fl][sl] != INVALID)
+			blocks[freeHeads[fl][sl]].prevFree = block;
+		freeHeads[fl][sl] = block;
+		flBitmap |= 1ull << fl;
+		slBitmap[fl] |= 1u << sl;
+	}
+
+	void removeFree(uint32_t block)
+	{
+		uint32_t fl, sl;
+		mapping(blocks[block].size, fl, sl);
+		Block& b = blocks[block];
+		if (b.prevFree != INVALID)
+			blocks[b.prevFree].nextFree = b.nextFree;
+		else
+			freeHeads[fl][sl] = b.nextFree;
+		if (b.nextFree != INVALID)
+			blocks[b.nextFree].prevFree = b.prevFree;
+		if (freeHeads[fl][sl] == INVALID)
+		{
+			slBitmap[fl] &= ~(1u << sl);
+			if (slBitmap[fl] == 0)
+				flBitmap &= ~(1ull << fl);
+		}
+		b.prevFree = b.nextFree = INVALID;
+	}
+
+	// merges the physical successor into 'block' and recycles its slot
+	void absorbNext(uint32_t block)
+	{
+		uint32_t next = blocks[block].nextPhys;
+		blocks[block].size += blocks[next].size;
+		blocks[block].nextPhys = blocks[next].nextPhys;
+		if (blocks[next].nextPhys != INVALID)
+			blocks[blocks[next].nextPhys].prevPhys = block;
+		else
+			lastBlock = block;
+		blocks[next] = Block();
+		unusedSlots.push_back(next);
+	}
+
+	uint32_t newBlock()
+	{
+		if (!unusedSlots.empty())
+		{
+			uint32_t slot = unusedSlots.back();
+			unusedSlots.pop_back();
+			return slot;
+		}
+		blocks.push_back(Block());
+		return (uint32_t)blocks.size() - 1;
+	}
+};
+
+// how the attributes of one vertex format are laid out in the arena's vertex buffer
+struct VertexAttribute
+{
+	GLuint location;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	GLuint offset;
+};
+
+struct VertexLayout
+{
+	GLsizei stride = 0;
+	std::vector<VertexAttribute> attributes;
+
+	// expects the VAO and the vertex buffer to be bound
+	void apply() const
+	{
+		for (const VertexAttribute& a : attributes)
+		{
+			glVertexAttribPointer(a.location, a.components, a.type, a.normalized, stride, (void*)(uintptr_t)a.offset);
+			glEnableVertexAttribArray(a.location);
+		}
+	}
+};
+
+// All meshes of one vertex format share a single vertex buffer, index buffer and VAO.
+// Meshes are drawn with base vertex draws so indices stay relative to the mesh and
+// allocations can be moved around by defragment() without touching the index data.
+class MeshArena
+{
+public:
+	struct DrawParams
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t baseVertex;
+	};
+
+	struct Stats
+	{
+		TlsfAllocator::Stats vertices;
+		TlsfAllocator::Stats indices;
+		size_t meshes = 0;
+		size_t bytesMoved = 0; // by defragment() since the last resetMoveCounter()
+	};
+
+	MeshArena(const VertexLayout& layout, size_t vertexCapacity = 1 << 16, size_t indexCapacity = 1 << 18)
+		: layout(layout), vertexAllocator(vertexCapacity), indexAllocator(indexCapacity)
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexCapacity * layout.stride, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(uint32_t), NULL, GL_STATIC_DRAW);
+		layout.apply();
+		glBindVertexArray(0);
+	}
+
+	~MeshArena() { release(); }
+
+	// deletes the GL objects, call before the context goes away
+	void release()
+	{
+		if (VAO == 0)
+			return;
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		VAO = VBO = EBO = 0;
+	}
+
+	MeshArena(const MeshArena&) = delete;
+	MeshArena& operator=(const MeshArena&) = delete;
+
+	// copies the mesh into the shared buffers, returns a mesh id or -1
+	int upload(const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+	{
+		int mesh = newMesh();
+		uint32_t vertexBlock = allocateOrGrow(vertexAllocator, vertexCount, (uint32_t)mesh, GL_ARRAY_BUFFER);
+		uint32_t indexBlock = allocateOrGrow(indexAllocator, indexCount, (uint32_t)mesh, GL_ELEMENT_ARRAY_BUFFER);
+		if (vertexBlock == TlsfAllocator::INVALID || indexBlock == TlsfAllocator::INVALID)
+		{
+			std::cout << "ERROR::MESH_ARENA::OUT_OF_MEMORY" << std::endl;
+			vertexAllocator.free(vertexBlock);
+			indexAllocator.free(indexBlock);
+			freeMeshes.push_back(mesh);
+			return -1;
+		}
+		meshes[mesh] = { vertexBlock, indexBlock, (uint32_t)indexCount, true };
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, vertexAllocator.offset(vertexBlock) * layout.stride, vertexCount * layout.stride, vertices);
+		// the element buffer binding is VAO state, go through the copy target instead
+		glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, indexAllocator.offset(indexBlock) * sizeof(uint32_t), indexCount * sizeof(uint32_t), indices);
+		return mesh;
+	}
+
+	void release(int mesh)
+	{
+		if (mesh < 0 || mesh >= (int)meshes.size() || !meshes[mesh].alive)
+			return;
+		vertexAllocator.free(meshes[mesh].vertexBlock);
+		indexAllocator.free(meshes[mesh].indexBlock);
+		meshes[mesh].alive = false;
+		freeMeshes.push_back(mesh);
+	}
+
+	DrawParams drawParams(int mesh) const
+	{
+		const Mesh& m = meshes[mesh];
+		return { (uint32_t)indexAllocator.offset(m.indexBlock), m.indexCount, (int32_t)vertexAllocator.offset(m.vertexBlock) };
+	}
+
+	GLuint vao() const { return VAO; }
+	GLuint vertexBuffer() const { return VBO; }
+	GLuint indexBuffer() const { return EBO; }
+	const VertexLayout& vertexLayout() const { return layout; }
+
+	// Moves allocations from the end of the buffers into free space further in front,
+	// at most byteBudget bytes per call so the caller can spread it over frames. The copies
+	// are queued on the GPU after the draws already submitted, so nothing stalls.
+	void defragment(size_t byteBudget)
+	{
+		size_t moved = compact(vertexAllocator, VBO, layout.stride, byteBudget, true);
+		if (moved < byteBudget)
+			compact(indexAllocator, EBO, sizeof(uint32_t), byteBudget - moved, false);
+	}
+
+	Stats stats() const
+	{
+		Stats s;
+		s.vertices = vertexAllocator.stats();
+		s.indices = indexAllocator.stats();
+		s.meshes = meshes.size() - freeMeshes.size();
+		s.bytesMoved = bytesMoved;
+		return s;
+	}
+
+	void resetMoveCounter() { bytesMoved = 0; }
+
+	void printStats() const
+	{
+		Stats s = stats();
+		std::cout << "MeshArena: " << s.meshes << " meshes, vertices " << s.vertices.used << "/" << s.vertices.capacity
+			<< " (" << (int)(s.vertices.utilization() * 100.0f) << "% used, " << (int)(s.vertices.fragmentation() * 100.0f) << "% fragmented), indices "
+			<< s.indices.used << "/" << s.indices.capacity << " (" << (int)(s.indices.utilization() * 100.0f) << "% used, "
+			<< (int)(s.indices.fragmentation() * 100.0f) << "% fragmented), " << s.bytesMoved / 1024 << " KB moved" << std::endl;
+	}
+
+private:
+	struct Mesh
+	{
+		uint32_t vertexBlock;
+		uint32_t indexBlock;
+		uint32_t indexCount;
+		bool alive;
+	};
+
+	VertexLayout layout;
+	TlsfAllocator vertexAllocator;
+	TlsfAllocator indexAllocator;
+	std::vector<Mesh> meshes;
+	std::vector<int> freeMeshes;
+	unsigned int VAO = 0, VBO = 0, EBO = 0;
+	size_t bytesMoved = 0;
+
+	int newMesh()
+	{
+		if (!freeMeshes.empty())
+		{
+			int mesh = freeMeshes.back();
+			freeMeshes.pop_back();
+			return mesh;
+		}
+		meshes.push_back(Mesh());
+		return (int)meshes.size() - 1;
+	}
+
+	// doubles the buffer until the allocation fits, the old contents are copied over on the GPU
+	uint32_t allocateOrGrow(TlsfAllocator& allocator, size_t count, uint32_t owner, GLenum target)
+	{
+		uint32_t block = allocator.allocate(count, owner);
+		while (block == TlsfAllocator::INVALID)
+		{
+			size_t oldCapacity = allocator.totalCapacity();
+			size_t newCapacity = oldCapacity * 2 > oldCapacity + count ? oldCapacity * 2 : oldCapacity + count * 2;
+			size_t unit = target == GL_ARRAY_BUFFER ? layout.stride : sizeof(uint32_t);
+			GLuint& buffer = target == GL_ARRAY_BUFFER ? VBO : EBO;
+
+			GLuint bigger;
+			glGenBuffers(1, &bigger);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+			glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * unit, NULL, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity * unit);
+			glDeleteBuffers(1, &buffer);
+			buffer = bigger;
+
+			// point the shared VAO at the new buffer
+			glBindVertexArray(VAO);
+			if (target == GL_ARRAY_BUFFER)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, VBO);
+				layout.apply();
+			}
+			else
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBindVertexArray(0);
+
+			allocator.grow(newCapacity);
+			block = allocator.allocate(count, owner);
+		}
+		return block;
+	}
+
+	size_t compact(TlsfAllocator& allocator, GLuint buffer, size_t unit, size_t byteBudget, bool vertices)
+	{
+		size_t moved = 0;
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		uint32_t block = allocator.last();
+		while (block != TlsfAllocator::INVALID && moved < byteBudget)
+		{
+			uint32_t prev = allocator.previous(block);
+			if (!allocator.isUsed(block))
+			{
+				block = prev;
+				continue;
+			}
+			size_t count = allocator.size(block);
+			uint32_t owner = allocator.owner(block);
+			uint32_t target = allocator.allocate(count, owner);
+			if (target == TlsfAllocator::INVALID)
+				break;
+			if (allocator.offset(target) > allocator.offset(block))
+			{
+				// the allocator found nothing in front of it, everything before is packed enough
+				allocator.free(target);
+				break;
+			}
+			// source and destination are distinct blocks, so the ranges never overlap
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocator.offset(block) * unit, allocator.offset(target) * unit, count * unit);
+			if (vertices)
+				meshes[owner].vertexBlock = target;
+			else
+				meshes[owner].indexBlock = target;
+			// freeing may merge 'prev' into a bigger block, so walk from the end again
+			allocator.free(block);
+			moved += count * unit;
+			block = allocator.last();
+		}
+		bytesMoved += moved;
+		return moved;
+	}
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <glm/glm.hpp>
+
+#include "BakedMesh.h"
+#include "GltfLoader.h"
+#include "JobSystem.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplify.h"
+#include "ObjLoader.h"
+#include "VertexFormat.h"
+
+#include <string>
+#include <vector>
+
+// bump when the import changes what ends up in a baked mesh, cached bakes of the
+// old importer are then ignored
+const uint32_t MESH_IMPORTER_VERSION = 4;
+
+// LOD0 is the source mesh, the simplified LODs follow it in the same index blob; their
+// errors are in the space of the source positions like the simplifier measures them.
+// The meshlets split LOD0, with bounds in that space as well.
+inline BakeMeshInput makeBakeInput(const VertexStreams& streams, const uint32_t* indices, size_t indexCount, const glm::mat4& transform, const VertexFormat& format,
+	size_t maxLods = BAKED_MESH_MAX_LODS, bool meshlets = true)
+{
+	BakeMeshInput mesh;
+	mesh.vertices = encodeVertices(streams, format);
+	mesh.transform = transform;
+	mesh.indices.assign(indices, indices + indexCount);
+	BakedLod lod0 = { 0, (uint32_t)indexCount, 0.0f, 0 };
+	mesh.lods.push_back(lod0);
+	if (maxLods > 1)
+		for (SimplifiedLod& simplified : simplifyLodChain(streams.positions, streams.positionStride, streams.count, indices, indexCount, std::min<size_t>(maxLods, BAKED_MESH_MAX_LODS) - 1))
+		{
+			BakedLod lod = { (uint32_t)mesh.indices.size(), (uint32_t)simplified.indices.size(), simplified.error, 0 };
+			mesh.indices.insert(mesh.indices.end(), simplified.indices.begin(), simplified.indices.end());
+			mesh.lods.push_back(lod);
+		}
+	if (meshlets)
+	{
+		MeshletBuildResult built = buildMeshlets(streams, indices, indexCount);
+		mesh.meshlets = std::move(built.meshlets);
+		mesh.meshletVertices = std::move(built.vertices);
+		mesh.meshletTriangles = std::move(built.triangles);
+	}
+	return mesh;
+}
+
+// OBJ/glTF into encoded meshes with their LOD chains (maxLods 1 keeps only the source)
+// and meshlets, shared by MeshBake and the viewer's cache; glTF primitives are processed
+// in parallel
+inline bool importMeshFile(const std::string& path, const VertexFormat& format, JobSystem* jobs, std::vector<BakeMeshInput>& out, LoadStats* stats = nullptr,
+	size_t maxLods = BAKED_MESH_MAX_LODS, bool meshlets = true)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	if (extension == "obj" || extension == "OBJ")
+	{
+		MeshData mesh;
+		if (!ObjLoader::load(path, mesh, jobs, stats))
+			return false;
+		if (mesh.normals.empty())
+			mesh.generateNormals();
+		out.push_back(makeBakeInput(mesh.streams(), mesh.indices.data(), mesh.indices.size(), glm::mat4(1.0f), format, maxLods, meshlets));
+		return true;
+	}
+
+	GltfModel model;
+	if (!model.load(path, jobs, stats))
+		return false;
+	size_t first = out.size();
+	out.resize(first + model.primitives.size());
+	auto bake = [&](size_t begin, size_t end, size_t, unsigned int)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const GltfPrimitive& primitive = model.primitives[i];
+			// NORMAL is optional, without it the primitive is smooth shaded like an OBJ
+			VertexStreams streams = primitive.streams;
+			std::vector<float> normals;
+			if (!streams.normals)
+			{
+				generateSmoothNormals(streams.positions, streams.positionStride, streams.count, primitive.indices, primitive.indexCount, normals);
+				streams.normals = normals.data();
+				streams.normalStride = 3;
+			}
+			out[first + i] = makeBakeInput(streams, primitive.indices, primitive.indexCount, primitive.transform, format, maxLods, meshlets);
+		}
+	};
+	if (jobs)
+		jobs->parallelFor(model.primitives.size(), 1, bake);
+	else
+		bake(0, model.primitives.size(), 0, 0);
+	return true;
+}
+
+// what a cache key has to include besides the source bytes, with the arguments the
+// import gets
+inline std::string meshImportSettings(const VertexFormat& format, size_t maxLods = BAKED_MESH_MAX_LODS, bool meshlets = true)
+{
+	return "bmesh" + std::to_string(BAKED_MESH_VERSION) + " pos" + std::to_string((int)format.position)
+		+ " nrm" + std::to_string((int)format.normal) + " uv" + std::to_string((int)format.uv)
+		+ " lods" + std::to_string(std::min<size_t>(maxLods, BAKED_MESH_MAX_LODS))
+		+ (meshlets ? " meshlets" + std::to_string(MESHLET_MAX_VERTICES) + "/" + std::to_string(MESHLET_MAX_TRIANGLES) : std::string());
+}
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Quadric error mesh simplification (Garland & Heckbert) by half edge collapses: a vertex
+// is merged into a neighbour and never moved, so every LOD indexes the original vertex
+// buffer and a whole chain only costs index data.
+//
+// Vertices with the same position (UV and normal seams) collapse as one. Seam and border
+// vertices are only ever collapsed onto, never moved, which keeps the silhouette of open
+// meshes and the texture seams in place at the price of simplifying less along them.
+// Each vertex accumulates the area weighted plane quadrics of the original triangles
+// around it; the cost of a collapse is the mean squared distance of the merged vertex to
+// those planes. Collapses run in passes: all edges sorted by cost, then the cheapest ones
+// that don't share a vertex with one already taken this pass and don't flip a triangle.
+//
+// The chain is one run of collapses, snapshotted whenever the triangle count reaches the
+// next target, so every LOD is measured against the original mesh.
+struct SimplifiedLod
+{
+	std::vector<uint32_t> indices;
+	float error; // object space, the square root of the highest collapse cost so far: an area weighted RMS plane distance
+};
+
+namespace meshsimplify
+{
+	// symmetric 4x4 matrix of the squared plane distance, plus the weight it was built with
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0, weight = 0;
+
+		void addPlane(const glm::dvec3& n, double d, double w)
+		{
+			a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+			b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+			c2 += w * n.z * n.z; cd += w * n.z * d;
+			d2 += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd; d2 += q.d2; weight += q.weight;
+		}
+
+		double evaluate(const glm::dvec3& p) const
+		{
+			double e = a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+				+ b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+				+ c2 * p.z * p.z + 2.0 * cd * p.z + d2;
+			return std::max(e, 0.0);
+		}
+	};
+
+	struct Edge
+	{
+		uint32_t from, to; // position ids, 'from' disappears
+		double cost;
+	};
+}
+
+// 'positions' has 'positionStride' floats per vertex. Returns at most 'maxLods' LODs after
+// the original, each about 'reduction' times the triangles of the one before; the chain
+// ends early when a LOD would have fewer than 'minTriangles' or collapsing stalls.
+inline std::vector<SimplifiedLod> simplifyLodChain(const float* positions, size_t positionStride, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, size_t maxLods, float reduction = 0.5f, size_t minTriangles = 64)
+{
+	using namespace meshsimplify;
+	std::vector<SimplifiedLod> chain;
+	size_t triangleCount = indexCount / 3;
+	if (maxLods == 0 || triangleCount * reduction < minTriangles)
+		return chain;
+
+	// one id per distinct position, the wedges of a seam share it
+	struct PositionKey
+	{
+		float x, y, z;
+		bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+	};
+	struct PositionHash
+	{
+		size_t operator()(const PositionKey& k) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &k, sizeof(bits));
+			return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+		}
+	};
+	std::unordered_map<PositionKey, uint32_t, PositionHash> lookup;
+	std::vector<uint32_t> positionOf(vertexCount);
+	std::vector<glm::dvec3> points;
+	std::vector<uint32_t> wedgeCount;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const float* p = positions + v * positionStride;
+		auto inserted = lookup.emplace(PositionKey{ p[0], p[1], p[2] }, (uint32_t)points.size());
+		if (inserted.second)
+		{
+			points.push_back(glm::dvec3(p[0], p[1], p[2]));
+			wedgeCount.push_back(0);
+		}
+		positionOf[v] = inserted.first->second;
+		wedgeCount[positionOf[v]]++;
+	}
+	size_t pointCount = points.size();
+
+	// live triangles keep their original vertex indices, adjacency is per position
+	std::vector<uint32_t> triangles(indices, indices + triangleCount * 3);
+	std::vector<uint8_t> alive(triangleCount, 1);
+	std::vector<std::vector<uint32_t>> around(pointCount);
+	std::vector<Quadric> quadrics(pointCount);
+	size_t live = 0;
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	auto edgeKey = [](uint32_t a, uint32_t b) { return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a; };
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t p0 = positionOf[triangles[t * 3]], p1 = positionOf[triangles[t * 3 + 1]], p2 = positionOf[triangles[t * 3 + 2]];
+		if (p0 == p1 || p1 == p2 || p0 == p2)
+		{
+			alive[t] = 0;
+			continue;
+		}
+		live++;
+		glm::dvec3 n = glm::cross(points[p1] - points[p0], points[p2] - points[p0]);
+		double length = glm::length(n);
+		if (length > 0.0)
+		{
+			n /= length;
+			Quadric q;
+			q.addPlane(n, -glm::dot(n, points[p0]), length * 0.5);
+			for (uint32_t p : { p0, p1, p2 })
+				quadrics[p].add(q);
+		}
+		for (uint32_t p : { p0, p1, p2 })
+			around[p].push_back((uint32_t)t);
+		edgeUses[edgeKey(p0, p1)]++;
+		edgeUses[edgeKey(p1, p2)]++;
+		edgeUses[edgeKey(p2, p0)]++;
+	}
+
+	// seams and open or non-manifold edges stay where they are
+	std::vector<uint8_t> locked(pointCount, 0);
+	for (size_t p = 0; p < pointCount; p++)
+		locked[p] = wedgeCount[p] > 1;
+	for (const auto& use : edgeUses)
+		if (use.second != 2)
+		{
+			locked[(uint32_t)(use.first >> 32)] = 1;
+			locked[(uint32_t)use.first] = 1;
+		}
+
+	auto cornerOf = [&](size_t t, uint32_t p) -> int
+	{
+		for (int c = 0; c < 3; c++)
+			if (positionOf[triangles[t * 3 + c]] == p)
+				return c;
+		return -1;
+	};
+
+	// the wedge of 'to' the triangles of 'from' switch to, -1 if the two triangles of the
+	// edge disagree (the collapse would tear a seam)
+	auto targetWedge = [&](uint32_t from, uint32_t to) -> int64_t
+	{
+		int64_t wedge = -1;
+		for (uint32_t t : around[from])
+		{
+			if (!alive[t])
+				continue;
+			int corner = cornerOf(t, to);
+			if (corner < 0)
+				continue;
+			uint32_t vertex = triangles[t * 3 + corner];
+			if (wedge >= 0 && wedge != vertex)
+				return -1;
+			wedge = vertex;
+		}
+		return wedge;
+	};
+
+	// no triangle around 'from' may turn over or degenerate when it moves onto 'to'
+	auto flips = [&](uint32_t from, uint32_t to)
+	{
+		for (uint32_t t : around[from])
+		{
+			if (!alive[t] || cornerOf(t, to) >= 0)
+				continue;
+			glm::dvec3 corner[3], moved[3];
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t p = positionOf[triangles[t * 3 + c]];
+				corner[c] = points[p];
+				moved[c] = p == from ? points[to] : points[p];
+			}
+			glm::dvec3 before = glm::cross(corner[1] - corner[0], corner[2] - corner[0]);
+			glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after))
+				return true;
+		}
+		return false;
+	};
+
+	// the two ends may only share the third corners of the triangles on the edge, a further
+	// common neighbour would pinch the surface into a non-manifold edge
+	std::vector<uint32_t> mark(pointCount, 0);
+	uint32_t stamp = 0;
+	auto pinches = [&](uint32_t from, uint32_t to)
+	{
+		stamp++;
+		size_t onEdge = 0, shared = 0;
+		for (uint32_t t : around[from])
+		{
+			if (!alive[t])
+				continue;
+			onEdge += cornerOf(t, to) >= 0;
+			for (int c = 0; c < 3; c++)
+				mark[positionOf[triangles[t * 3 + c]]] = stamp;
+		}
+		mark[from] = mark[to] = 0;
+		for (uint32_t t : around[to])
+			for (int c = 0; alive[t] && c < 3; c++)
+			{
+				uint32_t p = positionOf[triangles[t * 3 + c]];
+				if (mark[p] == stamp)
+				{
+					mark[p] = 0;
+					shared++;
+				}
+			}
+		return shared > onEdge;
+	};
+
+	auto snapshot = [&](double error)
+	{
+		SimplifiedLod lod;
+		lod.error = (float)std::sqrt(error);
+		for (size_t t = 0; t < triangleCount; t++)
+			if (alive[t])
+				lod.indices.insert(lod.indices.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+		chain.push_back(std::move(lod));
+	};
+
+	double maxError = 0.0;
+	size_t target = (size_t)(live * reduction);
+	size_t lastSnapshot = live;
+	std::vector<Edge> edges;
+	std::vector<uint8_t> touched(pointCount);
+	while (chain.size() < maxLods && target >= minTriangles)
+	{
+		edges.clear();
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t])
+				continue;
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t a = positionOf[triangles[t * 3 + c]], b = positionOf[triangles[t * 3 + (c + 1) % 3]];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					uint32_t from = direction ? b : a, to = direction ? a : b;
+					if (locked[from])
+						continue;
+					Quadric q = quadrics[from];
+					q.add(quadrics[to]);
+					edges.push_back({ from, to, q.weight > 0.0 ? q.evaluate(points[to]) / q.weight : 0.0 });
+				}
+			}
+		}
+		std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.cost < b.cost || (a.cost == b.cost && (a.from < b.from || (a.from == b.from && a.to < b.to))); });
+
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t collapsed = 0;
+		for (const Edge& edge : edges)
+		{
+			if (live <= target)
+				break;
+			if (touched[edge.from] || touched[edge.to] || pinches(edge.from, edge.to) || flips(edge.from, edge.to))
+				continue;
+			int64_t wedge = targetWedge(edge.from, edge.to);
+			if (wedge < 0)
+				continue;
+			for (uint32_t t : around[edge.from])
+			{
+				if (!alive[t])
+					continue;
+				if (cornerOf(t, edge.to) >= 0)
+				{
+					alive[t] = 0;
+					live--;
+					continue;
+				}
+				triangles[t * 3 + cornerOf(t, edge.from)] = (uint32_t)wedge;
+				around[edge.to].push_back(t);
+			}
+			around[edge.from].clear();
+			quadrics[edge.to].add(quadrics[edge.from]);
+			maxError = std::max(maxError, edge.cost);
+			touched[edge.from] = touched[edge.to] = 1;
+			collapsed++;
+		}
+
+		if (live <= target)
+		{
+			snapshot(maxError);
+			lastSnapshot = live;
+			target = (size_t)(live * reduction);
+		}
+		else if (collapsed == 0)
+		{
+			// stuck on seams and borders; keep what was reached if it is worth a LOD
+			if (live < lastSnapshot * 0.8)
+				snapshot(maxError);
+			break;
+		}
+	}
+	return chain;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <glm/glm.hpp>
+
+#include "BakedMesh.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Meshlets (clusters) of at most 64 vertices and 124 triangles: the limits of the mesh
+// shader hardware path, small enough that a cluster faces one way and covers a small part
+// of the screen, so culling them one by one removes work a whole mesh test can't.
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// The builder grows a meshlet from the triangles around the vertices it already has,
+// preferring the ones that add the fewest new vertices, and starts the next meshlet where
+// the index order continues. Bounds are in the space of the source positions (like LOD
+// errors): a sphere around the vertices and the cone of the triangle normals.
+//
+// The cone test follows the usual formulation: every triangle of a meshlet faces away from
+// a camera at 'eye' when dot(center - eye, axis) >= cutoff * length(center - eye) + radius,
+// where cutoff is the sine of the cone's half angle. Meshlets whose normals spread over
+// more than ~84 degrees get a cutoff of 1 and are never culled that way.
+struct MeshletBuildResult
+{
+	std::vector<BakedMeshlet> meshlets;
+	std::vector<uint32_t> vertices;  // mesh vertex of each meshlet vertex
+	std::vector<uint8_t> triangles;  // three meshlet vertex numbers per triangle
+};
+
+inline void computeMeshletBounds(const VertexStreams& streams, const MeshletBuildResult& result, BakedMeshlet& meshlet)
+{
+	auto position = [&](uint32_t local)
+	{
+		const float* p = streams.positions + result.vertices[meshlet.vertexOffset + local] * streams.positionStride;
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	glm::vec3 lo(position(0)), hi(position(0));
+	for (uint32_t v = 1; v < meshlet.vertexCount; v++)
+	{
+		lo = glm::min(lo, position(v));
+		hi = glm::max(hi, position(v));
+	}
+	glm::vec3 center = (lo + hi) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		radius = std::max(radius, glm::length(position(v) - center));
+
+	std::vector<glm::vec3> normals;
+	glm::vec3 sum(0.0f);
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+	{
+		const uint8_t* triangle = &result.triangles[meshlet.triangleOffset + t * 3];
+		glm::vec3 n = glm::cross(position(triangle[1]) - position(triangle[0]), position(triangle[2]) - position(triangle[0]));
+		float length = glm::length(n);
+		if (length <= 0.0f)
+			continue;
+		normals.push_back(n / length);
+		sum += n / length;
+	}
+	glm::vec3 axis(0.0f, 0.0f, 1.0f);
+	float cutoff = 1.0f;
+	if (glm::length(sum) > 0.0f && !normals.empty())
+	{
+		axis = glm::normalize(sum);
+		float minDot = 1.0f;
+		for (const glm::vec3& n : normals)
+			minDot = std::min(minDot, glm::dot(axis, n));
+		if (minDot > 0.1f)
+			cutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		meshlet.center[i] = center[i];
+		meshlet.coneAxis[i] = axis[i];
+	}
+	meshlet.radius = radius;
+	meshlet.coneCutoff = cutoff;
+}
+
+inline MeshletBuildResult buildMeshlets(const VertexStreams& streams, const uint32_t* indices, size_t indexCount,
+	size_t maxVertices = MESHLET_MAX_VERTICES, size_t maxTriangles = MESHLET_MAX_TRIANGLES)
+{
+	MeshletBuildResult result;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return result;
+
+	// triangles around each vertex
+	std::vector<uint32_t> firstAround(streams.count + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		firstAround[indices[i] + 1]++;
+	for (size_t v = 0; v < streams.count; v++)
+		firstAround[v + 1] += firstAround[v];
+	std::vector<uint32_t> around(triangleCount * 3);
+	std::vector<uint32_t> fill(firstAround.begin(), firstAround.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		around[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+	std::vector<uint8_t> used(triangleCount, 0);
+	std::vector<int> local(streams.count, -1); // meshlet vertex of a mesh vertex, -1 outside
+	BakedMeshlet meshlet = {};
+	auto flush = [&]()
+	{
+		if (meshlet.triangleCount == 0)
+			return;
+		computeMeshletBounds(streams, result, meshlet);
+		result.meshlets.push_back(meshlet);
+		for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+			local[result.vertices[meshlet.vertexOffset + v]] = -1;
+		meshlet = BakedMeshlet();
+		meshlet.vertexOffset = (uint32_t)result.vertices.size();
+		meshlet.triangleOffset = (uint32_t)result.triangles.size();
+	};
+	auto newVertices = [&](size_t t)
+	{
+		return (local[indices[t * 3]] < 0) + (local[indices[t * 3 + 1]] < 0) + (local[indices[t * 3 + 2]] < 0);
+	};
+
+	size_t next = 0; // first triangle in index order that may be unused
+	for (size_t placed = 0; placed < triangleCount; placed++)
+	{
+		// the neighbour adding the fewest vertices, else where the index order continues
+		size_t best = triangleCount;
+		int bestNew = 4;
+		for (uint32_t v = 0; v < meshlet.vertexCount && bestNew > 0; v++)
+		{
+			uint32_t vertex = result.vertices[meshlet.vertexOffset + v];
+			for (uint32_t a = firstAround[vertex]; a < firstAround[vertex + 1]; a++)
+			{
+				uint32_t t = around[a];
+				int added = used[t] ? 4 : newVertices(t);
+				if (added < bestNew)
+				{
+					best = t;
+					bestNew = added;
+				}
+			}
+		}
+		if (best == triangleCount)
+		{
+			while (used[next])
+				next++;
+			best = next;
+			bestNew = newVertices(best);
+		}
+		if (meshlet.vertexCount + bestNew > maxVertices || meshlet.triangleCount + 1 > maxTriangles)
+		{
+			flush();
+			if (bestNew < 3)
+			{
+				// the neighbour was picked for the old meshlet, start fresh in index order
+				while (used[next])
+					next++;
+				best = next;
+			}
+		}
+
+		used[best] = 1;
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t vertex = indices[best * 3 + c];
+			if (local[vertex] < 0)
+			{
+				local[vertex] = (int)meshlet.vertexCount++;
+				result.vertices.push_back(vertex);
+			}
+			result.triangles.push_back((uint8_t)local[vertex]);
+		}
+		meshlet.triangleCount++;
+	}
+	flush();
+	return result;
+}
+
+#endif
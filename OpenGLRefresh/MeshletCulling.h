@@ -0,0 +1,337 @@
+#ifndef MESHLET_CULLING_H
+#define MESHLET_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BakedMesh.h"
+#include "JobSystem.h"
+#include "MeshArena.h"
+#include "OcclusionCulling.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// the meshlets of one mesh as loaded, before they go into a MeshletCuller.
+// 'boundsToVertices' takes the space of the bounds (the source positions) into the space
+// of the vertices as stored, which the draws' model matrices start from.
+struct MeshletSource
+{
+	std::vector<BakedMeshlet> meshlets;
+	std::vector<uint32_t> vertices;
+	std::vector<uint8_t> triangles;
+	glm::mat4 boundsToVertices = glm::mat4(1.0f);
+};
+
+// inverse of EncodedVertices::dequantizeMatrix() for a mesh with these bounds
+inline glm::mat4 meshletBoundsToVertices(bool quantized, const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+{
+	if (!quantized)
+		return glm::mat4(1.0f);
+	glm::vec3 extent = aabbMax - aabbMin;
+	for (int i = 0; i < 3; i++)
+		extent[i] = extent[i] > 0.0f ? 1.0f / extent[i] : 1.0f;
+	return glm::translate(glm::scale(glm::mat4(1.0f), extent), -aabbMin);
+}
+
+struct MeshletStats
+{
+	uint64_t frames = 0;
+	uint64_t draws = 0;
+	uint64_t clusters = 0;
+	uint64_t frustumCulled = 0;
+	uint64_t backfacing = 0;
+	uint64_t occluded = 0;
+	uint64_t triangles = 0;      // of the draws queued
+	uint64_t drawnTriangles = 0; // in the compacted index buffer
+	double cullMs = 0.0;         // testing and compaction
+};
+
+// Cluster culling of meshes split into meshlets at bake time. The clusters of all draws
+// queued for a frame are tested on the job system against the frustum, their normal cone
+// (every triangle facing away) and the occlusion culler's Hi-Z. The indices of the
+// survivors are compacted into one index buffer streamed through a StreamBuffer, so each
+// draw is a single draw call over its part of that buffer, whatever survived.
+// Cone culling assumes the model matrix keeps the winding (no mirroring); mirrored draws
+// skip it.
+class MeshletCuller
+{
+public:
+	struct Range
+	{
+		uint32_t firstIndex; // into the compacted index buffer
+		uint32_t indexCount;
+	};
+
+	bool coneCulling = true;
+	bool occlusionCulling = true; // with the OcclusionCuller given to cull()
+
+	~MeshletCuller() { release(); }
+
+	// copies the clusters of one mesh; the indices they draw are expanded right away, the
+	// per frame compaction is then a plain copy
+	int addMesh(const MeshletSource& source)
+	{
+		Mesh mesh;
+		mesh.firstCluster = (uint32_t)clusters.size();
+		mesh.clusterCount = (uint32_t)source.meshlets.size();
+		mesh.boundsToVertices = source.boundsToVertices;
+		for (const BakedMeshlet& meshlet : source.meshlets)
+		{
+			Cluster cluster;
+			cluster.center = glm::vec3(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+			cluster.radius = meshlet.radius;
+			cluster.coneAxis = glm::vec3(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+			cluster.coneCutoff = meshlet.coneCutoff;
+			cluster.firstIndex = (uint32_t)indices.size();
+			cluster.indexCount = meshlet.triangleCount * 3;
+			for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++)
+				indices.push_back(source.vertices[meshlet.vertexOffset + source.triangles[meshlet.triangleOffset + i]]);
+			clusters.push_back(cluster);
+			mesh.triangles += meshlet.triangleCount;
+		}
+		meshes.push_back(mesh);
+		return (int)meshes.size() - 1;
+	}
+
+	void beginFrame()
+	{
+		draws.clear();
+		ranges.clear();
+	}
+
+	// queues 'mesh' drawn with 'model', the number returned picks its range() after cull()
+	int add(int mesh, const glm::mat4& model)
+	{
+		Draw draw;
+		draw.mesh = mesh;
+		draw.boundsModel = model * meshes[mesh].boundsToVertices;
+		draws.push_back(draw);
+		return (int)draws.size() - 1;
+	}
+
+	void cull(const glm::mat4& viewProjection, const glm::vec3& eye, const OcclusionCuller* occlusion, JobSystem* jobs = nullptr)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		glm::vec4 planes[6];
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+			glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+			planes[i * 2] = w + row;
+			planes[i * 2 + 1] = w - row;
+		}
+		for (glm::vec4& plane : planes)
+			plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+
+		// the camera in the space of the bounds, where the cones are
+		std::vector<uint32_t> drawClusters(draws.size() + 1, 0);
+		for (size_t d = 0; d < draws.size(); d++)
+		{
+			Draw& draw = draws[d];
+			const glm::mat4& m = draw.boundsModel;
+			draw.eye = glm::vec3(glm::inverse(m) * glm::vec4(eye, 1.0f));
+			draw.radiusScale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+			draw.mirrored = glm::dot(glm::cross(glm::vec3(m[0]), glm::vec3(m[1])), glm::vec3(m[2])) < 0.0f;
+			drawClusters[d + 1] = drawClusters[d] + meshes[draw.mesh].clusterCount;
+			stats.triangles += meshes[draw.mesh].triangles;
+		}
+		size_t total = drawClusters.back();
+		results.assign(total, Visible);
+
+		auto test = [&](size_t first, size_t last, size_t, unsigned int)
+		{
+			size_t d = std::upper_bound(drawClusters.begin(), drawClusters.end(), (uint32_t)first) - drawClusters.begin() - 1;
+			for (size_t k = first; k < last; k++)
+			{
+				while (k >= drawClusters[d + 1])
+					d++;
+				const Draw& draw = draws[d];
+				const Cluster& cluster = clusters[meshes[draw.mesh].firstCluster + (k - drawClusters[d])];
+				glm::vec3 center = glm::vec3(draw.boundsModel * glm::vec4(cluster.center, 1.0f));
+				float radius = cluster.radius * draw.radiusScale;
+				bool outside = false;
+				for (const glm::vec4& plane : planes)
+					outside |= glm::dot(glm::vec3(plane), center) + plane.w < -radius;
+				if (outside)
+				{
+					results[k] = OutsideFrustum;
+					continue;
+				}
+				glm::vec3 toCluster = cluster.center - draw.eye;
+				if (coneCulling && !draw.mirrored && cluster.coneCutoff < 1.0f
+					&& glm::dot(toCluster, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCluster) + cluster.radius)
+				{
+					results[k] = Backfacing;
+					continue;
+				}
+				if (occlusion && occlusionCulling)
+				{
+					glm::mat4 box = glm::translate(draw.boundsModel, cluster.center - glm::vec3(cluster.radius));
+					box = glm::scale(box, glm::vec3(cluster.radius * 2.0f));
+					if (occlusion->test(box) == OcclusionResult::Occluded)
+						results[k] = Occluded;
+				}
+			}
+		};
+
+		// where each surviving cluster's indices go
+		size_t grain = jobs ? jobs->suggestedGrain(total, 64) : total;
+		if (jobs)
+			jobs->parallelFor(total, grain, test);
+		else
+			test(0, total, 0, 0);
+		offsets.resize(total);
+		ranges.resize(draws.size());
+		uint32_t written = 0;
+		for (size_t d = 0; d < draws.size(); d++)
+		{
+			ranges[d].firstIndex = written;
+			const Mesh& mesh = meshes[draws[d].mesh];
+			for (uint32_t c = 0; c < mesh.clusterCount; c++)
+			{
+				size_t k = drawClusters[d] + c;
+				offsets[k] = written;
+				if (results[k] == Visible)
+					written += clusters[mesh.firstCluster + c].indexCount;
+				else
+					(results[k] == OutsideFrustum ? stats.frustumCulled : results[k] == Backfacing ? stats.backfacing : stats.occluded)++;
+			}
+			ranges[d].indexCount = written - ranges[d].firstIndex;
+		}
+
+		if (written > 0)
+		{
+			size_t offset = 0;
+			uint32_t* mapped = (uint32_t*)stream.map(written * sizeof(uint32_t), sizeof(uint32_t), offset);
+			if (mapped)
+			{
+				auto copy = [&](size_t first, size_t last, size_t, unsigned int)
+				{
+					size_t d = std::upper_bound(drawClusters.begin(), drawClusters.end(), (uint32_t)first) - drawClusters.begin() - 1;
+					for (size_t k = first; k < last; k++)
+					{
+						while (k >= drawClusters[d + 1])
+							d++;
+						if (results[k] != Visible)
+							continue;
+						const Cluster& cluster = clusters[meshes[draws[d].mesh].firstCluster + (k - drawClusters[d])];
+						std::copy(indices.begin() + cluster.firstIndex, indices.begin() + cluster.firstIndex + cluster.indexCount, mapped + offsets[k]);
+					}
+				};
+				if (jobs)
+					jobs->parallelFor(total, grain, copy);
+				else
+					copy(0, total, 0, 0);
+				stream.unmap();
+			}
+			for (Range& range : ranges)
+				range.firstIndex += (uint32_t)(offset / sizeof(uint32_t));
+		}
+
+		stats.frames++;
+		stats.draws += draws.size();
+		stats.clusters += total;
+		stats.drawnTriangles += written / 3;
+		stats.cullMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	}
+
+	const Range& range(int draw) const { return ranges[draw]; }
+
+	// VAO with the arena's vertices and the compacted indices, call after cull(): both
+	// buffers can be replaced when they grow
+	GLuint vao(const MeshArena& arena)
+	{
+		if (VAO == 0)
+			glGenVertexArrays(1, &VAO);
+		if (boundVertices != arena.vertexBuffer() || boundIndices != stream.id())
+		{
+			glBindVertexArray(VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, arena.vertexBuffer());
+			arena.vertexLayout().apply();
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream.id());
+			glBindVertexArray(0);
+			boundVertices = arena.vertexBuffer();
+			boundIndices = stream.id();
+		}
+		return VAO;
+	}
+
+	// call once the frame's draws are submitted
+	void endFrame() { stream.endFrame(); }
+
+	const MeshletStats& statistics() const { return stats; }
+
+	void printStats() const
+	{
+		double frames = (double)std::max<uint64_t>(stats.frames, 1);
+		double clusterCount = (double)std::max<uint64_t>(stats.clusters, 1);
+		const StreamBuffer::Stats& upload = stream.statistics();
+		std::printf("Meshlet culling (%s, averages over %llu frames):\n", coneCulling ? "frustum, cone, hi-z" : "frustum, hi-z", (unsigned long long)stats.frames);
+		std::printf("  draws %.1f, clusters %.1f: outside the frustum %.1f%%, backfacing %.1f%%, occluded %.1f%%\n", stats.draws / frames, stats.clusters / frames,
+			100.0 * stats.frustumCulled / clusterCount, 100.0 * stats.backfacing / clusterCount, 100.0 * stats.occluded / clusterCount);
+		std::printf("  triangles %.0f of %.0f drawn (%.1f%% culled), culling %.3f ms per frame\n", stats.drawnTriangles / frames, stats.triangles / frames,
+			stats.triangles ? 100.0 * (1.0 - (double)stats.drawnTriangles / (double)stats.triangles) : 0.0, stats.cullMs / frames);
+		std::printf("  indices streamed %.1f KB per frame, ring %zu KB, %llu waits (%.3f ms), %llu grows\n", upload.bytes / frames / 1024.0, stream.size() / 1024,
+			(unsigned long long)upload.waits, upload.waitMs, (unsigned long long)upload.grows);
+	}
+
+	void release()
+	{
+		if (VAO != 0)
+			glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+		boundVertices = boundIndices = 0;
+		stream.release();
+	}
+
+private:
+	enum Result : uint8_t { Visible, OutsideFrustum, Backfacing, Occluded };
+
+	struct Cluster
+	{
+		glm::vec3 center;
+		float radius;
+		glm::vec3 coneAxis;
+		float coneCutoff;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	struct Mesh
+	{
+		uint32_t firstCluster = 0;
+		uint32_t clusterCount = 0;
+		uint64_t triangles = 0;
+		glm::mat4 boundsToVertices = glm::mat4(1.0f);
+	};
+
+	struct Draw
+	{
+		int mesh;
+		glm::mat4 boundsModel;
+		glm::vec3 eye;
+		float radiusScale;
+		bool mirrored;
+	};
+
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> indices; // relative to the mesh's vertices, like the arena's
+	std::vector<Mesh> meshes;
+	std::vector<Draw> draws;
+	std::vector<Range> ranges;
+	std::vector<uint8_t> results;
+	std::vector<uint32_t> offsets;
+	StreamBuffer stream;
+	MeshletStats stats;
+	GLuint VAO = 0;
+	GLuint boundVertices = 0;
+	GLuint boundIndices = 0;
+};
+
+#endif
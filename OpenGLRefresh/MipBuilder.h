@@ -0,0 +1,511 @@
+#ifndef MIP_BUILDER_H
+#define MIP_BUILDER_H
+
+#include <glad/glad.h>
+
+#include "Image.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#define MIP_BUILDER_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIP_AVX2_FUNCTION
+#else
+#define MIP_AVX2_FUNCTION __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// CPU mip chains filtered in linear light. Averaging the stored sRGB bytes (what a box
+// filter on the bytes and glGenerateMipmap on an RGBA8 texture do) darkens every level
+// of diffuse textures, so color goes sRGB -> linear float -> filter -> sRGB. Alpha and
+// linear textures (normal maps) are filtered as stored.
+//
+// Every level is a separable 2:1 downsample of the one above it, either a box or a
+// Kaiser windowed sinc (sharper, less aliasing). Levels depend on each other and run in
+// order, each one split into row tiles for the job system; the conversion of all levels
+// back to 8 bit runs as one batch of tiles at the end. Level 0 is never converted as a
+// whole, tiles of level 1 decode the source rows they read into a small ring (a float
+// copy of a 2048^2 image costs more in page faults than all the filtering). The inner
+// loops use AVX2 + FMA when the CPU has them, picked at runtime.
+enum class MipFilter { Box, Kaiser };
+
+inline const char* mipFilterName(MipFilter filter) { return filter == MipFilter::Box ? "box" : "kaiser"; }
+
+struct MipSettings
+{
+	bool srgb = true;                      // color channels are sRGB encoded
+	MipFilter filter = MipFilter::Kaiser;
+	bool simd = true;                      // false forces the scalar loops, for benchmarking
+};
+
+inline bool mipCpuHasAvx2()
+{
+#ifdef MIP_BUILDER_AVX2
+	static const bool supported = []()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!fma || !osxsave || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}();
+	return supported;
+#else
+	return false;
+#endif
+}
+
+inline int mipLevelCount(int width, int height)
+{
+	int levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		levels++;
+	}
+	return levels;
+}
+
+// sRGB <-> linear --------------------------------------------------------------------
+
+struct SrgbTables
+{
+	float toLinear[256];
+	// linear -> sRGB byte: exponent and top 3 mantissa bits of the float pick one of 104
+	// segments (13 octaves from 2^-13 up to 1), the next 8 mantissa bits interpolate
+	// linearly inside it. Entry = bias >> 9 in the high half, slope in the low half.
+	uint32_t fromLinear[104];
+
+	static const uint32_t LOWEST = 0x39000000;  // 2^-13, everything below encodes to 0
+	static const uint32_t HIGHEST = 0x3f7fffff; // largest float below 1
+
+	static const SrgbTables& instance()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	static double decodeExact(double v) { return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4); }
+	static double encodeExact(double v) { return v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055; }
+
+	uint8_t encode(float v) const
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &v, 4);
+		if (!(v > 1.220703125e-4f)) // also catches NaN
+			bits = LOWEST;
+		if (bits > HIGHEST)
+			bits = HIGHEST;
+		uint32_t entry = fromLinear[(bits - LOWEST) >> 20];
+		uint32_t bias = (entry >> 16) << 9;
+		uint32_t scale = entry & 0xffff;
+		uint32_t t = (bits >> 12) & 0xff;
+		return (uint8_t)((bias + scale * t) >> 16);
+	}
+
+private:
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+			toLinear[i] = (float)decodeExact(i / 255.0);
+		for (uint32_t segment = 0; segment < 104; segment++)
+		{
+			// least squares line through the exact curve at the middle of each of the 256 steps
+			double st = 0.0, sy = 0.0, stt = 0.0, sty = 0.0;
+			for (uint32_t t = 0; t < 256; t++)
+			{
+				uint32_t bits = LOWEST + (segment << 20) + (t << 12) + (1 << 11);
+				float x;
+				std::memcpy(&x, &bits, 4);
+				double y = encodeExact(x) * 255.0;
+				st += t;
+				sy += y;
+				stt += (double)t * t;
+				sty += t * y;
+			}
+			double slope = (256.0 * sty - st * sy) / (256.0 * stt - st * st);
+			double offset = (sy - slope * st) / 256.0;
+			// + 0.5 so the final >> 16 rounds instead of truncating
+			uint32_t bias = (uint32_t)std::lround((offset + 0.5) * 65536.0 / 512.0);
+			uint32_t scale = (uint32_t)std::lround(slope * 65536.0);
+			fromLinear[segment] = (bias << 16) | scale;
+		}
+	}
+};
+
+// kernels ----------------------------------------------------------------------------
+
+// destination pixel x reads source pixels 2x + offset .. 2x + offset + taps - 1
+struct MipKernel
+{
+	int taps = 2;
+	int offset = 0;
+	float weights[8] = {};
+};
+
+// source rows are padded with this many replicated pixels on both sides so the
+// horizontal pass never needs to clamp
+const int MIP_ROW_PADDING = 4;
+
+inline MipKernel mipKernel(MipFilter filter)
+{
+	MipKernel kernel;
+	if (filter == MipFilter::Box)
+	{
+		kernel.taps = 2;
+		kernel.offset = 0;
+		kernel.weights[0] = kernel.weights[1] = 0.5f;
+		return kernel;
+	}
+
+	// Kaiser windowed sinc over 3 source pixels each side, alpha 4
+	auto bessel0 = [](double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 20; k++)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	};
+	const double pi = 3.14159265358979323846;
+	const double radius = 3.0, alpha = 4.0;
+	kernel.taps = 6;
+	kernel.offset = -2;
+	double total = 0.0;
+	double weights[6];
+	for (int t = 0; t < kernel.taps; t++)
+	{
+		double distance = t + kernel.offset - 0.5;  // from the destination pixel center, in source pixels
+		double x = distance * 0.5;                 // in destination pixels
+		double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+		double r = distance / radius;
+		double window = bessel0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel0(alpha);
+		weights[t] = sinc * window;
+		total += weights[t];
+	}
+	for (int t = 0; t < kernel.taps; t++)
+		kernel.weights[t] = (float)(weights[t] / total);
+	return kernel;
+}
+
+// row loops --------------------------------------------------------------------------
+
+inline void mipDecodeRow(const uint8_t* src, float* dst, int pixels, bool srgb)
+{
+	const SrgbTables& tables = SrgbTables::instance();
+	for (int i = 0; i < pixels * 4; i += 4)
+	{
+		for (int ch = 0; ch < 3; ch++)
+			dst[i + ch] = srgb ? tables.toLinear[src[i + ch]] : src[i + ch] * (1.0f / 255.0f);
+		dst[i + 3] = src[i + 3] * (1.0f / 255.0f);
+	}
+}
+
+inline void mipPadRow(float* line, int width)
+{
+	for (int p = 1; p <= MIP_ROW_PADDING; p++)
+	{
+		std::memcpy(line - p * 4, line, 4 * sizeof(float));
+		std::memcpy(line + (width - 1 + p) * 4, line + (width - 1) * 4, 4 * sizeof(float));
+	}
+}
+
+// one destination row: 'rows' are the kernel's source rows (clamped by the caller),
+// 'line' receives their vertical sum and must have MIP_ROW_PADDING pixels in front
+inline void mipFilterRowScalar(const MipKernel& kernel, const float* const* rows, int srcWidth, float* line, float* dst, int dstWidth)
+{
+	for (int i = 0; i < srcWidth * 4; i++)
+	{
+		float sum = 0.0f;
+		for (int t = 0; t < kernel.taps; t++)
+			sum += kernel.weights[t] * rows[t][i];
+		line[i] = sum;
+	}
+	mipPadRow(line, srcWidth);
+	for (int x = 0; x < dstWidth; x++)
+	{
+		const float* p = line + (2 * x + kernel.offset) * 4;
+		for (int ch = 0; ch < 4; ch++)
+		{
+			float sum = 0.0f;
+			for (int t = 0; t < kernel.taps; t++)
+				sum += kernel.weights[t] * p[t * 4 + ch];
+			dst[x * 4 + ch] = sum;
+		}
+	}
+}
+
+inline void mipEncodeRowScalar(const float* src, uint8_t* dst, int pixels, bool srgb)
+{
+	const SrgbTables& tables = SrgbTables::instance();
+	for (int i = 0; i < pixels * 4; i++)
+	{
+		if (srgb && (i & 3) != 3)
+			dst[i] = tables.encode(src[i]);
+		else
+			dst[i] = (uint8_t)(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+#ifdef MIP_BUILDER_AVX2
+// 2 pixels per step, color through a gather from the sRGB table
+inline MIP_AVX2_FUNCTION void mipDecodeRowAvx2(const uint8_t* src, float* dst, int pixels, bool srgb)
+{
+	const SrgbTables& tables = SrgbTables::instance();
+	const __m256i alphaLanes = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+	int x = 0;
+	for (; x + 2 <= pixels; x += 2)
+	{
+		__m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x * 4)));
+		__m256 result = _mm256_mul_ps(_mm256_cvtepi32_ps(bytes), scale);
+		if (srgb)
+			result = _mm256_blendv_ps(_mm256_i32gather_ps(tables.toLinear, bytes, 4), result, _mm256_castsi256_ps(alphaLanes));
+		_mm256_storeu_ps(dst + x * 4, result);
+	}
+	if (x < pixels)
+		mipDecodeRow(src + x * 4, dst + x * 4, pixels - x, srgb);
+}
+
+// same as the scalar version, the vertical pass does 8 floats (2 pixels) per step and
+// the horizontal one 2 destination pixels per step
+inline MIP_AVX2_FUNCTION void mipFilterRowAvx2(const MipKernel& kernel, const float* const* rows, int srcWidth, float* line, float* dst, int dstWidth)
+{
+	int count = srcWidth * 4;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_mul_ps(_mm256_set1_ps(kernel.weights[0]), _mm256_loadu_ps(rows[0] + i));
+		for (int t = 1; t < kernel.taps; t++)
+			sum = _mm256_fmadd_ps(_mm256_set1_ps(kernel.weights[t]), _mm256_loadu_ps(rows[t] + i), sum);
+		_mm256_storeu_ps(line + i, sum);
+	}
+	for (; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (int t = 0; t < kernel.taps; t++)
+			sum += kernel.weights[t] * rows[t][i];
+		line[i] = sum;
+	}
+	mipPadRow(line, srcWidth);
+
+	int x = 0;
+	for (; x + 2 <= dstWidth; x += 2)
+	{
+		const float* p = line + (2 * x + kernel.offset) * 4;
+		__m256 sum = _mm256_setzero_ps();
+		for (int t = 0; t < kernel.taps; t++)
+		{
+			// pixel p[t] for x and p[t + 2] for x + 1
+			__m256 pair = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + t * 4)), _mm_loadu_ps(p + t * 4 + 8), 1);
+			sum = _mm256_fmadd_ps(_mm256_set1_ps(kernel.weights[t]), pair, sum);
+		}
+		_mm256_storeu_ps(dst + x * 4, sum);
+	}
+	for (; x < dstWidth; x++)
+	{
+		const float* p = line + (2 * x + kernel.offset) * 4;
+		__m128 sum = _mm_setzero_ps();
+		for (int t = 0; t < kernel.taps; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel.weights[t]), _mm_loadu_ps(p + t * 4)));
+		_mm_storeu_ps(dst + x * 4, sum);
+	}
+}
+
+// 2 pixels per step, the sRGB segments are fetched with a gather
+inline MIP_AVX2_FUNCTION void mipEncodeRowAvx2(const float* src, uint8_t* dst, int pixels, bool srgb)
+{
+	const SrgbTables& tables = SrgbTables::instance();
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 lowest = _mm256_castsi256_ps(_mm256_set1_epi32((int)SrgbTables::LOWEST));
+	const __m256 highest = _mm256_castsi256_ps(_mm256_set1_epi32((int)SrgbTables::HIGHEST));
+	const __m256i alphaLanes = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+	int x = 0;
+	for (; x + 2 <= pixels; x += 2)
+	{
+		__m256 v = _mm256_loadu_ps(src + x * 4);
+		__m256 clamped = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+		__m256i result = _mm256_cvttps_epi32(_mm256_fmadd_ps(clamped, _mm256_set1_ps(255.0f), _mm256_set1_ps(0.5f)));
+		if (srgb)
+		{
+			// max picks 'lowest' for NaN like the scalar compare does
+			__m256i bits = _mm256_castps_si256(_mm256_min_ps(_mm256_max_ps(v, lowest), highest));
+			__m256i index = _mm256_srli_epi32(_mm256_sub_epi32(bits, _mm256_castps_si256(lowest)), 20);
+			__m256i entry = _mm256_i32gather_epi32((const int*)tables.fromLinear, index, 4);
+			__m256i bias = _mm256_slli_epi32(_mm256_srli_epi32(entry, 16), 9);
+			__m256i scale = _mm256_and_si256(entry, _mm256_set1_epi32(0xffff));
+			__m256i t = _mm256_and_si256(_mm256_srli_epi32(bits, 12), _mm256_set1_epi32(0xff));
+			__m256i encoded = _mm256_srli_epi32(_mm256_add_epi32(bias, _mm256_mullo_epi32(scale, t)), 16);
+			result = _mm256_blendv_epi8(encoded, result, alphaLanes);
+		}
+		__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(result, result), _mm256_setzero_si256());
+		int first = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+		int second = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+		std::memcpy(dst + x * 4, &first, 4);
+		std::memcpy(dst + x * 4 + 4, &second, 4);
+	}
+	if (x < pixels)
+		mipEncodeRowScalar(src + x * 4, dst + x * 4, pixels - x, srgb);
+}
+#endif
+
+// chain ------------------------------------------------------------------------------
+
+// all levels down to 1x1, level 0 is a copy of 'base'
+inline std::vector<ImageRGBA8> buildMipChain(const ImageRGBA8& base, const MipSettings& settings = MipSettings(), JobSystem* jobs = nullptr)
+{
+	bool avx2 = settings.simd && mipCpuHasAvx2();
+	MipKernel kernel = mipKernel(settings.filter);
+	auto forRows = [&](size_t rows, const std::function<void(size_t, size_t)>& fn)
+	{
+		if (jobs)
+			jobs->parallelFor(rows, jobs->suggestedGrain(rows, 4), [&](size_t begin, size_t end, size_t, unsigned int) { fn(begin, end); });
+		else
+			fn(0, rows);
+	};
+
+	int levelCount = mipLevelCount(base.width, base.height);
+	std::vector<int> widths(levelCount), heights(levelCount);
+	std::vector<std::vector<float>> linear(levelCount); // stays empty for level 0
+	widths[0] = base.width;
+	heights[0] = base.height;
+
+	for (int l = 1; l < levelCount; l++)
+	{
+		int srcWidth = widths[l - 1], srcHeight = heights[l - 1];
+		int width = widths[l] = std::max(1, srcWidth / 2);
+		int height = heights[l] = std::max(1, srcHeight / 2);
+		const float* src = linear[l - 1].data();
+		linear[l].resize((size_t)width * height * 4);
+		float* dst = linear[l].data();
+		forRows((size_t)height, [&](size_t begin, size_t end)
+		{
+			std::vector<float> scratch((size_t)(srcWidth + 2 * MIP_ROW_PADDING) * 4);
+			float* line = scratch.data() + MIP_ROW_PADDING * 4;
+			// level 0 rows by row index mod 8, the kernel window moves 2 rows per
+			// destination row and never spans more than 8
+			const int ringSize = 8;
+			std::vector<float> ring(l == 1 ? (size_t)ringSize * srcWidth * 4 : 0);
+			int ringRows[ringSize];
+			std::fill(ringRows, ringRows + ringSize, -1);
+			const float* rows[8];
+			for (size_t y = begin; y < end; y++)
+			{
+				for (int t = 0; t < kernel.taps; t++)
+				{
+					int sy = std::min(std::max(2 * (int)y + kernel.offset + t, 0), srcHeight - 1);
+					if (l > 1)
+					{
+						rows[t] = src + (size_t)sy * srcWidth * 4;
+						continue;
+					}
+					float* slot = ring.data() + (size_t)(sy % ringSize) * srcWidth * 4;
+					if (ringRows[sy % ringSize] != sy)
+					{
+						const uint8_t* bytes = base.data() + (size_t)sy * srcWidth * 4;
+#ifdef MIP_BUILDER_AVX2
+						if (avx2)
+							mipDecodeRowAvx2(bytes, slot, srcWidth, settings.srgb);
+						else
+#endif
+							mipDecodeRow(bytes, slot, srcWidth, settings.srgb);
+						ringRows[sy % ringSize] = sy;
+					}
+					rows[t] = slot;
+				}
+#ifdef MIP_BUILDER_AVX2
+				if (avx2)
+				{
+					mipFilterRowAvx2(kernel, rows, srcWidth, line, dst + y * width * 4, width);
+					continue;
+				}
+#endif
+				mipFilterRowScalar(kernel, rows, srcWidth, line, dst + y * width * 4, width);
+			}
+		});
+	}
+
+	std::vector<ImageRGBA8> levels(levelCount);
+	levels[0] = base;
+	for (int l = 1; l < levelCount; l++)
+	{
+		levels[l].width = widths[l];
+		levels[l].height = heights[l];
+		levels[l].pixels.resize((size_t)widths[l] * heights[l] * 4);
+	}
+	// (level, first row) tiles of every level in one go, the small levels are one tile each
+	const int tileRows = 16;
+	std::vector<std::pair<int, int>> tiles;
+	for (int l = 1; l < levelCount; l++)
+		for (int y = 0; y < heights[l]; y += tileRows)
+			tiles.push_back({ l, y });
+	auto encodeTiles = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			int l = tiles[i].first;
+			for (int y = tiles[i].second; y < std::min(tiles[i].second + tileRows, heights[l]); y++)
+			{
+				const float* src = linear[l].data() + (size_t)y * widths[l] * 4;
+				uint8_t* dst = levels[l].pixels.data() + (size_t)y * widths[l] * 4;
+#ifdef MIP_BUILDER_AVX2
+				if (avx2)
+				{
+					mipEncodeRowAvx2(src, dst, widths[l], settings.srgb);
+					continue;
+				}
+#endif
+				mipEncodeRowScalar(src, dst, widths[l], settings.srgb);
+			}
+		}
+	};
+	if (jobs)
+		jobs->parallelFor(tiles.size(), 1, [&](size_t begin, size_t end, size_t, unsigned int) { encodeTiles(begin, end); });
+	else
+		encodeTiles(0, tiles.size());
+	return levels;
+}
+
+// uncompressed upload of a CPU built chain, what glGenerateMipmap would have made
+// but filtered in linear space and without stalling the driver
+inline unsigned int uploadMipChain(const std::vector<ImageRGBA8>& levels, bool srgb)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (size_t l = 0; l < levels.size(); l++)
+		glTexImage2D(GL_TEXTURE_2D, (GLint)l, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, levels[l].width, levels[l].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[l].data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
+
+#endif
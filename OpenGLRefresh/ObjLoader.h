@@ -0,0 +1,493 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include "FastParse.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// area weighted smooth normals of an indexed triangle list, xyz per vertex; the glTF
+// import uses it for primitives without normals too
+inline void generateSmoothNormals(const float* positions, size_t positionStride, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, std::vector<float>& normals)
+{
+	normals.assign(vertexCount * 3, 0.0f);
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		const float* a = &positions[indices[t] * positionStride];
+		const float* b = &positions[indices[t + 1] * positionStride];
+		const float* c = &positions[indices[t + 2] * positionStride];
+		glm::vec3 n = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+		for (int k = 0; k < 3; k++)
+		{
+			float* dst = &normals[indices[t + k] * 3];
+			dst[0] += n.x;
+			dst[1] += n.y;
+			dst[2] += n.z;
+		}
+	}
+	for (size_t v = 0; v < normals.size(); v += 3)
+	{
+		glm::vec3 n(normals[v], normals[v + 1], normals[v + 2]);
+		float length = glm::length(n);
+		n = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		normals[v] = n.x;
+		normals[v + 1] = n.y;
+		normals[v + 2] = n.z;
+	}
+}
+
+// Triangle mesh with one index stream, the common output of the loaders. Normals are
+// always present (generated when the file has none), uvs may be empty.
+struct MeshData
+{
+	std::vector<float> positions; // xyz
+	std::vector<float> normals;   // xyz
+	std::vector<float> uvs;       // uv
+	std::vector<uint32_t> indices;
+
+	size_t vertexCount() const { return positions.size() / 3; }
+	size_t triangleCount() const { return indices.size() / 3; }
+
+	VertexStreams streams() const
+	{
+		VertexStreams s;
+		s.positions = positions.data();
+		s.normals = normals.empty() ? nullptr : normals.data();
+		s.uvs = uvs.empty() ? nullptr : uvs.data();
+		s.count = vertexCount();
+		return s;
+	}
+
+	void generateNormals()
+	{
+		generateSmoothNormals(positions.data(), 3, vertexCount(), indices.data(), indices.size(), normals);
+	}
+};
+
+struct LoadStats
+{
+	size_t bytes = 0;
+	double seconds = 0.0;
+	size_t vertices = 0;
+	size_t triangles = 0;
+
+	double megabytesPerSecond() const { return seconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / seconds : 0.0; }
+
+	void print(const std::string& name) const
+	{
+		std::cout << "Loaded " << name << ": " << vertices << " vertices, " << triangles << " triangles, "
+			<< bytes / 1024 << " KB in " << seconds * 1000.0 << " ms (" << megabytesPerSecond() << " MB/s)" << std::endl;
+	}
+};
+
+// Wavefront OBJ reader. The file is memory mapped and cut into chunks at line breaks.
+// A first parallel pass counts the elements in every chunk, the prefix sums give each
+// chunk its output range, and a second parallel pass parses straight into place.
+// Relative (negative) face indices work because every chunk knows how many vertices
+// came before it. v/vt/vn triplets are then welded into one index stream in parallel
+// by hashing them into one bucket per thread.
+class ObjLoader
+{
+public:
+	static bool load(const std::string& path, MeshData& out, JobSystem* jobs = nullptr, LoadStats* stats = nullptr)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		MappedFile file(path);
+		if (!file.isOpen())
+			return false;
+		if (!parse(file.chars(), file.chars() + file.size(), out, jobs))
+		{
+			std::cout << "ERROR::OBJ_LOADER::PARSE_FAILED " << path << std::endl;
+			return false;
+		}
+		if (stats)
+		{
+			stats->bytes = file.size();
+			stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			stats->vertices = out.vertexCount();
+			stats->triangles = out.triangleCount();
+		}
+		return true;
+	}
+
+	static bool parse(const char* begin, const char* end, MeshData& out, JobSystem* jobs = nullptr)
+	{
+		out = MeshData();
+		size_t threads = jobs ? jobs->threadCount() : 1;
+
+		// chunk boundaries on line starts
+		size_t chunkCount = threads > 1 ? threads * 8 : 1;
+		size_t chunkSize = (size_t)(end - begin) / chunkCount + 1;
+		std::vector<Chunk> chunks;
+		const char* p = begin;
+		while (p < end)
+		{
+			Chunk chunk;
+			chunk.begin = p;
+			const char* target = (size_t)(end - p) > chunkSize ? p + chunkSize : end;
+			chunk.end = target < end ? skipLine(target, end) : end;
+			chunks.push_back(chunk);
+			p = chunk.end;
+		}
+
+		forEach(jobs, chunks.size(), [&](size_t i) { count(chunks[i]); });
+
+		// prefix sums
+		Counts total;
+		for (Chunk& chunk : chunks)
+		{
+			chunk.offset = total;
+			total.positions += chunk.counts.positions;
+			total.normals += chunk.counts.normals;
+			total.uvs += chunk.counts.uvs;
+			total.corners += chunk.counts.corners;
+		}
+
+		std::vector<float> positions(total.positions * 3);
+		std::vector<float> normals(total.normals * 3);
+		std::vector<float> uvs(total.uvs * 2);
+		std::vector<Corner> corners(total.corners);
+		std::atomic<bool> ok(true);
+		forEach(jobs, chunks.size(), [&](size_t i)
+		{
+			if (!parseChunk(chunks[i], total, positions.data(), normals.data(), uvs.data(), corners.data()))
+				ok = false;
+		});
+		if (!ok)
+			return false;
+
+		bool hasUvs = total.uvs > 0;
+		bool hasNormals = total.normals > 0;
+		if (!hasUvs && !hasNormals)
+		{
+			// positions only: no welding needed, the position index is the vertex index
+			out.positions = std::move(positions);
+			out.indices.resize(corners.size());
+			forEach(jobs, chunks.size(), [&](size_t i)
+			{
+				const Chunk& chunk = chunks[i];
+				for (size_t c = chunk.offset.corners; c < chunk.offset.corners + chunk.counts.corners; c++)
+					out.indices[c] = (uint32_t)corners[c].v;
+			});
+			out.generateNormals();
+			return true;
+		}
+
+		weld(jobs, corners, positions, normals, uvs, hasNormals, hasUvs, out);
+		if (!hasNormals)
+			out.generateNormals();
+		return true;
+	}
+
+private:
+	struct Counts
+	{
+		size_t positions = 0;
+		size_t normals = 0;
+		size_t uvs = 0;
+		size_t corners = 0; // 3 per triangle after fan triangulation
+	};
+
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+		Counts counts;
+		Counts offset;
+	};
+
+	struct Corner
+	{
+		int32_t v;
+		int32_t vt;
+		int32_t vn;
+		bool operator==(const Corner& o) const { return v == o.v && vt == o.vt && vn == o.vn; }
+	};
+
+	struct CornerHash
+	{
+		size_t operator()(const Corner& c) const
+		{
+			uint64_t h = (uint64_t)(uint32_t)c.v * 0x9E3779B97F4A7C15ull;
+			h ^= (uint64_t)(uint32_t)c.vt * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= (uint64_t)(uint32_t)c.vn * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+
+	template <typename Fn>
+	static void forEach(JobSystem* jobs, size_t count, Fn fn)
+	{
+		if (!jobs)
+		{
+			for (size_t i = 0; i < count; i++)
+				fn(i);
+			return;
+		}
+		jobs->parallelFor(count, 1, [&](size_t begin, size_t end, size_t, unsigned int)
+		{
+			for (size_t i = begin; i < end; i++)
+				fn(i);
+		});
+	}
+
+	static void count(Chunk& chunk)
+	{
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+		while (p < end)
+		{
+			p = skipSpaces(p, end);
+			if (p + 1 < end && p[0] == 'v')
+			{
+				if (p[1] == ' ' || p[1] == '\t')
+					chunk.counts.positions++;
+				else if (p[1] == 'n')
+					chunk.counts.normals++;
+				else if (p[1] == 't')
+					chunk.counts.uvs++;
+			}
+			else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				// count the vertex references on this face
+				size_t vertices = 0;
+				const char* q = p + 1;
+				while (q < end && *q != '\n')
+				{
+					q = skipSpaces(q, end);
+					if (q >= end || *q == '\n')
+						break;
+					vertices++;
+					while (q < end && *q != ' ' && *q != '\t' && *q != '\n' && *q != '\r')
+						q++;
+				}
+				if (vertices >= 3)
+					chunk.counts.corners += (vertices - 2) * 3;
+			}
+			p = skipLine(p, end);
+		}
+	}
+
+	static bool parseChunk(const Chunk& chunk, const Counts& total, float* positions, float* normals, float* uvs, Corner* corners)
+	{
+		size_t v = chunk.offset.positions;
+		size_t vn = chunk.offset.normals;
+		size_t vt = chunk.offset.uvs;
+		size_t c = chunk.offset.corners;
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+		while (p < end)
+		{
+			p = skipSpaces(p, end);
+			if (p + 1 < end && p[0] == 'v')
+			{
+				if (p[1] == ' ' || p[1] == '\t')
+				{
+					if (!parseFloats(p + 1, end, positions + v * 3, 3))
+						return false;
+					v++;
+				}
+				else if (p[1] == 'n')
+				{
+					if (!parseFloats(p + 2, end, normals + vn * 3, 3))
+						return false;
+					vn++;
+				}
+				else if (p[1] == 't')
+				{
+					if (!parseFloats(p + 2, end, uvs + vt * 2, 2))
+						return false;
+					vt++;
+				}
+			}
+			else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				Corner first, previous, current;
+				size_t vertices = 0;
+				const char* q = p + 1;
+				for (;;)
+				{
+					q = skipSpaces(q, end);
+					if (q >= end || *q == '\n')
+						break;
+					if (!parseCorner(q, end, v, vt, vn, current))
+						return false;
+					if (current.v < 0 || (size_t)current.v >= total.positions
+						|| (current.vt >= 0 && (size_t)current.vt >= total.uvs)
+						|| (current.vn >= 0 && (size_t)current.vn >= total.normals))
+						return false;
+					if (vertices == 0)
+						first = current;
+					else if (vertices >= 2)
+					{
+						corners[c++] = first;
+						corners[c++] = previous;
+						corners[c++] = current;
+					}
+					previous = current;
+					vertices++;
+				}
+			}
+			p = skipLine(p, end);
+		}
+		return true;
+	}
+
+	static bool parseFloats(const char* p, const char* end, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			p = skipSpaces(p, end);
+			p = parseFloat(p, end, out[i]);
+			if (!p)
+				return false;
+		}
+		return true;
+	}
+
+	// "v", "v/vt", "v//vn" or "v/vt/vn", 1 based or negative = relative to the end so far
+	static bool parseCorner(const char*& p, const char* end, size_t positionsSoFar, size_t uvsSoFar, size_t normalsSoFar, Corner& corner)
+	{
+		long long value;
+		p = parseInt(p, end, value);
+		if (!p)
+			return false;
+		corner.v = resolve(value, positionsSoFar);
+		corner.vt = -1;
+		corner.vn = -1;
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p != '/')
+			{
+				p = parseInt(p, end, value);
+				if (!p)
+					return false;
+				corner.vt = resolve(value, uvsSoFar);
+			}
+			if (p < end && *p == '/')
+			{
+				p++;
+				p = parseInt(p, end, value);
+				if (!p)
+					return false;
+				corner.vn = resolve(value, normalsSoFar);
+			}
+		}
+		return true;
+	}
+
+	static int32_t resolve(long long index, size_t soFar)
+	{
+		return (int32_t)(index < 0 ? (long long)soFar + index : index - 1);
+	}
+
+	// turns v/vt/vn triplets into unique vertices. Corners are partitioned by hash into
+	// one bucket per thread so each thread can dedupe its bucket without any locking.
+	static void weld(JobSystem* jobs, const std::vector<Corner>& corners, const std::vector<float>& positions,
+		const std::vector<float>& normals, const std::vector<float>& uvs, bool hasNormals, bool hasUvs, MeshData& out)
+	{
+		size_t buckets = jobs ? jobs->threadCount() : 1;
+		size_t sliceCount = buckets * 4;
+		size_t sliceSize = corners.size() / sliceCount + 1;
+		CornerHash hasher;
+
+		// partition: count per (slice, bucket), prefix, scatter
+		std::vector<size_t> counts(sliceCount * buckets, 0);
+		forEach(jobs, sliceCount, [&](size_t s)
+		{
+			size_t begin = s * sliceSize, end = std::min(corners.size(), begin + sliceSize);
+			for (size_t c = begin; c < end; c++)
+				counts[s * buckets + hasher(corners[c]) % buckets]++;
+		});
+		std::vector<size_t> bucketStart(buckets + 1, 0);
+		std::vector<size_t> writePos(sliceCount * buckets);
+		size_t running = 0;
+		for (size_t b = 0; b < buckets; b++)
+		{
+			bucketStart[b] = running;
+			for (size_t s = 0; s < sliceCount; s++)
+			{
+				writePos[s * buckets + b] = running;
+				running += counts[s * buckets + b];
+			}
+		}
+		bucketStart[buckets] = running;
+		std::vector<uint32_t> partitioned(corners.size());
+		forEach(jobs, sliceCount, [&](size_t s)
+		{
+			size_t begin = s * sliceSize, end = std::min(corners.size(), begin + sliceSize);
+			for (size_t c = begin; c < end; c++)
+				partitioned[writePos[s * buckets + hasher(corners[c]) % buckets]++] = (uint32_t)c;
+		});
+
+		// dedupe every bucket on its own, remembering the local id of each corner
+		std::vector<uint32_t> localId(corners.size());
+		std::vector<std::vector<uint32_t>> uniqueCorners(buckets);
+		forEach(jobs, buckets, [&](size_t b)
+		{
+			std::unordered_map<Corner, uint32_t, CornerHash> ids;
+			ids.reserve(bucketStart[b + 1] - bucketStart[b]);
+			for (size_t i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+			{
+				uint32_t c = partitioned[i];
+				auto inserted = ids.emplace(corners[c], (uint32_t)uniqueCorners[b].size());
+				if (inserted.second)
+					uniqueCorners[b].push_back(c);
+				localId[c] = inserted.first->second;
+			}
+		});
+
+		std::vector<uint32_t> vertexBase(buckets + 1, 0);
+		for (size_t b = 0; b < buckets; b++)
+			vertexBase[b + 1] = vertexBase[b] + (uint32_t)uniqueCorners[b].size();
+		size_t vertexCount = vertexBase[buckets];
+
+		out.positions.resize(vertexCount * 3);
+		if (hasNormals)
+			out.normals.resize(vertexCount * 3);
+		if (hasUvs)
+			out.uvs.resize(vertexCount * 2);
+		forEach(jobs, buckets, [&](size_t b)
+		{
+			for (size_t i = 0; i < uniqueCorners[b].size(); i++)
+			{
+				const Corner& corner = corners[uniqueCorners[b][i]];
+				size_t vertex = vertexBase[b] + i;
+				std::memcpy(&out.positions[vertex * 3], &positions[corner.v * 3], 3 * sizeof(float));
+				if (hasNormals)
+				{
+					if (corner.vn >= 0)
+						std::memcpy(&out.normals[vertex * 3], &normals[corner.vn * 3], 3 * sizeof(float));
+					else
+						out.normals[vertex * 3 + 1] = 1.0f;
+				}
+				if (hasUvs && corner.vt >= 0)
+					std::memcpy(&out.uvs[vertex * 2], &uvs[corner.vt * 2], 2 * sizeof(float));
+			}
+		});
+
+		out.indices.resize(corners.size());
+		forEach(jobs, sliceCount, [&](size_t s)
+		{
+			size_t begin = s * sliceSize, end = std::min(corners.size(), begin + sliceSize);
+			for (size_t c = begin; c < end; c++)
+				out.indices[c] = vertexBase[hasher(corners[c]) % buckets] + localId[c];
+		});
+	}
+};
+
+#endif
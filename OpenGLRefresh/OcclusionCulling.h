@@ -0,0 +1,540 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Occlusion culling on the CPU. The big occluders of a frame are rasterized into a small
+// depth buffer, a max pyramid (Hi-Z) is built over it and every object's bounds are tested
+// against the pyramid before its draw is recorded, so nothing waits on the GPU and the
+// result is the same headless.
+//
+// Occluder triangles are transformed, clipped at the near plane and binned into bands of
+// rows on the job system; the bands then rasterize in parallel without sharing a pixel.
+// The inner loop covers 4 pixels per SSE2 instruction: the coverage of the three edge
+// functions is a lane mask, and only masked lanes take the triangle's depth (min).
+// Depth is window z in [0, 1] with 1 cleared, so the pyramid keeps the farthest occluder
+// of each texel. An object whose nearest corner is behind that everywhere in its screen
+// rectangle is hidden; objects crossing the near plane are always drawn.
+//
+// Occluders have to be solid: the bounds of a quantized mesh (the unit cube of
+// addBox()) are only an occluder for meshes that fill them, like the cube.
+struct OcclusionStats
+{
+	size_t frames = 0;
+	size_t occluders = 0;     // selected from the candidates
+	size_t triangles = 0;     // after near clipping and dropping the ones off screen
+	size_t tested = 0;
+	size_t frustumCulled = 0;
+	size_t occluded = 0;
+	double rasterMs = 0.0;    // selection, transform, binning and rasterization
+	double pyramidMs = 0.0;
+	double testMs = 0.0;
+
+	void add(const OcclusionStats& other)
+	{
+		frames += other.frames;
+		occluders += other.occluders;
+		triangles += other.triangles;
+		tested += other.tested;
+		frustumCulled += other.frustumCulled;
+		occluded += other.occluded;
+		rasterMs += other.rasterMs;
+		pyramidMs += other.pyramidMs;
+		testMs += other.testMs;
+	}
+};
+
+enum class OcclusionResult { Visible, OutsideFrustum, Occluded };
+
+class OcclusionCuller
+{
+public:
+	static const int BAND_HEIGHT = 8;
+
+	// the width is rounded up to whole SSE registers
+	explicit OcclusionCuller(int width = 256, int height = 128)
+		: width((std::max(width, 4) + 3) & ~3), height(std::max(height, 1))
+	{
+		int levelWidth = this->width, levelHeight = this->height;
+		for (;;)
+		{
+			levels.push_back({ levelWidth, levelHeight, std::vector<float>((size_t)levelWidth * levelHeight, 1.0f) });
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+			levelWidth = std::max(1, (levelWidth + 1) / 2);
+			levelHeight = std::max(1, (levelHeight + 1) / 2);
+		}
+		bands.resize((this->height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+	}
+
+	bool simd = true;                 // false forces the scalar loops, for benchmarking
+	float minOccluderArea = 0.002f;   // share of the screen an occluder's bounds have to cover
+	size_t triangleBudget = 4096;     // occluders are taken biggest first until this is spent
+
+	// a CPU copy of an occluder mesh, returns its id for addOccluder()
+	int addMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+	{
+		OccluderMesh mesh;
+		mesh.positions = positions;
+		mesh.indices = indices;
+		mesh.boundsMin = glm::vec3(FLT_MAX);
+		mesh.boundsMax = glm::vec3(-FLT_MAX);
+		for (const glm::vec3& p : positions)
+		{
+			mesh.boundsMin = glm::min(mesh.boundsMin, p);
+			mesh.boundsMax = glm::max(mesh.boundsMax, p);
+		}
+		meshes.push_back(std::move(mesh));
+		return (int)meshes.size() - 1;
+	}
+
+	// the unit cube the quantized positions of a mesh live in
+	int addBox()
+	{
+		std::vector<glm::vec3> corners;
+		for (int i = 0; i < 8; i++)
+			corners.push_back(glm::vec3((float)(i & 1), (float)((i >> 1) & 1), (float)((i >> 2) & 1)));
+		std::vector<uint32_t> indices = {
+			0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   0, 1, 4, 1, 5, 4,
+			2, 6, 3, 3, 6, 7,   0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5 };
+		return addMesh(corners, indices);
+	}
+
+	void beginFrame(const glm::mat4& viewProjection)
+	{
+		this->viewProjection = viewProjection;
+		candidates.clear();
+		frame = OcclusionStats();
+		frame.frames = 1;
+	}
+
+	// a candidate, render() picks the ones covering the most screen
+	void addOccluder(int mesh, const glm::mat4& model)
+	{
+		candidates.push_back({ mesh, model, 0.0f });
+	}
+
+	void render(JobSystem* jobs = nullptr)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		selectOccluders();
+
+		// transform and clip per chunk of occluders, stitched together in order
+		const size_t grain = 4;
+		std::vector<std::vector<Triangle>> chunks((selected.size() + grain - 1) / grain);
+		auto setup = [&](size_t first, size_t end, size_t chunk)
+		{
+			std::vector<Triangle>& out = chunks[chunk];
+			out.clear();
+			for (size_t i = first; i < end; i++)
+				setupOccluder(selected[i], out);
+		};
+		if (jobs)
+			jobs->parallelFor(selected.size(), grain, [&](size_t first, size_t end, size_t chunk, unsigned int) { setup(first, end, chunk); });
+		else
+			for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+				setup(chunk * grain, std::min(selected.size(), (chunk + 1) * grain), chunk);
+		triangles.clear();
+		for (const std::vector<Triangle>& chunk : chunks)
+			triangles.insert(triangles.end(), chunk.begin(), chunk.end());
+		for (std::vector<uint32_t>& band : bands)
+			band.clear();
+		for (uint32_t t = 0; t < (uint32_t)triangles.size(); t++)
+			for (int band = triangles[t].minY / BAND_HEIGHT; band <= triangles[t].maxY / BAND_HEIGHT; band++)
+				bands[band].push_back(t);
+
+		if (jobs)
+			jobs->parallelFor(bands.size(), 1, [&](size_t first, size_t end, size_t, unsigned int) { rasterizeBands(first, end); });
+		else
+			rasterizeBands(0, bands.size());
+		auto rasterized = std::chrono::high_resolution_clock::now();
+
+		buildPyramid();
+		auto built = std::chrono::high_resolution_clock::now();
+		frame.occluders = selected.size();
+		frame.triangles = triangles.size();
+		frame.rasterMs = std::chrono::duration<double, std::milli>(rasterized - begin).count();
+		frame.pyramidMs = std::chrono::duration<double, std::milli>(built - rasterized).count();
+	}
+
+	// 'box' maps the unit cube onto the object's bounds, e.g. model * dequantizeMatrix()
+	OcclusionResult test(const glm::mat4& box) const
+	{
+		glm::mat4 toClip = viewProjection * box;
+		glm::vec3 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+		int outsideAll = 0x3f;
+		bool crossesNear = false;
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec4 p = toClip * glm::vec4((float)(i & 1), (float)((i >> 1) & 1), (float)((i >> 2) & 1), 1.0f);
+			outsideAll &= outcode(p);
+			if (p.z < -p.w || p.w <= 0.0f)
+			{
+				crossesNear = true;
+				continue;
+			}
+			glm::vec3 ndc = glm::vec3(p) / p.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if (outsideAll != 0)
+			return OcclusionResult::OutsideFrustum;
+		if (crossesNear)
+			return OcclusionResult::Visible;
+
+		// the texels the bounds touch, in the level where that is at most 2x2
+		int x0 = std::max(0, (int)std::floor((ndcMin.x * 0.5f + 0.5f) * width));
+		int x1 = std::min(width - 1, (int)std::floor((ndcMax.x * 0.5f + 0.5f) * width));
+		int y0 = std::max(0, (int)std::floor((ndcMin.y * 0.5f + 0.5f) * height));
+		int y1 = std::min(height - 1, (int)std::floor((ndcMax.y * 0.5f + 0.5f) * height));
+		float nearest = ndcMin.z * 0.5f + 0.5f;
+		size_t level = 0;
+		while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+			level++;
+		const Level& hiZ = levels[level];
+		for (int y = y0 >> level; y <= y1 >> level; y++)
+			for (int x = x0 >> level; x <= x1 >> level; x++)
+				if (hiZ.depth[(size_t)y * hiZ.width + x] >= nearest)
+					return OcclusionResult::Visible;
+		return OcclusionResult::Occluded;
+	}
+
+	// tests all boxes, 'visible' gets 1 for the ones to draw
+	void test(const std::vector<glm::mat4>& boxes, std::vector<uint8_t>& visible, JobSystem* jobs = nullptr)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		visible.resize(boxes.size());
+		const size_t grain = 256;
+		std::vector<size_t> frustumCulled((boxes.size() + grain - 1) / grain, 0), occluded(frustumCulled.size(), 0);
+		auto testRange = [&](size_t first, size_t end, size_t chunk)
+		{
+			for (size_t i = first; i < end; i++)
+			{
+				OcclusionResult result = test(boxes[i]);
+				visible[i] = result == OcclusionResult::Visible;
+				frustumCulled[chunk] += result == OcclusionResult::OutsideFrustum;
+				occluded[chunk] += result == OcclusionResult::Occluded;
+			}
+		};
+		if (jobs)
+			jobs->parallelFor(boxes.size(), grain, [&](size_t first, size_t end, size_t chunk, unsigned int) { testRange(first, end, chunk); });
+		else
+			for (size_t chunk = 0; chunk < frustumCulled.size(); chunk++)
+				testRange(chunk * grain, std::min(boxes.size(), (chunk + 1) * grain), chunk);
+		frame.tested += boxes.size();
+		for (size_t chunk = 0; chunk < frustumCulled.size(); chunk++)
+		{
+			frame.frustumCulled += frustumCulled[chunk];
+			frame.occluded += occluded[chunk];
+		}
+		frame.testMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	}
+
+	// call once the frame's tests are done
+	void endFrame()
+	{
+		total.add(frame);
+	}
+
+	const OcclusionStats& frameStats() const { return frame; }
+	const OcclusionStats& totalStats() const { return total; }
+	int bufferWidth() const { return width; }
+	int bufferHeight() const { return height; }
+	// level 0 of the pyramid, bottom row first
+	const std::vector<float>& depth() const { return levels[0].depth; }
+
+	void printStats() const
+	{
+		double frames = (double)std::max<size_t>(total.frames, 1);
+		double tested = (double)std::max<size_t>(total.tested, 1);
+		std::printf("Occlusion culling (%dx%d, %s, averages over %zu frames):\n", width, height, simd && hasSimd() ? "SSE2" : "scalar", total.frames);
+		std::printf("  occluders %.1f (%.0f triangles), objects tested %.1f\n", total.occluders / frames, total.triangles / frames, total.tested / frames);
+		std::printf("  outside the frustum %.1f%%, occluded %.1f%%, culled %.1f%%\n", 100.0 * total.frustumCulled / tested,
+			100.0 * total.occluded / tested, 100.0 * (total.frustumCulled + total.occluded) / tested);
+		std::printf("  raster %.3f ms, hi-z %.3f ms, test %.3f ms, total %.3f ms per frame\n", total.rasterMs / frames, total.pyramidMs / frames,
+			total.testMs / frames, (total.rasterMs + total.pyramidMs + total.testMs) / frames);
+	}
+
+	static bool hasSimd()
+	{
+#ifdef OCCLUSION_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+
+private:
+	struct OccluderMesh
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		glm::vec3 boundsMin, boundsMax;
+	};
+
+	struct Candidate
+	{
+		int mesh;
+		glm::mat4 model;
+		float area; // share of the screen, 1 for candidates crossing the near plane
+	};
+
+	// window space, the edge functions are >= 0 inside
+	struct Triangle
+	{
+		float edge[3][3];  // a * x + b * y + c
+		float depth[3];    // the same plane for window z
+		int minX, maxX, minY, maxY;
+	};
+
+	struct Level
+	{
+		int width, height;
+		std::vector<float> depth;
+	};
+
+	int width, height;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	std::vector<OccluderMesh> meshes;
+	std::vector<Candidate> candidates;
+	std::vector<const Candidate*> selected;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> bands;
+	std::vector<Level> levels;
+	OcclusionStats frame;
+	OcclusionStats total;
+
+	// bit per clip plane the point is outside of
+	static int outcode(const glm::vec4& p)
+	{
+		return (p.x < -p.w ? 1 : 0) | (p.x > p.w ? 2 : 0) | (p.y < -p.w ? 4 : 0) | (p.y > p.w ? 8 : 0) | (p.z < -p.w ? 16 : 0) | (p.z > p.w ? 32 : 0);
+	}
+
+	void selectOccluders()
+	{
+		selected.clear();
+		for (Candidate& candidate : candidates)
+		{
+			const OccluderMesh& mesh = meshes[candidate.mesh];
+			glm::mat4 toClip = viewProjection * candidate.model;
+			glm::vec2 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+			int outsideAll = 0x3f;
+			candidate.area = 0.0f;
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec3 corner((i & 1) ? mesh.boundsMax.x : mesh.boundsMin.x, (i & 2) ? mesh.boundsMax.y : mesh.boundsMin.y, (i & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+				glm::vec4 p = toClip * glm::vec4(corner, 1.0f);
+				outsideAll &= outcode(p);
+				if (p.w <= 0.0f || p.z < -p.w)
+					candidate.area = 1.0f;
+				else
+				{
+					glm::vec2 ndc = glm::vec2(p.x, p.y) / p.w;
+					ndcMin = glm::min(ndcMin, ndc);
+					ndcMax = glm::max(ndcMax, ndc);
+				}
+			}
+			if (outsideAll != 0)
+				continue;
+			if (candidate.area < 1.0f)
+			{
+				glm::vec2 extent = glm::min(ndcMax, glm::vec2(1.0f)) - glm::max(ndcMin, glm::vec2(-1.0f));
+				candidate.area = std::max(extent.x, 0.0f) * std::max(extent.y, 0.0f) * 0.25f;
+			}
+			if (candidate.area >= minOccluderArea)
+				selected.push_back(&candidate);
+		}
+		std::stable_sort(selected.begin(), selected.end(), [](const Candidate* a, const Candidate* b) { return a->area > b->area; });
+		size_t budget = 0;
+		size_t count = 0;
+		while (count < selected.size() && budget + meshes[selected[count]->mesh].indices.size() / 3 <= triangleBudget)
+			budget += meshes[selected[count++]->mesh].indices.size() / 3;
+		selected.resize(count);
+	}
+
+	void setupOccluder(const Candidate* candidate, std::vector<Triangle>& out) const
+	{
+		const OccluderMesh& mesh = meshes[candidate->mesh];
+		glm::mat4 toClip = viewProjection * candidate->model;
+		std::vector<glm::vec4> clip(mesh.positions.size());
+		for (size_t i = 0; i < clip.size(); i++)
+			clip[i] = toClip * glm::vec4(mesh.positions[i], 1.0f);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			// Sutherland-Hodgman against the near plane, z >= -w
+			glm::vec4 input[3] = { clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]] };
+			glm::vec4 polygon[4];
+			int count = 0;
+			for (int v = 0; v < 3; v++)
+			{
+				const glm::vec4& a = input[v];
+				const glm::vec4& b = input[(v + 1) % 3];
+				float da = a.z + a.w, db = b.z + b.w;
+				if (da >= 0.0f)
+					polygon[count++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+					polygon[count++] = a + (b - a) * (da / (da - db));
+			}
+			for (int v = 1; v + 1 < count; v++)
+				setupTriangle(polygon[0], polygon[v], polygon[v + 1], out);
+		}
+	}
+
+	void setupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, std::vector<Triangle>& out) const
+	{
+		glm::vec3 v[3];
+		const glm::vec4* corners[3] = { &c0, &c1, &c2 };
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4& c = *corners[i];
+			float w = std::max(c.w, 1e-6f);
+			v[i] = glm::vec3((c.x / w * 0.5f + 0.5f) * width, (c.y / w * 0.5f + 0.5f) * height, c.z / w * 0.5f + 0.5f);
+		}
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::abs(area) < 1e-8f)
+			return;
+		// both windings occlude
+		if (area < 0.0f)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		// pixel centers inside the bounds
+		Triangle triangle;
+		triangle.minX = std::max(0, (int)std::ceil(std::min({ v[0].x, v[1].x, v[2].x }) - 0.5f));
+		triangle.maxX = std::min(width - 1, (int)std::floor(std::max({ v[0].x, v[1].x, v[2].x }) - 0.5f));
+		triangle.minY = std::max(0, (int)std::ceil(std::min({ v[0].y, v[1].y, v[2].y }) - 0.5f));
+		triangle.maxY = std::min(height - 1, (int)std::floor(std::max({ v[0].y, v[1].y, v[2].y }) - 0.5f));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+			return;
+		for (int e = 0; e < 3; e++)
+		{
+			const glm::vec3& a = v[e];
+			const glm::vec3& b = v[(e + 1) % 3];
+			triangle.edge[e][0] = a.y - b.y;
+			triangle.edge[e][1] = b.x - a.x;
+			triangle.edge[e][2] = a.x * b.y - a.y * b.x;
+		}
+		triangle.depth[0] = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+		triangle.depth[1] = ((v[1].x - v[0].x) * (v[2].z - v[0].z) - (v[2].x - v[0].x) * (v[1].z - v[0].z)) / area;
+		triangle.depth[2] = v[0].z - triangle.depth[0] * v[0].x - triangle.depth[1] * v[0].y;
+		out.push_back(triangle);
+	}
+
+	void rasterizeBands(size_t first, size_t end)
+	{
+		std::vector<float>& depth = levels[0].depth;
+		for (size_t band = first; band < end; band++)
+		{
+			int bandMinY = (int)band * BAND_HEIGHT;
+			int bandMaxY = std::min(height, bandMinY + BAND_HEIGHT) - 1;
+			std::fill(depth.begin() + (size_t)bandMinY * width, depth.begin() + (size_t)(bandMaxY + 1) * width, 1.0f);
+			for (uint32_t index : bands[band])
+			{
+				const Triangle& t = triangles[index];
+				int minY = std::max(t.minY, bandMinY), maxY = std::min(t.maxY, bandMaxY);
+#ifdef OCCLUSION_SSE2
+				if (simd)
+				{
+					rasterizeSse2(t, minY, maxY, depth);
+					continue;
+				}
+#endif
+				for (int y = minY; y <= maxY; y++)
+				{
+					float py = y + 0.5f;
+					float* row = &depth[(size_t)y * width];
+					for (int x = t.minX; x <= t.maxX; x++)
+					{
+						float px = x + 0.5f;
+						bool inside = true;
+						for (int e = 0; e < 3; e++)
+							inside = inside && t.edge[e][0] * px + t.edge[e][1] * py + t.edge[e][2] >= 0.0f;
+						if (inside)
+							row[x] = std::min(row[x], t.depth[0] * px + t.depth[1] * py + t.depth[2]);
+					}
+				}
+			}
+		}
+	}
+
+#ifdef OCCLUSION_SSE2
+	void rasterizeSse2(const Triangle& t, int minY, int maxY, std::vector<float>& depth) const
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 edgeX[3], edgeY[3], edgeC[3];
+		for (int e = 0; e < 3; e++)
+		{
+			edgeX[e] = _mm_set1_ps(t.edge[e][0]);
+			edgeY[e] = _mm_set1_ps(t.edge[e][1]);
+			edgeC[e] = _mm_set1_ps(t.edge[e][2]);
+		}
+		const __m128 depthX = _mm_set1_ps(t.depth[0]);
+		const __m128 depthY = _mm_set1_ps(t.depth[1]);
+		const __m128 depthC = _mm_set1_ps(t.depth[2]);
+		int firstX = t.minX & ~3;
+		for (int y = minY; y <= maxY; y++)
+		{
+			__m128 py = _mm_set1_ps(y + 0.5f);
+			__m128 rowEdge[3];
+			for (int e = 0; e < 3; e++)
+				rowEdge[e] = _mm_add_ps(_mm_mul_ps(edgeY[e], py), edgeC[e]);
+			__m128 rowDepth = _mm_add_ps(_mm_mul_ps(depthY, py), depthC);
+			float* row = &depth[(size_t)y * width];
+			for (int x = firstX; x <= t.maxX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+				__m128 covered = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[0], px), rowEdge[0]), zero);
+				covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[1], px), rowEdge[1]), zero));
+				covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[2], px), rowEdge[2]), zero));
+				if (_mm_movemask_ps(covered) == 0)
+					continue;
+				// uncovered lanes take the clear value, which never wins the min
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthX, px), rowDepth);
+				z = _mm_or_ps(_mm_and_ps(covered, z), _mm_andnot_ps(covered, one));
+				_mm_storeu_ps(row + x, _mm_min_ps(_mm_loadu_ps(row + x), z));
+			}
+		}
+	}
+#endif
+
+	void buildPyramid()
+	{
+		for (size_t l = 1; l < levels.size(); l++)
+		{
+			const Level& source = levels[l - 1];
+			Level& level = levels[l];
+			for (int y = 0; y < level.height; y++)
+			{
+				int y0 = y * 2, y1 = std::min(y * 2 + 1, source.height - 1);
+				for (int x = 0; x < level.width; x++)
+				{
+					int x0 = x * 2, x1 = std::min(x * 2 + 1, source.width - 1);
+					level.depth[(size_t)y * level.width + x] = std::max(
+						std::max(source.depth[(size_t)y0 * source.width + x0], source.depth[(size_t)y0 * source.width + x1]),
+						std::max(source.depth[(size_t)y1 * source.width + x0], source.depth[(size_t)y1 * source.width + x1]));
+				}
+			}
+		}
+	}
+};
+
+#endif
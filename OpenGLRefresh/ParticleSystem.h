@@ -0,0 +1,580 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "AssetCache.h"
+#include "JobSystem.h"
+#include "MipBuilder.h"
+#include "PostProcess.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#define PARTICLE_SYSTEM_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define PARTICLE_AVX2_FUNCTION
+#else
+#define PARTICLE_AVX2_FUNCTION __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+// Sparks for effects, up to a million alive. Every particle lives equally long, so they
+// die in the order they were emitted: the state is a ring of structure-of-arrays streams
+// (position, velocity, remaining life) with the oldest particle at 'first', emission
+// appends behind the newest and retiring only moves 'first'. Nothing is ever compacted.
+struct ParticleSettings
+{
+	size_t capacity = 1 << 20;  // most particles alive at once, emission fills it up
+	float lifetime = 2.0f;      // seconds
+	float speed = 2.5f;
+	float spread = 0.4f;        // radius of the emission cone at unit height
+	float size = 0.015f;        // billboard half size
+	float drag = 0.2f;          // fraction of the velocity lost per second
+	float bounce = 0.4f;        // fraction of the vertical speed kept off the floor
+	float floorHeight = -0.5f;  // the cube stands on it
+	glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+	float intensity = 0.6f;     // of the additive glow
+	bool simd = true;           // false forces the scalar loops, for benchmarking
+	bool gpu = false;           // simulate in a compute shader (ComputeApi) instead
+};
+
+// summed over frames
+struct ParticleStats
+{
+	uint64_t frames = 0;
+	uint64_t updated = 0;      // particle updates
+	uint64_t emitted = 0;
+	uint64_t uploadBytes = 0;  // what went to the GPU: instances (CPU path) or new particles (GPU path)
+	double updateMs = 0.0;     // CPU time of the updates including the instance writes
+	double emitMs = 0.0;
+	double seconds = 0.0;      // simulated time
+};
+
+// the CPU side without any GL, the viewer's ParticleSystem and the benchmark share it
+class ParticleSimulation
+{
+public:
+	explicit ParticleSimulation(const ParticleSettings& settings = ParticleSettings())
+		: settings(settings), random(1)
+	{
+		for (std::vector<float>* stream : { &position[0], &position[1], &position[2], &velocity[0], &velocity[1], &velocity[2], &life })
+			stream->resize(settings.capacity);
+	}
+
+	static bool hasSimd() { return mipCpuHasAvx2(); }
+
+	// back to no particles and the random sequence from the start, the statistics stay
+	void reset()
+	{
+		first = count = newFirst = newCount = 0;
+		time = 0.0;
+		emitCarry = 0.0f;
+		batches.clear();
+		random.seed(1);
+	}
+
+	// retires what has lived 'lifetime' and emits capacity / lifetime particles per second
+	// at 'origin', spread over the frame so a fast emitter leaves a trail and not clumps
+	void emit(const glm::vec3& origin, float deltaTime)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		time += deltaTime;
+		stats.seconds += deltaTime;
+		while (!batches.empty() && batches.front().death <= time)
+		{
+			first = (first + batches.front().count) % settings.capacity;
+			count -= batches.front().count;
+			batches.pop_front();
+		}
+
+		emitCarry += (float)settings.capacity / settings.lifetime * deltaTime;
+		size_t emitting = std::min((size_t)emitCarry, settings.capacity - count);
+		emitCarry -= (float)(size_t)emitCarry;
+		newFirst = (first + count) % settings.capacity;
+		newCount = emitting;
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (size_t i = 0; i < emitting; i++)
+		{
+			size_t slot = (newFirst + i) % settings.capacity;
+			float angle = 6.2831853f * unit(random);
+			float radius = settings.spread * std::sqrt(unit(random));
+			glm::vec3 direction = glm::normalize(glm::vec3(radius * std::cos(angle), 1.0f, radius * std::sin(angle)));
+			glm::vec3 v = direction * settings.speed * (0.75f + 0.5f * unit(random));
+			float age = deltaTime * unit(random); // emitted this long before the end of the frame
+			glm::vec3 p = origin + glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f) * 0.2f + v * age;
+			for (int c = 0; c < 3; c++)
+			{
+				position[c][slot] = p[c];
+				velocity[c][slot] = v[c];
+			}
+			life[slot] = settings.lifetime - age;
+		}
+		if (emitting > 0)
+			batches.push_back({ time + settings.lifetime, emitting });
+		count += emitting;
+		stats.emitted += emitting;
+		stats.emitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	}
+
+	// one step for every live particle, on the job system when there is one. With
+	// 'instances' each particle also writes (position, remaining life) there, oldest first,
+	// 16 bytes apiece: the billboards' instance data, straight into a mapped buffer.
+	void update(float deltaTime, float* instances, JobSystem* jobs)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		Step step;
+		step.deltaTime = deltaTime;
+		step.gravity = settings.gravity * deltaTime;
+		step.damping = std::max(0.0f, 1.0f - settings.drag * deltaTime);
+		step.floorHeight = settings.floorHeight;
+		step.bounce = settings.bounce;
+		bool avx2 = settings.simd && hasSimd();
+		// [begin, end) in age order, split where the ring wraps
+		auto updateRange = [&](size_t rangeBegin, size_t rangeEnd)
+		{
+			while (rangeBegin < rangeEnd)
+			{
+				size_t slot = (first + rangeBegin) % settings.capacity;
+				size_t slots = std::min(rangeEnd - rangeBegin, settings.capacity - slot);
+				float* out = instances ? instances + rangeBegin * 4 : nullptr;
+#ifdef PARTICLE_SYSTEM_AVX2
+				if (avx2)
+					updateAvx2(step, slot, slot + slots, out);
+				else
+#endif
+					updateScalar(step, slot, slot + slots, out);
+				rangeBegin += slots;
+			}
+		};
+		if (jobs)
+			jobs->parallelFor(count, jobs->suggestedGrain(count, 4096), [&](size_t rangeBegin, size_t rangeEnd, size_t, unsigned int) { updateRange(rangeBegin, rangeEnd); });
+		else
+			updateRange(0, count);
+		stats.frames++;
+		stats.updated += count;
+		if (instances)
+			stats.uploadBytes += count * 16;
+		stats.updateMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	}
+
+	size_t size() const { return count; }
+	size_t capacity() const { return settings.capacity; }
+	// slot of the oldest particle, the others follow it around the ring
+	size_t firstSlot() const { return first; }
+	// what the last emit() added
+	size_t emittedFirstSlot() const { return newFirst; }
+	size_t emittedCount() const { return newCount; }
+	const ParticleSettings& configuration() const { return settings; }
+
+	// slot's state as (position, life) and (velocity, 0), how the compute path stores it
+	void pack(size_t slot, float* positionLife, float* velocity4) const
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			positionLife[c] = position[c][slot];
+			velocity4[c] = velocity[c][slot];
+		}
+		positionLife[3] = life[slot];
+		velocity4[3] = 0.0f;
+	}
+
+	ParticleStats stats;
+
+private:
+	struct Step
+	{
+		float deltaTime;
+		glm::vec3 gravity; // times deltaTime
+		float damping;     // velocity kept over the step
+		float floorHeight;
+		float bounce;
+	};
+	struct Batch
+	{
+		double death;
+		size_t count;
+	};
+
+	ParticleSettings settings;
+	std::vector<float> position[3];
+	std::vector<float> velocity[3];
+	std::vector<float> life;
+	size_t first = 0;
+	size_t count = 0;
+	size_t newFirst = 0;
+	size_t newCount = 0;
+	double time = 0.0;
+	float emitCarry = 0.0f;
+	std::deque<Batch> batches; // one per frame that emitted, oldest first
+	std::mt19937 random;
+
+	void updateScalar(const Step& step, size_t begin, size_t end, float* out)
+	{
+		float* px = position[0].data();
+		float* py = position[1].data();
+		float* pz = position[2].data();
+		float* vx = velocity[0].data();
+		float* vy = velocity[1].data();
+		float* vz = velocity[2].data();
+		float* l = life.data();
+		for (size_t i = begin; i < end; i++)
+		{
+			vx[i] = (vx[i] + step.gravity.x) * step.damping;
+			vy[i] = (vy[i] + step.gravity.y) * step.damping;
+			vz[i] = (vz[i] + step.gravity.z) * step.damping;
+			px[i] += vx[i] * step.deltaTime;
+			py[i] += vy[i] * step.deltaTime;
+			pz[i] += vz[i] * step.deltaTime;
+			if (py[i] < step.floorHeight)
+			{
+				py[i] = step.floorHeight;
+				vy[i] = -vy[i] * step.bounce;
+			}
+			l[i] -= step.deltaTime;
+			if (out)
+			{
+				float* instance = out + (i - begin) * 4;
+				instance[0] = px[i];
+				instance[1] = py[i];
+				instance[2] = pz[i];
+				instance[3] = l[i];
+			}
+		}
+	}
+
+#ifdef PARTICLE_SYSTEM_AVX2
+	// 8 particles per step, the instances are transposed to (x, y, z, life) in registers
+	PARTICLE_AVX2_FUNCTION void updateAvx2(const Step& step, size_t begin, size_t end, float* out)
+	{
+		float* px = position[0].data();
+		float* py = position[1].data();
+		float* pz = position[2].data();
+		float* vx = velocity[0].data();
+		float* vy = velocity[1].data();
+		float* vz = velocity[2].data();
+		float* l = life.data();
+		const __m256 dt = _mm256_set1_ps(step.deltaTime);
+		const __m256 gx = _mm256_set1_ps(step.gravity.x);
+		const __m256 gy = _mm256_set1_ps(step.gravity.y);
+		const __m256 gz = _mm256_set1_ps(step.gravity.z);
+		const __m256 damping = _mm256_set1_ps(step.damping);
+		const __m256 floorHeight = _mm256_set1_ps(step.floorHeight);
+		const __m256 bounce = _mm256_set1_ps(-step.bounce);
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+			__m256 velocityX = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vx + i), gx), damping);
+			__m256 velocityY = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vy + i), gy), damping);
+			__m256 velocityZ = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vz + i), gz), damping);
+			x = _mm256_fmadd_ps(velocityX, dt, x);
+			y = _mm256_fmadd_ps(velocityY, dt, y);
+			z = _mm256_fmadd_ps(velocityZ, dt, z);
+			__m256 below = _mm256_cmp_ps(y, floorHeight, _CMP_LT_OQ);
+			y = _mm256_blendv_ps(y, floorHeight, below);
+			velocityY = _mm256_blendv_ps(velocityY, _mm256_mul_ps(velocityY, bounce), below);
+			__m256 remaining = _mm256_sub_ps(_mm256_loadu_ps(l + i), dt);
+			_mm256_storeu_ps(px + i, x);
+			_mm256_storeu_ps(py + i, y);
+			_mm256_storeu_ps(pz + i, z);
+			_mm256_storeu_ps(vx + i, velocityX);
+			_mm256_storeu_ps(vy + i, velocityY);
+			_mm256_storeu_ps(vz + i, velocityZ);
+			_mm256_storeu_ps(l + i, remaining);
+			if (out)
+			{
+				// rows (x y z l) of particles 0/4, 1/5, 2/6 and 3/7, then pairs of whole rows
+				__m256 xy0 = _mm256_unpacklo_ps(x, y), xy1 = _mm256_unpackhi_ps(x, y);
+				__m256 zl0 = _mm256_unpacklo_ps(z, remaining), zl1 = _mm256_unpackhi_ps(z, remaining);
+				__m256 p04 = _mm256_shuffle_ps(xy0, zl0, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 p15 = _mm256_shuffle_ps(xy0, zl0, _MM_SHUFFLE(3, 2, 3, 2));
+				__m256 p26 = _mm256_shuffle_ps(xy1, zl1, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 p37 = _mm256_shuffle_ps(xy1, zl1, _MM_SHUFFLE(3, 2, 3, 2));
+				float* instance = out + (i - begin) * 4;
+				_mm256_storeu_ps(instance, _mm256_permute2f128_ps(p04, p15, 0x20));
+				_mm256_storeu_ps(instance + 8, _mm256_permute2f128_ps(p26, p37, 0x20));
+				_mm256_storeu_ps(instance + 16, _mm256_permute2f128_ps(p04, p15, 0x31));
+				_mm256_storeu_ps(instance + 24, _mm256_permute2f128_ps(p26, p37, 0x31));
+			}
+		}
+		if (i < end)
+			updateScalar(step, i, end, out ? out + (i - begin) * 4 : nullptr);
+	}
+#endif
+};
+
+// The viewer's particles: simulated on the CPU (job system, AVX2) with the instance data
+// written straight into a StreamBuffer range, or with settings.gpu in a compute shader
+// on two shader storage buffers that the billboards then read as instance attributes.
+// There only the particles emitted this frame are uploaded. Either way the billboards
+// are one instanced triangle strip per draw, blended additively without depth writes.
+class ParticleSystem
+{
+public:
+	// 'defines' are the base defines ShaderCheck validates the shaders with, so --spirv finds them
+	ParticleSystem(const ParticleSettings& settings, const std::string& defines, AssetCache* cache = nullptr)
+		: simulation(settings), stream(gpuSupported(settings) ? 0 : settings.capacity * 16 * 3), simulateTimer({ "simulate" })
+	{
+		useGpu = gpuSupported(settings);
+		if (settings.gpu && !useGpu)
+			std::cout << "Compute shaders or storage buffers are not supported, simulating the particles on the CPU" << std::endl;
+
+		renderProgram = Shader("shaders/particle.vs", "shaders/particle.fs", defines, cache).ID;
+		projectionLocation = Shader::uniformLocation(renderProgram, "projection");
+		viewLocation = Shader::uniformLocation(renderProgram, "view");
+		glUseProgram(renderProgram);
+		glUniform1f(Shader::uniformLocation(renderProgram, "size"), settings.size);
+		glUniform1f(Shader::uniformLocation(renderProgram, "lifetime"), settings.lifetime);
+		glUniform1f(Shader::uniformLocation(renderProgram, "intensity"), settings.intensity);
+		if (useGpu)
+		{
+			simulateProgram = Shader::compute("shaders/particles.comp", defines, cache).ID;
+			glUseProgram(simulateProgram);
+			glUniform1i(Shader::uniformLocation(simulateProgram, "capacity"), (GLint)settings.capacity);
+			glUniform3fv(Shader::uniformLocation(simulateProgram, "gravity"), 1, &settings.gravity[0]);
+			glUniform1f(Shader::uniformLocation(simulateProgram, "floorHeight"), settings.floorHeight);
+			glUniform1f(Shader::uniformLocation(simulateProgram, "bounce"), settings.bounce);
+			firstLocation = Shader::uniformLocation(simulateProgram, "first");
+			countLocation = Shader::uniformLocation(simulateProgram, "count");
+			deltaTimeLocation = Shader::uniformLocation(simulateProgram, "deltaTime");
+			dampingLocation = Shader::uniformLocation(simulateProgram, "damping");
+			glGenBuffers(2, stateBuffers);
+			for (GLuint buffer : stateBuffers)
+			{
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+				glBufferData(GL_SHADER_STORAGE_BUFFER, settings.capacity * 16, NULL, GL_DYNAMIC_DRAW);
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+		glUseProgram(0);
+
+		// the corners come from gl_VertexID, the only attribute is the instance's
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glEnableVertexAttribArray(0);
+		glVertexAttribDivisor(0, 1);
+		glBindVertexArray(0);
+	}
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	bool gpu() const { return useGpu; }
+
+	// starts over with nothing emitted; the state buffers keep their contents, emission
+	// overwrites the slots before they are read
+	void reset()
+	{
+		simulation.reset();
+		instanceCount = 0;
+	}
+
+	// emits at 'origin' and advances everything by 'deltaTime', before the scene pass. Long
+	// frames (the first one, a stall) are simulated as 0.1 s, more would only be a burst.
+	void update(const glm::vec3& origin, float deltaTime, JobSystem* jobs)
+	{
+		deltaTime = std::min(std::max(deltaTime, 0.0f), 0.1f);
+		simulation.emit(origin, deltaTime);
+		if (useGpu)
+		{
+			simulateGpu(deltaTime);
+			return;
+		}
+		instanceCount = simulation.size();
+		if (instanceCount == 0)
+		{
+			simulation.update(deltaTime, nullptr, jobs);
+			return;
+		}
+		size_t offset = 0;
+		float* instances = (float*)stream.map(instanceCount * 16, 16, offset);
+		if (!instances)
+		{
+			instanceCount = 0;
+			return;
+		}
+		simulation.update(deltaTime, instances, jobs);
+		stream.unmap();
+		instanceOffset = offset;
+	}
+
+	// inside the scene pass, with its render target bound
+	void draw(const glm::mat4& projection, const glm::mat4& view)
+	{
+		size_t count = useGpu ? simulation.size() : instanceCount;
+		if (count == 0)
+			return;
+		glUseProgram(renderProgram);
+		glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, &projection[0][0]);
+		glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &view[0][0]);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		glDepthMask(GL_FALSE);
+		glBindVertexArray(vao);
+		if (useGpu)
+		{
+			// the ring as it is in the state buffer, in up to two pieces
+			glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[0]);
+			size_t first = simulation.firstSlot();
+			size_t head = std::min(count, simulation.capacity() - first);
+			drawInstances(first * 16, head);
+			if (head < count)
+				drawInstances(0, count - head);
+		}
+		else
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, stream.id());
+			drawInstances(instanceOffset, count);
+		}
+		glBindVertexArray(0);
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+
+	// once the frame's draws are submitted
+	void endFrame()
+	{
+		if (!useGpu)
+			stream.endFrame();
+	}
+
+	void printStats() const
+	{
+		const ParticleStats& stats = simulation.stats;
+		if (stats.frames == 0)
+			return;
+		double frames = (double)stats.frames;
+		double alive = (double)stats.updated / frames;
+		if (useGpu)
+		{
+			double ms = simulateTimer.averageMs(0);
+			std::printf("Particles (compute shader, averages over %llu frames): %.0f alive of %zu\n", (unsigned long long)stats.frames, alive, simulation.capacity());
+			std::printf("  simulation %.3f ms GPU, %.0f particles per ms\n", ms, ms > 0.0 ? alive / ms : 0.0);
+		}
+		else
+		{
+			bool avx2 = simulation.configuration().simd && ParticleSimulation::hasSimd();
+			double ms = stats.updateMs / frames;
+			std::printf("Particles (%s on the job system, averages over %llu frames): %.0f alive of %zu\n", avx2 ? "AVX2" : "scalar", (unsigned long long)stats.frames, alive, simulation.capacity());
+			std::printf("  update %.3f ms CPU, %.0f particles per ms, instances written at %.2f GB/s\n", ms, ms > 0.0 ? alive / ms : 0.0,
+				stats.updateMs > 0.0 ? (double)stats.uploadBytes / (stats.updateMs * 1e6) : 0.0);
+			const StreamBuffer::Stats& streamStats = stream.statistics();
+			std::printf("  stream ring %zu KB, %llu waits (%.3f ms), %llu grows\n", stream.size() / 1024, (unsigned long long)streamStats.waits, streamStats.waitMs, (unsigned long long)streamStats.grows);
+		}
+		std::printf("  emission %.3f ms CPU, %.0f new particles per frame\n", stats.emitMs / frames, (double)stats.emitted / frames);
+		std::printf("  upload %.1f KB per frame, %.1f MB/s\n", (double)stats.uploadBytes / frames / 1024.0,
+			stats.seconds > 0.0 ? (double)stats.uploadBytes / stats.seconds / 1e6 : 0.0);
+	}
+
+	void release()
+	{
+		glDeleteProgram(renderProgram);
+		if (simulateProgram != 0)
+			glDeleteProgram(simulateProgram);
+		renderProgram = simulateProgram = 0;
+		if (stateBuffers[0] != 0)
+			glDeleteBuffers(2, stateBuffers);
+		stateBuffers[0] = stateBuffers[1] = 0;
+		glDeleteVertexArrays(1, &vao);
+		vao = 0;
+		stream.release();
+		simulateTimer.release();
+	}
+
+	ParticleSimulation simulation;
+
+private:
+	StreamBuffer stream;
+	GpuPassTimer simulateTimer;
+	bool useGpu = false;
+	GLuint renderProgram = 0;
+	GLuint simulateProgram = 0;
+	GLuint stateBuffers[2] = {}; // (position, life) and (velocity, 0) of every slot
+	GLuint vao = 0;
+	GLint projectionLocation = -1;
+	GLint viewLocation = -1;
+	GLint firstLocation = -1;
+	GLint countLocation = -1;
+	GLint deltaTimeLocation = -1;
+	GLint dampingLocation = -1;
+	size_t instanceOffset = 0;
+	size_t instanceCount = 0;
+	std::vector<float> staging;
+
+	// the simulation shader keeps the state in storage buffers (core in 4.3 like compute)
+	static bool gpuSupported(const ParticleSettings& settings)
+	{
+		return settings.gpu && ComputeApi::instance().supported
+			&& (glContextVersion() >= 43 || glHasExtension("GL_ARB_shader_storage_buffer_object"));
+	}
+
+	void drawInstances(size_t offset, size_t count)
+	{
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 16, (void*)offset);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+	}
+
+	// the new particles go into their slots of the state buffers, then one invocation
+	// per live particle steps it where it is
+	void simulateGpu(float deltaTime)
+	{
+		ParticleStats& stats = simulation.stats;
+		size_t emitted = simulation.emittedCount();
+		size_t slot = simulation.emittedFirstSlot();
+		while (emitted > 0)
+		{
+			size_t slots = std::min(emitted, simulation.capacity() - slot);
+			staging.resize(slots * 8);
+			for (size_t i = 0; i < slots; i++)
+				simulation.pack(slot + i, &staging[i * 4], &staging[(slots + i) * 4]);
+			for (int b = 0; b < 2; b++)
+			{
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateBuffers[b]);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, slot * 16, slots * 16, &staging[b * slots * 4]);
+			}
+			stats.uploadBytes += slots * 32;
+			emitted -= slots;
+			slot = 0;
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		size_t count = simulation.size();
+		stats.frames++;
+		stats.updated += count;
+		if (count == 0)
+			return;
+		simulateTimer.beginFrame();
+		simulateTimer.mark(0);
+		glUseProgram(simulateProgram);
+		glUniform1i(firstLocation, (GLint)simulation.firstSlot());
+		glUniform1i(countLocation, (GLint)count);
+		glUniform1f(deltaTimeLocation, deltaTime);
+		glUniform1f(dampingLocation, std::max(0.0f, 1.0f - simulation.configuration().drag * deltaTime));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, stateBuffers[0]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, stateBuffers[1]);
+		ComputeApi::instance().dispatchCompute((GLuint)((count + 255) / 256), 1, 1);
+		ComputeApi::instance().memoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		simulateTimer.mark(1);
+		simulateTimer.endFrame();
+		glUseProgram(0);
+	}
+};
+
+#endif
@@ -0,0 +1,433 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "AssetCache.h"
+#include "FrameGraph.h"
+#include "ShaderVariants.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum class Tonemapper
+{
+	Aces,
+	Agx
+};
+
+inline bool parseTonemapper(const std::string& name, Tonemapper& tonemapper)
+{
+	if (name == "aces")
+		tonemapper = Tonemapper::Aces;
+	else if (name == "agx")
+		tonemapper = Tonemapper::Agx;
+	else
+		return false;
+	return true;
+}
+
+// GPU time between marks within a frame, from GL_TIMESTAMP queries. Unlike GL_TIME_ELAPSED
+// these nest inside other timers (DynamicResolution's frame timer). A ring of frames is
+// in flight and read once available; with all of them pending a frame goes unmeasured.
+class GpuPassTimer
+{
+public:
+	static const int RING = 4;
+
+	// 'names' are the spans between consecutive marks, mark(names.size()) ends the last
+	explicit GpuPassTimer(const std::vector<std::string>& names)
+		: names(names), averages(names.size(), 0.0)
+	{
+	}
+	GpuPassTimer(const GpuPassTimer&) = delete;
+	GpuPassTimer& operator=(const GpuPassTimer&) = delete;
+
+	void beginFrame()
+	{
+		if (queries.empty())
+		{
+			queries.resize(RING * (names.size() + 1));
+			glGenQueries((GLsizei)queries.size(), queries.data());
+		}
+		poll();
+		slot = (int)(frame % RING);
+		recording = !pending[slot];
+	}
+
+	void mark(size_t index)
+	{
+		if (recording)
+			glQueryCounter(queries[slot * (names.size() + 1) + index], GL_TIMESTAMP);
+	}
+
+	void endFrame()
+	{
+		pending[slot] = recording;
+		recording = false;
+		frame++;
+	}
+
+	// exponential average over roughly the last 30 measured frames
+	double averageMs(size_t span) const { return averages[span]; }
+	const std::vector<std::string>& spans() const { return names; }
+	uint64_t measuredFrames() const { return measured; }
+
+	void release()
+	{
+		if (!queries.empty())
+			glDeleteQueries((GLsizei)queries.size(), queries.data());
+		queries.clear();
+		std::fill(pending, pending + RING, false);
+	}
+
+private:
+	std::vector<std::string> names;
+	std::vector<double> averages;
+	std::vector<GLuint> queries;
+	bool pending[RING] = {};
+	int slot = 0;
+	bool recording = false;
+	uint64_t frame = 0;
+	uint64_t measured = 0;
+
+	void poll()
+	{
+		size_t marks = names.size() + 1;
+		for (int s = 0; s < RING; s++)
+		{
+			if (!pending[s])
+				continue;
+			GLint available = 0;
+			glGetQueryObjectiv(queries[s * marks + marks - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+			std::vector<GLuint64> times(marks);
+			for (size_t m = 0; m < marks; m++)
+				glGetQueryObjectui64v(queries[s * marks + m], GL_QUERY_RESULT, &times[m]);
+			for (size_t span = 0; span < names.size(); span++)
+			{
+				double ms = (times[span + 1] - times[span]) / 1e6;
+				averages[span] = measured == 0 ? ms : averages[span] + (ms - averages[span]) / 30.0;
+			}
+			measured++;
+			pending[s] = false;
+		}
+	}
+};
+
+// HDR post processing, all but the last pass in compute shaders (ComputeApi):
+//
+//   scene (RGBA16F) -> bloom down 0..4 -> bloom up 3..0 -> tonemap -> fxaa -> output
+//
+// The bloom pyramid is R11F_G11F_B10F, half the bytes of RGBA16F. The tonemap pass does
+// bloom's last upsample, the composite and the tonemapping curve at once and stores the
+// luma FXAA needs in alpha, so no full size HDR image is written after the scene. FXAA
+// is a fragment pass since it writes the final pixels, which may be the default
+// framebuffer. Everything works on the bottom left renderWidth x renderHeight of full
+// size textures, the same way DynamicResolution's Upscaler does.
+class PostChain
+{
+public:
+	static const int BLOOM_LEVELS = 5;
+
+	// 'defines' are the base defines ShaderCheck validates the shaders with, so --spirv finds them
+	PostChain(Tonemapper tonemapper, const std::string& defines, AssetCache* cache = nullptr)
+		: timer({ "bloom prefilter", "bloom downsample", "bloom upsample", "tonemap", "fxaa" })
+	{
+		prefilterProgram = Shader::compute("shaders/bloom_downsample.comp", ShaderVariants::bloomPrefilter(defines), cache).ID;
+		downsampleProgram = Shader::compute("shaders/bloom_downsample.comp", defines, cache).ID;
+		upsampleProgram = Shader::compute("shaders/bloom_upsample.comp", defines, cache).ID;
+		tonemapProgram = Shader::compute("shaders/tonemap.comp", ShaderVariants::tonemap(tonemapper == Tonemapper::Agx, defines), cache).ID;
+		fxaaProgram = Shader("shaders/fullscreen.vs", "shaders/fxaa.fs", defines, cache).ID;
+		for (GLuint program : { prefilterProgram, downsampleProgram, upsampleProgram, tonemapProgram, fxaaProgram })
+		{
+			glUseProgram(program);
+			glUniform1i(Shader::uniformLocation(program, "source"), 0);
+			glUniform1i(Shader::uniformLocation(program, "scene"), 0);
+			glUniform1i(Shader::uniformLocation(program, "current"), 1);
+			glUniform1i(Shader::uniformLocation(program, "bloom"), 1);
+		}
+		glUseProgram(0);
+		thresholdLocation = Shader::uniformLocation(prefilterProgram, "threshold");
+		for (GLuint program : { prefilterProgram, downsampleProgram, upsampleProgram })
+		{
+			sourceSizeLocations.push_back(Shader::uniformLocation(program, "sourceSize"));
+			destinationSizeLocations.push_back(Shader::uniformLocation(program, "destinationSize"));
+		}
+		renderSizeLocation = Shader::uniformLocation(tonemapProgram, "renderSize");
+		bloomSizeLocation = Shader::uniformLocation(tonemapProgram, "bloomSize");
+		bloomStrengthLocation = Shader::uniformLocation(tonemapProgram, "bloomStrength");
+		exposureLocation = Shader::uniformLocation(tonemapProgram, "exposure");
+		fxaaRenderSizeLocation = Shader::uniformLocation(fxaaProgram, "renderSize");
+		// the full screen triangle comes from gl_VertexID, core profile still wants a VAO
+		glGenVertexArrays(1, &emptyVao);
+	}
+	PostChain(const PostChain&) = delete;
+	PostChain& operator=(const PostChain&) = delete;
+
+	float exposure = 1.0f;
+	float bloomStrength = 0.05f;
+	float bloomThreshold = 1.0f; // scene values above this bloom, the specular highlights do
+	float bloomKnee = 0.5f;
+
+	// 'output' FRAME_GRAPH_INVALID makes the chain create an RGBA8 texture of the scene's
+	// size, e.g. for the upscaler. Returns the output.
+	FrameGraphResource addPasses(FrameGraph& graph, FrameGraphResource scene, FrameGraphResource output, const FrameGraphTextureDesc& desc, int renderWidth, int renderHeight)
+	{
+		// the passes run later this frame, what they need of it is kept in members
+		sceneResource = scene;
+		renderSize = glm::vec2((float)renderWidth, (float)renderHeight);
+		FrameGraphTextureDesc levelDescs[BLOOM_LEVELS];
+		FrameGraphTextureDesc levelDesc = desc;
+		levelDesc.internalFormat = GL_R11F_G11F_B10F;
+		int width = renderWidth, height = renderHeight;
+		for (int level = 0; level < BLOOM_LEVELS; level++)
+		{
+			levelDesc.width = std::max(1, levelDesc.width / 2);
+			levelDesc.height = std::max(1, levelDesc.height / 2);
+			levelDescs[level] = levelDesc;
+			// rounded up so the odd edge texel still lands somewhere
+			width = std::min(levelDesc.width, (width + 1) / 2);
+			height = std::min(levelDesc.height, (height + 1) / 2);
+			levelSize[level] = glm::vec2((float)width, (float)height);
+		}
+
+		for (int level = 0; level < BLOOM_LEVELS; level++)
+		{
+			graph.addPass("bloom down " + std::to_string(level), [&](FrameGraph::PassBuilder& builder)
+			{
+				builder.read(level == 0 ? scene : down[level - 1]);
+				down[level] = builder.create("bloom down " + std::to_string(level), levelDescs[level]);
+				builder.write(down[level], FrameGraphAccess::Image);
+			},
+			[this, level](const FrameGraphContext& context)
+			{
+				if (level == 0)
+				{
+					timer.beginFrame();
+					timer.mark(0);
+				}
+				else if (level == 1)
+					timer.mark(1);
+				int program = level == 0 ? 0 : 1;
+				glUseProgram(level == 0 ? prefilterProgram : downsampleProgram);
+				if (level == 0)
+				{
+					float knee = std::max(bloomKnee, 1e-4f);
+					glUniform4f(thresholdLocation, bloomThreshold, bloomThreshold - knee, 2.0f * knee, 0.25f / knee);
+				}
+				glm::vec2 sourceSize = level == 0 ? renderSize : levelSize[level - 1];
+				glUniform2f(sourceSizeLocations[program], sourceSize.x, sourceSize.y);
+				glUniform2f(destinationSizeLocations[program], levelSize[level].x, levelSize[level].y);
+				bindTextures(context.texture(level == 0 ? sceneResource : down[level - 1]), 0);
+				dispatch(context.texture(down[level]), GL_R11F_G11F_B10F, levelSize[level]);
+			});
+		}
+
+		// the smallest level is its own upsample
+		up[BLOOM_LEVELS - 1] = down[BLOOM_LEVELS - 1];
+		for (int level = BLOOM_LEVELS - 2; level >= 0; level--)
+		{
+			graph.addPass("bloom up " + std::to_string(level), [&](FrameGraph::PassBuilder& builder)
+			{
+				builder.read(up[level + 1]);
+				builder.read(down[level]);
+				up[level] = builder.create("bloom up " + std::to_string(level), levelDescs[level]);
+				builder.write(up[level], FrameGraphAccess::Image);
+			},
+			[this, level](const FrameGraphContext& context)
+			{
+				if (level == BLOOM_LEVELS - 2)
+					timer.mark(2);
+				glUseProgram(upsampleProgram);
+				glUniform2f(sourceSizeLocations[2], levelSize[level + 1].x, levelSize[level + 1].y);
+				glUniform2f(destinationSizeLocations[2], levelSize[level].x, levelSize[level].y);
+				bindTextures(context.texture(up[level + 1]), context.texture(down[level]));
+				dispatch(context.texture(up[level]), GL_R11F_G11F_B10F, levelSize[level]);
+			});
+		}
+
+		graph.addPass("tonemap", [&](FrameGraph::PassBuilder& builder)
+		{
+			builder.read(scene);
+			builder.read(up[0]);
+			FrameGraphTextureDesc ldrDesc = desc;
+			ldrDesc.internalFormat = GL_RGBA8;
+			ldr = builder.create("tonemapped", ldrDesc);
+			builder.write(ldr, FrameGraphAccess::Image);
+		},
+		[this](const FrameGraphContext& context)
+		{
+			timer.mark(3);
+			glUseProgram(tonemapProgram);
+			glUniform2f(renderSizeLocation, renderSize.x, renderSize.y);
+			glUniform2f(bloomSizeLocation, levelSize[0].x, levelSize[0].y);
+			glUniform1f(bloomStrengthLocation, bloomStrength);
+			glUniform1f(exposureLocation, exposure);
+			bindTextures(context.texture(sceneResource), context.texture(up[0]));
+			dispatch(context.texture(ldr), GL_RGBA8, renderSize);
+		});
+
+		graph.addPass("fxaa", [&](FrameGraph::PassBuilder& builder)
+		{
+			builder.read(ldr);
+			if (output == FRAME_GRAPH_INVALID)
+			{
+				FrameGraphTextureDesc outputDesc = desc;
+				outputDesc.internalFormat = GL_RGBA8;
+				output = builder.create("post color", outputDesc);
+			}
+			builder.write(output);
+		},
+		[this](const FrameGraphContext& context)
+		{
+			timer.mark(4);
+			context.bindRenderTarget();
+			glViewport(0, 0, (GLsizei)renderSize.x, (GLsizei)renderSize.y);
+			glUseProgram(fxaaProgram);
+			glUniform2f(fxaaRenderSizeLocation, renderSize.x, renderSize.y);
+			bindTextures(context.texture(ldr), 0);
+			glDisable(GL_DEPTH_TEST);
+			glBindVertexArray(emptyVao);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glEnable(GL_DEPTH_TEST);
+			timer.mark(5);
+			timer.endFrame();
+		});
+		return output;
+	}
+
+	// Memory traffic of each pass per frame, counting every texel read once since the
+	// overlapping taps mostly hit the cache. 'fused' false is the same chain the plain
+	// way for comparison: an RGBA16F pyramid, bloom upsampled to full size, composited
+	// and tonemapped in passes of their own.
+	struct PassTraffic
+	{
+		std::string name;
+		double bytes;
+	};
+
+	static std::vector<PassTraffic> traffic(int width, int height, bool fused = true)
+	{
+		double pixels = (double)width * height;
+		double bloomBytes = fused ? 4.0 : 8.0;
+		double level[BLOOM_LEVELS];
+		for (int i = 0; i < BLOOM_LEVELS; i++)
+			level[i] = (double)std::max(1, width >> (i + 1)) * std::max(1, height >> (i + 1));
+
+		std::vector<PassTraffic> passes;
+		passes.push_back({ "bloom prefilter", pixels * 8.0 + level[0] * bloomBytes });
+		double bytes = 0.0;
+		for (int i = 1; i < BLOOM_LEVELS; i++)
+			bytes += (level[i - 1] + level[i]) * bloomBytes;
+		passes.push_back({ "bloom downsample", bytes });
+		bytes = 0.0;
+		for (int i = BLOOM_LEVELS - 2; i >= 0; i--)
+			bytes += (level[i + 1] + level[i] * 2.0) * bloomBytes;
+		passes.push_back({ "bloom upsample", bytes });
+		if (fused)
+			passes.push_back({ "tonemap", pixels * 8.0 + level[0] * bloomBytes + pixels * 4.0 });
+		else
+		{
+			passes.push_back({ "bloom upsample full", level[0] * bloomBytes + pixels * 8.0 });
+			passes.push_back({ "composite", pixels * 8.0 * 3.0 });
+			passes.push_back({ "tonemap", pixels * 8.0 + pixels * 4.0 });
+		}
+		passes.push_back({ "fxaa", pixels * 4.0 * 2.0 });
+		return passes;
+	}
+
+	void printStats(int width, int height) const
+	{
+		std::printf("Post processing GPU time (average of %llu measured frames):\n", (unsigned long long)timer.measuredFrames());
+		double total = 0.0;
+		for (size_t span = 0; span < timer.spans().size(); span++)
+		{
+			std::printf("  %-20s %8.3f ms\n", timer.spans()[span].c_str(), timer.averageMs(span));
+			total += timer.averageMs(span);
+		}
+		std::printf("  %-20s %8.3f ms\n", "total", total);
+
+		const int sizes[3][2] = { { width, height }, { 1920, 1080 }, { 3840, 2160 } };
+		std::vector<PassTraffic> columns[3];
+		double totals[3] = {}, unfused[3] = {};
+		for (int s = 0; s < 3; s++)
+		{
+			columns[s] = traffic(sizes[s][0], sizes[s][1]);
+			for (const PassTraffic& pass : columns[s])
+				totals[s] += pass.bytes;
+			for (const PassTraffic& pass : traffic(sizes[s][0], sizes[s][1], false))
+				unfused[s] += pass.bytes;
+		}
+		std::printf("Post processing traffic per frame (estimate, MB): %12s %12s %12s\n",
+			(std::to_string(width) + "x" + std::to_string(height)).c_str(), "1920x1080", "3840x2160");
+		for (size_t p = 0; p < columns[0].size(); p++)
+			std::printf("  %-46s %12.1f %12.1f %12.1f\n", columns[0][p].name.c_str(), columns[0][p].bytes / 1e6, columns[1][p].bytes / 1e6, columns[2][p].bytes / 1e6);
+		std::printf("  %-46s %12.1f %12.1f %12.1f\n", "total", totals[0] / 1e6, totals[1] / 1e6, totals[2] / 1e6);
+		std::printf("  %-46s %12.1f %12.1f %12.1f\n", "at 60 fps, GB/s", totals[0] * 60.0 / 1e9, totals[1] * 60.0 / 1e9, totals[2] * 60.0 / 1e9);
+		std::printf("  %-46s %12.1f %12.1f %12.1f\n", "unfused RGBA16F chain, total", unfused[0] / 1e6, unfused[1] / 1e6, unfused[2] / 1e6);
+	}
+
+	void release()
+	{
+		for (GLuint program : { prefilterProgram, downsampleProgram, upsampleProgram, tonemapProgram, fxaaProgram })
+			glDeleteProgram(program);
+		prefilterProgram = downsampleProgram = upsampleProgram = tonemapProgram = fxaaProgram = 0;
+		glDeleteVertexArrays(1, &emptyVao);
+		emptyVao = 0;
+		timer.release();
+	}
+
+private:
+	GpuPassTimer timer;
+	GLuint prefilterProgram = 0;
+	GLuint downsampleProgram = 0;
+	GLuint upsampleProgram = 0;
+	GLuint tonemapProgram = 0;
+	GLuint fxaaProgram = 0;
+	GLuint emptyVao = 0;
+	GLint thresholdLocation = -1;
+	std::vector<GLint> sourceSizeLocations; // prefilter, downsample, upsample
+	std::vector<GLint> destinationSizeLocations;
+	GLint renderSizeLocation = -1;
+	GLint bloomSizeLocation = -1;
+	GLint bloomStrengthLocation = -1;
+	GLint exposureLocation = -1;
+	GLint fxaaRenderSizeLocation = -1;
+
+	// this frame's resources
+	FrameGraphResource sceneResource = FRAME_GRAPH_INVALID;
+	FrameGraphResource down[BLOOM_LEVELS] = {};
+	FrameGraphResource up[BLOOM_LEVELS] = {};
+	FrameGraphResource ldr = FRAME_GRAPH_INVALID;
+	glm::vec2 renderSize = glm::vec2(0.0f);
+	glm::vec2 levelSize[BLOOM_LEVELS];
+
+	// 'first' on unit 0, 'second' (if any) on unit 1
+	static void bindTextures(GLuint first, GLuint second)
+	{
+		if (second != 0)
+		{
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, second);
+		}
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, first);
+	}
+
+	// one invocation per texel of the 'size' part of 'destination', in 8x8 groups
+	static void dispatch(GLuint destination, GLenum format, glm::vec2 size)
+	{
+		ComputeApi& api = ComputeApi::instance();
+		api.bindImageTexture(0, destination, 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
+		api.dispatchCompute(((GLuint)size.x + 7) / 8, ((GLuint)size.y + 7) / 8, 1);
+	}
+};
+
+#endif
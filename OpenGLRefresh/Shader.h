@@ -3,10 +3,146 @@
 
 #include <glad/glad.h>
 
+#include "AssetCache.h"
+#include "GLExtensions.h"
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
 #include <string>
 #include <fstream>
+#include <unordered_map>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+// glGetProgramBinary/glProgramBinary are core in 4.1 (ARB_get_program_binary before),
+// the 3.3 glad loader does not resolve them so main loads them through glfw
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_SHADER_BINARY_FORMAT_SPIR_V_ARB
+#define GL_SHADER_BINARY_FORMAT_SPIR_V_ARB 0x9551
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_FRAMEBUFFER_BARRIER_BIT
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#endif
+
+struct ProgramBinaryApi
+{
+	typedef void (APIENTRYP GetProgramBinaryFn)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+	typedef void (APIENTRYP ProgramBinaryFn)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+	typedef void (APIENTRYP ProgramParameteriFn)(GLuint program, GLenum pname, GLint value);
+
+	GetProgramBinaryFn getProgramBinary = nullptr;
+	ProgramBinaryFn programBinary = nullptr;
+	ProgramParameteriFn programParameteri = nullptr;
+	bool supported = false;
+
+	static ProgramBinaryApi& instance()
+	{
+		static ProgramBinaryApi api;
+		return api;
+	}
+
+	// call once the context is current, e.g. with glfwGetProcAddress
+	static void load(GLADloadproc getProcAddress)
+	{
+		ProgramBinaryApi& api = instance();
+		api.getProgramBinary = (GetProgramBinaryFn)getProcAddress("glGetProgramBinary");
+		api.programBinary = (ProgramBinaryFn)getProcAddress("glProgramBinary");
+		api.programParameteri = (ProgramParameteriFn)getProcAddress("glProgramParameteri");
+		GLint formats = 0;
+		if (api.getProgramBinary && api.programBinary && api.programParameteri)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		api.supported = formats > 0;
+	}
+};
+
+// GL_ARB_gl_spirv (core in 4.6): shaders straight from the SPIR-V ShaderCheck writes.
+// 'preferCompiled' makes Shader look for ShaderCheck's output first, SPIR-V where this
+// is supported and its optimized GLSL otherwise.
+struct SpirvApi
+{
+	typedef void (APIENTRYP ShaderBinaryFn)(GLsizei count, const GLuint* shaders, GLenum binaryFormat, const void* binary, GLsizei length);
+	typedef void (APIENTRYP SpecializeShaderFn)(GLuint shader, const GLchar* entryPoint, GLuint constantCount, const GLuint* constantIndices, const GLuint* constantValues);
+
+	ShaderBinaryFn shaderBinary = nullptr;
+	SpecializeShaderFn specializeShader = nullptr;
+	bool supported = false;
+	bool preferCompiled = false;
+
+	static SpirvApi& instance()
+	{
+		static SpirvApi api;
+		return api;
+	}
+
+	// call once the context is current, e.g. with glfwGetProcAddress
+	static void load(GLADloadproc getProcAddress)
+	{
+		SpirvApi& api = instance();
+		api.shaderBinary = (ShaderBinaryFn)getProcAddress("glShaderBinary");
+		api.specializeShader = (SpecializeShaderFn)getProcAddress("glSpecializeShaderARB");
+		if (!api.specializeShader)
+			api.specializeShader = (SpecializeShaderFn)getProcAddress("glSpecializeShader");
+		api.supported = api.shaderBinary && api.specializeShader && glHasExtension("GL_ARB_gl_spirv");
+	}
+};
+
+// compute shaders, image load/store and memory barriers (core in 4.2/4.3), none of which
+// the 3.3 glad loader resolves. FrameGraph issues the barriers between passes.
+struct ComputeApi
+{
+	typedef void (APIENTRYP DispatchComputeFn)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+	typedef void (APIENTRYP BindImageTextureFn)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+	typedef void (APIENTRYP MemoryBarrierFn)(GLbitfield barriers);
+
+	DispatchComputeFn dispatchCompute = nullptr;
+	BindImageTextureFn bindImageTexture = nullptr;
+	MemoryBarrierFn memoryBarrier = nullptr;
+	bool supported = false;
+
+	static ComputeApi& instance()
+	{
+		static ComputeApi api;
+		return api;
+	}
+
+	// call once the context is current, e.g. with glfwGetProcAddress
+	static void load(GLADloadproc getProcAddress)
+	{
+		ComputeApi& api = instance();
+		api.dispatchCompute = (DispatchComputeFn)getProcAddress("glDispatchCompute");
+		api.bindImageTexture = (BindImageTextureFn)getProcAddress("glBindImageTexture");
+		api.memoryBarrier = (MemoryBarrierFn)getProcAddress("glMemoryBarrier");
+		api.supported = api.dispatchCompute && api.bindImageTexture && api.memoryBarrier
+			&& (glContextVersion() >= 43 || (glHasExtension("GL_ARB_compute_shader") && glHasExtension("GL_ARB_shader_image_load_store")));
+	}
+};
+
+// what a program was built from. Part of the program binary key: SPIR-V programs look
+// their uniforms up by the explicit locations in the source, the others by name.
+enum class ShaderOrigin { Source, OptimizedGlsl, Spirv };
 
 class Shader
 {
@@ -14,149 +150,385 @@ public:
 	//the program ID
 	unsigned int ID;
 
-	//constructor reads and builds the Shader
-	Shader(const char* vertexPath, const char* fragmentPath)
+	// every file the sources were put together from, for hot reload
+	std::vector<std::string> files;
+
+	//constructor reads and builds the Shader, 'defines' is inserted right after the #version line.
+	// #include "file" is resolved relative to the including file (see ShaderPreprocessor),
+	// files come from the shared in-memory cache so permutations don't read them again.
+	// with a cache the linked program binary is reused as long as sources and driver stay the same
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "", AssetCache* cache = nullptr)
 	{
 		// 1. retrieve the vertex/fragment source code from file path
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		// ensure ifstream objects can throw exceptins
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			//open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read files buffer content into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
+		ShaderPreprocessor preprocessor;
+		PreprocessedShader vertexSource = preprocessor.process(vertexPath, defines);
+		PreprocessedShader fragmentSource = preprocessor.process(fragmentPath, defines);
+		if (!vertexSource.ok || !fragmentSource.ok)
 			std::cout << "ERROR::SHADER::FILE_NOTSUCCESFULLY_READ" << std::endl;
-		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+		files = vertexSource.files;
+		files.insert(files.end(), fragmentSource.files.begin(), fragmentSource.files.end());
+		const std::string& vertexCode = vertexSource.code;
+		const std::string& fragmentCode = fragmentSource.code;
+		std::string sources = vertexCode + '\0' + fragmentCode;
 
-		// 2. compile shaders
+		// 2. with --spirv ShaderCheck's output is used when it is there. The file names
+		// hash the preprocessed code, so edited sources never pick up stale ones.
+		std::vector<std::string> compiled = { compiledShaderPath(vertexPath, vertexCode, "vert"), compiledShaderPath(fragmentPath, fragmentCode, "frag") };
+		std::vector<std::string> bytes;
+		ShaderOrigin origin = pickOrigin(compiled, bytes, true);
 
-		unsigned int vertex, fragment;
-		int success;
-		char infoLog[512];
+		AssetKey binaryKey;
+		bool useBinaryCache = cache && cache->isEnabled() && ProgramBinaryApi::instance().supported;
+		if (useBinaryCache)
+		{
+			binaryKey = programKey(*cache, sources, origin);
+			if (loadBinary(*cache, binaryKey, sources.size()))
+			{
+				trackLocations(origin, sources);
+				return;
+			}
+		}
 
-		// vertex Shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		// print compile errors if any
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success)
+		// 3. compile shaders
+		bool linked = false;
+		if (origin == ShaderOrigin::Spirv)
 		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+			linked = link({ compileSpirv(GL_VERTEX_SHADER, bytes[0]), compileSpirv(GL_FRAGMENT_SHADER, bytes[1]) }, useBinaryCache, false);
+			if (!linked)
+			{
+				std::cout << "ERROR::SHADER::SPIRV_FAILED " << compiled[0] << ", compiling the GLSL" << std::endl;
+				origin = pickOrigin(compiled, bytes, false);
+				if (useBinaryCache)
+					binaryKey = programKey(*cache, sources, origin);
+			}
 		}
-		// fragment Shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		// print compile errors if any
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success)
+		if (!linked)
 		{
-			glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			// ShaderCheck's GLSL is already validated, its #line directives are gone though
+			// so log lines only map back to real files for the preprocessed source
+			bool optimized = origin == ShaderOrigin::OptimizedGlsl;
+			unsigned int vertex = compileGlsl(GL_VERTEX_SHADER, optimized ? bytes[0] : vertexCode, vertexSource, "VERTEX");
+			unsigned int fragment = compileGlsl(GL_FRAGMENT_SHADER, optimized ? bytes[1] : fragmentCode, fragmentSource, "FRAGMENT");
+			linked = link({ vertex, fragment }, useBinaryCache, true);
 		}
+		trackLocations(origin, sources);
+		if (linked && useBinaryCache)
+			storeBinary(*cache, binaryKey);
+	}
+	// a compute program (ComputeApi) from a single file, with the same preprocessing,
+	// binary cache and ShaderCheck outputs as the vertex/fragment pairs
+	static Shader compute(const char* computePath, const std::string& defines = "", AssetCache* cache = nullptr)
+	{
+		Shader shader;
+		ShaderPreprocessor preprocessor;
+		PreprocessedShader source = preprocessor.process(computePath, defines);
+		if (!source.ok)
+			std::cout << "ERROR::SHADER::FILE_NOTSUCCESFULLY_READ" << std::endl;
+		shader.files = source.files;
+		std::vector<std::string> compiled = { compiledShaderPath(computePath, source.code, "comp") };
+		std::vector<std::string> bytes;
+		ShaderOrigin origin = pickOrigin(compiled, bytes, true);
 
-		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		glLinkProgram(ID);
-		// print linking errors if any
-		glGetProgramiv(ID, GL_LINK_STATUS, &success);
-		if (!success)
+		AssetKey binaryKey;
+		bool useBinaryCache = cache && cache->isEnabled() && ProgramBinaryApi::instance().supported;
+		if (useBinaryCache)
 		{
-			glGetProgramInfoLog(ID, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+			binaryKey = programKey(*cache, source.code, origin);
+			if (shader.loadBinary(*cache, binaryKey, source.code.size()))
+			{
+				shader.trackLocations(origin, source.code);
+				return shader;
+			}
 		}
 
-		// deleting the shaders since we dont need them anymore
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-
+		bool linked = false;
+		if (origin == ShaderOrigin::Spirv)
+		{
+			linked = shader.link({ compileSpirv(GL_COMPUTE_SHADER, bytes[0]) }, useBinaryCache, false);
+			if (!linked)
+			{
+				std::cout << "ERROR::SHADER::SPIRV_FAILED " << compiled[0] << ", compiling the GLSL" << std::endl;
+				origin = pickOrigin(compiled, bytes, false);
+				if (useBinaryCache)
+					binaryKey = programKey(*cache, source.code, origin);
+			}
+		}
+		if (!linked)
+		{
+			bool optimized = origin == ShaderOrigin::OptimizedGlsl;
+			linked = shader.link({ compileGlsl(GL_COMPUTE_SHADER, optimized ? bytes[0] : source.code, source, "COMPUTE") }, useBinaryCache, true);
+		}
+		shader.trackLocations(origin, source.code);
+		if (linked && useBinaryCache)
+			shader.storeBinary(*cache, binaryKey);
+		return shader;
 	}
+
 	//use/activate the shader 
 	void use()
 	{
 		glUseProgram(ID);
 	}
+	// location of a uniform of this program, see uniformLocation()
+	GLint location(const std::string& name) const
+	{
+		return uniformLocation(ID, name.c_str());
+	}
+	// glGetUniformLocation for any program, except those linked from SPIR-V: they carry no
+	// names, their uniforms are found by the LOCATION(n) they are declared with
+	static GLint uniformLocation(GLuint program, const char* name)
+	{
+		const auto& programs = spirvLocations();
+		auto found = programs.find(program);
+		if (found == programs.end())
+			return glGetUniformLocation(program, name);
+		auto location = found->second.find(name);
+		return location == found->second.end() ? -1 : location->second;
+	}
+	// blocks and samplers of those come with their binding point, nothing to look up or set
+	static bool linkedFromSpirv(GLuint program)
+	{
+		return spirvLocations().count(program) != 0;
+	}
 	// utility uniform functions
 		// ------------------------------------------------------------------------
 	void setBool(const std::string& name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(location(name), (int)value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string& name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(location(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string& name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(location(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setVec2(const std::string& name, const glm::vec2& value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(location(name), 1, &value[0]);
 	}
 	void setVec2(const std::string& name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(location(name), x, y);
 	}
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string& name, const glm::vec3& value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(location(name), 1, &value[0]);
 	}
 	void setVec3(const std::string& name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(location(name), x, y, z);
 	}
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string& name, const glm::vec4& value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(location(name), 1, &value[0]);
 	}
 	void setVec4(const std::string& name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(location(name), x, y, z, w);
 	}
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string& name, const glm::mat2& mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setMat3(const std::string& name, const glm::mat3& mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setMat4(const std::string& name, const glm::mat4& mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+	}
+
+private:
+	Shader() : ID(0) {}
+
+	// explicit uniform locations by program, only for programs linked from SPIR-V
+	static std::unordered_map<GLuint, std::unordered_map<std::string, GLint>>& spirvLocations()
+	{
+		static std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> programs;
+		return programs;
+	}
+
+	// collects the 'LOCATION(n) uniform type name' declarations of shaders/include/locations.glsl,
+	// other programs drop what an earlier program with the same ID left
+	void trackLocations(ShaderOrigin origin, const std::string& code) const
+	{
+		if (origin != ShaderOrigin::Spirv)
+		{
+			spirvLocations().erase(ID);
+			return;
+		}
+		std::unordered_map<std::string, GLint>& locations = spirvLocations()[ID];
+		locations.clear();
+		for (size_t at = code.find("LOCATION("); at != std::string::npos; at = code.find("LOCATION(", at))
+		{
+			at += 9;
+			std::istringstream declaration(code.substr(at, code.find(';', at) - at));
+			GLint location;
+			char close;
+			std::string keyword, type, name;
+			if (declaration >> location >> close >> keyword >> type >> name && close == ')' && keyword == "uniform")
+				locations[name.substr(0, name.find('['))] = location;
+		}
+	}
+
+	// ShaderCheck's output for every stage, SPIR-V if allowed and supported, then its optimized GLSL
+	static ShaderOrigin pickOrigin(const std::vector<std::string>& compiled, std::vector<std::string>& bytes, bool allowSpirv)
+	{
+		SpirvApi& spirv = SpirvApi::instance();
+		bytes.assign(compiled.size(), std::string());
+		if (!spirv.preferCompiled)
+			return ShaderOrigin::Source;
+		auto readAll = [&](const char* extension)
+		{
+			for (size_t i = 0; i < compiled.size(); i++)
+				if (!readFile(compiled[i] + extension, bytes[i]))
+					return false;
+			return true;
+		};
+		if (allowSpirv && spirv.supported && readAll(".spv"))
+			return ShaderOrigin::Spirv;
+		if (readAll(".glsl"))
+			return ShaderOrigin::OptimizedGlsl;
+		return ShaderOrigin::Source;
+	}
+
+	static AssetKey programKey(AssetCache& cache, const std::string& sources, ShaderOrigin origin)
+	{
+		const char* origins[] = { "source", "optimized", "spirv" };
+		return cache.key("program", 2, sources.data(), sources.size(), driverString() + origins[(int)origin]);
+	}
+
+	// program binaries only work on the driver that produced them
+	static std::string driverString()
+	{
+		std::string result;
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum name : names)
+		{
+			const GLubyte* value = glGetString(name);
+			result += value ? (const char*)value : "";
+			result += '|';
+		}
+		return result;
+	}
+
+	bool loadBinary(AssetCache& cache, const AssetKey& key, size_t sourceBytes)
+	{
+		MappedFile cached;
+		if (!cache.find(key, cached, sourceBytes) || cached.size() <= 4)
+			return false;
+		GLenum format;
+		std::memcpy(&format, cached.data(), 4);
+		ID = glCreateProgram();
+		ProgramBinaryApi::instance().programBinary(ID, format, cached.data() + 4, (GLsizei)(cached.size() - 4));
+		int success;
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (success)
+			return true;
+		// the driver can still refuse, compiling from source again replaces the entry
+		glDeleteProgram(ID);
+		return false;
+	}
+
+	// whole info log, they easily run past a fixed size buffer with a few errors
+	static std::string infoLog(GLuint object, bool program)
+	{
+		GLint length = 0;
+		if (program)
+			glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+		else
+			glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+		std::string log((size_t)std::max(length, 1), '\0');
+		if (program)
+			glGetProgramInfoLog(object, length, NULL, &log[0]);
+		else
+			glGetShaderInfoLog(object, length, NULL, &log[0]);
+		log.resize(std::strlen(log.c_str()));
+		return log;
+	}
+
+	static bool readFile(const std::string& path, std::string& bytes)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		bytes = buffer.str();
+		return !bytes.empty();
+	}
+
+	static unsigned int compileGlsl(GLenum stage, const std::string& code, const PreprocessedShader& source, const char* stageName)
+	{
+		unsigned int shader = glCreateShader(stage);
+		const char* text = code.c_str();
+		glShaderSource(shader, 1, &text, NULL);
+		glCompileShader(shader);
+		// print compile errors if any
+		int success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+			std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" << source.remapLog(infoLog(shader, false)) << std::endl;
+		return shader;
+	}
+
+	static unsigned int compileSpirv(GLenum stage, const std::string& binary)
+	{
+		SpirvApi& api = SpirvApi::instance();
+		unsigned int shader = glCreateShader(stage);
+		api.shaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, binary.data(), (GLsizei)binary.size());
+		api.specializeShader(shader, "main", 0, NULL, NULL);
+		int success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+			std::cout << "ERROR::SHADER::SPIRV::SPECIALIZATION_FAILED\n" << infoLog(shader, false) << std::endl;
+		return shader;
+	}
+
+	// links into ID and deletes the shaders, a failed program is deleted unless it's the last try
+	bool link(std::initializer_list<unsigned int> shaders, bool retrievable, bool reportErrors)
+	{
+		ID = glCreateProgram();
+		for (unsigned int shader : shaders)
+			glAttachShader(ID, shader);
+		if (retrievable)
+			ProgramBinaryApi::instance().programParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(ID);
+		// deleting the shaders since we dont need them anymore
+		for (unsigned int shader : shaders)
+			glDeleteShader(shader);
+
+		int success;
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success && reportErrors)
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog(ID, true) << std::endl;
+		else if (!success)
+			glDeleteProgram(ID);
+		return success != 0;
+	}
+
+	void storeBinary(AssetCache& cache, const AssetKey& key) const
+	{
+		GLint length = 0;
+		glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::string blob(4 + (size_t)length, '\0');
+		GLenum format = 0;
+		ProgramBinaryApi::instance().getProgramBinary(ID, length, NULL, &format, &blob[4]);
+		std::memcpy(&blob[0], &format, 4);
+		cache.store(key, blob.data(), blob.size());
 	}
 };
 
@@ -0,0 +1,366 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include "AssetCache.h"
+
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Shader sources by path, read once and kept in memory so compiling hundreds of
+// permutations touches every file a single time. The modification time is remembered
+// for hot reload: pollChanges() re-reads what changed on disk.
+class ShaderSourceCache
+{
+public:
+	struct Stats
+	{
+		size_t reads = 0;
+		size_t hits = 0;
+		size_t reloads = 0;
+	};
+
+	// the process wide cache Shader uses
+	static ShaderSourceCache& shared()
+	{
+		static ShaderSourceCache cache;
+		return cache;
+	}
+
+	// nullptr when the file can't be read
+	const std::string* load(const std::string& path)
+	{
+		std::string key = normalize(path);
+		auto it = files.find(key);
+		if (it != files.end())
+		{
+			stats.hits++;
+			return &it->second.text;
+		}
+		File file;
+		if (!read(key, file))
+			return nullptr;
+		stats.reads++;
+		return &(files[key] = std::move(file)).text;
+	}
+
+	// files whose time stamp moved since they were read, their new text is loaded
+	std::vector<std::string> pollChanges()
+	{
+		std::vector<std::string> changed;
+		for (auto& entry : files)
+		{
+			std::error_code error;
+			std::filesystem::file_time_type time = std::filesystem::last_write_time(entry.first, error);
+			if (error || time == entry.second.time)
+				continue;
+			File file;
+			if (!read(entry.first, file))
+				continue; // editors sometimes hold the file for a moment, try again next poll
+			entry.second = std::move(file);
+			stats.reloads++;
+			changed.push_back(entry.first);
+		}
+		return changed;
+	}
+
+	const Stats& statistics() const { return stats; }
+	size_t size() const { return files.size(); }
+
+	// "shaders/./include/../a.glsl" and "shaders\\a.glsl" are the same file
+	static std::string normalize(const std::string& path)
+	{
+		return std::filesystem::path(path).lexically_normal().generic_string();
+	}
+
+private:
+	struct File
+	{
+		std::string text;
+		std::filesystem::file_time_type time;
+	};
+
+	std::map<std::string, File> files;
+	Stats stats;
+
+	static bool read(const std::string& path, File& file)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		if (!stream)
+			return false;
+		std::stringstream buffer;
+		buffer << stream.rdbuf();
+		file.text = buffer.str();
+		std::error_code error;
+		file.time = std::filesystem::last_write_time(path, error);
+		return true;
+	}
+};
+
+// result of ShaderPreprocessor::process, 'files' is indexed by the source string number
+// the #line directives use, so driver messages can be mapped back to real file names
+struct PreprocessedShader
+{
+	std::string code;
+	std::vector<std::string> files;
+	bool ok = false;
+	std::string error;
+
+	// "0(12) : error ..." (NVIDIA) and "ERROR: 0:12: ..." (AMD, Intel, Mesa) become
+	// "shaders/include/lighting.glsl(12) : error ..."
+	std::string remapLog(const std::string& log) const
+	{
+		std::string out;
+		size_t i = 0;
+		while (i < log.size())
+		{
+			size_t lineEnd = log.find('\n', i);
+			if (lineEnd == std::string::npos)
+				lineEnd = log.size();
+			out += remapLine(log.substr(i, lineEnd - i));
+			if (lineEnd < log.size())
+				out += '\n';
+			i = lineEnd + 1;
+		}
+		return out;
+	}
+
+private:
+	std::string remapLine(const std::string& line) const
+	{
+		// first "<number>(" or "<number>:" that is followed by another number
+		for (size_t start = 0; start < line.size(); start++)
+		{
+			if (!std::isdigit((unsigned char)line[start]) || (start > 0 && std::isalnum((unsigned char)line[start - 1])))
+				continue;
+			size_t end = start;
+			while (end < line.size() && std::isdigit((unsigned char)line[end]))
+				end++;
+			if (end + 1 >= line.size() || (line[end] != '(' && line[end] != ':') || !std::isdigit((unsigned char)line[end + 1]))
+			{
+				start = end;
+				continue;
+			}
+			size_t file = (size_t)std::stoul(line.substr(start, end - start));
+			if (file >= files.size())
+				return line;
+			size_t numberEnd = end + 1;
+			while (numberEnd < line.size() && std::isdigit((unsigned char)line[numberEnd]))
+				numberEnd++;
+			std::string lineNumber = line.substr(end + 1, numberEnd - end - 1);
+			if (line[end] == '(' && numberEnd < line.size() && line[numberEnd] == ')')
+				numberEnd++;
+			return line.substr(0, start) + files[file] + "(" + lineNumber + ")" + line.substr(numberEnd);
+		}
+		return line;
+	}
+};
+
+// Resolves '#include "file"' relative to the including file, honours '#pragma once',
+// puts 'defines' right behind the #version line and emits #line directives so every
+// line keeps its original number. GLSL only allows numbers as source string, those
+// index PreprocessedShader::files.
+// Includes are expanded whether or not they sit in an #ifdef, the compiler drops the
+// disabled code anyway, it just makes the dependency list a little longer.
+class ShaderPreprocessor
+{
+public:
+	explicit ShaderPreprocessor(ShaderSourceCache& sources = ShaderSourceCache::shared()) : sources(sources) {}
+
+	PreprocessedShader process(const std::string& path, const std::string& defines = "")
+	{
+		PreprocessedShader result;
+		std::set<std::string> once;
+		std::vector<std::string> stack;
+		std::ostringstream out;
+		versionSeen = false;
+		result.ok = expand(ShaderSourceCache::normalize(path), defines, result, once, stack, out, 0);
+		result.code = out.str();
+		// without a #version line the defines simply go first
+		if (!versionSeen && !defines.empty())
+			result.code = defines + "#line 1 0\n" + result.code;
+		if (!result.ok)
+			std::cout << "ERROR::SHADER::PREPROCESS " << result.error << std::endl;
+		return result;
+	}
+
+private:
+	ShaderSourceCache& sources;
+	bool versionSeen = false;
+	static const int MAX_INCLUDE_DEPTH = 32;
+
+	bool expand(const std::string& path, const std::string& defines, PreprocessedShader& result, std::set<std::string>& once,
+		std::vector<std::string>& stack, std::ostringstream& out, int depth)
+	{
+		const std::string* text = sources.load(path);
+		if (!text)
+		{
+			result.error = "can't read " + path + (stack.empty() ? "" : " included from " + stack.back());
+			return false;
+		}
+		if (depth > MAX_INCLUDE_DEPTH)
+		{
+			result.error = "includes nested deeper than " + std::to_string(MAX_INCLUDE_DEPTH) + " at " + path;
+			return false;
+		}
+		for (const std::string& open : stack)
+		{
+			if (open == path)
+			{
+				result.error = "include cycle through " + path + ", missing #pragma once?";
+				return false;
+			}
+		}
+
+		size_t fileIndex = result.files.size();
+		result.files.push_back(path);
+		stack.push_back(path);
+		std::string directory = std::filesystem::path(path).parent_path().generic_string();
+
+		std::istringstream lines(*text);
+		std::string line;
+		int number = 0;
+		bool root = depth == 0;
+		if (!root)
+			out << "#line 1 " << fileIndex << "\n";
+		while (std::getline(lines, line))
+		{
+			number++;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			std::string directive, argument;
+			parseDirective(line, directive, argument);
+
+			if (directive == "version")
+			{
+				if (!root)
+				{
+					result.error = path + "(" + std::to_string(number) + "): #version in an included file";
+					return false;
+				}
+				versionSeen = true;
+				out << line << "\n" << defines;
+				out << "#line " << number + 1 << " " << fileIndex << "\n";
+			}
+			else if (directive == "pragma" && argument == "once")
+			{
+				once.insert(path);
+				out << "\n";
+			}
+			else if (directive == "include")
+			{
+				if (argument.size() < 2 || (argument.front() != '"' && argument.front() != '<') || (argument.back() != '"' && argument.back() != '>'))
+				{
+					result.error = path + "(" + std::to_string(number) + "): expected #include \"file\"";
+					return false;
+				}
+				std::string included = ShaderSourceCache::normalize(directory.empty() ? argument.substr(1, argument.size() - 2)
+					: directory + "/" + argument.substr(1, argument.size() - 2));
+				if (once.count(included) == 0)
+				{
+					if (!expand(included, defines, result, once, stack, out, depth + 1))
+						return false;
+					out << "#line " << number + 1 << " " << fileIndex << "\n";
+				}
+				else
+					out << "\n";
+			}
+			else
+				out << line << "\n";
+		}
+		stack.pop_back();
+		return true;
+	}
+
+	// "  #  include  "a.glsl" // x" -> "include", "\"a.glsl\""
+	static void parseDirective(const std::string& line, std::string& directive, std::string& argument)
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#')
+			return;
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos)
+			return;
+		size_t end = i;
+		while (end < line.size() && std::isalpha((unsigned char)line[end]))
+			end++;
+		directive = line.substr(i, end - i);
+		size_t start = line.find_first_not_of(" \t", end);
+		if (start == std::string::npos)
+			return;
+		size_t stop = line.find("//", start);
+		argument = line.substr(start, stop == std::string::npos ? std::string::npos : stop - start);
+		while (!argument.empty() && (argument.back() == ' ' || argument.back() == '\t'))
+			argument.pop_back();
+	}
+};
+
+// where ShaderCheck puts the offline compiled form of one preprocessed shader, without
+// the extension (".spv" SPIR-V, ".glsl" optimized GLSL). Named after the hash of the
+// code, so every permutation has its own files and edited sources never match old ones.
+// 'stage' is "vert", "frag" or "comp".
+inline std::string compiledShaderPath(const std::string& shaderPath, const std::string& code, const char* stage)
+{
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)XxHash64::hash(code));
+	std::filesystem::path directory = std::filesystem::path(shaderPath).parent_path() / "compiled";
+	return (directory / (std::string(hex) + "." + stage)).generic_string();
+}
+
+// which programs have to be rebuilt when a file changes, filled from the file lists of
+// the preprocessed shaders. Programs are whatever integer the owner uses to find them.
+class ShaderDependencies
+{
+public:
+	void set(int program, const std::vector<std::string>& files)
+	{
+		remove(program);
+		for (const std::string& file : files)
+		{
+			dependents[file].insert(program);
+			dependencies[program].insert(file);
+		}
+	}
+
+	void remove(int program)
+	{
+		auto it = dependencies.find(program);
+		if (it == dependencies.end())
+			return;
+		for (const std::string& file : it->second)
+			dependents[file].erase(program);
+		dependencies.erase(it);
+	}
+
+	std::set<int> affected(const std::vector<std::string>& changedFiles) const
+	{
+		std::set<int> programs;
+		for (const std::string& file : changedFiles)
+		{
+			auto it = dependents.find(file);
+			if (it != dependents.end())
+				programs.insert(it->second.begin(), it->second.end());
+		}
+		return programs;
+	}
+
+	const std::set<std::string>& files(int program) const
+	{
+		static const std::set<std::string> none;
+		auto it = dependencies.find(program);
+		return it != dependencies.end() ? it->second : none;
+	}
+
+private:
+	std::map<std::string, std::set<int>> dependents;
+	std::map<int, std::set<std::string>> dependencies;
+};
+
+#endif
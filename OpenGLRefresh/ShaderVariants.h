@@ -0,0 +1,99 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "BindlessTextures.h"
+#include "LodSelection.h"
+#include "Materials.h"
+#include "VertexFormat.h"
+
+#include <string>
+#include <vector>
+
+// The define sets the viewer compiles its shaders with. ShaderCheck enumerates them from
+// here too: compiled shaders are found by the hash of the preprocessed code, so a set it
+// builds even slightly differently is a permutation the viewer never picks up.
+struct ShaderVariant
+{
+	std::string label;
+	std::string defines;
+};
+
+struct ShaderVariants
+{
+	// what the viewer encodes every mesh as, its shaderDefines() are the base of every set.
+	// MeshBake's default matches it.
+	static VertexFormat vertexFormat()
+	{
+		VertexFormat format;
+		format.position = PositionEncoding::Unorm16;
+		format.normal = NormalEncoding::Oct16;
+		format.uv = UvEncoding::Half;
+		return format;
+	}
+
+	// ShaderPermutations' base defines, each ShaderPermutation's own go in front
+	static std::string material(bool lodCrossFade, const std::string& base)
+	{
+		return (lodCrossFade ? LodSelector::shaderDefines() : std::string()) + base;
+	}
+
+	// textured.fs with the texture path of --bench-textures
+	static std::string texturedBench(MaterialTextureSource source, const std::string& base)
+	{
+		std::string defines;
+		if (source == MaterialTextureSource::Bindless)
+			defines += BindlessTextureTable::shaderDefines();
+		else if (source == MaterialTextureSource::Array)
+			defines += "#define TEXTURE_ARRAYS 1\n";
+		return defines + "#define TEXTURED 1\n" + base;
+	}
+
+	// first level of the bloom pyramid, bloom_downsample.comp
+	static std::string bloomPrefilter(const std::string& base) { return "#define BLOOM_PREFILTER 1\n" + base; }
+	// tonemap.comp, ACES unless 'agx'
+	static std::string tonemap(bool agx, const std::string& base) { return (agx ? "#define TONEMAP_AGX 1\n" : "") + base; }
+
+	// every set 'fileName' (without directory) is compiled with. The vertex shader is
+	// shared, it sees every set any fragment shader gets.
+	static std::vector<ShaderVariant> forFile(const std::string& fileName, const std::string& base)
+	{
+		std::vector<ShaderVariant> variants = { { "default", base } };
+		if (fileName == "shader.fs" || fileName == "shader.vs")
+			addMaterials(variants, base);
+		if (fileName == "textured.fs" || fileName == "shader.vs")
+		{
+			variants.push_back({ "bound", texturedBench(MaterialTextureSource::Bound2D, base) });
+			variants.push_back({ "arrays", texturedBench(MaterialTextureSource::Array, base) });
+			variants.push_back({ "bindless", texturedBench(MaterialTextureSource::Bindless, base) });
+		}
+		if (fileName == "bloom_downsample.comp")
+			variants.push_back({ "prefilter", bloomPrefilter(base) });
+		if (fileName == "tonemap.comp")
+			variants.push_back({ "agx", tonemap(true, base) });
+		return variants;
+	}
+
+private:
+	// every ShaderPermutation a scene can ask for, with and without --lod-fade
+	static void addMaterials(std::vector<ShaderVariant>& variants, const std::string& base)
+	{
+		const MaterialTextureSource sources[] = { MaterialTextureSource::Bound2D, MaterialTextureSource::Array, MaterialTextureSource::Bindless };
+		for (int fade = 0; fade < 2; fade++)
+			for (int textured = 0; textured < 2; textured++)
+				for (int source = 0; source < (textured ? 3 : 1); source++)
+					for (int lights = 1; lights <= 8; lights++)
+						for (int shadows = 0; shadows < 2; shadows++)
+						{
+							ShaderPermutation permutation;
+							permutation.textured = textured != 0;
+							permutation.source = sources[source];
+							permutation.lights = lights;
+							permutation.shadows = shadows != 0;
+							std::string label = std::string(fade ? "lod fade " : "") + (textured ? "textured " : "") + (source == 1 ? "arrays " : source == 2 ? "bindless " : "")
+								+ std::to_string(lights) + (lights == 1 ? " light" : " lights") + (shadows ? " shadows" : "");
+							variants.push_back({ label, permutation.defines() + material(fade != 0, base) });
+						}
+	}
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Ring buffer for data written anew every frame (compacted indices, particle instances).
+// Each write maps the next free range unsynchronized, so the driver neither copies nor
+// waits; the ranges of a frame are fenced at endFrame() and the ring only wraps onto
+// ranges whose fence has passed. With a few frames of room nothing ever blocks.
+// The buffer is mapped through GL_COPY_WRITE_BUFFER, element buffer bindings (VAO state)
+// are not touched. If a frame needs more than the ring holds it grows: the ranges already
+// handed out this frame are copied to the same offsets of the new buffer, so id() with an
+// earlier offset still finds its data, and the old buffer lives on until the GPU is done
+// with the draws of that frame.
+class StreamBuffer
+{
+public:
+	struct Stats
+	{
+		uint64_t frames = 0;
+		uint64_t bytes = 0;     // written over all frames
+		uint64_t waits = 0;     // writes that had to wait for the GPU to release a range
+		uint64_t grows = 0;
+		double waitMs = 0.0;
+	};
+
+	explicit StreamBuffer(size_t capacity = 4 << 20)
+		: capacity(capacity)
+	{
+	}
+
+	~StreamBuffer() { release(); }
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// maps 'bytes' (at least one) at the next 'alignment' boundary; fill them and call
+	// unmap() before the next map() or any draw reading them. 'offset' is where they start.
+	void* map(size_t bytes, size_t alignment, size_t& offset)
+	{
+		if (buffer == 0)
+			allocate(std::max(capacity, bytes));
+		size_t begin = (head + alignment - 1) / alignment * alignment;
+		if (begin + bytes > capacity)
+			begin = 0;
+		if (begin + bytes > capacity || overlapsCurrentFrame(begin, begin + bytes))
+		{
+			grow(bytes + alignment);
+			begin = (head + alignment - 1) / alignment * alignment;
+		}
+		waitFor(begin, begin + bytes);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		void* mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, begin, std::max<size_t>(bytes, 1),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!mapped)
+		{
+			std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+			return nullptr;
+		}
+		current.push_back({ begin, begin + bytes });
+		head = begin + bytes;
+		stats.bytes += bytes;
+		offset = begin;
+		return mapped;
+	}
+
+	void unmap()
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+
+	// copies 'data' in, returns its offset
+	size_t write(const void* data, size_t bytes, size_t alignment = 16)
+	{
+		size_t offset = 0;
+		if (bytes == 0)
+			return offset;
+		if (void* mapped = map(bytes, alignment, offset))
+		{
+			std::copy((const uint8_t*)data, (const uint8_t*)data + bytes, (uint8_t*)mapped);
+			unmap();
+		}
+		return offset;
+	}
+
+	// fences what was written this frame, call once the draws using it are submitted
+	void endFrame()
+	{
+		stats.frames++;
+		if (!current.empty())
+			inFlight.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(current) });
+		current.clear();
+		if (!retired.empty())
+			glDeleteBuffers((GLsizei)retired.size(), retired.data());
+		retired.clear();
+	}
+
+	// the buffer changes when the ring grows, VAOs using it have to be pointed at it again
+	GLuint id() const { return buffer; }
+	size_t size() const { return capacity; }
+	const Stats& statistics() const { return stats; }
+
+	void release()
+	{
+		for (Frame& frame : inFlight)
+			glDeleteSync(frame.fence);
+		inFlight.clear();
+		current.clear();
+		if (!retired.empty())
+			glDeleteBuffers((GLsizei)retired.size(), retired.data());
+		retired.clear();
+		if (buffer != 0)
+			glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		head = 0;
+	}
+
+private:
+	typedef std::pair<size_t, size_t> Range;
+	struct Frame
+	{
+		GLsync fence;
+		std::vector<Range> ranges;
+	};
+
+	GLuint buffer = 0;
+	size_t capacity;
+	size_t head = 0;
+	std::vector<Range> current;
+	std::deque<Frame> inFlight;
+	std::vector<GLuint> retired;
+	Stats stats;
+
+	static bool overlaps(const Range& range, size_t begin, size_t end) { return begin < range.second && range.first < end; }
+
+	bool overlapsCurrentFrame(size_t begin, size_t end) const
+	{
+		for (const Range& range : current)
+			if (overlaps(range, begin, end))
+				return true;
+		return false;
+	}
+
+	// retires frames oldest first up to the last one still using [begin, end)
+	void waitFor(size_t begin, size_t end)
+	{
+		size_t last = 0;
+		for (size_t i = 0; i < inFlight.size(); i++)
+			for (const Range& range : inFlight[i].ranges)
+				if (overlaps(range, begin, end))
+					last = i + 1;
+		for (size_t i = 0; i < last; i++)
+		{
+			GLenum state = glClientWaitSync(inFlight.front().fence, 0, 0);
+			if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+			{
+				auto waitBegin = std::chrono::high_resolution_clock::now();
+				state = glClientWaitSync(inFlight.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+				if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+					std::cout << "ERROR::STREAM_BUFFER::FENCE_TIMEOUT" << std::endl;
+				stats.waits++;
+				stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitBegin).count();
+			}
+			glDeleteSync(inFlight.front().fence);
+			inFlight.pop_front();
+		}
+	}
+
+	void allocate(size_t bytes)
+	{
+		capacity = bytes;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	}
+
+	// a fresh buffer at least twice the size with this frame's ranges copied over, writing
+	// continues behind the old size where none of them can be. The old one is deleted at
+	// endFrame(), which GL defers until the draws already queued with it have finished.
+	void grow(size_t bytes)
+	{
+		GLuint old = buffer;
+		size_t oldCapacity = capacity;
+		retired.push_back(old);
+		for (Frame& frame : inFlight)
+			glDeleteSync(frame.fence);
+		inFlight.clear();
+		stats.grows++;
+		allocate(std::max(capacity * 2, bytes * 2));
+		glBindBuffer(GL_COPY_READ_BUFFER, old);
+		for (const Range& range : current)
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.first, range.first, range.second - range.first);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		head = oldCapacity;
+	}
+};
+
+#endif
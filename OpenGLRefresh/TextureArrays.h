@@ -0,0 +1,432 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "BcEncoder.h"
+#include "Image.h"
+#include "JobSystem.h"
+#include "Ktx2.h"
+#include "MipBuilder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+// Fewer texture binds: textures of the same format, size and mip count become layers of
+// one GL_TEXTURE_2D_ARRAY, so draws that switch materials only switch a layer index
+// (a uniform or per instance value) and can be merged into one instanced/indirect call.
+// Images that don't share a size with anything are packed into atlas pages instead,
+// each page is an array with one layer so shaders only need the sampler2DArray path:
+//
+//   texture(textures, vec3(uv * slot.uvRect.zw + slot.uvRect.xy, slot.layer))
+//
+// Atlas entries get a gutter of repeated border texels against bleeding and the page
+// only keeps the mips the gutter covers, entries are aligned so every kept mip still
+// has whole BC blocks per entry. They can't use GL_REPEAT.
+
+// where a material finds its texture
+struct TextureSlot
+{
+	int array = -1;                                      // TextureArrays index, -1 = none
+	int layer = 0;
+	glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // offset xy, scale zw
+};
+
+// skyline bottom-left packer: keeps the top edge of the packed area as a list of
+// horizontal segments and puts every rectangle where its top ends up lowest
+class SkylinePacker
+{
+public:
+	explicit SkylinePacker(int width = 0, int height = 0) { reset(width, height); }
+
+	void reset(int w, int h)
+	{
+		width = w;
+		height = h;
+		usedArea = 0;
+		usedWidth = usedHeight = 0;
+		skyline.assign(1, { 0, 0, w });
+	}
+
+	bool insert(int w, int h, int& outX, int& outY)
+	{
+		int best = -1, bestTop = INT_MAX, bestWidth = INT_MAX, bestY = 0;
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			int y;
+			if (!fits(i, w, h, y))
+				continue;
+			if (y + h < bestTop || (y + h == bestTop && skyline[i].width < bestWidth))
+			{
+				best = (int)i;
+				bestTop = y + h;
+				bestWidth = skyline[i].width;
+				bestY = y;
+			}
+		}
+		if (best < 0)
+			return false;
+		outX = skyline[best].x;
+		outY = bestY;
+
+		skyline.insert(skyline.begin() + best, { outX, bestY + h, w });
+		// the new segment covers the start of the ones after it
+		for (size_t i = best + 1; i < skyline.size();)
+		{
+			int previousEnd = skyline[i - 1].x + skyline[i - 1].width;
+			if (skyline[i].x >= previousEnd)
+				break;
+			int shrink = previousEnd - skyline[i].x;
+			skyline[i].x += shrink;
+			skyline[i].width -= shrink;
+			if (skyline[i].width > 0)
+				break;
+			skyline.erase(skyline.begin() + i);
+		}
+		for (size_t i = 0; i + 1 < skyline.size();)
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else
+				i++;
+		}
+		usedArea += (size_t)w * h;
+		usedWidth = std::max(usedWidth, outX + w);
+		usedHeight = std::max(usedHeight, outY + h);
+		return true;
+	}
+
+	// bounding box of everything packed so far
+	int extentWidth() const { return usedWidth; }
+	int extentHeight() const { return usedHeight; }
+	size_t area() const { return usedArea; }
+
+private:
+	struct Segment
+	{
+		int x, y, width;
+	};
+
+	int width = 0;
+	int height = 0;
+	size_t usedArea = 0;
+	int usedWidth = 0;
+	int usedHeight = 0;
+	std::vector<Segment> skyline;
+
+	// y a w*h rectangle would sit at when its left edge is at segment 'index'
+	bool fits(size_t index, int w, int h, int& y) const
+	{
+		if (skyline[index].x + w > width)
+			return false;
+		y = 0;
+		int remaining = w;
+		for (size_t i = index; remaining > 0; i++)
+		{
+			if (i >= skyline.size())
+				return false;
+			y = std::max(y, skyline[i].y);
+			if (y + h > height)
+				return false;
+			remaining -= skyline[i].width;
+		}
+		return true;
+	}
+};
+
+class TextureArrays
+{
+public:
+	explicit TextureArrays(int atlasSize = 2048, int atlasPadding = 8) : atlasSize(atlasSize), atlasPadding(std::max(4, atlasPadding)) {}
+	~TextureArrays() { release(); }
+
+	// compressed texture, grouped with the others of its format, size and mip count.
+	// Returns a handle for slot() once build() ran.
+	int add(Ktx2Texture&& texture)
+	{
+		handles.push_back({ false, (int)textures.size(), 0, 0, 0, 0 });
+		textures.push_back(std::move(texture));
+		return (int)handles.size() - 1;
+	}
+
+	// uncompressed image for the atlas, the pages are BC7 compressed in build()
+	int addToAtlas(const ImageRGBA8& image, bool srgb)
+	{
+		// rectangles stay multiples of 4 texels down to the last kept mip so blocks don't
+		// straddle two entries at any level; the skyline then only places them on that grid too
+		int alignment = 4 << (atlasLevels() - 1);
+		int w = (image.width + 2 * atlasPadding + alignment - 1) & ~(alignment - 1);
+		int h = (image.height + 2 * atlasPadding + alignment - 1) & ~(alignment - 1);
+		if (w > atlasSize || h > atlasSize)
+		{
+			std::cout << "ERROR::TEXTURE_ARRAYS::TOO_LARGE_FOR_ATLAS " << image.width << "x" << image.height << std::endl;
+			return -1;
+		}
+		int x = 0, y = 0;
+		size_t page = 0;
+		for (; page < pages.size(); page++)
+			if (pages[page].srgb == srgb && pages[page].packer.insert(w, h, x, y))
+				break;
+		if (page == pages.size())
+		{
+			AtlasPage added;
+			added.srgb = srgb;
+			added.packer.reset(atlasSize, atlasSize);
+			added.image.width = added.image.height = atlasSize;
+			added.image.pixels.assign((size_t)atlasSize * atlasSize * 4, 0);
+			added.packer.insert(w, h, x, y);
+			pages.push_back(std::move(added));
+		}
+
+		// the gutter repeats the nearest border texel
+		ImageRGBA8& target = pages[page].image;
+		for (int py = 0; py < h; py++)
+		{
+			int sy = std::min(std::max(py - atlasPadding, 0), image.height - 1);
+			for (int px = 0; px < w; px++)
+			{
+				int sx = std::min(std::max(px - atlasPadding, 0), image.width - 1);
+				std::memcpy(&target.pixels[((size_t)(y + py) * atlasSize + x + px) * 4], &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+			}
+		}
+		handles.push_back({ true, (int)page, x + atlasPadding, y + atlasPadding, image.width, image.height });
+		return (int)handles.size() - 1;
+	}
+
+	// creates the GL arrays and lets go of the sources
+	void build(JobSystem* jobs = nullptr)
+	{
+		GLint maxLayers = 256;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+		// format, sRGB, width, height, levels -> textures
+		std::map<std::tuple<int, bool, int, int, int>, std::vector<int>> groups;
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			const Ktx2Texture& t = textures[i];
+			groups[std::make_tuple((int)t.format(), t.isSrgb(), t.width(), t.height(), t.levelCount())].push_back((int)i);
+		}
+		std::vector<TextureSlot> textureSlots(textures.size());
+		for (auto& group : groups)
+		{
+			const std::vector<int>& members = group.second;
+			for (size_t first = 0; first < members.size(); first += (size_t)maxLayers)
+			{
+				int layers = (int)std::min(members.size() - first, (size_t)maxLayers);
+				const Ktx2Texture& prototype = textures[members[first]];
+				int array = createArray(prototype.format(), prototype.isSrgb(), prototype.width(), prototype.height(), prototype.levelCount(), layers, false);
+				for (int layer = 0; layer < layers; layer++)
+				{
+					const Ktx2Texture& t = textures[members[first + layer]];
+					for (int l = 0; l < t.levelCount(); l++)
+						uploadLayer(array, l, layer, t.levelData(l));
+					textureSlots[members[first + layer]].array = array;
+					textureSlots[members[first + layer]].layer = layer;
+				}
+			}
+		}
+
+		std::vector<int> pageArrays;
+		for (AtlasPage& page : pages)
+		{
+			// a page that isn't full shrinks to the power of two around what was packed
+			int width = 4, height = 4;
+			while (width < page.packer.extentWidth())
+				width *= 2;
+			while (height < page.packer.extentHeight())
+				height *= 2;
+			ImageRGBA8 cropped;
+			cropped.width = width;
+			cropped.height = height;
+			cropped.pixels.resize((size_t)width * height * 4);
+			for (int y = 0; y < height; y++)
+				std::memcpy(&cropped.pixels[(size_t)y * width * 4], &page.image.pixels[(size_t)y * atlasSize * 4], (size_t)width * 4);
+			page.image = std::move(cropped);
+
+			// only the mips where the gutter is still at least one texel wide
+			int levels = std::min(mipLevelCount(width, height), atlasLevels());
+			MipSettings mipSettings;
+			mipSettings.srgb = page.srgb;
+			std::vector<ImageRGBA8> chain = buildMipChain(page.image, mipSettings, jobs);
+			int array = createArray(BcFormat::BC7, page.srgb, width, height, levels, 1, true);
+			for (int l = 0; l < levels; l++)
+			{
+				std::vector<uint8_t> blocks = bcEncodeImage(chain[l].data(), chain[l].width, chain[l].height, BcFormat::BC7, jobs);
+				uploadLayer(array, l, 0, blocks.data());
+			}
+			pageArrays.push_back(array);
+		}
+
+		slots.resize(handles.size());
+		for (size_t i = 0; i < handles.size(); i++)
+		{
+			const Handle& handle = handles[i];
+			if (!handle.atlas)
+			{
+				slots[i] = textureSlots[handle.index];
+				continue;
+			}
+			const ImageRGBA8& page = pages[handle.index].image;
+			slots[i].array = pageArrays[handle.index];
+			slots[i].layer = 0;
+			slots[i].uvRect = glm::vec4((float)handle.x / page.width, (float)handle.y / page.height, (float)handle.width / page.width, (float)handle.height / page.height);
+		}
+		for (const AtlasPage& page : pages)
+			atlasOccupancy.push_back((double)page.packer.area() / ((double)page.image.width * page.image.height));
+		textures.clear();
+		pages.clear();
+	}
+
+	const TextureSlot& slot(int handle) const { return slots[handle]; }
+	int arrayCount() const { return (int)arrays.size(); }
+	unsigned int texture(int array) const { return arrays[array].texture; }
+
+	void printStats() const
+	{
+		size_t bytes = 0;
+		int layers = 0;
+		for (const Array& array : arrays)
+		{
+			bytes += array.bytes;
+			layers += array.layers;
+		}
+		std::cout << "Texture arrays: " << slots.size() << " textures in " << arrays.size() << " arrays (" << layers << " layers), "
+			<< bytes / 1024 << " KB, binds per frame when every material switches " << slots.size() << " -> " << arrays.size() << std::endl;
+		size_t page = 0;
+		for (const Array& array : arrays)
+		{
+			std::cout << "  " << bcFormatName(array.format) << (array.srgb ? " sRGB " : " ") << array.width << "x" << array.height << ", "
+				<< array.levels << " levels, " << array.layers << " layers, " << array.bytes / 1024 << " KB";
+			if (array.atlas)
+				std::cout << ", atlas page " << 100.0 * atlasOccupancy[page++] << "% used";
+			std::cout << std::endl;
+		}
+	}
+
+	void release()
+	{
+		for (Array& array : arrays)
+			glDeleteTextures(1, &array.texture);
+		arrays.clear();
+		slots.clear();
+		handles.clear();
+		textures.clear();
+		pages.clear();
+		atlasOccupancy.clear();
+	}
+
+private:
+	struct Handle
+	{
+		bool atlas;
+		int index;       // texture or page
+		int x, y;        // atlas rectangle without the gutter
+		int width, height;
+	};
+
+	struct AtlasPage
+	{
+		bool srgb = true;
+		SkylinePacker packer;
+		ImageRGBA8 image;
+	};
+
+	struct Array
+	{
+		unsigned int texture = 0;
+		BcFormat format = BcFormat::BC7;
+		bool srgb = false;
+		bool native = true;  // false: decoded to RGBA8 on upload
+		bool atlas = false;
+		int width = 0, height = 0, levels = 0, layers = 0;
+		size_t bytes = 0;
+	};
+
+	int atlasSize;
+	int atlasPadding;
+
+	// mips the gutter is still at least one texel wide in
+	int atlasLevels() const { return 1 + (int)std::log2((double)atlasPadding); }
+
+	std::vector<Handle> handles;
+	std::vector<Ktx2Texture> textures;
+	std::vector<AtlasPage> pages;
+	std::vector<Array> arrays;
+	std::vector<TextureSlot> slots;
+	std::vector<double> atlasOccupancy;
+
+	static size_t levelBytes(BcFormat format, int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * bcBlockBytes(format);
+	}
+
+	// storage for every level and layer, filled by uploadLayer
+	int createArray(BcFormat format, bool srgb, int width, int height, int levels, int layers, bool atlas)
+	{
+		Array array;
+		array.format = format;
+		array.srgb = srgb;
+		array.native = ktx2::glSupports(format);
+		array.atlas = atlas;
+		array.width = width;
+		array.height = height;
+		array.levels = levels;
+		array.layers = layers;
+		if (!array.native)
+			std::cout << "ERROR::TEXTURE_ARRAYS::FORMAT_NOT_SUPPORTED " << bcFormatName(format) << " decoding on the CPU" << std::endl;
+
+		glGenTextures(1, &array.texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+		for (int l = 0; l < levels; l++)
+		{
+			int w = std::max(1, width >> l), h = std::max(1, height >> l);
+			if (array.native)
+			{
+				size_t bytes = levelBytes(format, w, h) * layers;
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, ktx2::glInternalFormat(format, srgb), w, h, layers, 0, (GLsizei)bytes, nullptr);
+				array.bytes += bytes;
+			}
+			else
+			{
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, l, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, w, h, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+				array.bytes += (size_t)w * h * 4 * layers;
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		arrays.push_back(array);
+		return (int)arrays.size() - 1;
+	}
+
+	// BCn blocks of one level of one layer
+	void uploadLayer(int index, int level, int layer, const uint8_t* blocks)
+	{
+		const Array& array = arrays[index];
+		int w = std::max(1, array.width >> level), h = std::max(1, array.height >> level);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+		if (array.native)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, ktx2::glInternalFormat(array.format, array.srgb),
+				(GLsizei)levelBytes(array.format, w, h), blocks);
+		else
+		{
+			std::vector<uint8_t> rgba = bcDecodeImage(blocks, w, h, array.format);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef TEXTURE_IMPORT_H
+#define TEXTURE_IMPORT_H
+
+#include "BcEncoder.h"
+#include "Image.h"
+#include "JobSystem.h"
+#include "Ktx2.h"
+#include "MipBuilder.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// bump when the import changes its output, cached textures of the old version are ignored
+const uint32_t TEXTURE_IMPORTER_VERSION = 2;
+
+struct TextureImportSettings
+{
+	BcFormat format = BcFormat::BC7;
+	bool srgb = true;
+	bool mips = true;
+	MipFilter mipFilter = MipFilter::Kaiser;
+
+	// naming convention of the textures folder: _D diffuse (sRGB color), _N normal maps
+	// (BC5, linear), anything else is treated as linear color
+	static TextureImportSettings fromName(const std::string& path)
+	{
+		TextureImportSettings settings;
+		settings.srgb = false;
+		std::string file = path.substr(path.find_last_of("/\\") + 1);
+		file = file.substr(0, file.find('.'));
+		size_t start = 0;
+		while (start <= file.size())
+		{
+			size_t end = std::min(file.find('_', start), file.size());
+			std::string token = file.substr(start, end - start);
+			if (token == "N")
+				settings.format = BcFormat::BC5;
+			if (token == "D")
+				settings.srgb = true;
+			start = end + 1;
+		}
+		if (settings.format == BcFormat::BC5)
+			settings.srgb = false;
+		return settings;
+	}
+
+	// everything that changes the output, part of the asset cache key
+	std::string key() const
+	{
+		return std::string(bcFormatName(format)) + (srgb ? " srgb" : " linear") + (mips ? std::string(" mips ") + mipFilterName(mipFilter) : "");
+	}
+};
+
+struct TextureImportReport
+{
+	int width = 0;
+	int height = 0;
+	int levels = 0;
+	size_t rawBytes = 0;        // RGBA8 with mips
+	size_t compressedBytes = 0;
+	double decodeSeconds = 0.0;
+	double mipSeconds = 0.0;
+	double encodeSeconds = 0.0;
+	double psnr = 0.0;          // of level 0 over the channels the format keeps
+
+	void print(const std::string& name, const TextureImportSettings& settings) const
+	{
+		double megapixels = 0.0;
+		for (int l = 0; l < levels; l++)
+			megapixels += (double)std::max(1, width >> l) * std::max(1, height >> l) / 1e6;
+		std::cout << "Texture " << name << ": " << width << "x" << height << " " << levels << " levels " << bcFormatName(settings.format)
+			<< (settings.srgb ? " sRGB" : "") << ", " << rawBytes / 1024 << " KB -> " << compressedBytes / 1024 << " KB, decode "
+			<< decodeSeconds * 1000.0 << " ms, mips " << mipSeconds * 1000.0 << " ms, encode " << encodeSeconds * 1000.0 << " ms ("
+			<< (encodeSeconds > 0.0 ? megapixels / encodeSeconds : 0.0) << " MPix/s), PSNR " << psnr << " dB" << std::endl;
+	}
+};
+
+// image file bytes -> mip chain -> BCn -> .ktx2 at 'outputPath'
+inline bool importTexture(const uint8_t* data, size_t size, const std::string& name, const TextureImportSettings& settings,
+	const std::string& outputPath, JobSystem* jobs, TextureImportReport* report = nullptr)
+{
+	TextureImportReport local;
+	TextureImportReport& r = report ? *report : local;
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+	auto seconds = [](std::chrono::high_resolution_clock::time_point since) { return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - since).count(); };
+
+	auto start = now();
+	ImageRGBA8 image;
+	if (!decodeImageRGBA8(data, size, image, name))
+		return false;
+	r.decodeSeconds = seconds(start);
+
+	start = now();
+	std::vector<ImageRGBA8> levels;
+	if (settings.mips)
+	{
+		MipSettings mipSettings;
+		mipSettings.srgb = settings.srgb;
+		mipSettings.filter = settings.mipFilter;
+		levels = buildMipChain(image, mipSettings, jobs);
+	}
+	else
+		levels.push_back(std::move(image));
+	r.mipSeconds = seconds(start);
+
+	start = now();
+	std::vector<std::vector<uint8_t>> blocks;
+	for (const ImageRGBA8& level : levels)
+		blocks.push_back(bcEncodeImage(level.data(), level.width, level.height, settings.format, jobs));
+	r.encodeSeconds = seconds(start);
+
+	std::vector<uint8_t> decoded = bcDecodeImage(blocks[0].data(), levels[0].width, levels[0].height, settings.format);
+	r.psnr = bcPsnr(levels[0].data(), decoded.data(), (size_t)levels[0].width * levels[0].height, bcChannelCount(settings.format));
+	r.width = levels[0].width;
+	r.height = levels[0].height;
+	r.levels = (int)levels.size();
+	r.rawBytes = 0;
+	r.compressedBytes = 0;
+	for (size_t l = 0; l < levels.size(); l++)
+	{
+		r.rawBytes += levels[l].bytes();
+		r.compressedBytes += blocks[l].size();
+	}
+	return writeKtx2(outputPath, settings.format, settings.srgb, r.width, r.height, blocks);
+}
+
+#endif
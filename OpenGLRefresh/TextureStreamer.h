@@ -0,0 +1,322 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "JobSystem.h"
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Mip streaming for .ktx2 textures mapped from the asset cache. A texture starts with
+// only its mip tail resident (levels of at most 'tailSize' texels); every frame the
+// renderer requests the mip it needs (see mipForScreenSize) and finer levels come in one
+// per texture per frame, biggest gap first, within a per frame upload limit and a total
+// VRAM budget. When the budget is full the least recently requested textures give up
+// their finest levels first.
+//
+// GL 3.3 has no sparse textures, so residency is GL_TEXTURE_BASE_LEVEL: levels from the
+// base down are specified, evicted levels are respecified as 0x0 so the driver can free
+// them. The GL handle of a texture never changes.
+//
+// Reading a level from the mapping is a disk read when the cache is cold, so levels are
+// touched on the job system one frame before the GL thread uploads them.
+class TextureStreamer
+{
+public:
+	struct Stats
+	{
+		size_t residentBytes = 0;
+		size_t streamedBytesFrame = 0;    // uploaded by the last update()
+		size_t streamedBytesFrameMax = 0;
+		size_t streamedBytesTotal = 0;
+		size_t evictedBytesTotal = 0;
+		uint32_t levelsStreamed = 0;
+		uint32_t levelsEvicted = 0;
+		uint32_t popIns = 0;               // requests that became resident
+		double popInSecondsTotal = 0.0;    // from the first frame a finer mip was wanted
+		double popInSecondsMax = 0.0;
+		uint64_t popInFramesMax = 0;
+	};
+
+	explicit TextureStreamer(JobSystem* jobs = nullptr, size_t budgetBytes = 256u << 20, size_t uploadBytesPerFrame = 4u << 20, int tailSize = 64)
+		: jobs(jobs), budget(budgetBytes), uploadLimit(uploadBytesPerFrame), tailSize(tailSize)
+	{
+	}
+
+	~TextureStreamer() { release(); }
+
+	// takes over the mapping and uploads the mip tail, returns the id for request()
+	int add(Ktx2Texture&& source)
+	{
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->source = std::move(source);
+		Ktx2Texture& ktx = entry->source;
+		entry->levels = ktx.levelCount();
+		entry->tailMip = entry->levels - 1;
+		while (entry->tailMip > 0 && std::max(ktx.levelWidth(entry->tailMip - 1), ktx.levelHeight(entry->tailMip - 1)) <= tailSize)
+			entry->tailMip--;
+		entry->residentMip = entry->tailMip;
+		entry->wanted = entry->tailMip;
+
+		glGenTextures(1, &entry->texture);
+		glBindTexture(GL_TEXTURE_2D, entry->texture);
+		for (int l = entry->tailMip; l < entry->levels; l++)
+		{
+			ktx.uploadLevel(l);
+			stats.residentBytes += ktx.levelVramBytes(l);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry->tailMip);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry->levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, entry->levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		entries.push_back(std::move(entry));
+		return (int)entries.size() - 1;
+	}
+
+	int count() const { return (int)entries.size(); }
+	unsigned int texture(int id) const { return entries[id]->texture; }
+	int residentMip(int id) const { return entries[id]->residentMip; }
+	const Stats& statistics() const { return stats; }
+
+	// about one texel per pixel when the texture's larger side spans 'pixels' on screen
+	int mipForScreenSize(int id, float pixels) const
+	{
+		const Entry& entry = *entries[id];
+		if (!(pixels > 0.0f))
+			return entry.levels - 1;
+		float texels = (float)std::max(entry.source.width(), entry.source.height());
+		int mip = (int)std::floor(std::log2(std::max(1.0f, texels / pixels)));
+		return std::min(mip, entry.levels - 1);
+	}
+
+	// may be called several times per frame, the finest request wins
+	void request(int id, int mip)
+	{
+		Entry& entry = *entries[id];
+		mip = std::min(std::max(mip, 0), entry.levels - 1);
+		if (entry.lastUsed != frame)
+			entry.wanted = mip;
+		else
+			entry.wanted = std::min(entry.wanted, mip);
+		entry.lastUsed = frame;
+	}
+
+	// once per frame on the GL thread, after the requests
+	void update()
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		stats.streamedBytesFrame = 0;
+
+		for (std::unique_ptr<Entry>& entry : entries)
+		{
+			// not requested this frame: keep what is resident, but stop asking for more
+			if (entry->lastUsed != frame)
+			{
+				entry->wanted = std::max(entry->wanted, entry->residentMip);
+				entry->waiting = false;
+			}
+			if (entry->wanted < entry->residentMip && !entry->waiting)
+			{
+				entry->waiting = true;
+				entry->waitStart = now;
+				entry->waitFrame = frame;
+			}
+		}
+
+		// upload what was prefetched, oldest first
+		size_t kept = 0;
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			Prefetch& prefetch = *pending[i];
+			Entry& entry = *entries[prefetch.id];
+			bool stale = prefetch.level != entry.residentMip - 1 || entry.wanted > prefetch.level;
+			size_t bytes = entry.source.levelVramBytes(prefetch.level);
+			bool overLimit = stats.streamedBytesFrame > 0 && stats.streamedBytesFrame + bytes > uploadLimit;
+			// a running prefetch job still points at its entry, keep it until it is done
+			if (!prefetch.ready.load() || (!stale && overLimit))
+			{
+				pending[kept++] = std::move(pending[i]);
+				continue;
+			}
+			entry.queued = false;
+			if (stale || !makeRoom(bytes, prefetch.id))
+				continue;
+			glBindTexture(GL_TEXTURE_2D, entry.texture);
+			entry.source.uploadLevel(prefetch.level);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, prefetch.level);
+			entry.residentMip = prefetch.level;
+			stats.residentBytes += bytes;
+			stats.streamedBytesFrame += bytes;
+			stats.streamedBytesTotal += bytes;
+			stats.levelsStreamed++;
+		}
+		pending.resize(kept);
+		stats.streamedBytesFrameMax = std::max(stats.streamedBytesFrameMax, stats.streamedBytesFrame);
+
+		for (std::unique_ptr<Entry>& entry : entries)
+		{
+			if (entry->waiting && entry->residentMip <= entry->wanted)
+			{
+				double seconds = std::chrono::duration<double>(now - entry->waitStart).count();
+				entry->waiting = false;
+				stats.popIns++;
+				stats.popInSecondsTotal += seconds;
+				stats.popInSecondsMax = std::max(stats.popInSecondsMax, seconds);
+				stats.popInFramesMax = std::max(stats.popInFramesMax, frame - entry->waitFrame);
+			}
+		}
+
+		// next level of every texture that is short, biggest gap first
+		std::vector<int> candidates;
+		for (int id = 0; id < count(); id++)
+			if (!entries[id]->queued && entries[id]->wanted < entries[id]->residentMip)
+				candidates.push_back(id);
+		std::sort(candidates.begin(), candidates.end(), [&](int a, int b)
+		{
+			int gapA = entries[a]->residentMip - entries[a]->wanted, gapB = entries[b]->residentMip - entries[b]->wanted;
+			return gapA != gapB ? gapA > gapB : entries[a]->lastUsed > entries[b]->lastUsed;
+		});
+		size_t queuedBytes = 0;
+		for (int id : candidates)
+		{
+			Entry& entry = *entries[id];
+			int level = entry.residentMip - 1;
+			size_t bytes = entry.source.levelSize(level);
+			if (queuedBytes > 0 && queuedBytes + bytes > uploadLimit)
+				break;
+			queuedBytes += bytes;
+			entry.queued = true;
+			std::unique_ptr<Prefetch> prefetch(new Prefetch());
+			prefetch->id = id;
+			prefetch->level = level;
+			Prefetch* target = prefetch.get();
+			const uint8_t* data = entry.source.levelData(level);
+			// without workers submitted jobs only run inside wait(), touch the pages here
+			if (jobs && jobs->threadCount() > 1)
+				jobs->submit([target, data, bytes]() { touch(data, bytes); target->ready.store(true); });
+			else
+			{
+				touch(data, bytes);
+				target->ready.store(true);
+			}
+			pending.push_back(std::move(prefetch));
+		}
+		frame++;
+	}
+
+	void printStats() const
+	{
+		size_t mb = 1024 * 1024;
+		std::cout << "Texture streaming: " << entries.size() << " textures, resident " << stats.residentBytes / 1024 << " KB of "
+			<< budget / mb << " MB budget (" << 100.0 * stats.residentBytes / budget << "%), last frame " << stats.streamedBytesFrame / 1024
+			<< " KB (max " << stats.streamedBytesFrameMax / 1024 << " KB), streamed " << stats.streamedBytesTotal / 1024 << " KB in "
+			<< stats.levelsStreamed << " levels, evicted " << stats.evictedBytesTotal / 1024 << " KB in " << stats.levelsEvicted << " levels" << std::endl;
+		std::cout << "  pop-in: " << stats.popIns << " requests, avg " << (stats.popIns ? stats.popInSecondsTotal / stats.popIns * 1000.0 : 0.0)
+			<< " ms, max " << stats.popInSecondsMax * 1000.0 << " ms / " << stats.popInFramesMax << " frames" << std::endl;
+		for (const std::unique_ptr<Entry>& entry : entries)
+		{
+			size_t resident = 0;
+			for (int l = entry->residentMip; l < entry->levels; l++)
+				resident += entry->source.levelVramBytes(l);
+			std::cout << "  " << entry->source.path() << ": mip " << entry->residentMip << " resident (" << entry->source.levelWidth(entry->residentMip)
+				<< "x" << entry->source.levelHeight(entry->residentMip) << ", " << resident / 1024 << " KB), wants " << entry->wanted << ", "
+				<< (entry->lastUsed ? "last used " + std::to_string(frame - 1 - entry->lastUsed) + " frames ago" : std::string("never used")) << std::endl;
+		}
+	}
+
+	void release()
+	{
+		// prefetch jobs point into the entries
+		if (jobs && !pending.empty())
+			jobs->wait();
+		pending.clear();
+		for (std::unique_ptr<Entry>& entry : entries)
+			glDeleteTextures(1, &entry->texture);
+		entries.clear();
+		stats.residentBytes = 0;
+	}
+
+private:
+	struct Entry
+	{
+		Ktx2Texture source;
+		unsigned int texture = 0;
+		int levels = 1;
+		int tailMip = 0;      // levels from here down are always resident
+		int residentMip = 0;  // finest resident level, the GL base level
+		int wanted = 0;
+		uint64_t lastUsed = 0;
+		bool queued = false;  // has a prefetch in flight
+		bool waiting = false; // wanted a finer mip than resident since waitStart
+		std::chrono::high_resolution_clock::time_point waitStart;
+		uint64_t waitFrame = 0;
+	};
+
+	struct Prefetch
+	{
+		int id = 0;
+		int level = 0;
+		std::atomic<bool> ready{ false };
+	};
+
+	JobSystem* jobs;
+	size_t budget;
+	size_t uploadLimit;
+	int tailSize;
+	uint64_t frame = 1;
+	std::vector<std::unique_ptr<Entry>> entries;
+	std::vector<std::unique_ptr<Prefetch>> pending;
+	Stats stats;
+
+	static void touch(const uint8_t* data, size_t size)
+	{
+		volatile uint8_t sink = 0;
+		for (size_t i = 0; i < size; i += 4096)
+			sink = sink + data[i];
+		(void)sink;
+	}
+
+	// evicts the finest levels of the least recently used textures until 'bytes' fit.
+	// Textures used this frame only give up levels finer than they want.
+	bool makeRoom(size_t bytes, int forId)
+	{
+		while (stats.residentBytes + bytes > budget)
+		{
+			Entry* victim = nullptr;
+			for (int id = 0; id < count(); id++)
+			{
+				Entry& entry = *entries[id];
+				if (id == forId || entry.residentMip >= entry.tailMip)
+					continue;
+				if (entry.lastUsed == frame && entry.residentMip >= entry.wanted)
+					continue;
+				if (!victim || entry.lastUsed < victim->lastUsed)
+					victim = &entry;
+			}
+			if (!victim)
+				return false;
+			int level = victim->residentMip;
+			glBindTexture(GL_TEXTURE_2D, victim->texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			size_t freed = victim->source.levelVramBytes(level);
+			victim->residentMip = level + 1;
+			stats.residentBytes -= freed;
+			stats.evictedBytesTotal += freed;
+			stats.levelsEvicted++;
+		}
+		return true;
+	}
+};
+
+#endif
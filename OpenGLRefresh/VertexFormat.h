@@ -0,0 +1,393 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MeshArena.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Describes how a vertex is stored on the GPU. The float formats match what the cube
+// used to upload, the compact ones trade a little precision for a lot less bandwidth:
+//   position  Unorm16    - 4 x uint16 relative to the mesh AABB, undone by the model matrix
+//   normal    Oct16      - octahedral map in 2 x snorm16, decoded in shader.vs
+//   normal    Snorm10    - 10:10:10:2 packed, the attribute fetch unpacks it for free
+//   uv        Half       - 2 x float16
+// Attribute locations stay the same as before: 0 position, 1 normal, 2 uv.
+enum class PositionEncoding { Float32, Unorm16 };
+enum class NormalEncoding { None, Float32, Oct16, Snorm10 };
+enum class UvEncoding { None, Float32, Half };
+
+struct VertexFormat
+{
+	PositionEncoding position = PositionEncoding::Float32;
+	NormalEncoding normal = NormalEncoding::Float32;
+	UvEncoding uv = UvEncoding::None;
+
+	static VertexFormat full() { return VertexFormat(); }
+	static VertexFormat compact()
+	{
+		VertexFormat format;
+		format.position = PositionEncoding::Unorm16;
+		format.normal = NormalEncoding::Oct16;
+		format.uv = UvEncoding::Half;
+		return format;
+	}
+
+	size_t positionSize() const { return position == PositionEncoding::Float32 ? 12 : 8; }
+	size_t normalSize() const
+	{
+		switch (normal)
+		{
+		case NormalEncoding::Float32: return 12;
+		case NormalEncoding::Oct16: case NormalEncoding::Snorm10: return 4;
+		default: return 0;
+		}
+	}
+	size_t uvSize() const
+	{
+		switch (uv)
+		{
+		case UvEncoding::Float32: return 8;
+		case UvEncoding::Half: return 4;
+		default: return 0;
+		}
+	}
+	size_t stride() const { return positionSize() + normalSize() + uvSize(); }
+
+	bool operator==(const VertexFormat& other) const { return position == other.position && normal == other.normal && uv == other.uv; }
+	bool operator!=(const VertexFormat& other) const { return !(*this == other); }
+
+	// attribute pointers for MeshArena / glVertexAttribPointer
+	VertexLayout layout() const
+	{
+		VertexLayout layout;
+		layout.stride = (GLsizei)stride();
+		GLuint offset = 0;
+		if (position == PositionEncoding::Float32)
+			layout.attributes.push_back({ 0, 3, GL_FLOAT, GL_FALSE, offset });
+		else
+			layout.attributes.push_back({ 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offset });
+		offset += (GLuint)positionSize();
+
+		if (normal == NormalEncoding::Float32)
+			layout.attributes.push_back({ 1, 3, GL_FLOAT, GL_FALSE, offset });
+		else if (normal == NormalEncoding::Oct16)
+			layout.attributes.push_back({ 1, 2, GL_SHORT, GL_TRUE, offset });
+		else if (normal == NormalEncoding::Snorm10)
+			layout.attributes.push_back({ 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset });
+		offset += (GLuint)normalSize();
+
+		if (uv == UvEncoding::Float32)
+			layout.attributes.push_back({ 2, 2, GL_FLOAT, GL_FALSE, offset });
+		else if (uv == UvEncoding::Half)
+			layout.attributes.push_back({ 2, 2, GL_HALF_FLOAT, GL_FALSE, offset });
+		return layout;
+	}
+
+	// defines the vertex shader needs to read this format, passed on to the Shader constructor
+	std::string shaderDefines() const
+	{
+		std::string defines;
+		if (normal == NormalEncoding::Oct16)
+			defines += "#define NORMAL_OCTAHEDRAL 1\n";
+		if (uv != UvEncoding::None)
+			defines += "#define HAS_UV 1\n";
+		return defines;
+	}
+};
+
+// ------------------------------------------------------------------------
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, 4);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	if (((bits >> 23) & 0xFF) == 0xFF)
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // inf / nan
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7C00);
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		// denormal, round to nearest
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) // round to nearest, may carry into the exponent which is fine
+		half++;
+	return (uint16_t)half;
+}
+
+inline float halfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+			bits = sign;
+		else
+		{
+			// renormalize the denormal
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else if (exponent == 31)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	float value;
+	std::memcpy(&value, &bits, 4);
+	return value;
+}
+
+inline int16_t floatToSnorm16(float v)
+{
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (int16_t)std::lround(v * 32767.0f);
+}
+
+inline float snorm16ToFloat(int16_t v)
+{
+	float f = v / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+// octahedral mapping of a unit vector onto [-1,1]^2
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+	n = n / (std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		e.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		e.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+inline glm::vec3 octDecode(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+	float t = n.z < 0.0f ? -n.z : 0.0f;
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+inline uint32_t packSnorm1010102(glm::vec3 n)
+{
+	auto component = [](float v) -> uint32_t
+	{
+		v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+		return (uint32_t)(std::lround(v * 511.0f)) & 0x3FF;
+	};
+	return component(n.x) | (component(n.y) << 10) | (component(n.z) << 20);
+}
+
+inline glm::vec3 unpackSnorm1010102(uint32_t packed)
+{
+	auto component = [](uint32_t bits) -> float
+	{
+		int32_t v = (int32_t)(bits << 22) >> 22; // sign extend 10 bits
+		float f = v / 511.0f;
+		return f < -1.0f ? -1.0f : f;
+	};
+	return glm::vec3(component(packed & 0x3FF), component((packed >> 10) & 0x3FF), component((packed >> 20) & 0x3FF));
+}
+
+// Source data for the converter, strides are in floats so interleaved arrays like the
+// cube's 6 float vertices can be passed without copying. normals/uvs may be NULL.
+struct VertexStreams
+{
+	const float* positions = nullptr;
+	const float* normals = nullptr;
+	const float* uvs = nullptr;
+	size_t positionStride = 3;
+	size_t normalStride = 3;
+	size_t uvStride = 2;
+	size_t count = 0;
+};
+
+struct EncodedVertices
+{
+	VertexFormat format;
+	std::vector<uint8_t> data;
+	glm::vec3 aabbMin = glm::vec3(0.0f);
+	glm::vec3 aabbMax = glm::vec3(0.0f);
+
+	// error metrics measured by decoding what was written
+	float maxPositionError = 0.0f;  // object space units
+	float rmsPositionError = 0.0f;
+	float maxNormalErrorDegrees = 0.0f;
+	float maxUvError = 0.0f;
+	size_t sourceBytes = 0;
+
+	size_t vertexCount() const { return data.size() / format.stride(); }
+
+	// maps the unit cube the quantized positions live in back onto the mesh AABB,
+	// multiply it onto the model matrix instead of decoding in the shader
+	glm::mat4 dequantizeMatrix() const
+	{
+		if (format.position == PositionEncoding::Float32)
+			return glm::mat4(1.0f);
+		glm::mat4 m = glm::translate(glm::mat4(1.0f), aabbMin);
+		return glm::scale(m, aabbMax - aabbMin);
+	}
+
+	void printReport(const std::string& name) const
+	{
+		std::cout << "VertexFormat: " << name << " " << vertexCount() << " vertices, " << sourceBytes << " -> " << data.size()
+			<< " bytes (" << (data.empty() ? 0.0f : (float)sourceBytes / (float)data.size()) << "x smaller), position error max "
+			<< maxPositionError << " rms " << rmsPositionError << ", normal error max " << maxNormalErrorDegrees
+			<< " deg, uv error max " << maxUvError << std::endl;
+	}
+};
+
+inline EncodedVertices encodeVertices(const VertexStreams& src, const VertexFormat& format)
+{
+	EncodedVertices out;
+	out.format = format;
+	size_t stride = format.stride();
+	out.data.resize(src.count * stride);
+	// what the same attributes cost as plain floats
+	out.sourceBytes = src.count * (12 + (format.normal != NormalEncoding::None ? 12 : 0) + (format.uv != UvEncoding::None ? 8 : 0));
+	if (src.count == 0)
+		return out;
+
+	glm::vec3 lo(src.positions[0], src.positions[1], src.positions[2]);
+	glm::vec3 hi = lo;
+	for (size_t i = 1; i < src.count; i++)
+	{
+		const float* p = src.positions + i * src.positionStride;
+		glm::vec3 v(p[0], p[1], p[2]);
+		lo = glm::min(lo, v);
+		hi = glm::max(hi, v);
+	}
+	out.aabbMin = lo;
+	out.aabbMax = hi;
+	glm::vec3 extent = hi - lo;
+	for (int c = 0; c < 3; c++)
+		if (extent[c] <= 0.0f)
+			extent[c] = 1.0f;
+	out.aabbMax = lo + extent;
+
+	double squaredErrorSum = 0.0;
+	for (size_t i = 0; i < src.count; i++)
+	{
+		uint8_t* dst = out.data.data() + i * stride;
+		const float* p = src.positions + i * src.positionStride;
+		glm::vec3 position(p[0], p[1], p[2]);
+
+		// position
+		glm::vec3 decoded;
+		if (format.position == PositionEncoding::Float32)
+		{
+			std::memcpy(dst, p, 12);
+			decoded = position;
+		}
+		else
+		{
+			uint16_t q[4] = { 0, 0, 0, 0 };
+			for (int c = 0; c < 3; c++)
+			{
+				float t = (position[c] - lo[c]) / extent[c];
+				t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+				q[c] = (uint16_t)std::lround(t * 65535.0f);
+				decoded[c] = lo[c] + (q[c] / 65535.0f) * extent[c];
+			}
+			std::memcpy(dst, q, 8);
+		}
+		float error = glm::length(decoded - position);
+		out.maxPositionError = error > out.maxPositionError ? error : out.maxPositionError;
+		squaredErrorSum += (double)error * error;
+		dst += format.positionSize();
+
+		// normal
+		if (format.normal != NormalEncoding::None)
+		{
+			glm::vec3 n(0.0f, 0.0f, 1.0f);
+			if (src.normals)
+			{
+				const float* s = src.normals + i * src.normalStride;
+				n = glm::vec3(s[0], s[1], s[2]);
+				float length = glm::length(n);
+				n = length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+			glm::vec3 decodedNormal;
+			if (format.normal == NormalEncoding::Float32)
+			{
+				std::memcpy(dst, &n[0], 12);
+				decodedNormal = n;
+			}
+			else if (format.normal == NormalEncoding::Oct16)
+			{
+				glm::vec2 e = octEncode(n);
+				int16_t q[2] = { floatToSnorm16(e.x), floatToSnorm16(e.y) };
+				std::memcpy(dst, q, 4);
+				decodedNormal = octDecode(glm::vec2(snorm16ToFloat(q[0]), snorm16ToFloat(q[1])));
+			}
+			else
+			{
+				uint32_t packed = packSnorm1010102(n);
+				std::memcpy(dst, &packed, 4);
+				decodedNormal = glm::normalize(unpackSnorm1010102(packed));
+			}
+			// atan2 stays accurate for tiny angles where acos(dot) is all rounding noise
+			float degrees = glm::degrees(std::atan2(glm::length(glm::cross(decodedNormal, n)), glm::dot(decodedNormal, n)));
+			out.maxNormalErrorDegrees = degrees > out.maxNormalErrorDegrees ? degrees : out.maxNormalErrorDegrees;
+			dst += format.normalSize();
+		}
+
+		// uv
+		if (format.uv != UvEncoding::None)
+		{
+			float uv[2] = { 0.0f, 0.0f };
+			if (src.uvs)
+			{
+				uv[0] = src.uvs[i * src.uvStride];
+				uv[1] = src.uvs[i * src.uvStride + 1];
+			}
+			if (format.uv == UvEncoding::Float32)
+				std::memcpy(dst, uv, 8);
+			else
+			{
+				uint16_t h[2] = { floatToHalf(uv[0]), floatToHalf(uv[1]) };
+				std::memcpy(dst, h, 4);
+				for (int c = 0; c < 2; c++)
+				{
+					float e = std::fabs(halfToFloat(h[c]) - uv[c]);
+					out.maxUvError = e > out.maxUvError ? e : out.maxUvError;
+				}
+			}
+		}
+	}
+	out.rmsPositionError = (float)std::sqrt(squaredErrorSum / (double)src.count);
+	return out;
+}
+
+#endif
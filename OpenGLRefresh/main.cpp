@@ -7,17 +7,71 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "shader.h"
+#include "Shader.h"
 #include "stb_image.h"
-
+#include "JobSystem.h"
+#include "CommandList.h"
+#include "FrameGraph.h"
+#include "MeshArena.h"
+#include "VertexFormat.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+#include "BakedMesh.h"
+#include "MeshImport.h"
+#include "AssetCache.h"
+#include "TextureImport.h"
+#include "TextureArrays.h"
+#include "TextureStreamer.h"
+#include "BindlessTextures.h"
+#include "Materials.h"
+#include "ShaderVariants.h"
+#include "GoldenImage.h"
+#include "FrameCapture.h"
+#include "BatchJobs.h"
+#include "GLTrace.h"
+#include "DynamicResolution.h"
+#include "PostProcess.h"
+#include "OcclusionCulling.h"
+#include "LodSelection.h"
+#include "MeshletCulling.h"
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
 
+struct MeshInstance;
+bool loadMeshFile(const std::string& path, const VertexFormat& format, JobSystem& jobs, MeshArena& arena, AssetCache& cache, std::vector<MeshInstance>& out);
+int benchLoad(const std::string& path, int repeat);
+bool loadTextureFile(const std::string& path, JobSystem& jobs, AssetCache& cache, Ktx2Texture& out);
+unsigned int loadRawTexture(const std::string& path, JobSystem& jobs);
+int benchMips(const std::string& path, int repeat);
+int benchOcclusion(int count);
+int benchParticles(int count);
+int benchTextures(GLFWwindow* window, JobSystem& jobs, AssetCache& cache, MeshArena& arena, int mesh, const glm::mat4& meshTransform,
+	const std::string& defines, const std::vector<std::string>& paths, int draws);
+ImageRGBA8 readBackbuffer(int width, int height);
+
 float mixValue = 0.5f;
+// size of the golden image frames
+const int GOLDEN_WIDTH = 400;
+const int GOLDEN_HEIGHT = 300;
 // settings 
 unsigned int SCR_WIDTH = 800;
 unsigned int SCR_HEIGHT = 600;
@@ -42,20 +96,301 @@ float fov = 45.0f;
 float deltaTime = 0;
 float lastFrame = 0;
 
+// one shot debug actions triggered from key_callback
+bool dumpFrameGraph = false;
+bool printMeshArena = false;
+bool printTextureStreaming = false;
+bool printDynamicResolution = false;
+bool printPostProcessing = false;
+bool printOcclusion = false;
+bool printLods = false;
+bool printMeshlets = false;
+bool printParticles = false;
+bool toggleCapture = false;
+bool takeScreenshot = false;
+
+// everything the worker threads need to record one draw, GL handles and
+// uniform locations are looked up on the main thread beforehand
+struct RenderObject
+{
+	unsigned int program;
+	int mesh;
+	int modelLocation;
+	glm::vec3 position;
+	float scale;
+	glm::mat4 meshTransform; // undoes the vertex quantization of the mesh
+	int material;            // -1 for programs outside the material system
+	int lodFade = -1;        // cross-fade uniform, -1 when the program has none
+	int normalMatrixLocation = -1;
+	glm::mat3 normalMatrix = glm::mat3(1.0f); // of the node transform, see bakedNormalMatrix()
+};
+
+// a mesh loaded from a file, placed with its node transform
+struct MeshInstance
+{
+	int mesh;
+	glm::mat4 transform;
+	glm::mat3 normalMatrix = glm::mat3(1.0f);
+	MeshLodChain lods = {};
+	MeshletSource meshlets = {};
+};
+
 
 
-int main()
+// one reference set per scene setup, "cube", "cube_lights3_shadows", ...
+std::string goldenSceneName(int lights, bool shadows, const std::string& tonemapper, const std::vector<std::string>& meshes, const std::vector<std::string>& textures)
 {
+	std::string name = "cube";
+	if (lights > 1)
+		name += "_lights" + std::to_string(lights);
+	if (shadows)
+		name += "_shadows";
+	if (!tonemapper.empty())
+		name += "_" + tonemapper;
+	for (const std::vector<std::string>* paths : { &meshes, &textures })
+		for (const std::string& path : *paths)
+			name += "_" + std::filesystem::path(path).stem().string();
+	return name;
+}
+
+int main(int argc, char** argv)
+{
+	auto startupBegin = std::chrono::high_resolution_clock::now();
+
+	// command line:
+	//   --mesh <file.obj|file.gltf|file.glb|file.bmesh>   show a model next to the cube
+	//   --mesh-grid <n>                        an n x n field of copies of it behind the cube (64 at most)
+	//   --lod                                  draw the meshes' LODs by projected error (L prints the
+	//                                          stats and toggles full detail)
+	//   --lod-fade                             --lod with dithered cross fades between the LODs
+	//   --lod-error <pixels>                   screen space error a LOD may have, 1 by default
+	//   --meshlets                             cull the full detail meshes per meshlet (K prints the stats)
+	//   --bench-load <file> [--repeat N]       only measure the parse throughput and exit
+	//   --bench-mips <image> [--repeat N]      only measure the mip chain builder and exit
+	//   --bench-occlusion <objects>            only measure occlusion culling on a generated city and exit
+	//   --texture <file.png|file.ktx2>          compress (once, cached) and stream a texture
+	//   --texture-budget <MB>                  VRAM budget of the texture streamer
+	//   --raw-textures                         upload images as RGBA8 + CPU mips instead
+	//   --texture-arrays                       group textures into arrays (raw ones into an atlas)
+	//   --bindless                             resident texture handles, falls back to the arrays
+	//   --bench-textures <draws>               binds vs arrays vs bindless for the --texture files
+	//   --lights <n>                           number of lights circling the scene
+	//   --shadows                              shadow map for the first light
+	//   --spirv                                use ShaderCheck's SPIR-V (GL_ARB_gl_spirv) or optimized GLSL
+	//   --golden <dir>                         render fixed animation times headless (llvmpipe) and
+	//                                          compare them to the reference PNGs in <dir>
+	//                                          (golden has the committed ones)
+	//   --update-golden                        write the references instead of comparing
+	//   --capture <dir>                        capture every frame into <dir> (C toggles, P saves a PNG)
+	//   --capture-format png|raw|y4m           format of the captured frames, png by default
+	//   --batch <jobs.json>                    render the jobs offscreen and write them through the
+	//                                          capture path, see BatchJobs.h for the file
+	//   --batch-workers <n>                    split the jobs over n processes
+	//   --trace <file>                         record every GL call into <file> for GLReplay
+	//   --trace-frames <n>                     stop recording after n frames
+	//   --dynamic-res <ms>                     render the scene at a resolution that keeps its GPU
+	//                                          time within <ms> per frame (R prints the stats)
+	//   --upscale bilinear|fsr                 how that image is brought to the window, fsr by default
+	//   --min-scale <s>                        lowest render scale of --dynamic-res, 0.5 by default
+	//   --hdr [aces|agx]                       HDR scene with bloom, tonemapping and FXAA (H prints
+	//                                          the pass timings), aces by default
+	//   --exposure <f>                         exposure of --hdr, 1 by default
+	//   --occlusion                            skip objects the cubes hide, CPU Hi-Z (O prints the stats)
+	//   --particles <count>                    sparks from the orbiting light, up to <count> (1M at most)
+	//                                          alive at once (F prints the stats)
+	//   --particles-gpu                        simulate them in a compute shader instead of on the CPU
+	//   --bench-particles <count>              only measure the CPU particle update and exit
+	//   --no-cache                             ignore and don't fill the asset cache
+	std::vector<std::string> meshPaths;
+	std::vector<std::string> texturePaths;
+	bool useAssetCache = true;
+	bool compressTextures = true;
+	size_t textureBudget = 256;
+	bool useTextureArrays = false;
+	bool useBindless = false;
+	int benchTextureDraws = 0;
+	int lightCount = 1;
+	bool useShadows = false;
+	bool useCompiledShaders = false;
+	std::string goldenDirectory;
+	bool updateGolden = false;
+	std::string captureDirectory = "capture";
+	CaptureFormat captureFormat = CaptureFormat::Png;
+	bool captureFromStart = false;
+	std::string batchPath;
+	int batchWorkers = 1;
+	int batchWorker = -1; // set in the worker processes
+	std::string workerArguments; // what the workers get passed on
+	std::string tracePath;
+	int traceFrames = 0;
+	float dynamicResolutionMs = 0.0f;
+	UpscaleMode upscaleMode = UpscaleMode::Fsr;
+	float minRenderScale = 0.5f;
+	std::string tonemapperName; // empty without --hdr
+	Tonemapper tonemapper = Tonemapper::Aces;
+	float exposure = 1.0f;
+	bool useOcclusion = false;
+	bool useLods = false;
+	bool lodCrossFade = false;
+	float lodPixelError = 1.0f;
+	int meshGrid = 1;
+	bool useMeshlets = false;
+	size_t particleCount = 0;
+	bool particlesOnGpu = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--batch-workers" && i + 1 < argc)
+			i++;
+		else
+			workerArguments += std::string(" \"") + argv[i] + "\"";
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bench-load" && i + 1 < argc)
+		{
+			int repeat = 5;
+			for (int k = i + 2; k + 1 < argc; k++)
+				if (std::string(argv[k]) == "--repeat")
+					repeat = std::max(1, std::atoi(argv[k + 1]));
+			return benchLoad(argv[i + 1], repeat);
+		}
+		if (arg == "--bench-mips" && i + 1 < argc)
+		{
+			int repeat = 5;
+			for (int k = i + 2; k + 1 < argc; k++)
+				if (std::string(argv[k]) == "--repeat")
+					repeat = std::max(1, std::atoi(argv[k + 1]));
+			return benchMips(argv[i + 1], repeat);
+		}
+		if (arg == "--bench-occlusion" && i + 1 < argc)
+			return benchOcclusion(std::max(1, std::atoi(argv[i + 1])));
+		if (arg == "--bench-particles" && i + 1 < argc)
+			return benchParticles(std::min(std::max(1, std::atoi(argv[i + 1])), 1 << 20));
+		if (arg == "--mesh" && i + 1 < argc)
+			meshPaths.push_back(argv[++i]);
+		if (arg == "--texture" && i + 1 < argc)
+			texturePaths.push_back(argv[++i]);
+		if (arg == "--no-cache")
+			useAssetCache = false;
+		if (arg == "--raw-textures")
+			compressTextures = false;
+		if (arg == "--texture-arrays")
+			useTextureArrays = true;
+		if (arg == "--bindless")
+			useBindless = true;
+		if (arg == "--bench-textures" && i + 1 < argc)
+			benchTextureDraws = std::max(1, std::atoi(argv[++i]));
+		if (arg == "--lights" && i + 1 < argc)
+			lightCount = std::min(std::max(1, std::atoi(argv[++i])), 8);
+		if (arg == "--shadows")
+			useShadows = true;
+		if (arg == "--spirv")
+			useCompiledShaders = true;
+		if (arg == "--golden" && i + 1 < argc)
+			goldenDirectory = argv[++i];
+		if (arg == "--update-golden")
+			updateGolden = true;
+		if (arg == "--capture" && i + 1 < argc)
+		{
+			captureDirectory = argv[++i];
+			captureFromStart = true;
+		}
+		if (arg == "--capture-format" && i + 1 < argc && !parseCaptureFormat(argv[++i], captureFormat))
+			std::cout << "Unknown capture format " << argv[i] << ", using png" << std::endl;
+		if (arg == "--batch" && i + 1 < argc)
+			batchPath = argv[++i];
+		if (arg == "--batch-workers" && i + 1 < argc)
+			batchWorkers = std::max(1, std::atoi(argv[++i]));
+		if (arg == "--batch-worker" && i + 1 < argc)
+		{
+			// "i/n"
+			std::string worker = argv[++i];
+			batchWorker = std::atoi(worker.c_str());
+			batchWorkers = std::max(1, std::atoi(worker.c_str() + std::min(worker.find('/') + 1, worker.size())));
+		}
+		if (arg == "--trace" && i + 1 < argc)
+			tracePath = argv[++i];
+		if (arg == "--trace-frames" && i + 1 < argc)
+			traceFrames = std::max(1, std::atoi(argv[++i]));
+		if (arg == "--dynamic-res" && i + 1 < argc)
+			dynamicResolutionMs = std::max(0.0f, (float)std::atof(argv[++i]));
+		if (arg == "--upscale" && i + 1 < argc && !parseUpscaleMode(argv[++i], upscaleMode))
+			std::cout << "Unknown upscale mode " << argv[i] << ", using fsr" << std::endl;
+		if (arg == "--min-scale" && i + 1 < argc)
+			minRenderScale = std::min(std::max((float)std::atof(argv[++i]), 0.1f), 1.0f);
+		if (arg == "--hdr")
+		{
+			tonemapperName = "aces";
+			if (i + 1 < argc && parseTonemapper(argv[i + 1], tonemapper))
+				tonemapperName = argv[++i];
+		}
+		if (arg == "--exposure" && i + 1 < argc)
+			exposure = std::max((float)std::atof(argv[++i]), 0.0f);
+		if (arg == "--occlusion")
+			useOcclusion = true;
+		if (arg == "--lod" || arg == "--lod-fade")
+			useLods = true;
+		if (arg == "--lod-fade")
+			lodCrossFade = true;
+		if (arg == "--lod-error" && i + 1 < argc)
+			lodPixelError = std::max((float)std::atof(argv[++i]), 0.01f);
+		if (arg == "--meshlets")
+			useMeshlets = true;
+		if (arg == "--particles" && i + 1 < argc)
+			particleCount = (size_t)std::min(std::max(1, std::atoi(argv[++i])), 1 << 20);
+		if (arg == "--particles-gpu")
+			particlesOnGpu = true;
+		if (arg == "--mesh-grid" && i + 1 < argc)
+			meshGrid = std::min(std::max(1, std::atoi(argv[++i])), 64);
+		if (arg == "--texture-budget" && i + 1 < argc)
+			textureBudget = (size_t)std::max(1, std::atoi(argv[++i]));
+	}
+
+	// batch rendering: the parent only starts the worker processes and waits for them
+	std::vector<RenderJob> renderJobs;
+	if (!batchPath.empty() && !loadRenderJobs(batchPath, renderJobs))
+		return 1;
+	if (!renderJobs.empty() && batchWorker < 0 && batchWorkers > 1)
+	{
+		int totalFrames = 0;
+		for (const RenderJob& job : renderJobs)
+			totalFrames += job.frames;
+		return runBatchWorkers(argv[0], workerArguments, batchWorkers, totalFrames);
+	}
+	BatchRun batch;
+	if (!renderJobs.empty())
+		batch = BatchRun(renderJobs, std::max(batchWorker, 0), batchWorkers);
+	bool headless = !goldenDirectory.empty() || batch.enabled();
+
+	// golden images are made with Mesa's software rasterizer so they are the same on every
+	// machine: on Windows put Mesa's opengl32.dll next to the exe, elsewhere these select it
+	GoldenImageRun golden(goldenDirectory, goldenSceneName(lightCount, useShadows, tonemapperName, meshPaths, texturePaths), updateGolden);
+	if (golden.enabled())
+	{
+#ifdef _WIN32
+		if (!std::getenv("GALLIUM_DRIVER"))
+			_putenv_s("GALLIUM_DRIVER", "llvmpipe");
+#else
+		setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+		setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+#endif
+	}
+
 	// Initializing glfw, setting the min and maj required Versions and telling the program to use the core profile
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (headless)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 
 	// creating the Window (sizing and naming)
 
-	GLFWwindow* window = glfwCreateWindow(1200, 800, "Second OpenGL Test", NULL, NULL);
+	// the references have a fixed size, small enough for the software rasterizer
+	GLFWwindow* window = golden.enabled() ? glfwCreateWindow(GOLDEN_WIDTH, GOLDEN_HEIGHT, "Golden images", NULL, NULL)
+		: glfwCreateWindow(1200, 800, "Second OpenGL Test", NULL, NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -66,8 +401,10 @@ int main()
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetKeyCallback(window, key_callback);
 
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headless)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	
 
 
@@ -76,19 +413,100 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	// before any other GL call, a replay needs every object from its creation on
+	if (!tracePath.empty())
+	{
+		int traceWidth, traceHeight;
+		glfwGetFramebufferSize(window, &traceWidth, &traceHeight);
+		GLTraceWriter::instance().start(tracePath, traceWidth, traceHeight, traceFrames);
+	}
 	//setting the Viewportsize ; could be smaller than the Window to 
 	// have a 3d Viewport and some other stuff elewhere
 
 	//glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 	
 
-	glfwSwapInterval(1); // Enable VSync (1 frame per refresh)
+	glfwSwapInterval(headless ? 0 : 1); // Enable VSync (1 frame per refresh)
+	if (golden.enabled())
+	{
+		std::string renderer = (const char*)glGetString(GL_RENDERER);
+		std::cout << "Golden images on " << renderer << std::endl;
+		if (renderer.find("llvmpipe") == std::string::npos)
+			std::cout << "WARNING::GOLDEN::NOT_LLVMPIPE the references come from llvmpipe, expect small differences" << std::endl;
+	}
+
+	// processed assets (baked meshes, program binaries) keyed by the hash of their sources
+	AssetCache assetCache("cache");
+	assetCache.setEnabled(useAssetCache && assetCache.isEnabled());
+	ProgramBinaryApi::load((GLADloadproc)glfwGetProcAddress);
+	BindlessTextureApi::load((GLADloadproc)glfwGetProcAddress);
+	SpirvApi::load((GLADloadproc)glfwGetProcAddress);
+	ComputeApi::load((GLADloadproc)glfwGetProcAddress);
+	SpirvApi::instance().preferCompiled = useCompiledShaders;
+	if (GLTraceWriter::instance().recording())
+	{
+		// these bypass glad and with it the trace, a replay would miss their programs and textures
+		ProgramBinaryApi::instance().supported = false;
+		BindlessTextureApi::instance().supported = false;
+		SpirvApi::instance().supported = false;
+		ComputeApi::instance().supported = false;
+	}
+	if (useCompiledShaders && !SpirvApi::instance().supported)
+		std::cout << "GL_ARB_gl_spirv is not supported, using ShaderCheck's optimized GLSL where it exists" << std::endl;
+
+	// the window is bigger than the default settings, start with the real framebuffer size
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	SCR_WIDTH = framebufferWidth;
+	SCR_HEIGHT = framebufferHeight;
 
 	//setup and buid shaderprograms -----------------------------------------------------------------------------------------------------
 
 
-	Shader myShader("shaders/shader.vs", "shaders/shader.fs");
-	Shader lightShader("shaders/shader.vs", "shaders/lightShader.fs");
+	// the cube is stored with 16 bit positions inside its AABB and octahedral normals,
+	// 12 bytes per vertex instead of 24. The shaders get told how to read that.
+	VertexFormat cubeFormat = ShaderVariants::vertexFormat();
+
+	// the lit objects go through the material system, their programs are compiled per
+	// permutation once the materials are known. Cross-fading LODs dither in all of them.
+	ShaderPermutations materialShaders("shaders/shader.vs", "shaders/shader.fs", ShaderVariants::material(lodCrossFade, cubeFormat.shaderDefines()), &assetCache);
+	Shader lightShader("shaders/shader.vs", "shaders/lightShader.fs", cubeFormat.shaderDefines(), &assetCache);
+	// depth only, the fragment shader's color goes nowhere without a color attachment
+	Shader shadowShader("shaders/shader.vs", "shaders/lightShader.fs", cubeFormat.shaderDefines(), &assetCache);
+
+	// dynamic resolution: the scene renders into a texture of its own at the scale the GPU
+	// timings pick and gets upscaled into the window. Golden images and batch jobs always
+	// render at their exact size.
+	DynamicResolution dynamicResolution;
+	std::unique_ptr<Upscaler> upscaler;
+	GpuFrameTimer gpuTimer;
+	if (dynamicResolutionMs > 0.0f && !headless)
+	{
+		dynamicResolution = DynamicResolution(dynamicResolutionMs, minRenderScale);
+		upscaler.reset(new Upscaler(upscaleMode, cubeFormat.shaderDefines(), &assetCache));
+	}
+	// HDR: the scene renders into RGBA16F and the post chain brings it to the display,
+	// before the upscaler so bloom and FXAA only run at the render resolution
+	std::unique_ptr<PostChain> postChain;
+	if (!tonemapperName.empty())
+	{
+		if (ComputeApi::instance().supported)
+		{
+			postChain.reset(new PostChain(tonemapper, cubeFormat.shaderDefines(), &assetCache));
+			postChain->exposure = exposure;
+		}
+		else
+			std::cout << "Compute shaders are not supported" << (GLTraceWriter::instance().recording() ? " while tracing" : "") << ", rendering without --hdr" << std::endl;
+	}
+	// sparks streaming out of the light cube, drawn into the scene after the objects
+	std::unique_ptr<ParticleSystem> particles;
+	if (particleCount > 0)
+	{
+		ParticleSettings particleSettings;
+		particleSettings.capacity = particleCount;
+		particleSettings.gpu = particlesOnGpu;
+		particles.reset(new ParticleSystem(particleSettings, cubeFormat.shaderDefines(), &assetCache));
+	}
 
 
 
@@ -96,158 +514,1369 @@ int main()
 
 
 	float vertices[] = {
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
+		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+
+		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,  0.0f, 0.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,  1.0f, 1.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,  1.0f, 1.0f,
+		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,  0.0f, 0.0f,
+
+		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
 	};
 
-	unsigned int indices[] = {
-		0, 1, 3,
-		1, 2, 3
-	};
-
-	
-	unsigned int VBO, VAO, EBO;
-	
-
-	//Generate a Buffer inside the Variable
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-
-
-	glBindVertexArray(VAO);
+	VertexStreams cubeStreams;
+	cubeStreams.positions = vertices;
+	cubeStreams.normals = vertices + 3;
+	cubeStreams.uvs = vertices + 6;
+	cubeStreams.positionStride = 8;
+	cubeStreams.normalStride = 8;
+	cubeStreams.uvStride = 8;
+	cubeStreams.count = 36;
+	EncodedVertices cubeVertices = encodeVertices(cubeStreams, cubeFormat);
+	cubeVertices.printReport("cube");
+
+	// every mesh of this vertex format lives in one shared vertex/index buffer with one VAO
+	MeshArena meshArena(cubeFormat.layout());
+
+	std::vector<uint32_t> cubeIndices(36);
+	std::iota(cubeIndices.begin(), cubeIndices.end(), 0);
+	int cubeMesh = meshArena.upload(cubeVertices.data.data(), cubeVertices.vertexCount(), cubeIndices.data(), cubeIndices.size());
+
+	JobSystem jobs;
+
+	std::vector<MeshInstance> loadedMeshes;
+	auto loadBegin = std::chrono::high_resolution_clock::now();
+	for (const std::string& path : meshPaths)
+		loadMeshFile(path, cubeFormat, jobs, meshArena, assetCache, loadedMeshes);
+	if (!meshPaths.empty())
+		std::cout << "Mesh loading took " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadBegin).count() << " ms" << std::endl;
+
+	if (benchTextureDraws > 0)
+	{
+		int result = benchTextures(window, jobs, assetCache, meshArena, cubeMesh, cubeVertices.dequantizeMatrix(), cubeFormat.shaderDefines(), texturePaths, benchTextureDraws);
+		meshArena.release();
+		GLTraceWriter::instance().stop();
+		glfwTerminate();
+		return result;
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	//specifies the Bufffertype, the size of the data, a reference to the data and how to draw it
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// compressed textures start with their mip tail and stream in finer levels as needed.
+	// With --texture-arrays they are grouped into array layers (all levels resident) and
+	// raw images are packed into atlas pages, materials then reference a slot.
+	// With --bindless every texture is uploaded completely and gets a resident handle,
+	// the slots are then indices into the handle table.
+	if (useBindless && !BindlessTextureTable::isSupported())
+	{
+		std::cout << "GL_ARB_bindless_texture or GL_ARB_shader_storage_buffer_object not supported, using texture arrays" << std::endl;
+		useBindless = false;
+		useTextureArrays = true;
+	}
+	else if (useBindless)
+	{
+		std::cout << "Using bindless textures" << std::endl;
+		useTextureArrays = false;
+	}
+	TextureStreamer textureStreamer(&jobs, textureBudget * 1024 * 1024);
+	TextureArrays textureArrays;
+	BindlessTextureTable bindlessTextures;
+	std::vector<int> textureSlots;
+	std::vector<unsigned int> textures;
+	loadBegin = std::chrono::high_resolution_clock::now();
+	for (const std::string& path : texturePaths)
+	{
+		Ktx2Texture texture;
+		if (useBindless)
+		{
+			unsigned int id = 0;
+			if (!compressTextures)
+				id = loadRawTexture(path, jobs);
+			else if (loadTextureFile(path, jobs, assetCache, texture))
+				id = texture.upload();
+			if (id != 0)
+			{
+				textures.push_back(id);
+				textureSlots.push_back(bindlessTextures.add(id));
+			}
+		}
+		else if (!compressTextures && useTextureArrays)
+		{
+			MappedFile source(path);
+			ImageRGBA8 image;
+			if (source.isOpen() && decodeImageRGBA8(source.data(), source.size(), image, path))
+				textureSlots.push_back(textureArrays.addToAtlas(image, TextureImportSettings::fromName(path).srgb));
+		}
+		else if (!compressTextures)
+		{
+			if (unsigned int raw = loadRawTexture(path, jobs))
+			{
+				textureSlots.push_back((int)textures.size());
+				textures.push_back(raw);
+			}
+		}
+		else if (loadTextureFile(path, jobs, assetCache, texture))
+		{
+			if (useTextureArrays)
+				textureSlots.push_back(textureArrays.add(std::move(texture)));
+			else
+				textureSlots.push_back(textureStreamer.add(std::move(texture)));
+		}
+	}
+	if (useTextureArrays)
+	{
+		textureArrays.build(&jobs);
+		textureArrays.printStats();
+	}
+	bindlessTextures.upload();
+	if (!texturePaths.empty())
+		std::cout << "Texture loading took " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadBegin).count() << " ms" << std::endl;
+	assetCache.printStats();
 
 
+	glEnable(GL_DEPTH_TEST);
 
-	//telling OpenGL how to interpret the vertex Data
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0); //Needs to be enabled? is deabled by default
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
 
+	// materials -------------------------------------------------------------------------------------------
+	// the cube and the loaded models get the first two textures, when there are any
+	MaterialTextureSource textureSource = useBindless ? MaterialTextureSource::Bindless
+		: (useTextureArrays ? MaterialTextureSource::Array : MaterialTextureSource::Bound2D);
+	MaterialLibrary materials;
+	auto materialTexture = [&](int slot)
+	{
+		MaterialTexture texture;
+		if (useBindless)
+			texture.bindlessIndex = slot;
+		else if (useTextureArrays)
+		{
+			const TextureSlot& arraySlot = textureArrays.slot(slot);
+			texture.texture = textureArrays.texture(arraySlot.array);
+			texture.layer = (float)arraySlot.layer;
+			texture.uvRect = arraySlot.uvRect;
+		}
+		else
+			texture.texture = compressTextures ? textureStreamer.texture(slot) : textures[slot];
+		return texture;
+	};
+	auto addMaterial = [&](Material material, size_t textureIndex)
+	{
+		if (textureIndex < textureSlots.size() && textureSlots[textureIndex] >= 0)
+		{
+			material.texture = (int)textureIndex;
+			return materials.add(material, materialTexture(textureSlots[textureIndex]));
+		}
+		return materials.add(material);
+	};
+	Material orange;
+	orange.color = glm::vec3(1.0f, 0.5f, 0.31f);
+	int cubeMaterial = addMaterial(orange, 0);
+	int meshMaterial = addMaterial(orange, textureSlots.size() > 1 ? 1 : 0);
+	materials.upload();
 
-	unsigned int lightVAO;
-	glGenVertexArrays(1, &lightVAO);
-	glBindVertexArray(lightVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
 
+	// command recording -----------------------------------------------------------------------------------
+	// worker threads only fill command lists, the GL calls all happen here on the context thread
 
-	glEnable(GL_DEPTH_TEST);
+	ParallelCommandRecorder recorder;
+	ParallelCommandRecorder shadowRecorder;
+	GLCommandReplayer replayer;
+	CommandList frameCommands;
+	FrameGraph frameGraph;
 
+	// every material asks for its permutation, objects with the same one share the program
+	auto materialObject = [&](int mesh, glm::vec3 position, float scale, const glm::mat4& meshTransform, const glm::mat3& normalMatrix, int material)
+	{
+		const MaterialProgram& program = materialShaders.program(materialShaders.find(materials.permutation(material, textureSource, lightCount, useShadows)));
+		return RenderObject{ program.id, mesh, program.model, position, scale, meshTransform, material, program.lodFade, program.normalMatrix, normalMatrix };
+	};
+	std::vector<RenderObject> objects;
+	objects.push_back(materialObject(cubeMesh, glm::vec3(0.0f), 1.0f, cubeVertices.dequantizeMatrix(), glm::mat3(1.0f), cubeMaterial));
+	objects.push_back({ lightShader.ID, cubeMesh, Shader::uniformLocation(lightShader.ID, "model"), lightPos, 0.2f, cubeVertices.dequantizeMatrix(), -1 });
+	const size_t lightObject = 1;
+	// loaded models sit next to the cube, with --mesh-grid as a field of copies behind it
+	std::vector<MeshLodChain> meshLods; // by arena mesh, empty chains draw the whole mesh
+	MeshletCuller meshletCuller;
+	std::vector<int> meshClusters;      // by arena mesh, the culler's mesh or -1
+	for (const MeshInstance& instance : loadedMeshes)
+	{
+		float spacing = 1.5f * std::max(1.0f, LodSelector::maxScale(instance.transform));
+		for (int z = 0; z < meshGrid; z++)
+			for (int x = 0; x < meshGrid; x++)
+				objects.push_back(materialObject(instance.mesh, glm::vec3(2.5f + x * spacing, 0.0f, -z * spacing), 1.0f, instance.transform, instance.normalMatrix, meshMaterial));
+		if (instance.mesh >= (int)meshLods.size())
+			meshLods.resize(instance.mesh + 1);
+		meshLods[instance.mesh] = instance.lods;
+		if (useMeshlets && !instance.meshlets.meshlets.empty())
+		{
+			meshClusters.resize(meshLods.size(), -1);
+			meshClusters[instance.mesh] = meshletCuller.addMesh(instance.meshlets);
+		}
+	}
+	materialShaders.printStats();
+
+	// LODs by projected error; L switches between them and full detail to compare both
+	LodSelector lodSelector;
+	lodSelector.pixelError = lodPixelError;
+	lodSelector.crossFade = lodCrossFade;
+	std::vector<LodState> objectLods(objects.size());
+	// full detail draws of meshes with meshlets go through cluster culling (K prints stats)
+	std::vector<int> objectClusters(objects.size(), -1);
+	bool lodsEnabled = useLods;
+	LodStats lodStats[2]; // full detail, LODs
+	GpuPassTimer lodSceneTimer({ "scene" }), fullSceneTimer({ "scene" });
+	bool timeLods = useLods && !GLTraceWriter::instance().recording();
+	auto printLodStats = [&]()
+	{
+		GpuPassTimer* timers[2] = { &fullSceneTimer, &lodSceneTimer };
+		for (int mode = 1; mode >= 0; mode--)
+		{
+			std::cout << (mode ? "With LODs (" : "Full detail (") << lodStats[mode].frames << " frames, scene pass " << timers[mode]->averageMs(0) << " ms GPU)" << std::endl;
+			lodStats[mode].print();
+		}
+		if (timers[0]->measuredFrames() > 0 && timers[1]->measuredFrames() > 0)
+			std::cout << "LODs save " << timers[0]->averageMs(0) - timers[1]->averageMs(0) << " ms of scene GPU time" << std::endl;
+	};
 
+	// the cubes fill their bounds and are the occluders, everything is tested by its bounds
+	OcclusionCuller occlusion;
+	int cubeOccluder = occlusion.addBox();
+	std::vector<glm::mat4> objectBounds(objects.size());
+	std::vector<uint8_t> objectVisible(objects.size(), 1);
+
+	int lightProjectionLoc = Shader::uniformLocation(lightShader.ID, "projection");
+	int lightViewLoc = Shader::uniformLocation(lightShader.ID, "view");
+	int shadowModelLoc = Shader::uniformLocation(shadowShader.ID, "model");
+	int shadowProjectionLoc = Shader::uniformLocation(shadowShader.ID, "projection");
+	int shadowViewLoc = Shader::uniformLocation(shadowShader.ID, "view");
+
+	// the first light is the white one circling the cube, the others follow it around
+	std::vector<glm::vec3> lightPositions(lightCount);
+	std::vector<glm::vec3> lightColors(lightCount, glm::vec3(1.0f));
+	const glm::vec3 lightPalette[] = { glm::vec3(0.6f, 0.3f, 0.3f), glm::vec3(0.3f, 0.6f, 0.3f), glm::vec3(0.3f, 0.3f, 0.6f) };
+	for (int i = 1; i < lightCount; i++)
+		lightColors[i] = lightPalette[(i - 1) % 3];
+
+
+	// frames are read back through a ring of pixel buffers and written on their own thread
+	FrameCapture frameCapture;
+	if (captureFromStart)
+		frameCapture.start(captureDirectory, captureFormat);
+	int screenshotCount = 0;
+
+	// batch jobs render into their own color texture at the job's size, the capture reads it
+	// back through a framebuffer of its own. The window only provides the context.
+	unsigned int batchColor = 0;
+	unsigned int batchReadFramebuffer = 0;
+	int batchWidth = 0, batchHeight = 0;
+	if (batch.enabled())
+	{
+		frameCapture.verbose = false;
+		if (!batch.active())
+			glfwSetWindowShouldClose(window, true); // more workers than ranges
+		batch.start();
+	}
 
 
 	// render loop ----------------------------------------------------------------------------------------
+	bool firstFrame = true;
+	float lastShaderPoll = 0.0f;
+	int framesSinceDefragment = 0;
 	while (!glfwWindowShouldClose(window))
 	{
-
-		float currentFrame = glfwGetTime();
+		auto frameBegin = std::chrono::high_resolution_clock::now();
+
+		// golden images replay fixed points of the animation with the camera where it starts
+		float currentFrame = golden.active() ? golden.time() : (float)glfwGetTime();
+		bool offscreen = batch.active();
+		if (offscreen)
+		{
+			const RenderJob& job = batch.job();
+			if (batch.unitStarts())
+			{
+				if (job.width != batchWidth || job.height != batchHeight)
+				{
+					if (batchColor == 0)
+					{
+						glGenTextures(1, &batchColor);
+						glGenFramebuffers(1, &batchReadFramebuffer);
+					}
+					glBindTexture(GL_TEXTURE_2D, batchColor);
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, job.width, job.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+					glBindTexture(GL_TEXTURE_2D, 0);
+					glBindFramebuffer(GL_FRAMEBUFFER, batchReadFramebuffer);
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, batchColor, 0);
+					glBindFramebuffer(GL_FRAMEBUFFER, 0);
+					batchWidth = job.width;
+					batchHeight = job.height;
+				}
+				frameCapture.start(job.output, job.format, job.fps, batch.firstFrame());
+
+				// the particles carry state from frame to frame: they are simulated from the
+				// job's first frame on, with the time steps rendering it whole would take, so a
+				// range looks the same however the job was split between workers
+				auto frameStep = [&job](int frame) { return frame > 0 ? job.time(frame) - job.time(frame - 1) : 1.0f / job.fps; };
+				if (particles)
+				{
+					particles->reset();
+					for (int frame = 0; frame < batch.firstFrame(); frame++)
+					{
+						float t = job.time(frame);
+						glm::vec3 origin = glm::vec3(sin(t) * 3, 1, cos(t) * 3);
+						job.lightAt(t, origin);
+						particles->update(origin, frameStep(frame), &jobs);
+						particles->endFrame();
+					}
+				}
+				lastFrame = batch.firstFrame() > 0 ? job.time(batch.firstFrame() - 1) : job.time(0) - frameStep(0);
+			}
+			SCR_WIDTH = job.width;
+			SCR_HEIGHT = job.height;
+			currentFrame = batch.time();
+			CameraKey camera = job.cameraAt(currentFrame);
+			cameraPos = camera.position;
+			cameraFront = glm::normalize(camera.target - camera.position);
+			fov = camera.fov;
+		}
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		//input:
-		processInput(window);
-
-		//rendering:
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		myShader.use();
-		myShader.setVec3("objectColor", 1.0f, 0.5f, 0.31f);
-		myShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-		myShader.setVec3("lightPos", lightPos);
-		myShader.setVec3("viewPos", cameraPos);
+		if (!headless)
+			processInput(window);
+
+		// hot reload: the material permutations that include an edited file are rebuilt
+		if (currentFrame - lastShaderPoll > 0.5f)
+		{
+			lastShaderPoll = currentFrame;
+			std::vector<std::string> changed = ShaderSourceCache::shared().pollChanges();
+			if (!changed.empty() && materialShaders.reload(changed))
+				for (RenderObject& object : objects)
+					if (object.material >= 0)
+						object = materialObject(object.mesh, object.position, object.scale, object.meshTransform, object.normalMatrix, object.material);
+		}
+
+		// compaction copies on the render thread, so it runs in slices: at most every 16th
+		// frame and only while the free space is scattered. It has to happen before
+		// recording reads the draw ranges.
+		if (++framesSinceDefragment >= 16)
+		{
+			framesSinceDefragment = 0;
+			MeshArena::Stats arenaStats = meshArena.stats();
+			if (std::max(arenaStats.vertices.fragmentation(), arenaStats.indices.fragmentation()) > 0.25f)
+				meshArena.defragment(256 * 1024);
+		}
 
 		// view/projection transformations
 		glm::mat4 projection =	glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-		myShader.setMat4("projection", projection);
-		myShader.setMat4("view", view);
 
-		// world transformations
-		glm::mat4 model = glm::mat4(1.0f);
-		myShader.setMat4("model", model);
-
-		// setting value for Blending
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		lightShader.use();
+		// per frame uniforms, these are program state so they only need setting once
 		lightPos = glm::vec3(sin(currentFrame) * 3, 1 , cos(currentFrame) * 3);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, lightPos);
-		model = glm::scale(model, glm::vec3(0.2f));
-		lightShader.setMat4("projection", projection);
-		lightShader.setMat4("view", view);
-
-		lightShader.setMat4("model", model);
-
-		glBindVertexArray(lightVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
+		objects[lightObject].position = lightPos;
+		for (int i = 0; i < lightCount; i++)
+		{
+			float phase = currentFrame + i * 6.2831853f / lightCount;
+			lightPositions[i] = glm::vec3(sin(phase) * 3, 1.0f + 0.5f * i, cos(phase) * 3);
+		}
+		glm::vec3 jobLight;
+		if (offscreen && batch.job().lightAt(currentFrame, jobLight))
+		{
+			lightPositions[0] = jobLight;
+			lightPos = jobLight;
+			objects[lightObject].position = jobLight;
+		}
+
+		// the shadow casting light looks at the scene center
+		glm::mat4 lightSpace = glm::perspective(glm::radians(90.0f), 1.0f, 0.5f, 20.0f) * glm::lookAt(lightPositions[0], glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		// per frame uniforms, these are program state so they only need setting once per
+		// permutation. Material parameters are in the uniform buffer and not set at all.
+		frameCommands.reset();
+		for (const MaterialProgram& program : materialShaders.programs())
+		{
+			frameCommands.bindProgram(program.id);
+			frameCommands.uniform(program.lightPositions, UniformType::Vec3, lightCount, lightPositions.data(), sizeof(glm::vec3) * lightCount);
+			frameCommands.uniform(program.lightColors, UniformType::Vec3, lightCount, lightColors.data(), sizeof(glm::vec3) * lightCount);
+			frameCommands.setVec3(program.viewPos, cameraPos);
+			frameCommands.setMat4(program.projection, projection);
+			frameCommands.setMat4(program.view, view);
+			frameCommands.setMat4(program.lightSpace, lightSpace);
+		}
+		frameCommands.bindProgram(lightShader.ID);
+		frameCommands.setMat4(lightProjectionLoc, projection);
+		frameCommands.setMat4(lightViewLoc, view);
+
+		// mip each streamed texture needs from the on-screen size of the objects using it
+		for (int i = 0; i < textureStreamer.count(); i++)
+			textureStreamer.request(i, textureStreamer.mipForScreenSize(i, 0.0f));
+		for (const RenderObject& object : objects)
+		{
+			if (object.material < 0 || materials.material(object.material).texture < 0 || !compressTextures || useTextureArrays || useBindless)
+				continue;
+			int texture = textureSlots[materials.material(object.material).texture];
+			float distance = std::max(0.1f, glm::length(object.position - cameraPos));
+			float pixels = object.scale / (2.0f * distance * tan(glm::radians(fov) * 0.5f)) * SCR_HEIGHT * dynamicResolution.scale();
+			textureStreamer.request(texture, textureStreamer.mipForScreenSize(texture, pixels));
+		}
+		textureStreamer.update();
+		materials.upload();
+
+		// occlusion culling of the camera view, shadow casters outside of it still cast
+		if (useOcclusion)
+		{
+			occlusion.beginFrame(projection * view);
+			for (size_t i = 0; i < objects.size(); i++)
+			{
+				const RenderObject& object = objects[i];
+				objectBounds[i] = glm::translate(glm::mat4(1.0f), object.position) * glm::scale(glm::mat4(1.0f), glm::vec3(object.scale)) * object.meshTransform;
+				if (object.mesh == cubeMesh)
+					occlusion.addOccluder(cubeOccluder, objectBounds[i]);
+			}
+			occlusion.render(&jobs);
+			occlusion.test(objectBounds, objectVisible, &jobs);
+			occlusion.endFrame();
+		}
+
+		// LODs from the projected simplification error of each object's nearest point.
+		// Objects with a chain always draw one of its ranges, without --lod that is LOD0.
+		lodStats[lodsEnabled ? 1 : 0].frames++;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			const RenderObject& object = objects[i];
+			if (object.mesh >= (int)meshLods.size() || meshLods[object.mesh].lods.empty())
+				continue;
+			const MeshLodChain& chain = meshLods[object.mesh];
+			int lod = 0;
+			if (lodsEnabled)
+			{
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), object.position) * glm::scale(glm::mat4(1.0f), glm::vec3(object.scale)) * object.meshTransform;
+				glm::vec3 center = glm::vec3(model * glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+				float radius = 0.5f * glm::length(glm::vec3(model * glm::vec4(1.0f, 1.0f, 1.0f, 0.0f)));
+				float distance = glm::length(center - cameraPos) - radius;
+				lod = lodSelector.select(chain, object.scale, distance, glm::radians(fov), SCR_HEIGHT * dynamicResolution.scale(), objectLods[i].lod);
+			}
+			lodSelector.update(objectLods[i], lod, deltaTime);
+			if (objectVisible[i])
+				lodStats[lodsEnabled ? 1 : 0].count(chain, objectLods[i]);
+		}
+
+		// clusters of the visible objects drawn at full detail, compacted into one index
+		// buffer; coarser LODs are cheap enough as they are
+		GLuint meshletVao = 0;
+		if (useMeshlets)
+		{
+			meshletCuller.beginFrame();
+			for (size_t i = 0; i < objects.size(); i++)
+			{
+				const RenderObject& object = objects[i];
+				objectClusters[i] = -1;
+				if (!objectVisible[i] || object.mesh >= (int)meshClusters.size() || meshClusters[object.mesh] < 0 || objectLods[i].lod != 0 || objectLods[i].previous >= 0)
+					continue;
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), object.position) * glm::scale(glm::mat4(1.0f), glm::vec3(object.scale)) * object.meshTransform;
+				objectClusters[i] = meshletCuller.add(meshClusters[object.mesh], model);
+			}
+			meshletCuller.cull(projection * view, cameraPos, useOcclusion ? &occlusion : nullptr, &jobs);
+			meshletVao = meshletCuller.vao(meshArena);
+		}
+
+		// the CPU path writes the instances into the stream buffer on the workers meanwhile
+		if (particles)
+			particles->update(objects[lightObject].position, deltaTime, &jobs);
+
+		// world transformations are built on the worker threads
+		recorder.record(jobs, objects.size(), jobs.suggestedGrain(objects.size(), 64), [&](CommandList& list, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				if (!objectVisible[i])
+					continue;
+				const RenderObject& object = objects[i];
+				glm::mat4 model = glm::mat4(1.0f);
+				model = glm::translate(model, object.position);
+				model = glm::scale(model, glm::vec3(object.scale));
+				model = model * object.meshTransform;
+				list.bindProgram(object.program);
+				MeshArena::DrawParams draw = meshArena.drawParams(object.mesh);
+				list.bindVertexArray(meshArena.vao());
+				if (object.material >= 0)
+				{
+					// redundant binds of the same texture are dropped by the replayer
+					const MaterialTexture& texture = materials.texture(object.material);
+					if (texture.texture != 0)
+						list.bindTexture(MATERIAL_DIFFUSE_UNIT, texture.texture, textureSource == MaterialTextureSource::Array);
+					model = packMaterialIndex(model, object.material);
+				}
+				list.setMat4(object.modelLocation, model);
+				if (object.normalMatrixLocation >= 0)
+					list.setMat3(object.normalMatrixLocation, object.normalMatrix);
+				if (objectClusters[i] >= 0)
+				{
+					// what survived cluster culling, from the compacted index buffer
+					const MeshletCuller::Range& range = meshletCuller.range(objectClusters[i]);
+					if (object.lodFade >= 0)
+						list.setFloat(object.lodFade, 0.0f);
+					list.bindVertexArray(meshletVao);
+					if (range.indexCount > 0)
+						list.drawElements(PrimitiveType::Triangles, range.firstIndex, range.indexCount, draw.baseVertex);
+				}
+				else if (object.mesh < (int)meshLods.size() && !meshLods[object.mesh].lods.empty())
+				{
+					// cross-fading, the new LOD keeps the dither pattern's pixels under the fade
+					// and the old one draws the others, so each pixel comes from exactly one
+					const std::vector<BakedLod>& lods = meshLods[object.mesh].lods;
+					const LodState& state = objectLods[i];
+					bool fading = state.previous >= 0 && object.lodFade >= 0;
+					float fade = std::max(state.fade, 1e-3f);
+					if (object.lodFade >= 0)
+						list.setFloat(object.lodFade, fading ? fade : 0.0f);
+					list.drawElements(PrimitiveType::Triangles, draw.firstIndex + lods[state.lod].firstIndex, lods[state.lod].indexCount, draw.baseVertex);
+					if (fading)
+					{
+						list.setFloat(object.lodFade, -fade);
+						list.drawElements(PrimitiveType::Triangles, draw.firstIndex + lods[state.previous].firstIndex, lods[state.previous].indexCount, draw.baseVertex);
+					}
+				}
+				else
+					list.drawElements(PrimitiveType::Triangles, draw.firstIndex, draw.indexCount, draw.baseVertex);
+			}
+		});
+		if (useShadows)
+		{
+			shadowRecorder.record(jobs, objects.size(), jobs.suggestedGrain(objects.size(), 64), [&](CommandList& list, size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					const RenderObject& object = objects[i];
+					if (object.material < 0)
+						continue;
+					glm::mat4 model = glm::translate(glm::mat4(1.0f), object.position) * glm::scale(glm::mat4(1.0f), glm::vec3(object.scale)) * object.meshTransform;
+					MeshArena::DrawParams draw = meshArena.drawParams(object.mesh);
+					list.bindProgram(shadowShader.ID);
+					list.bindVertexArray(meshArena.vao());
+					list.setMat4(shadowModelLoc, model);
+					if (object.mesh < (int)meshLods.size() && !meshLods[object.mesh].lods.empty())
+					{
+						const BakedLod& lod = meshLods[object.mesh].lods[objectLods[i].lod];
+						list.drawElements(PrimitiveType::Triangles, draw.firstIndex + lod.firstIndex, lod.indexCount, draw.baseVertex);
+					}
+					else
+						list.drawElements(PrimitiveType::Triangles, draw.firstIndex, draw.indexCount, draw.baseVertex);
+				}
+			});
+		}
 
-
-		
+		//rendering:
+		// the passes are declared every frame, the graph keeps its textures and framebuffers
+		frameGraph.reset();
+		FrameGraphTextureDesc backbufferDesc;
+		backbufferDesc.width = SCR_WIDTH;
+		backbufferDesc.height = SCR_HEIGHT;
+		FrameGraphResource backbuffer = frameGraph.importTexture("backbuffer", offscreen ? batchColor : 0, backbufferDesc);
+		// scaled, the scene draws into the bottom left of a full size texture, a new scale
+		// then doesn't reallocate anything
+		FrameGraphResource sceneColor = backbuffer;
+		int renderWidth = SCR_WIDTH, renderHeight = SCR_HEIGHT;
+		if (upscaler)
+			dynamicResolution.renderSize(SCR_WIDTH, SCR_HEIGHT, renderWidth, renderHeight);
+
+		FrameGraphResource shadowMap = FRAME_GRAPH_INVALID;
+		if (useShadows)
+		{
+			frameGraph.addPass("shadow", [&](FrameGraph::PassBuilder& builder)
+			{
+				FrameGraphTextureDesc shadowDesc;
+				shadowDesc.width = shadowDesc.height = 2048;
+				shadowDesc.internalFormat = GL_DEPTH_COMPONENT24;
+				shadowMap = builder.create("shadow map", shadowDesc);
+				builder.write(shadowMap);
+			},
+			[&](const FrameGraphContext& context)
+			{
+				context.bindRenderTarget();
+				glClear(GL_DEPTH_BUFFER_BIT);
+				CommandList shadowFrame;
+				shadowFrame.bindProgram(shadowShader.ID);
+				shadowFrame.setMat4(shadowProjectionLoc, lightSpace);
+				shadowFrame.setMat4(shadowViewLoc, glm::mat4(1.0f));
+				replayer.beginFrame();
+				replayer.replay(shadowFrame);
+				replayer.replay(shadowRecorder);
+			});
+		}
+
+		frameGraph.addPass("scene", [&](FrameGraph::PassBuilder& builder)
+		{
+			if (useShadows)
+				builder.read(shadowMap);
+			if (postChain)
+			{
+				FrameGraphTextureDesc hdrDesc = backbufferDesc;
+				hdrDesc.internalFormat = GL_RGBA16F;
+				sceneColor = builder.create("scene hdr", hdrDesc);
+			}
+			else if (upscaler)
+				sceneColor = builder.create("scene color", backbufferDesc);
+			builder.write(sceneColor);
+			if (offscreen || upscaler || postChain)
+			{
+				// the default framebuffer brings its own depth buffer, textures don't
+				FrameGraphTextureDesc depthDesc = backbufferDesc;
+				depthDesc.internalFormat = GL_DEPTH_COMPONENT24;
+				builder.write(builder.create("scene depth", depthDesc));
+			}
+		},
+		[&](const FrameGraphContext& context)
+		{
+			GpuPassTimer& sceneTimer = lodsEnabled ? lodSceneTimer : fullSceneTimer;
+			if (timeLods)
+			{
+				sceneTimer.beginFrame();
+				sceneTimer.mark(0);
+			}
+			context.bindRenderTarget();
+			glViewport(0, 0, renderWidth, renderHeight);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			materials.bind();
+			bindlessTextures.bind();
+			if (useShadows)
+			{
+				glActiveTexture(GL_TEXTURE0 + MATERIAL_SHADOW_UNIT);
+				glBindTexture(GL_TEXTURE_2D, context.texture(shadowMap));
+				glActiveTexture(GL_TEXTURE0);
+			}
+			replayer.beginFrame();
+			replayer.replay(frameCommands);
+			replayer.replay(recorder);
+			if (particles)
+				particles->draw(projection, view);
+			if (timeLods)
+			{
+				sceneTimer.mark(1);
+				sceneTimer.endFrame();
+			}
+		});
+
+		FrameGraphResource displayColor = sceneColor;
+		if (postChain)
+			displayColor = postChain->addPasses(frameGraph, sceneColor, upscaler ? FRAME_GRAPH_INVALID : backbuffer, backbufferDesc, renderWidth, renderHeight);
+		if (upscaler)
+			upscaler->addPasses(frameGraph, displayColor, backbuffer, backbufferDesc, renderWidth, renderHeight);
+
+		frameGraph.compile();
+		if (upscaler)
+			gpuTimer.begin(dynamicResolution.scale());
+		frameGraph.execute();
+		if (useMeshlets)
+			meshletCuller.endFrame();
+		if (particles)
+			particles->endFrame();
+		if (upscaler)
+		{
+			// results arrive a few frames late, each is judged against the scale it was drawn at
+			gpuTimer.end();
+			double gpuMs;
+			float renderedScale;
+			while (gpuTimer.poll(gpuMs, renderedScale))
+				dynamicResolution.update(gpuMs, renderedScale);
+		}
+
+		if (golden.active())
+		{
+			glFinish();
+			double frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameBegin).count();
+			if (golden.frameRendered(frameMs))
+				golden.check(readBackbuffer(SCR_WIDTH, SCR_HEIGHT));
+			if (!golden.active())
+				glfwSetWindowShouldClose(window, true);
+		}
+
+		if (offscreen)
+		{
+			frameCapture.frame(SCR_WIDTH, SCR_HEIGHT, batchReadFramebuffer);
+			batch.advance();
+			if (!batch.active())
+				glfwSetWindowShouldClose(window, true);
+		}
+		else
+			frameCapture.frame(SCR_WIDTH, SCR_HEIGHT);
+
+		if (toggleCapture)
+		{
+			if (frameCapture.capturing())
+				frameCapture.stop();
+			else
+				frameCapture.start(captureDirectory, captureFormat);
+			toggleCapture = false;
+		}
+		if (takeScreenshot)
+		{
+			frameCapture.screenshot(captureDirectory + "/screenshot_" + std::to_string(screenshotCount++) + ".png");
+			takeScreenshot = false;
+		}
+
+		if (dumpFrameGraph)
+		{
+			std::ofstream("framegraph.dot") << frameGraph.dumpDot();
+			frameGraph.printStats();
+			dumpFrameGraph = false;
+		}
+		if (printMeshArena)
+		{
+			meshArena.printStats();
+			printMeshArena = false;
+		}
+		if (printTextureStreaming)
+		{
+			textureStreamer.printStats();
+			printTextureStreaming = false;
+		}
+		if (printDynamicResolution)
+		{
+			if (upscaler)
+			{
+				dynamicResolution.printStats();
+				dynamicResolution.writeHistory("dynamic_resolution.csv");
+			}
+			printDynamicResolution = false;
+		}
+		if (printOcclusion)
+		{
+			if (useOcclusion)
+				occlusion.printStats();
+			printOcclusion = false;
+		}
+		if (printMeshlets)
+		{
+			if (useMeshlets)
+				meshletCuller.printStats();
+			printMeshlets = false;
+		}
+		if (printParticles)
+		{
+			if (particles)
+				particles->printStats();
+			printParticles = false;
+		}
+		if (printLods)
+		{
+			if (useLods)
+			{
+				printLodStats();
+				lodsEnabled = !lodsEnabled;
+				std::cout << (lodsEnabled ? "LODs on" : "LODs off, drawing full detail") << std::endl;
+			}
+			printLods = false;
+		}
+		if (printPostProcessing)
+		{
+			if (postChain)
+				postChain->printStats(SCR_WIDTH, SCR_HEIGHT);
+			printPostProcessing = false;
+		}
 
 		// check and call events and swap buffers
 		glfwSwapBuffers(window);
+		GLTraceWriter::instance().frameEnd();
 		glfwPollEvents();
+
+		if (firstFrame)
+		{
+			// compare runs with --mesh file.obj against the baked file.bmesh
+			glFinish();
+			std::cout << "Time to first frame: " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupBegin).count() << " ms" << std::endl;
+			firstFrame = false;
+		}
 	}
 
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteVertexArrays(1, &lightVAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
-	glDeleteProgram(myShader.ID);
+	frameCapture.flush();
+	frameCapture.printStats();
+	frameCapture.release();
+	if (batch.enabled())
+		batch.printStats();
+	if (batchColor != 0)
+	{
+		glDeleteFramebuffers(1, &batchReadFramebuffer);
+		glDeleteTextures(1, &batchColor);
+	}
+	if (textureStreamer.count() > 0)
+		textureStreamer.printStats();
+	if (upscaler)
+	{
+		dynamicResolution.printStats();
+		upscaler->release();
+	}
+	if (useOcclusion)
+		occlusion.printStats();
+	if (useLods)
+		printLodStats();
+	if (useMeshlets)
+		meshletCuller.printStats();
+	meshletCuller.release();
+	if (particles)
+	{
+		particles->printStats();
+		particles->release();
+	}
+	lodSceneTimer.release();
+	fullSceneTimer.release();
+	if (postChain)
+	{
+		postChain->printStats(SCR_WIDTH, SCR_HEIGHT);
+		postChain->release();
+	}
+	gpuTimer.release();
+	textureStreamer.release();
+	textureArrays.release();
+	bindlessTextures.release();
+	meshArena.release();
+	frameGraph.release();
+	if (!textures.empty())
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	materials.release();
+	materialShaders.release();
 	glDeleteProgram(lightShader.ID);
+	glDeleteProgram(shadowShader.ID);
+	GLTraceWriter::instance().stop();
 
 	glfwTerminate();
+	return golden.enabled() ? golden.finish() : 0;
+}
+
+// the default framebuffer as top to bottom RGBA8, e.g. for golden images
+// ----------------------------------------------------------------------
+ImageRGBA8 readBackbuffer(int width, int height)
+{
+	ImageRGBA8 image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize((size_t)width * height * 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+	// GL rows start at the bottom
+	size_t stride = (size_t)width * 4;
+	std::vector<uint8_t> row(stride);
+	for (int y = 0; y < height / 2; y++)
+	{
+		uint8_t* top = image.pixels.data() + y * stride;
+		uint8_t* bottom = image.pixels.data() + (height - 1 - y) * stride;
+		std::memcpy(row.data(), top, stride);
+		std::memcpy(top, bottom, stride);
+		std::memcpy(bottom, row.data(), stride);
+	}
+	return image;
+}
+
+// vertices and indices go from the mapping straight into the arena
+// ----------------------------------------------------------------------
+bool uploadBakedMesh(const std::string& path, const BakedMeshFile& baked, const VertexFormat& format, MeshArena& arena, std::vector<MeshInstance>& out)
+{
+	if (baked.format() != format)
+	{
+		std::cout << "ERROR::BAKED_MESH::FORMAT_MISMATCH " << path << " was baked with a different vertex format" << std::endl;
+		return false;
+	}
+	for (uint32_t i = 0; i < baked.meshCount(); i++)
+	{
+		// all LODs go into the arena, they are ranges of the mesh's indices
+		const BakedMeshRecord& record = baked.record(i);
+		int id = arena.upload(baked.vertices(i), record.vertexCount, baked.indices(i), record.indexCount);
+		if (id < 0)
+			return false;
+		MeshInstance instance = { id, baked.transform(i), baked.normalMatrix(i) };
+		instance.lods.lods.assign(record.lods, record.lods + std::min<uint32_t>(record.lodCount, BAKED_MESH_MAX_LODS));
+		if (instance.lods.lods.empty())
+			instance.lods.lods.push_back({ 0, record.indexCount, 0.0f, 0 });
+		// the errors are in node space, the stored transform also scales by the AABB size
+		glm::vec3 extent = format.position == PositionEncoding::Float32 ? glm::vec3(1.0f)
+			: glm::vec3(record.aabbMax[0] - record.aabbMin[0], record.aabbMax[1] - record.aabbMin[1], record.aabbMax[2] - record.aabbMin[2]);
+		instance.lods.errorScale = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+			if (extent[axis] > 0.0f)
+				instance.lods.errorScale = std::max(instance.lods.errorScale, glm::length(glm::vec3(instance.transform[axis])) / extent[axis]);
+		if (instance.lods.errorScale == 0.0f)
+			instance.lods.errorScale = 1.0f;
+		// copied, the mapping of a cached bake goes away after loading
+		instance.meshlets.meshlets.assign(baked.meshlets(i), baked.meshlets(i) + record.meshletCount);
+		instance.meshlets.vertices.assign(baked.meshletVertices(i), baked.meshletVertices(i) + record.meshletVertexCount);
+		instance.meshlets.triangles.assign(baked.meshletTriangles(i), baked.meshletTriangles(i) + record.meshletTriangleBytes);
+		instance.meshlets.boundsToVertices = meshletBoundsToVertices(format.position != PositionEncoding::Float32,
+			glm::vec3(record.aabbMin[0], record.aabbMin[1], record.aabbMin[2]), glm::vec3(record.aabbMax[0], record.aabbMax[1], record.aabbMax[2]));
+		out.push_back(instance);
+	}
+	std::cout << "Loaded " << path << ": " << baked.meshCount() << " meshes, " << baked.size() / 1024 << " KB mapped" << std::endl;
+	return true;
+}
+
+// loads every triangle mesh of an OBJ/glTF/bmesh file into the arena
+// ----------------------------------------------------------------------
+bool loadMeshFile(const std::string& path, const VertexFormat& format, JobSystem& jobs, MeshArena& arena, AssetCache& cache, std::vector<MeshInstance>& out)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	if (extension == "bmesh")
+	{
+		// baked by MeshBake
+		BakedMeshFile baked;
+		return baked.load(path) && uploadBakedMesh(path, baked, format, arena, out);
+	}
+
+	// text formats are baked into the asset cache on first use, later launches map the
+	// bake. A .gltf can reference buffers the hash would not see, those always import.
+	bool cacheable = extension != "gltf";
+	AssetKey key;
+	if (cacheable)
+	{
+		MappedFile source(path);
+		if (!source.isOpen())
+			return false;
+		key = cache.key("mesh", MESH_IMPORTER_VERSION, source.data(), source.size(), meshImportSettings(format));
+		MappedFile cached;
+		BakedMeshFile baked;
+		if (cache.find(key, cached, source.size()) && baked.load(std::move(cached), cache.path(key)))
+			return uploadBakedMesh(path, baked, format, arena, out);
+	}
+
+	LoadStats stats;
+	std::vector<BakeMeshInput> meshes;
+	if (!importMeshFile(path, format, &jobs, meshes, &stats))
+		return false;
+	stats.print(path);
+	if (cacheable)
+		cache.storeWith(key, [&](const std::string& file) { return writeBakedMeshFile(file, format, meshes); });
+
+	for (const BakeMeshInput& mesh : meshes)
+	{
+		mesh.vertices.printReport(path);
+		int id = arena.upload(mesh.vertices.data.data(), mesh.vertices.vertexCount(), mesh.indices.data(), mesh.indices.size());
+		if (id < 0)
+			return false;
+		MeshInstance instance = { id, mesh.transform * mesh.vertices.dequantizeMatrix(), bakedNormalMatrix(mesh.transform) };
+		instance.lods.lods = mesh.lods;
+		instance.lods.errorScale = LodSelector::maxScale(mesh.transform);
+		instance.meshlets.meshlets = mesh.meshlets;
+		instance.meshlets.vertices = mesh.meshletVertices;
+		instance.meshlets.triangles = mesh.meshletTriangles;
+		instance.meshlets.boundsToVertices = meshletBoundsToVertices(format.position != PositionEncoding::Float32, mesh.vertices.aabbMin, mesh.vertices.aabbMax);
+		out.push_back(instance);
+	}
+	return true;
+}
+
+// block compressed textures: .ktx2 files map directly, images are compressed into the
+// asset cache on first use and later launches map the .ktx2 from there
+// ----------------------------------------------------------------------
+bool loadTextureFile(const std::string& path, JobSystem& jobs, AssetCache& cache, Ktx2Texture& out)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	if (extension == "ktx2")
+		return out.load(path);
+
+	MappedFile source(path);
+	if (!source.isOpen())
+		return false;
+	TextureImportSettings settings = TextureImportSettings::fromName(path);
+	AssetKey key = cache.key("texture", TEXTURE_IMPORTER_VERSION, source.data(), source.size(), settings.key());
+	MappedFile cached;
+	if (cache.find(key, cached, source.size()) && out.load(std::move(cached), cache.path(key)))
+		return true;
+
+	TextureImportReport report;
+	std::string ktxPath;
+	if (cache.isEnabled())
+	{
+		if (!cache.storeWith(key, [&](const std::string& file) { return importTexture(source.data(), source.size(), path, settings, file, &jobs, &report); }))
+			return false;
+		ktxPath = cache.path(key);
+	}
+	else
+	{
+		ktxPath = path + ".ktx2";
+		if (!importTexture(source.data(), source.size(), path, settings, ktxPath, &jobs, &report))
+			return false;
+	}
+	report.print(path, settings);
+	return out.load(ktxPath);
+}
+
+// uncompressed upload with mips from the CPU builder, filtered in linear space
+// ----------------------------------------------------------------------
+unsigned int loadRawTexture(const std::string& path, JobSystem& jobs)
+{
+	MappedFile source(path);
+	ImageRGBA8 image;
+	if (!source.isOpen() || !decodeImageRGBA8(source.data(), source.size(), image, path))
+		return 0;
+	TextureImportSettings settings = TextureImportSettings::fromName(path);
+	MipSettings mipSettings;
+	mipSettings.srgb = settings.srgb;
+	mipSettings.filter = settings.mipFilter;
+	return uploadMipChain(buildMipChain(image, mipSettings, &jobs), settings.srgb);
+}
+
+// parse throughput, single threaded and with the job system, no window needed
+// ----------------------------------------------------------------------
+int benchLoad(const std::string& path, int repeat)
+{
+	JobSystem jobs;
+	bool obj = path.size() > 4 && (path.compare(path.size() - 4, 4, ".obj") == 0 || path.compare(path.size() - 4, 4, ".OBJ") == 0);
+	for (int threaded = 0; threaded < 2; threaded++)
+	{
+		double best = 0.0;
+		for (int i = 0; i < repeat; i++)
+		{
+			LoadStats stats;
+			bool ok;
+			if (obj)
+			{
+				MeshData mesh;
+				ok = ObjLoader::load(path, mesh, threaded ? &jobs : nullptr, &stats);
+			}
+			else
+			{
+				GltfModel model;
+				ok = model.load(path, threaded ? &jobs : nullptr, &stats);
+			}
+			if (!ok)
+				return -1;
+			best = std::max(best, stats.megabytesPerSecond());
+			if (i == 0)
+				stats.print(path);
+		}
+		std::cout << (threaded ? "threaded (" + std::to_string(jobs.threadCount()) + " threads)" : std::string("single thread"))
+			<< ": best of " << repeat << " " << best << " MB/s" << std::endl;
+	}
+	return 0;
+}
+
+// mip chain builder: box vs Kaiser, scalar vs AVX2, one thread vs the job system. Also
+// shows how much darker the small levels get when filtering the sRGB bytes directly.
+// ----------------------------------------------------------------------
+int benchMips(const std::string& path, int repeat)
+{
+	MappedFile source(path);
+	ImageRGBA8 image;
+	if (!source.isOpen() || !decodeImageRGBA8(source.data(), source.size(), image, path))
+		return -1;
+	JobSystem jobs;
+	double megapixels = (double)image.width * image.height / 1e6;
+	std::cout << path << ": " << image.width << "x" << image.height << ", " << mipLevelCount(image.width, image.height) << " levels, AVX2 "
+		<< (mipCpuHasAvx2() ? "available" : "not available") << std::endl;
+	for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser })
+		for (int simd = 0; simd < (mipCpuHasAvx2() ? 2 : 1); simd++)
+			for (int threaded = 0; threaded < 2; threaded++)
+			{
+				MipSettings settings;
+				settings.filter = filter;
+				settings.simd = simd != 0;
+				double best = 1e30;
+				for (int i = 0; i < repeat; i++)
+				{
+					auto start = std::chrono::high_resolution_clock::now();
+					std::vector<ImageRGBA8> levels = buildMipChain(image, settings, threaded ? &jobs : nullptr);
+					best = std::min(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+				}
+				std::cout << mipFilterName(filter) << (simd ? " avx2 " : " scalar ")
+					<< (threaded ? std::to_string(jobs.threadCount()) + " threads" : std::string("1 thread")) << ": best of " << repeat << " "
+					<< best * 1000.0 << " ms (" << megapixels / best << " MPix/s)" << std::endl;
+			}
+
+	// average color byte of a small level, filtered in linear space vs on the sRGB bytes
+	auto average = [](const ImageRGBA8& level)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < level.pixels.size(); i++)
+			if ((i & 3) != 3)
+				sum += level.pixels[i];
+		return sum / (level.pixels.size() / 4 * 3);
+	};
+	MipSettings gamma, bytes;
+	bytes.srgb = false;
+	std::vector<ImageRGBA8> correct = buildMipChain(image, gamma, &jobs);
+	std::vector<ImageRGBA8> naive = buildMipChain(image, bytes, &jobs);
+	size_t l = std::min<size_t>(4, correct.size() - 1);
+	std::cout << "average color byte: level 0 " << average(correct[0]) << ", level " << l << " linear filtered " << average(correct[l])
+		<< ", sRGB filtered " << average(naive[l]) << std::endl;
+	return 0;
+}
+
+// a city of 'count' boxes on a grid, walked through at eye height along one street. Every
+// box is occluder candidate and tested object. Prints what gets culled and the cost per
+// frame, scalar and SSE2, on one thread and on the job system.
+// ----------------------------------------------------------------------
+int benchOcclusion(int count)
+{
+	const float spacing = 6.0f;
+	const int frames = 120;
+	int side = (int)std::ceil(std::sqrt((float)count));
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::mat4> boxes;
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 center((i % side - side / 2) * spacing, 0.0f, (i / side - side / 2) * spacing);
+		glm::vec3 size(2.0f + 2.0f * unit(random), 1.0f + 12.0f * unit(random), 2.0f + 2.0f * unit(random));
+		boxes.push_back(glm::translate(glm::mat4(1.0f), center - glm::vec3(size.x, 0.0f, size.z) * 0.5f) * glm::scale(glm::mat4(1.0f), size));
+	}
+	float extent = side * spacing * 0.5f;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, extent * 3.0f);
+
+	JobSystem jobs;
+	std::cout << count << " boxes, " << frames << " frames, SSE2 " << (OcclusionCuller::hasSimd() ? "available" : "not available") << std::endl;
+	std::vector<std::vector<uint8_t>> reference(frames);
+	for (int simd = 0; simd < (OcclusionCuller::hasSimd() ? 2 : 1); simd++)
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			OcclusionCuller culler;
+			culler.simd = simd != 0;
+			int box = culler.addBox();
+			size_t mismatches = 0;
+			std::vector<uint8_t> visible;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				float t = (float)frame / frames;
+				glm::vec3 eye(-extent + 2.0f * extent * t, 1.7f, spacing * 0.5f);
+				float yaw = 0.6f * std::sin(t * 12.0f);
+				glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+				culler.beginFrame(projection * view);
+				for (const glm::mat4& bounds : boxes)
+					culler.addOccluder(box, bounds);
+				culler.render(threaded ? &jobs : nullptr);
+				culler.test(boxes, visible, threaded ? &jobs : nullptr);
+				culler.endFrame();
+				if (reference[frame].empty())
+					reference[frame] = visible;
+				for (size_t i = 0; i < visible.size(); i++)
+					mismatches += visible[i] != reference[frame][i];
+			}
+			const OcclusionStats& stats = culler.totalStats();
+			double tested = (double)std::max<size_t>(stats.tested, 1);
+			std::cout << (simd ? "sse2 " : "scalar ") << (threaded ? std::to_string(jobs.threadCount()) + " threads" : std::string("1 thread"))
+				<< ": " << (stats.rasterMs + stats.pyramidMs + stats.testMs) / frames << " ms per frame (raster " << stats.rasterMs / frames
+				<< ", hi-z " << stats.pyramidMs / frames << ", test " << stats.testMs / frames << "), " << stats.occluders / frames << " occluders, "
+				<< 100.0 * stats.frustumCulled / tested << "% outside the frustum, " << 100.0 * stats.occluded / tested << "% occluded";
+			if (simd || threaded)
+				std::cout << ", " << mismatches << " results differ from scalar";
+			std::cout << std::endl;
+		}
+	return 0;
+}
+
+// the CPU particle update with up to 'count' alive: scalar vs AVX2, one thread vs the job
+// system. Runs one lifetime to fill up, then measures the next one; the instance data goes
+// to plain memory here, in the viewer it is a mapped stream buffer range.
+// ----------------------------------------------------------------------
+int benchParticles(int count)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	JobSystem jobs;
+	ParticleSettings settings;
+	settings.capacity = (size_t)count;
+	int frames = (int)(settings.lifetime / deltaTime);
+	std::cout << count << " particles, " << frames << " frames, AVX2 " << (ParticleSimulation::hasSimd() ? "available" : "not available") << std::endl;
+	std::vector<float> reference;
+	for (int simd = 0; simd < (ParticleSimulation::hasSimd() ? 2 : 1); simd++)
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			settings.simd = simd != 0;
+			ParticleSimulation simulation(settings);
+			std::vector<float> instances(settings.capacity * 4);
+			for (int frame = 0; frame < 2 * frames; frame++)
+			{
+				if (frame == frames)
+					simulation.stats = ParticleStats();
+				float t = frame * deltaTime;
+				simulation.emit(glm::vec3(std::sin(t) * 3.0f, 1.0f, std::cos(t) * 3.0f), deltaTime);
+				simulation.update(deltaTime, instances.data(), threaded ? &jobs : nullptr);
+			}
+			// same emission, so only the FMA rounding of the AVX2 loop differs
+			float deviation = 0.0f;
+			if (reference.empty())
+				reference = instances;
+			for (size_t i = 0; i < simulation.size() * 4; i++)
+				deviation = std::max(deviation, std::fabs(instances[i] - reference[i]));
+			const ParticleStats& stats = simulation.stats;
+			double ms = stats.updateMs / stats.frames;
+			std::cout << (simd ? "avx2 " : "scalar ") << (threaded ? std::to_string(jobs.threadCount()) + " threads" : std::string("1 thread"))
+				<< ": " << ms << " ms per frame, " << (double)stats.updated / stats.updateMs << " particles per ms, instances written at "
+				<< (double)stats.uploadBytes / (stats.updateMs * 1e6) << " GB/s (" << (double)stats.uploadBytes / stats.frames / (1024.0 * 1024.0)
+				<< " MB per frame), emission " << stats.emitMs / stats.frames << " ms";
+			if (simd || threaded)
+				std::cout << ", max difference from scalar " << deviation;
+			std::cout << std::endl;
+		}
+	return 0;
+}
+
+// what it costs per frame to give every draw a different texture: a glBindTexture per
+// draw, texture arrays (a bind per array and the layer as uniform) and bindless handles
+// (only the index as uniform). Same grid of cubes for each path, vsync off.
+// ----------------------------------------------------------------------
+int benchTextures(GLFWwindow* window, JobSystem& jobs, AssetCache& cache, MeshArena& arena, int mesh, const glm::mat4& meshTransform,
+	const std::string& defines, const std::vector<std::string>& paths, int draws)
+{
+	// every texture once as plain 2D texture (also what the handles point at) and once in the arrays
+	std::vector<unsigned int> textures;
+	TextureArrays arrays;
+	std::vector<int> slots;
+	for (const std::string& path : paths)
+	{
+		Ktx2Texture texture;
+		if (!loadTextureFile(path, jobs, cache, texture))
+			continue;
+		textures.push_back(texture.upload());
+		slots.push_back(arrays.add(std::move(texture)));
+	}
+	if (textures.empty())
+	{
+		std::cout << "ERROR::BENCH_TEXTURES::NO_TEXTURES pass some with --texture" << std::endl;
+		return -1;
+	}
+	arrays.build(&jobs);
+	BindlessTextureTable bindless;
+	for (unsigned int texture : textures)
+		bindless.add(texture);
+	bindless.upload();
+
+	int side = (int)std::ceil(std::sqrt((double)draws));
+	std::vector<glm::mat4> models(draws);
+	for (int i = 0; i < draws; i++)
+	{
+		glm::vec3 position((i % side) - (side - 1) * 0.5f, (i / side) - (side - 1) * 0.5f, 0.0f);
+		models[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.7f)) * meshTransform;
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, side * 4.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, side * 1.3f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	MeshArena::DrawParams draw = arena.drawParams(mesh);
+
+	std::cout << draws << " draws over " << textures.size() << " textures, " << arrays.arrayCount() << " arrays, bindless "
+		<< (BindlessTextureTable::isSupported() ? "supported" : "not supported") << std::endl;
+	enum Path { Binds, Arrays, Bindless };
+	const char* names[] = { "bind per draw", "texture arrays", "bindless" };
+	double cpuMs[3] = {};
+	size_t binds[3] = {};
+	glfwSwapInterval(0);
+	for (int path = Binds; path <= Bindless; path++)
+	{
+		if (path == Bindless && !BindlessTextureTable::isSupported())
+			continue;
+		MaterialTextureSource source = path == Bindless ? MaterialTextureSource::Bindless : (path == Arrays ? MaterialTextureSource::Array : MaterialTextureSource::Bound2D);
+		Shader shader("shaders/shader.vs", "shaders/textured.fs", ShaderVariants::texturedBench(source, defines), &cache);
+		shader.use();
+		shader.setInt(path == Arrays ? "diffuseArray" : "diffuseMap", 0);
+		shader.setVec3("lightColor", glm::vec3(1.0f));
+		shader.setVec3("lightPos", glm::vec3(0.0f, side * 0.5f, side * 1.0f));
+		shader.setMat4("projection", projection);
+		shader.setMat4("view", view);
+		shader.setMat3("normalMatrix", glm::mat3(1.0f));
+		int modelLoc = Shader::uniformLocation(shader.ID, "model");
+		int layerLoc = Shader::uniformLocation(shader.ID, "textureLayer");
+		int uvRectLoc = Shader::uniformLocation(shader.ID, "uvRect");
+		int indexLoc = Shader::uniformLocation(shader.ID, "textureIndex");
+
+		ParallelCommandRecorder recorder;
+		GLCommandReplayer replayer;
+		const int warmup = 20, frames = 300;
+		double recordSeconds = 0.0, replaySeconds = 0.0, frameSeconds = 0.0;
+		GLCommandReplayer::Stats stats;
+		for (int frame = 0; frame < warmup + frames && !glfwWindowShouldClose(window); frame++)
+		{
+			auto frameBegin = std::chrono::high_resolution_clock::now();
+			recorder.record(jobs, draws, jobs.suggestedGrain(draws, 64), [&](CommandList& list, size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					int texture = (int)(i % textures.size());
+					list.bindProgram(shader.ID);
+					list.bindVertexArray(arena.vao());
+					if (path == Binds)
+						list.bindTexture(0, textures[texture]);
+					else if (path == Arrays)
+					{
+						const TextureSlot& slot = arrays.slot(slots[texture]);
+						list.bindTexture(0, arrays.texture(slot.array), true);
+						list.setFloat(layerLoc, (float)slot.layer);
+						list.setVec4(uvRectLoc, slot.uvRect);
+					}
+					else
+						list.setInt(indexLoc, texture);
+					list.setMat4(modelLoc, models[i]);
+					list.drawElements(PrimitiveType::Triangles, draw.firstIndex, draw.indexCount, draw.baseVertex);
+				}
+			});
+			auto replayBegin = std::chrono::high_resolution_clock::now();
+
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (path == Bindless)
+				bindless.bind(0);
+			replayer.beginFrame();
+			replayer.replay(recorder);
+			auto replayEnd = std::chrono::high_resolution_clock::now();
+			glfwSwapBuffers(window);
+			GLTraceWriter::instance().frameEnd();
+			glfwPollEvents();
+			glFinish();
+
+			if (frame >= warmup)
+			{
+				recordSeconds += std::chrono::duration<double>(replayBegin - frameBegin).count();
+				replaySeconds += std::chrono::duration<double>(replayEnd - replayBegin).count();
+				frameSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - frameBegin).count();
+				stats = replayer.frameStats();
+			}
+		}
+		glDeleteProgram(shader.ID);
+
+		cpuMs[path] = (recordSeconds + replaySeconds) * 1000.0 / frames;
+		binds[path] = stats.textureBinds;
+		std::cout << names[path] << ": " << stats.textureBinds << " texture binds, " << stats.uniforms << " uniforms, " << stats.commands
+			<< " commands (" << stats.bytes / 1024 << " KB) per frame, record " << recordSeconds * 1000.0 / frames << " ms, replay "
+			<< replaySeconds * 1000.0 / frames << " ms, frame " << frameSeconds * 1000.0 / frames << " ms" << std::endl;
+	}
+	glfwSwapInterval(1);
+	for (int path = Arrays; path <= Bindless; path++)
+		if (cpuMs[path] > 0.0)
+			std::cout << names[path] << " vs bind per draw: " << (long long)binds[Binds] - (long long)binds[path] << " texture binds and "
+				<< cpuMs[Binds] - cpuMs[path] << " ms CPU saved per frame" << std::endl;
+
+	bindless.release();
+	arrays.release();
+	glDeleteTextures((GLsizei)textures.size(), textures.data());
 	return 0;
 }
 
@@ -311,6 +1940,36 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	cameraFront = glm::normalize(direction);
 }
 
+// glfw: one shot key presses for debug output
+// ----------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (action != GLFW_PRESS)
+		return;
+	if (key == GLFW_KEY_G)
+		dumpFrameGraph = true; // writes framegraph.dot next to the executable
+	if (key == GLFW_KEY_M)
+		printMeshArena = true;
+	if (key == GLFW_KEY_T)
+		printTextureStreaming = true;
+	if (key == GLFW_KEY_R)
+		printDynamicResolution = true; // also writes dynamic_resolution.csv
+	if (key == GLFW_KEY_H)
+		printPostProcessing = true;
+	if (key == GLFW_KEY_C)
+		toggleCapture = true;
+	if (key == GLFW_KEY_P)
+		takeScreenshot = true;
+	if (key == GLFW_KEY_O)
+		printOcclusion = true;
+	if (key == GLFW_KEY_K)
+		printMeshlets = true;
+	if (key == GLFW_KEY_F)
+		printParticles = true;
+	if (key == GLFW_KEY_L)
+		printLods = true; // and switches between LODs and full detail
+}
+
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
@@ -320,4 +1979,4 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 		fov = 1.0f;
 	if (fov > 180.0f)
 		fov = 180.0f;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 330 core
+// one triangle over the whole target, drawn with 3 vertices and no vertex buffer
+out vec2 TexCoord;
+
+void main()
+{
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	TexCoord = position;
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
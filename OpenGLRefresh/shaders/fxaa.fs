@@ -0,0 +1,118 @@
+#version 330 core
+// FXAA 3.11 (Timothy Lottes), the quality variant: finds the edge through the center
+// pixel, walks along it in both directions to its ends and blends across it by how far
+// the pixel is from the nearer end. Sub-pixel aliasing is softened from the 3x3 average.
+// Reads the tonemapped image with its luma in alpha and writes the final pixels.
+#include "include/locations.glsl"
+out vec4 FragColor;
+
+BINDING(0) uniform sampler2D source;
+LOCATION(0) uniform vec2 renderSize; // the part of 'source' that holds the picture
+
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float EDGE_THRESHOLD_MAX = 0.125;
+const float SUBPIXEL_QUALITY = 0.75;
+const int ITERATIONS = 12;
+const float STEPS[ITERATIONS] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+vec2 inverseSize;
+
+// positions in texels
+vec4 tap(vec2 position)
+{
+	return textureLod(source, clamp(position, vec2(0.5), renderSize - 0.5) * inverseSize, 0.0);
+}
+
+float luma(vec2 position)
+{
+	return tap(position).a;
+}
+
+void main()
+{
+	inverseSize = 1.0 / vec2(textureSize(source, 0));
+	vec2 position = gl_FragCoord.xy;
+	vec4 center = tap(position);
+	float lumaCenter = center.a;
+	float lumaDown = luma(position + vec2(0.0, -1.0));
+	float lumaUp = luma(position + vec2(0.0, 1.0));
+	float lumaLeft = luma(position + vec2(-1.0, 0.0));
+	float lumaRight = luma(position + vec2(1.0, 0.0));
+
+	float lumaMin = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+	float lumaMax = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+	float range = lumaMax - lumaMin;
+	if (range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD_MAX))
+	{
+		FragColor = vec4(center.rgb, 1.0);
+		return;
+	}
+
+	float lumaDownLeft = luma(position + vec2(-1.0, -1.0));
+	float lumaUpRight = luma(position + vec2(1.0, 1.0));
+	float lumaUpLeft = luma(position + vec2(-1.0, 1.0));
+	float lumaDownRight = luma(position + vec2(1.0, -1.0));
+	float lumaDownUp = lumaDown + lumaUp;
+	float lumaLeftRight = lumaLeft + lumaRight;
+	float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+	float lumaDownCorners = lumaDownLeft + lumaDownRight;
+	float lumaRightCorners = lumaDownRight + lumaUpRight;
+	float lumaUpCorners = lumaUpRight + lumaUpLeft;
+
+	// horizontal edge when the luma changes more from row to row than from column to column
+	float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + abs(-2.0 * lumaCenter + lumaDownUp) * 2.0 + abs(-2.0 * lumaRight + lumaRightCorners);
+	float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + abs(-2.0 * lumaCenter + lumaLeftRight) * 2.0 + abs(-2.0 * lumaDown + lumaDownCorners);
+	bool horizontal = edgeHorizontal >= edgeVertical;
+
+	// which side of the pixel the edge is on
+	float luma1 = horizontal ? lumaDown : lumaLeft;
+	float luma2 = horizontal ? lumaUp : lumaRight;
+	float gradient1 = luma1 - lumaCenter;
+	float gradient2 = luma2 - lumaCenter;
+	bool steeper1 = abs(gradient1) >= abs(gradient2);
+	float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+	float stepLength = steeper1 ? -1.0 : 1.0;
+	float lumaLocalAverage = 0.5 * ((steeper1 ? luma1 : luma2) + lumaCenter);
+
+	// walk along the edge, half a texel over so every fetch is the average of both sides
+	vec2 edge = position + (horizontal ? vec2(0.0, stepLength * 0.5) : vec2(stepLength * 0.5, 0.0));
+	vec2 direction = horizontal ? vec2(1.0, 0.0) : vec2(0.0, 1.0);
+	vec2 end1 = edge - direction * STEPS[0];
+	vec2 end2 = edge + direction * STEPS[0];
+	float lumaEnd1 = luma(end1) - lumaLocalAverage;
+	float lumaEnd2 = luma(end2) - lumaLocalAverage;
+	bool reached1 = abs(lumaEnd1) >= gradientScaled;
+	bool reached2 = abs(lumaEnd2) >= gradientScaled;
+	for (int i = 1; i < ITERATIONS && !(reached1 && reached2); i++)
+	{
+		if (!reached1)
+		{
+			end1 -= direction * STEPS[i];
+			lumaEnd1 = luma(end1) - lumaLocalAverage;
+			reached1 = abs(lumaEnd1) >= gradientScaled;
+		}
+		if (!reached2)
+		{
+			end2 += direction * STEPS[i];
+			lumaEnd2 = luma(end2) - lumaLocalAverage;
+			reached2 = abs(lumaEnd2) >= gradientScaled;
+		}
+	}
+
+	float distance1 = horizontal ? position.x - end1.x : position.y - end1.y;
+	float distance2 = horizontal ? end2.x - position.x : end2.y - position.y;
+	bool closer1 = distance1 < distance2;
+	float pixelOffset = 0.5 - min(distance1, distance2) / (distance1 + distance2);
+	// only blend when the nearer end goes the other way than the center does
+	bool centerSmaller = lumaCenter < lumaLocalAverage;
+	bool correctVariation = ((closer1 ? lumaEnd1 : lumaEnd2) < 0.0) != centerSmaller;
+	float offset = correctVariation ? pixelOffset : 0.0;
+
+	float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners);
+	float subPixel = clamp(abs(lumaAverage - lumaCenter) / range, 0.0, 1.0);
+	subPixel = (-2.0 * subPixel + 3.0) * subPixel * subPixel;
+	offset = max(offset, subPixel * subPixel * SUBPIXEL_QUALITY);
+
+	vec2 blended = position + (horizontal ? vec2(0.0, offset * stepLength) : vec2(offset * stepLength, 0.0));
+	FragColor = vec4(tap(blended).rgb, 1.0);
+}
@@ -0,0 +1,20 @@
+#pragma once
+// sampling the bloom pyramid. Positions are in texels of 'image', 'size' is the part of
+// it that holds the picture (dynamic resolution only fills the bottom left), so reads
+// never reach past it.
+
+vec3 bloomTap(sampler2D image, vec2 position, vec2 size)
+{
+	return textureLod(image, clamp(position, vec2(0.5), size - 0.5) / vec2(textureSize(image, 0)), 0.0).rgb;
+}
+
+// 3x3 tent, 1 2 1 / 2 4 2 / 1 2 1, 'radius' in texels of 'image'
+vec3 bloomTent(sampler2D image, vec2 position, vec2 size, float radius)
+{
+	vec3 sum = bloomTap(image, position, size) * 4.0;
+	sum += (bloomTap(image, position + vec2(-radius, 0.0), size) + bloomTap(image, position + vec2(radius, 0.0), size)
+		+ bloomTap(image, position + vec2(0.0, -radius), size) + bloomTap(image, position + vec2(0.0, radius), size)) * 2.0;
+	sum += bloomTap(image, position + vec2(-radius, -radius), size) + bloomTap(image, position + vec2(radius, -radius), size)
+		+ bloomTap(image, position + vec2(-radius, radius), size) + bloomTap(image, position + vec2(radius, radius), size);
+	return sum * (1.0 / 16.0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+// Phong over LIGHT_COUNT point lights, the first one optionally shadowed
+#include "locations.glsl"
+#include "materials.glsl"
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
+LOCATION(8) uniform vec3 lightPositions[LIGHT_COUNT];
+LOCATION(16) uniform vec3 lightColors[LIGHT_COUNT];
+LOCATION(24) uniform vec3 viewPos;
+
+#ifdef SHADOWS
+BINDING(1) uniform sampler2D shadowMap;
+
+// 3x3 PCF over the depth map of the first light
+float shadowFactor(vec4 lightSpacePos, vec3 norm, vec3 lightDir)
+{
+    vec3 p = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    if (p.z > 1.0 || any(lessThan(p.xy, vec2(0.0))) || any(greaterThan(p.xy, vec2(1.0))))
+        return 1.0;
+    float bias = max(0.0005, 0.003 * (1.0 - dot(norm, lightDir)));
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0));
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            lit += p.z - bias > texture(shadowMap, p.xy + vec2(x, y) * texel).r ? 0.0 : 1.0;
+    return lit / 9.0;
+}
+#endif
+
+// 'shadow' is the visibility of the first light, 1.0 without shadows
+vec3 shade(MaterialData material, vec3 fragPos, vec3 norm, float shadow)
+{
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 result = vec3(0.0);
+    for (int i = 0; i < LIGHT_COUNT; i++)
+    {
+        vec3 ambient = material.colorAmbient.a * lightColors[i];
+
+        vec3 lightDir = normalize(lightPositions[i] - fragPos);
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * lightColors[i];
+
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.params.y);
+        vec3 specular = material.params.x * spec * lightColors[i];
+
+        float visible = i == 0 ? shadow : 1.0;
+        result += ambient + visible * (diffuse + specular);
+    }
+    return result;
+}
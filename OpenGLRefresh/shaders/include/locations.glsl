@@ -0,0 +1,14 @@
+#pragma once
+// explicit uniform locations and bindings for the SPIR-V ShaderCheck writes. Programs
+// from GL_ARB_gl_spirv have no names to look up, Shader reads the LOCATION numbers out
+// of the source instead and samplers and blocks come with their unit or binding point.
+// Plain GLSL 330 has neither and keeps going by name. Include before any declaration.
+#ifdef GL_SPIRV
+#extension GL_ARB_explicit_uniform_location : enable
+#extension GL_ARB_shading_language_420pack : enable
+#define LOCATION(n) layout(location = n)
+#define BINDING(n) layout(binding = n)
+#else
+#define LOCATION(n)
+#define BINDING(n)
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+// the material buffer of Materials.h and the texture sources a material can use
+#include "locations.glsl"
+
+#ifndef MAX_MATERIALS
+#define MAX_MATERIALS 256
+#endif
+
+// std140 copy of MaterialLibrary's buffer, indexed by the material id, bound to
+// MATERIAL_BLOCK_BINDING
+struct MaterialData
+{
+    vec4 colorAmbient; // rgb color, ambient strength
+    vec4 uvRect;       // texture rectangle: offset xy, scale zw
+    vec4 params;       // specular strength, shininess, array layer, bindless index
+};
+layout(std140) BINDING(0) uniform Materials
+{
+    MaterialData materials[MAX_MATERIALS];
+};
+
+#ifdef TEXTURED
+#if defined(BINDLESS_TEXTURES)
+// resident handles of BindlessTextureTable, bound to point 0
+layout(std430) BINDING(0) readonly buffer TextureHandles
+{
+    uvec2 textureHandles[];
+};
+#elif defined(TEXTURE_ARRAYS)
+BINDING(0) uniform sampler2DArray diffuseArray;
+#else
+BINDING(0) uniform sampler2D diffuseMap;
+#endif
+
+vec3 sampleDiffuse(MaterialData material, vec2 uv)
+{
+#if defined(BINDLESS_TEXTURES)
+    return texture(sampler2D(textureHandles[int(material.params.w)]), uv).rgb;
+#elif defined(TEXTURE_ARRAYS)
+    return texture(diffuseArray, vec3(material.uvRect.xy + fract(uv) * material.uvRect.zw, material.params.z)).rgb;
+#else
+    return texture(diffuseMap, material.uvRect.xy + uv * material.uvRect.zw).rgb;
+#endif
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+// vertex normal decoding for the encodings of VertexFormat.h
+
+#ifdef NORMAL_OCTAHEDRAL
+// inverse of the octahedral mapping in VertexFormat.h
+vec3 decodeNormal(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+#else
+vec3 decodeNormal(vec3 n)
+{
+	return n;
+}
+#endif
@@ -0,0 +1,18 @@
+#version 330 core
+// additive glow, white hot when emitted and cooling to a dim red
+#include "include/locations.glsl"
+in vec2 Corner;
+in float Age;
+
+out vec4 FragColor;
+
+LOCATION(4) uniform float intensity;
+
+void main()
+{
+	float falloff = 1.0 - dot(Corner, Corner);
+	if (falloff <= 0.0)
+		discard;
+	vec3 color = mix(vec3(1.0, 0.9, 0.6), vec3(0.8, 0.15, 0.05), Age);
+	FragColor = vec4(color * (intensity * falloff * falloff * (1.0 - Age)), 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+// camera facing quads, one instance per particle: the corner comes from gl_VertexID
+// (a strip of 4 vertices, no vertex buffer), the particle from the instance attribute
+#include "include/locations.glsl"
+layout (location = 0) in vec4 particle; // position, remaining life in seconds
+
+LOCATION(0) uniform mat4 projection;
+LOCATION(1) uniform mat4 view;
+LOCATION(2) uniform float size;
+LOCATION(3) uniform float lifetime;
+
+out vec2 Corner;
+out float Age; // 0 when emitted, 1 when it dies
+
+void main()
+{
+	Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	Age = clamp(1.0 - particle.w / lifetime, 0.0, 1.0);
+	// particles that died this frame are retired with the next one, until then they
+	// collapse to a point
+	float radius = particle.w > 0.0 ? size * (1.0 - 0.5 * Age) : 0.0;
+	vec4 eye = view * vec4(particle.xyz, 1.0);
+	eye.xy += Corner * radius;
+	gl_Position = projection * eye;
+}
@@ -1,33 +1,47 @@
 #version 330 core
+#include "include/locations.glsl"
 out vec4 FragColor;
-  
-uniform vec3 objectColor;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+
+#include "include/lighting.glsl"
 
 in vec3 Normal;
 in vec3 FragPos;
+flat in int MaterialIndex;
+#ifdef TEXTURED
+in vec2 TexCoord;
+#endif
+#ifdef SHADOWS
+in vec4 LightSpacePos;
+#endif
+#ifdef LOD_CROSSFADE
+// fade of the LOD being drawn: 0 outside of a transition, the fade of the incoming LOD
+// and minus that of the outgoing one while two are drawn
+LOCATION(4) uniform float lodFade;
+#endif
 
 void main()
 {
-    float ambientStrength = 0.2;
-    float specularStrength = 0.8;
-    vec3 ambient = ambientStrength * lightColor;
-    
+#ifdef LOD_CROSSFADE
+    if (lodFade != 0.0)
+    {
+        // screen door: the incoming LOD keeps the 4x4 Bayer cells under the fade
+        const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+        ivec2 cell = ivec2(gl_FragCoord.xy) & 3;
+        float dither = (bayer[cell.y * 4 + cell.x] + 0.5) / 16.0;
+        if ((lodFade > 0.0) != (dither < abs(lodFade)))
+            discard;
+    }
+#endif
+    MaterialData material = materials[MaterialIndex];
+    vec3 albedo = material.colorAmbient.rgb;
+#ifdef TEXTURED
+    albedo *= sampleDiffuse(material, TexCoord);
+#endif
 
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
-
-    
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm); 
-
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor; 
-
-    vec3 result = (ambient + diffuse + specular) * objectColor;
-    FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+    float shadow = 1.0;
+#ifdef SHADOWS
+    shadow = shadowFactor(LightSpacePos, norm, normalize(lightPositions[0] - FragPos));
+#endif
+    FragColor = vec4(shade(material, FragPos, norm, shadow) * albedo, 1.0);
+}
@@ -1,19 +1,54 @@
 #version 330 core
+#include "include/locations.glsl"
 layout (location = 0) in vec3 aPos;
+#ifdef NORMAL_OCTAHEDRAL
+layout (location = 1) in vec2 aNormal;
+#else
 layout (location = 1) in vec3 aNormal;
+#endif
+#ifdef HAS_UV
+layout (location = 2) in vec2 aTexCoord;
+#endif
 
 out vec3 Normal;
 out vec3 FragPos;
+flat out int MaterialIndex;
+#ifdef TEXTURED
+out vec2 TexCoord;
+#endif
+#ifdef SHADOWS
+out vec4 LightSpacePos;
+LOCATION(3) uniform mat4 lightSpace;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+LOCATION(0) uniform mat4 model;
+LOCATION(1) uniform mat4 view;
+LOCATION(2) uniform mat4 projection;
+// inverse transpose of the node transform without the dequantization, the normals are
+// stored apart from the positions (BakedMesh.h)
+LOCATION(32) uniform mat3 normalMatrix;
+
+#include "include/normals.glsl"
 
 void main()
 {
-	FragPos = vec3(model * vec4(aPos, 1.0f));
-	Normal = aNormal;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	// the material id is packed into the bottom row of the model matrix (Materials.h)
+	MaterialIndex = int(model[0][3] + 0.5);
+	mat4 world = model;
+	world[0][3] = 0.0;
 
-}
+	FragPos = vec3(world * vec4(aPos, 1.0f));
+	Normal = normalMatrix * decodeNormal(aNormal);
+#if defined(TEXTURED) && defined(HAS_UV)
+	TexCoord = aTexCoord;
+#elif defined(TEXTURED)
+	// a format without uvs, project the texture along the dominant normal axis
+	vec3 a = abs(Normal);
+	TexCoord = a.x > a.y && a.x > a.z ? aPos.zy : (a.y > a.z ? aPos.xz : aPos.xy);
+#endif
+#ifdef SHADOWS
+	LightSpacePos = lightSpace * vec4(FragPos, 1.0);
+#endif
+	gl_Position = projection * view * vec4(FragPos, 1.0);
 
+}
@@ -0,0 +1,39 @@
+#version 330 core
+// Robust contrast adaptive sharpening after FidelityFX Super Resolution 1 (RCAS), run
+// on the upscaled image at output size. The sharpening lobe is the largest one that
+// keeps the center within the range of its 4 neighbours, so it can't clip:
+//
+//     b
+//   d e f
+//     h
+#include "include/locations.glsl"
+out vec4 FragColor;
+
+BINDING(0) uniform sampler2D source;
+LOCATION(0) uniform float sharpness; // 0 is none, 1 the most
+
+vec3 tap(ivec2 position)
+{
+	return texelFetch(source, clamp(position, ivec2(0), textureSize(source, 0) - 1), 0).rgb;
+}
+
+void main()
+{
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	vec3 b = tap(p + ivec2(0, -1));
+	vec3 d = tap(p + ivec2(-1, 0));
+	vec3 e = tap(p);
+	vec3 f = tap(p + ivec2(1, 0));
+	vec3 h = tap(p + ivec2(0, 1));
+
+	vec3 mn4 = min(min(b, d), min(f, h));
+	vec3 mx4 = max(max(b, d), max(f, h));
+	// how far the lobe may go before the result leaves [0, 1]
+	vec3 hitMin = min(mn4, e) / (4.0 * mx4 + 1e-5);
+	vec3 hitMax = (1.0 - max(mx4, e)) / (4.0 * mn4 - 4.0 - 1e-5);
+	vec3 lobeRGB = max(-hitMin, hitMax);
+	// 0.25 - 1/16 caps the lobe where the filter would turn into a blur
+	float lobe = max(-0.1875, min(max(lobeRGB.r, max(lobeRGB.g, lobeRGB.b)), 0.0)) * sharpness;
+
+	FragColor = vec4((lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0), 1.0);
+}
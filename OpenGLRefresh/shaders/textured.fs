@@ -0,0 +1,47 @@
+#version 330 core
+#include "include/locations.glsl"
+out vec4 FragColor;
+
+LOCATION(4) uniform vec3 lightColor;
+LOCATION(5) uniform vec3 lightPos;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+
+// three ways to get at the material texture, picked with defines by the application
+#if defined(BINDLESS_TEXTURES)
+// resident handles from BindlessTextureTable, nothing is bound per draw
+layout(std430) BINDING(0) readonly buffer TextureHandles
+{
+    uvec2 textureHandles[];
+};
+LOCATION(6) uniform int textureIndex;
+#elif defined(TEXTURE_ARRAYS)
+// layer of a TextureArrays array, atlas entries also need their rectangle
+BINDING(0) uniform sampler2DArray diffuseArray;
+LOCATION(7) uniform float textureLayer;
+LOCATION(8) uniform vec4 uvRect;
+#else
+BINDING(0) uniform sampler2D diffuseMap;
+#endif
+
+vec4 sampleDiffuse(vec2 uv)
+{
+#if defined(BINDLESS_TEXTURES)
+    return texture(sampler2D(textureHandles[textureIndex]), uv);
+#elif defined(TEXTURE_ARRAYS)
+    return texture(diffuseArray, vec3(uvRect.xy + fract(uv) * uvRect.zw, textureLayer));
+#else
+    return texture(diffuseMap, uv);
+#endif
+}
+
+void main()
+{
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(lightPos - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 light = (0.2 + diff) * lightColor;
+    FragColor = vec4(sampleDiffuse(TexCoord).rgb * light, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// bilinear upscale of the dynamic resolution image, which only fills the bottom left
+// renderSize texels of the source
+#include "include/locations.glsl"
+in vec2 TexCoord;
+out vec4 FragColor;
+
+BINDING(0) uniform sampler2D source;
+LOCATION(0) uniform vec2 renderSize;
+
+void main()
+{
+	vec2 size = vec2(textureSize(source, 0));
+	// stay half a texel inside, the filter must not pull in what is outside the image
+	vec2 position = clamp(TexCoord * renderSize, vec2(0.5), renderSize - 0.5);
+	FragColor = vec4(texture(source, position / size).rgb, 1.0);
+}
@@ -0,0 +1,139 @@
+#version 330 core
+// Edge adaptive spatial upsampling after FidelityFX Super Resolution 1 (EASU). The 12
+// texels around the output position feed an analysis of the local edge direction and
+// strength; the kernel, an approximated Lanczos 2, gets stretched along that edge and
+// the result is clamped to the 4 nearest texels so it can't ring.
+//
+//     b c
+//   e f g h
+//   i j k l
+//     n o
+#include "include/locations.glsl"
+out vec4 FragColor;
+
+BINDING(0) uniform sampler2D source; // only the bottom left renderSize texels hold the image
+LOCATION(0) uniform vec2 renderSize;
+LOCATION(1) uniform vec2 outputSize;
+
+ivec2 maxTexel;
+
+vec3 tap(ivec2 position)
+{
+	return texelFetch(source, clamp(position, ivec2(0), maxTexel), 0).rgb;
+}
+
+// luma times 2, good enough for finding edges
+float luma(vec3 color)
+{
+	return color.b * 0.5 + (color.r * 0.5 + color.g);
+}
+
+// Direction and length of the edge at one of the 4 bilinear corners, weighted like the
+// bilinear filter would weigh that corner. l* is the '+' around it:
+//     a
+//   b c d
+//     e
+void analyze(inout vec2 dir, inout float len, float w, float lA, float lB, float lC, float lD, float lE)
+{
+	float dc = lD - lC;
+	float cb = lC - lB;
+	float lenX = max(abs(dc), abs(cb));
+	lenX = lenX > 0.0 ? 1.0 / lenX : 0.0;
+	float dirX = lD - lB;
+	dir.x += dirX * w;
+	lenX = clamp(abs(dirX) * lenX, 0.0, 1.0);
+	len += lenX * lenX * w;
+
+	float ec = lE - lC;
+	float ca = lC - lA;
+	float lenY = max(abs(ec), abs(ca));
+	lenY = lenY > 0.0 ? 1.0 / lenY : 0.0;
+	float dirY = lE - lA;
+	dir.y += dirY * w;
+	lenY = clamp(abs(dirY) * lenY, 0.0, 1.0);
+	len += lenY * lenY * w;
+}
+
+void accumulate(inout vec3 color, inout float weight, vec2 offset, vec2 dir, vec2 len, float lob, float clp, vec3 c)
+{
+	// rotate into the edge, then the anisotropic scale
+	vec2 v = vec2(offset.x * dir.x + offset.y * dir.y, offset.x * -dir.y + offset.y * dir.x) * len;
+	float d2 = min(dot(v, v), clp);
+	// Lanczos 2 without sin, rcp or sqrt:
+	// (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (lob * x^2 - 1)^2
+	float wB = 2.0 / 5.0 * d2 - 1.0;
+	float wA = lob * d2 - 1.0;
+	wB *= wB;
+	wA *= wA;
+	wB = 25.0 / 16.0 * wB - (25.0 / 16.0 - 1.0);
+	float w = wB * wA;
+	color += c * w;
+	weight += w;
+}
+
+void main()
+{
+	maxTexel = ivec2(renderSize) - 1;
+	vec2 position = gl_FragCoord.xy * renderSize / outputSize - 0.5;
+	vec2 base = floor(position);
+	vec2 pp = position - base;
+	ivec2 p = ivec2(base);
+
+	vec3 bC = tap(p + ivec2(0, -1));
+	vec3 cC = tap(p + ivec2(1, -1));
+	vec3 eC = tap(p + ivec2(-1, 0));
+	vec3 fC = tap(p);
+	vec3 gC = tap(p + ivec2(1, 0));
+	vec3 hC = tap(p + ivec2(2, 0));
+	vec3 iC = tap(p + ivec2(-1, 1));
+	vec3 jC = tap(p + ivec2(0, 1));
+	vec3 kC = tap(p + ivec2(1, 1));
+	vec3 lC = tap(p + ivec2(2, 1));
+	vec3 nC = tap(p + ivec2(0, 2));
+	vec3 oC = tap(p + ivec2(1, 2));
+
+	float bL = luma(bC), cL = luma(cC), eL = luma(eC), fL = luma(fC), gL = luma(gC), hL = luma(hC);
+	float iL = luma(iC), jL = luma(jC), kL = luma(kC), lL = luma(lC), nL = luma(nC), oL = luma(oC);
+
+	vec2 dir = vec2(0.0);
+	float len = 0.0;
+	analyze(dir, len, (1.0 - pp.x) * (1.0 - pp.y), bL, eL, fL, gL, jL);
+	analyze(dir, len, pp.x * (1.0 - pp.y), cL, fL, gL, hL, kL);
+	analyze(dir, len, (1.0 - pp.x) * pp.y, fL, iL, jL, kL, nL);
+	analyze(dir, len, pp.x * pp.y, gL, jL, kL, lL, oL);
+
+	// normalized direction, flat areas get an arbitrary one
+	float dirR = dot(dir, dir);
+	bool noEdge = dirR < 1.0 / 32768.0;
+	dir = noEdge ? vec2(1.0, 0.0) : dir * inversesqrt(dirR);
+
+	// edge strength from {0 to 2} to {0 to 1}, shaped with a square
+	len = len * 0.5;
+	len *= len;
+	// stretch 1 along the axes up to sqrt(2) on the diagonal
+	float stretch = dot(dir, dir) / max(abs(dir.x), abs(dir.y));
+	vec2 len2 = vec2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);
+	// the window goes from +/-sqrt(2) to a little beyond 2 with the amount of edge
+	float lob = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * len;
+	float clp = 1.0 / lob;
+
+	vec3 color = vec3(0.0);
+	float weight = 0.0;
+	accumulate(color, weight, vec2(0.0, -1.0) - pp, dir, len2, lob, clp, bC);
+	accumulate(color, weight, vec2(1.0, -1.0) - pp, dir, len2, lob, clp, cC);
+	accumulate(color, weight, vec2(-1.0, 1.0) - pp, dir, len2, lob, clp, iC);
+	accumulate(color, weight, vec2(0.0, 1.0) - pp, dir, len2, lob, clp, jC);
+	accumulate(color, weight, vec2(0.0, 0.0) - pp, dir, len2, lob, clp, fC);
+	accumulate(color, weight, vec2(-1.0, 0.0) - pp, dir, len2, lob, clp, eC);
+	accumulate(color, weight, vec2(1.0, 1.0) - pp, dir, len2, lob, clp, kC);
+	accumulate(color, weight, vec2(2.0, 1.0) - pp, dir, len2, lob, clp, lC);
+	accumulate(color, weight, vec2(2.0, 0.0) - pp, dir, len2, lob, clp, hC);
+	accumulate(color, weight, vec2(1.0, 0.0) - pp, dir, len2, lob, clp, gC);
+	accumulate(color, weight, vec2(1.0, 2.0) - pp, dir, len2, lob, clp, oC);
+	accumulate(color, weight, vec2(0.0, 2.0) - pp, dir, len2, lob, clp, nC);
+
+	// deringing
+	vec3 low = min(min(fC, gC), min(jC, kC));
+	vec3 high = max(max(fC, gC), max(jC, kC));
+	FragColor = vec4(clamp(color / weight, low, high), 1.0);
+}
@@ -0,0 +1,253 @@
+// ShaderCheck: validates every shader of the viewer offline with glslang, so a typo in
+// an include fails the build instead of printing a truncated log at startup. Runs as
+// post build step of this project, see ShaderCheck.vcxproj.
+//
+//   ShaderCheck <shader dir> [--spirv] [--optimize] [--tools <dir>]
+//
+// Shaders are checked with the define sets the viewer compiles them with, both take them
+// from ShaderVariants.h: every ShaderPermutation of shader.vs/shader.fs, the texture paths
+// of textured.fs, the post processing variants and the plain vertex format defines for
+// everything else.
+// --spirv writes SPIR-V for GL_ARB_gl_spirv, --optimize runs it through spirv-opt and
+// SPIRV-Cross back to GLSL 330 as well. Both land in <shader dir>/compiled, named like
+// compiledShaderPath() expects so the viewer finds them with --spirv.
+// The tools come with the Vulkan SDK: --tools, then %VULKAN_SDK%, then the PATH. Without
+// glslangValidator the check is skipped with a warning so the solution still builds on a
+// machine without the SDK; --spirv and --optimize fail instead, their outputs are asked for.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "ShaderPreprocessor.h"
+#include "ShaderVariants.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Tools
+{
+	std::string glslang = "glslangValidator";
+	std::string optimizer = "spirv-opt";
+	std::string cross = "spirv-cross";
+
+	void find(const std::string& directory)
+	{
+		std::filesystem::path dir = directory;
+		if (dir.empty())
+		{
+			const char* sdk = std::getenv("VULKAN_SDK");
+			if (!sdk)
+				return; // from the PATH
+			dir = std::filesystem::path(sdk) / "Bin";
+			if (!std::filesystem::exists(dir))
+				dir = std::filesystem::path(sdk) / "bin";
+		}
+		glslang = (dir / "glslangValidator").string();
+		optimizer = (dir / "spirv-opt").string();
+		cross = (dir / "spirv-cross").string();
+	}
+};
+
+struct CheckStats
+{
+	size_t checked = 0;
+	size_t skipped = 0; // same preprocessed code as one checked before
+	size_t failed = 0;
+	size_t compiled = 0;
+};
+
+static std::string quote(const std::string& text)
+{
+	return "\"" + text + "\"";
+}
+
+// runs 'command' with stdout and stderr in 'output', returns the exit code
+static int run(const std::string& command, const std::string& logPath, std::string& output)
+{
+	std::string line = command + " > " + quote(logPath) + " 2>&1";
+#ifdef _WIN32
+	// cmd.exe strips the first and last quote of the line
+	line = "\"" + line + "\"";
+#endif
+	int result = std::system(line.c_str());
+	std::ifstream log(logPath, std::ios::binary);
+	std::stringstream buffer;
+	buffer << log.rdbuf();
+	output = buffer.str();
+	log.close();
+	std::error_code error;
+	std::filesystem::remove(logPath, error);
+	return result;
+}
+
+static bool writeFile(const std::string& path, const std::string& text)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << text;
+	return (bool)file;
+}
+
+// validates one preprocessed stage, with --spirv/--optimize writes the compiled forms next to it
+static bool checkStage(const std::string& path, const PreprocessedShader& source, const char* stage, const std::string& label,
+	const Tools& tools, bool spirv, bool optimize, CheckStats& stats)
+{
+	std::string output = compiledShaderPath(path, source.code, stage);
+	std::string input = output + ".in.glsl";
+	std::string log = output + ".log";
+	if (!writeFile(input, source.code))
+	{
+		std::cout << "ERROR::SHADERCHECK::WRITE_FAILED " << input << std::endl;
+		stats.failed++;
+		return false;
+	}
+
+	std::string messages;
+	bool ok = run(quote(tools.glslang) + " -S " + stage + " " + quote(input), log, messages) == 0;
+	if (!ok)
+	{
+		std::cout << "ERROR::SHADERCHECK::" << path << " [" << label << "]\n" << source.remapLog(messages) << std::endl;
+		stats.failed++;
+	}
+	stats.checked++;
+
+	if (ok && (spirv || optimize))
+	{
+		std::string binary = output + ".spv";
+		// uniforms, samplers and blocks have explicit locations and bindings under GL_SPIRV
+		// (include/locations.glsl), the auto mapping only places the stage inputs and outputs
+		std::string command = quote(tools.glslang) + " -G --auto-map-locations --auto-map-bindings -S " + stage + " -o " + quote(binary) + " " + quote(input);
+		if (run(command, log, messages) != 0)
+		{
+			std::cout << "ERROR::SHADERCHECK::SPIRV " << path << " [" << label << "]\n" << source.remapLog(messages) << std::endl;
+			ok = false;
+		}
+		if (ok && optimize && run(quote(tools.optimizer) + " -O " + quote(binary) + " -o " + quote(binary), log, messages) != 0)
+		{
+			std::cout << "ERROR::SHADERCHECK::SPIRV_OPT " << path << " [" << label << "]\n" << messages << std::endl;
+			ok = false;
+		}
+		if (ok && optimize)
+		{
+			// back to GLSL for drivers without GL_ARB_gl_spirv, checked again since it is what they get
+			std::string glsl = output + ".glsl";
+			// compute needs 430, everything else stays on the 3.3 the context asks for
+			const char* version = std::strcmp(stage, "comp") == 0 ? "430" : "330";
+			if (run(quote(tools.cross) + " " + quote(binary) + " --version " + version + " --no-es --output " + quote(glsl), log, messages) != 0
+				|| run(quote(tools.glslang) + " -S " + stage + " " + quote(glsl), log, messages) != 0)
+			{
+				std::cout << "ERROR::SHADERCHECK::SPIRV_CROSS " << path << " [" << label << "]\n" << messages << std::endl;
+				std::error_code error;
+				std::filesystem::remove(glsl, error);
+				ok = false;
+			}
+		}
+		if (ok)
+			stats.compiled++;
+		else
+		{
+			// half written outputs would be picked up by the viewer
+			std::error_code error;
+			std::filesystem::remove(binary, error);
+			stats.failed++;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove(input, error);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: ShaderCheck <shader dir> [--spirv] [--optimize] [--tools <dir>]" << std::endl;
+		return 1;
+	}
+	std::string directory = argv[1];
+	bool spirv = false;
+	bool optimize = false;
+	std::string toolDirectory;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--spirv")
+			spirv = true;
+		if (arg == "--optimize")
+			optimize = true;
+		if (arg == "--tools" && i + 1 < argc)
+			toolDirectory = argv[++i];
+	}
+	Tools tools;
+	tools.find(toolDirectory);
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(directory) / "compiled", error);
+	if (error)
+	{
+		std::cout << "ERROR::SHADERCHECK::NO_OUTPUT_DIR " << directory << "/compiled" << std::endl;
+		return 1;
+	}
+
+	// once up front, otherwise every variant would fail on its own
+	std::string messages;
+	if (run(quote(tools.glslang) + " --version", (std::filesystem::path(directory) / "compiled" / "glslang.log").string(), messages) != 0)
+	{
+		if (spirv || optimize)
+		{
+			std::cout << "ERROR::SHADERCHECK::NO_GLSLANG " << tools.glslang << " does not run, install the Vulkan SDK or pass --tools" << std::endl;
+			return 1;
+		}
+		std::cout << "WARNING::SHADERCHECK::NO_GLSLANG " << tools.glslang << " does not run, shaders not validated (install the Vulkan SDK)" << std::endl;
+		return 0;
+	}
+
+	// the define sets come from the viewer's own lists so the code hashes match
+	std::string baseDefines = ShaderVariants::vertexFormat().shaderDefines();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	CheckStats stats;
+	std::set<std::string> seen;
+	ShaderPreprocessor preprocessor;
+	for (const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		std::string extension = entry.path().extension().string();
+		if (!entry.is_regular_file() || (extension != ".vs" && extension != ".fs" && extension != ".comp"))
+			continue; // include/ only holds pieces of shaders, they are checked through their users
+		std::string path = ShaderSourceCache::normalize(entry.path().string());
+		std::string name = entry.path().filename().string();
+		const char* stage = extension == ".vs" ? "vert" : extension == ".fs" ? "frag" : "comp";
+
+		for (const ShaderVariant& variant : ShaderVariants::forFile(name, baseDefines))
+		{
+			PreprocessedShader source = preprocessor.process(path, variant.defines);
+			if (!source.ok)
+			{
+				stats.failed++;
+				continue;
+			}
+			if (!seen.insert(compiledShaderPath(path, source.code, stage)).second)
+			{
+				stats.skipped++;
+				continue;
+			}
+			checkStage(path, source, stage, variant.label, tools, spirv, optimize, stats);
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "ShaderCheck: " << stats.checked << " shader variants checked (" << stats.skipped << " duplicates skipped), "
+		<< stats.failed << " failed";
+	if (spirv || optimize)
+		std::cout << ", " << stats.compiled << (optimize ? " optimized" : " compiled") << " to SPIR-V";
+	std::cout << " in " << seconds * 1000.0 << " ms" << std::endl;
+	return stats.failed == 0 ? 0 : 1;
+}